@@ -102,6 +102,11 @@ DebugOptions DefaultDebugOptionsIgnoringFlags() {
   opts.set_xla_gpu_normalize_layouts(true);
   opts.set_xla_gpu_simplify_all_fp_conversions(true);
   opts.set_xla_dump_latency_hiding_schedule(false);
+  opts.set_xla_cpu_persistent_cache_max_size_bytes(int64_t{4} << 30);
+  opts.set_xla_hlo_pass_computation_parallelism(1);
+  opts.set_xla_cpu_parallel_codegen_split_count(1);
+  opts.set_xla_cpu_enable_latency_hiding_scheduler(false);
+  opts.set_xla_cpu_enable_peak_memory_reordering(false);
   return opts;
 }
 
@@ -830,6 +835,82 @@ void MakeDebugOptionsFlags(std::vector<tsl::Flag>* flag_list,
       bool_setter_for(&DebugOptions::set_xla_dump_latency_hiding_schedule),
       debug_options->xla_dump_latency_hiding_schedule(),
       "Dump the schedule from the latency-hiding scheduler."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_persistent_cache_dir",
+      string_setter_for(&DebugOptions::set_xla_cpu_persistent_cache_dir),
+      debug_options->xla_cpu_persistent_cache_dir(),
+      "Directory in which the CPU client stores compiled executables so that "
+      "they can be reused by later processes. Empty disables the cache."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_persistent_cache_max_size_bytes",
+      int64_setter_for(
+          &DebugOptions::set_xla_cpu_persistent_cache_max_size_bytes),
+      debug_options->xla_cpu_persistent_cache_max_size_bytes(),
+      "Maximum total size of xla_cpu_persistent_cache_dir; the oldest entries "
+      "are evicted beyond it. Zero or less means unbounded."));
+  flag_list->push_back(tsl::Flag(
+      "xla_hlo_pass_computation_parallelism",
+      int32_setter_for(
+          &DebugOptions::set_xla_hlo_pass_computation_parallelism),
+      debug_options->xla_hlo_pass_computation_parallelism(),
+      "Number of threads used to run computation-local HLO passes over "
+      "independent computations of a module. One or less runs them serially."));
+  flag_list->push_back(tsl::Flag(
+      "xla_dump_hlo_pass_profile",
+      bool_setter_for(&DebugOptions::set_xla_dump_hlo_pass_profile),
+      debug_options->xla_dump_hlo_pass_profile(),
+      "Dump the wall time, instruction counts and peak RSS growth of every HLO "
+      "pass run by a top-level pass pipeline, as JSON and as a Perfetto "
+      "trace."));
+  flag_list->push_back(tsl::Flag(
+      "xla_algebraic_simplifier_use_worklist",
+      bool_setter_for(&DebugOptions::set_xla_algebraic_simplifier_use_worklist),
+      debug_options->xla_algebraic_simplifier_use_worklist(),
+      "Revisit only the instructions affected by each algebraic "
+      "simplification until the module reaches a fixed point, instead of "
+      "re-running the simplifier over whole computations."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_parallel_codegen_split_count",
+      int32_setter_for(
+          &DebugOptions::set_xla_cpu_parallel_codegen_split_count),
+      debug_options->xla_cpu_parallel_codegen_split_count(),
+      "Number of LLVM modules the CPU backend splits its IR into to optimize "
+      "and compile them concurrently. One or less disables splitting."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_enable_latency_hiding_scheduler",
+      bool_setter_for(
+          &DebugOptions::set_xla_cpu_enable_latency_hiding_scheduler),
+      debug_options->xla_cpu_enable_latency_hiding_scheduler(),
+      "Reorder the CPU schedule with the latency-hiding scheduler. The CPU "
+      "pipeline does not lower collectives or host transfers to asynchronous "
+      "pairs yet, so this is currently a no-op."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_enable_peak_memory_reordering",
+      bool_setter_for(&DebugOptions::set_xla_cpu_enable_peak_memory_reordering),
+      debug_options->xla_cpu_enable_peak_memory_reordering(),
+      "Lower the peak memory of the CPU schedule by moving instructions around "
+      "the peak of each computation."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_latency_estimator_flops_per_second",
+      int64_setter_for(
+          &DebugOptions::set_xla_cpu_latency_estimator_flops_per_second),
+      debug_options->xla_cpu_latency_estimator_flops_per_second(),
+      "Arithmetic throughput assumed by the CPU latency-hiding scheduler. Zero "
+      "or less keeps the built-in default."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_latency_estimator_bytes_per_second",
+      int64_setter_for(
+          &DebugOptions::set_xla_cpu_latency_estimator_bytes_per_second),
+      debug_options->xla_cpu_latency_estimator_bytes_per_second(),
+      "Memory and collective bandwidth assumed by the CPU latency-hiding "
+      "scheduler. Zero or less keeps the built-in default."));
+  flag_list->push_back(tsl::Flag(
+      "xla_cpu_latency_estimator_collective_latency_ns",
+      int64_setter_for(
+          &DebugOptions::set_xla_cpu_latency_estimator_collective_latency_ns),
+      debug_options->xla_cpu_latency_estimator_collective_latency_ns(),
+      "Fixed latency of a collective, in nanoseconds, assumed by the CPU "
+      "latency-hiding scheduler. Zero or less keeps the built-in default."));
 }  // NOLINT(readability/fn_size)
 
 // Allocates flag_values and flag_objects; this function must not be called more
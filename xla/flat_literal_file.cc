@@ -0,0 +1,261 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/flat_literal_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/string_view.h"
+#include "xla/layout_util.h"
+#include "xla/shape.h"
+#include "xla/shape_util.h"
+#include "xla/util.h"
+#include "xla/xla_data.pb.h"
+#include "tsl/platform/byte_order.h"
+#include "tsl/platform/coding.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/raw_coding.h"
+
+namespace xla {
+namespace {
+
+constexpr absl::string_view kMagic("XLAFLAT\0", 8);
+constexpr uint32_t kVersion = 1;
+// magic, version, alignment, shape_size and num_buffers.
+constexpr size_t kHeaderSize = 8 + 4 + 4 + 8 + 8;
+constexpr size_t kBufferEntrySize = 8 + 8;
+
+int64_t RoundUpToAlignment(int64_t offset, int64_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Size in bytes of the buffer stored for the array subshape `shape`.
+int64_t BufferSize(const Shape& shape) {
+  int64_t size = ShapeUtil::ByteSizeOf(shape);
+  if (shape.is_dynamic()) {
+    size += shape.dimensions_size() * sizeof(int32_t);
+  }
+  return size;
+}
+
+Status CheckLittleEndian() {
+  if (!tsl::port::kLittleEndian) {
+    return Unimplemented(
+        "Flat literal files are only supported on little-endian hosts");
+  }
+  return OkStatus();
+}
+
+}  // namespace
+
+/*static*/ bool FlatLiteralFile::HasMagic(absl::string_view contents) {
+  return absl::StartsWith(contents, kMagic);
+}
+
+/*static*/ StatusOr<bool> FlatLiteralFile::IsFlatLiteralFile(
+    const std::string& path, tsl::Env* env) {
+  std::unique_ptr<tsl::RandomAccessFile> file;
+  TF_RETURN_IF_ERROR(env->NewRandomAccessFile(path, &file));
+  char scratch[kMagic.size()];
+  absl::string_view contents;
+  Status status = file->Read(0, kMagic.size(), &contents, scratch);
+  // Reading past the end of a short file is not an error here.
+  if (!status.ok() && !tsl::errors::IsOutOfRange(status)) {
+    return status;
+  }
+  return HasMagic(contents);
+}
+
+/*static*/ Status FlatLiteralFile::Write(const LiteralSlice& literal,
+                                         const std::string& path,
+                                         tsl::Env* env) {
+  TF_RETURN_IF_ERROR(CheckLittleEndian());
+  const Shape& shape = literal.shape();
+  if (!shape.IsTuple() && !shape.IsArray()) {
+    return Unimplemented("Unsupported literal shape %s",
+                         ShapeUtil::HumanString(shape));
+  }
+  std::vector<ShapeIndex> buffer_indices;
+  Status status = OkStatus();
+  ShapeUtil::ForEachSubshape(
+      shape, [&](const Shape& subshape, const ShapeIndex& index) {
+        if (subshape.IsArray()) {
+          if (!LayoutUtil::IsDenseArray(subshape)) {
+            status = Unimplemented("Unsupported array shape %s in literal",
+                                   ShapeUtil::HumanStringWithLayout(subshape));
+          }
+          buffer_indices.push_back(index);
+        }
+      });
+  TF_RETURN_IF_ERROR(status);
+
+  std::string shape_bytes;
+  if (!shape.ToProto().SerializeToString(&shape_bytes)) {
+    return Internal("Failed to serialize the shape of a literal");
+  }
+
+  // The header and buffer table, followed by the shape and the padding up to
+  // the first buffer.
+  const int64_t metadata_size = kHeaderSize +
+                                buffer_indices.size() * kBufferEntrySize +
+                                shape_bytes.size();
+  std::string metadata(kHeaderSize + buffer_indices.size() * kBufferEntrySize,
+                       '\0');
+  char* header = metadata.data();
+  std::copy(kMagic.begin(), kMagic.end(), header);
+  tsl::core::EncodeFixed32(header + 8, kVersion);
+  tsl::core::EncodeFixed32(header + 12, kAlignment);
+  tsl::core::EncodeFixed64(header + 16, shape_bytes.size());
+  tsl::core::EncodeFixed64(header + 24, buffer_indices.size());
+  int64_t offset = RoundUpToAlignment(metadata_size, kAlignment);
+  std::vector<int64_t> offsets;
+  offsets.reserve(buffer_indices.size());
+  for (int64_t i = 0; i < buffer_indices.size(); ++i) {
+    const int64_t size =
+        BufferSize(ShapeUtil::GetSubshape(shape, buffer_indices[i]));
+    char* entry = header + kHeaderSize + i * kBufferEntrySize;
+    tsl::core::EncodeFixed64(entry, offset);
+    tsl::core::EncodeFixed64(entry + 8, size);
+    offsets.push_back(offset);
+    offset = RoundUpToAlignment(offset + size, kAlignment);
+  }
+  metadata.append(shape_bytes);
+
+  std::unique_ptr<tsl::WritableFile> file;
+  TF_RETURN_IF_ERROR(env->NewWritableFile(path, &file));
+  TF_RETURN_IF_ERROR(file->Append(metadata));
+  int64_t written = metadata.size();
+  const std::string padding(kAlignment, '\0');
+  for (int64_t i = 0; i < buffer_indices.size(); ++i) {
+    TF_RETURN_IF_ERROR(file->Append(
+        absl::string_view(padding.data(), offsets[i] - written)));
+    const ShapeIndex& index = buffer_indices[i];
+    const Shape& subshape = ShapeUtil::GetSubshape(shape, index);
+    const int64_t dense_size = ShapeUtil::ByteSizeOf(subshape);
+    TF_RETURN_IF_ERROR(file->Append(absl::string_view(
+        static_cast<const char*>(literal.untyped_data(index)), dense_size)));
+    if (subshape.is_dynamic()) {
+      std::string dynamic_sizes(subshape.dimensions_size() * sizeof(int32_t),
+                                '\0');
+      for (int64_t dim = 0; dim < subshape.dimensions_size(); ++dim) {
+        tsl::core::EncodeFixed32(dynamic_sizes.data() + dim * sizeof(int32_t),
+                                 literal.GetDynamicSize(dim, index));
+      }
+      TF_RETURN_IF_ERROR(file->Append(dynamic_sizes));
+    }
+    written = offsets[i] + BufferSize(subshape);
+  }
+  return file->Close();
+}
+
+/*static*/ StatusOr<std::unique_ptr<FlatLiteralFile>> FlatLiteralFile::Open(
+    const std::string& path, tsl::Env* env) {
+  TF_RETURN_IF_ERROR(CheckLittleEndian());
+  std::unique_ptr<tsl::ReadOnlyMemoryRegion> region;
+  TF_RETURN_IF_ERROR(env->NewReadOnlyMemoryRegionFromFile(path, &region));
+  const char* data = static_cast<const char*>(region->data());
+  const uint64_t length = region->length();
+
+  if (length < kHeaderSize || !HasMagic(absl::string_view(data, length))) {
+    return InvalidArgument("%s is not a flat literal file", path);
+  }
+  const uint32_t version = tsl::core::DecodeFixed32(data + 8);
+  if (version != kVersion) {
+    return Unimplemented("%s has unsupported flat literal version %u", path,
+                         version);
+  }
+  const uint32_t alignment = tsl::core::DecodeFixed32(data + 12);
+  const uint64_t shape_size = tsl::core::DecodeFixed64(data + 16);
+  const uint64_t num_buffers = tsl::core::DecodeFixed64(data + 24);
+  if (num_buffers > (length - kHeaderSize) / kBufferEntrySize ||
+      shape_size > length - kHeaderSize - num_buffers * kBufferEntrySize) {
+    return InvalidArgument("%s is truncated", path);
+  }
+  // Buffers are accessed in place as typed arrays, so they must be at least as
+  // aligned as Write places them. Mapped regions start at a page boundary.
+  if (alignment == 0 || alignment % kAlignment != 0) {
+    return InvalidArgument("%s has unsupported buffer alignment %u", path,
+                           alignment);
+  }
+  if (reinterpret_cast<uintptr_t>(data) % kAlignment != 0) {
+    return Internal("%s is not mapped at a %d byte boundary", path,
+                    kAlignment);
+  }
+
+  ShapeProto shape_proto;
+  if (!shape_proto.ParseFromArray(
+          data + kHeaderSize + num_buffers * kBufferEntrySize, shape_size)) {
+    return InvalidArgument("%s has a malformed shape", path);
+  }
+  Shape shape(shape_proto);
+  TF_RETURN_IF_ERROR(ShapeUtil::ValidateShapeWithOptionalLayout(shape));
+  if (!shape.IsTuple() && !shape.IsArray()) {
+    return InvalidArgument("%s has unsupported shape %s", path,
+                           ShapeUtil::HumanString(shape));
+  }
+  if (!LayoutUtil::HasLayout(shape)) {
+    return InvalidArgument("%s has a shape without layout: %s", path,
+                           ShapeUtil::HumanString(shape));
+  }
+
+  std::vector<const char*> buffers;
+  Status status = OkStatus();
+  ShapeUtil::ForEachSubshape(
+      shape, [&](const Shape& subshape, const ShapeIndex& index) {
+        if (!subshape.IsArray() || !status.ok()) {
+          return;
+        }
+        const int64_t i = buffers.size();
+        if (i >= num_buffers) {
+          status = InvalidArgument("%s has too few buffers", path);
+          return;
+        }
+        const char* entry = data + kHeaderSize + i * kBufferEntrySize;
+        const uint64_t offset = tsl::core::DecodeFixed64(entry);
+        const uint64_t size = tsl::core::DecodeFixed64(entry + 8);
+        if (size != BufferSize(subshape) || offset > length ||
+            size > length - offset) {
+          status = InvalidArgument("%s has an invalid buffer for %s", path,
+                                   index.ToString());
+          return;
+        }
+        if (offset % alignment != 0) {
+          status = InvalidArgument("%s has a misaligned buffer for %s", path,
+                                   index.ToString());
+          return;
+        }
+        buffers.push_back(data + offset);
+      });
+  TF_RETURN_IF_ERROR(status);
+  if (buffers.size() != num_buffers) {
+    return InvalidArgument("%s has %u buffers, but its shape %s needs %u", path,
+                           num_buffers, ShapeUtil::HumanString(shape),
+                           buffers.size());
+  }
+
+  BorrowingLiteral literal = shape.IsTuple()
+                                 ? BorrowingLiteral(buffers, shape)
+                                 : BorrowingLiteral(buffers[0], shape);
+  return std::unique_ptr<FlatLiteralFile>(
+      new FlatLiteralFile(std::move(region), std::move(literal)));
+}
+
+}  // namespace xla
@@ -0,0 +1,87 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_FLAT_LITERAL_FILE_H_
+#define TENSORFLOW_COMPILER_XLA_FLAT_LITERAL_FILE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "xla/literal.h"
+#include "xla/statusor.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/status.h"
+
+namespace xla {
+
+// A literal stored in a flat binary file that can be memory-mapped and used
+// without copying or parsing its payload. Unlike LiteralProto, the format is
+// not limited to 2GB.
+//
+// All integers are little-endian. The file is laid out as:
+//
+//   char     magic[8]        "XLAFLAT\0"
+//   uint32   version         currently 1
+//   uint32   alignment       alignment of every buffer offset
+//   uint64   shape_size      size of the serialized ShapeProto
+//   uint64   num_buffers
+//   struct { uint64 offset; uint64 size; } buffers[num_buffers]
+//   byte     shape[shape_size]
+//   ...      the buffers, each at an offset that is a multiple of alignment
+//
+// The shape includes layouts. There is one buffer for each array subshape, in
+// the order of ShapeUtil::ForEachSubshape, holding the array in its layout.
+// For dynamically shaped arrays the buffer is followed by the int32 dynamic
+// sizes of each dimension, as in the literal's in-memory representation.
+class FlatLiteralFile {
+ public:
+  // Alignment of the buffers written by Write.
+  static constexpr int64_t kAlignment = 64;
+
+  // Writes `literal` to the file at `path`, streaming its buffers without
+  // building the file in memory.
+  static Status Write(const LiteralSlice& literal, const std::string& path,
+                      tsl::Env* env = tsl::Env::Default());
+
+  // Maps the file at `path` into memory and wraps it as a literal.
+  static StatusOr<std::unique_ptr<FlatLiteralFile>> Open(
+      const std::string& path, tsl::Env* env = tsl::Env::Default());
+
+  // Returns whether `contents` starts like a flat literal file, which can be
+  // used to tell it apart from a serialized LiteralProto.
+  static bool HasMagic(absl::string_view contents);
+
+  // Returns whether the file at `path` starts like a flat literal file.
+  static StatusOr<bool> IsFlatLiteralFile(const std::string& path,
+                                          tsl::Env* env = tsl::Env::Default());
+
+  // The literal, which points into the mapped file and is valid for as long as
+  // this object is alive.
+  const LiteralBase& literal() const { return literal_; }
+
+ private:
+  FlatLiteralFile(std::unique_ptr<tsl::ReadOnlyMemoryRegion> region,
+                  BorrowingLiteral literal)
+      : region_(std::move(region)), literal_(std::move(literal)) {}
+
+  std::unique_ptr<tsl::ReadOnlyMemoryRegion> region_;
+  BorrowingLiteral literal_;
+};
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_FLAT_LITERAL_FILE_H_
@@ -0,0 +1,129 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/flat_literal_file.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "xla/layout_util.h"
+#include "xla/literal.h"
+#include "xla/literal_util.h"
+#include "xla/shape_util.h"
+#include "xla/test.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/statusor.h"
+
+namespace xla {
+namespace {
+
+std::string TempPath() {
+  std::string path;
+  CHECK(tsl::Env::Default()->LocalTempFilename(&path));
+  return path;
+}
+
+StatusOr<std::unique_ptr<FlatLiteralFile>> RoundTrip(
+    const LiteralSlice& literal) {
+  std::string path = TempPath();
+  TF_RETURN_IF_ERROR(FlatLiteralFile::Write(literal, path));
+  return FlatLiteralFile::Open(path);
+}
+
+TEST(FlatLiteralFileTest, RoundTripsArray) {
+  Literal literal = LiteralUtil::CreateR2WithLayout<float>(
+      {{1.0f, 2.0f, 3.0f}, {4.0f, 5.0f, 6.0f}}, LayoutUtil::MakeLayout({0, 1}));
+  TF_ASSERT_OK_AND_ASSIGN(auto file, RoundTrip(literal));
+  EXPECT_TRUE(ShapeUtil::Equal(file->literal().shape(), literal.shape()));
+  EXPECT_EQ(file->literal(), literal);
+  // The buffer is used in place and is aligned.
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(file->literal().untyped_data()) %
+                FlatLiteralFile::kAlignment,
+            0);
+}
+
+TEST(FlatLiteralFileTest, RoundTripsNestedTuple) {
+  Literal literal = LiteralUtil::MakeTupleOwned(
+      LiteralUtil::MakeTupleOwned(LiteralUtil::CreateR1<int8_t>({1, 2, 3}),
+                                  LiteralUtil::CreateR0<bool>(true)),
+      LiteralUtil::CreateR1<bfloat16>({}),
+      LiteralUtil::CreateR2<double>({{1.5, 2.5}, {3.5, 4.5}}),
+      LiteralUtil::MakeTupleOwned(std::vector<Literal>()));
+  TF_ASSERT_OK_AND_ASSIGN(auto file, RoundTrip(literal));
+  EXPECT_EQ(file->literal(), literal);
+  EXPECT_EQ(file->literal().Get<double>({1, 0}, {2}), 3.5);
+}
+
+TEST(FlatLiteralFileTest, RoundTripsDynamicShape) {
+  Literal literal = LiteralUtil::CreateR2<int32_t>({{1, 2, 3}, {4, 5, 6}});
+  literal.SetDynamicSize(1, 2);
+  TF_ASSERT_OK_AND_ASSIGN(auto file, RoundTrip(literal));
+  EXPECT_EQ(file->literal().GetDynamicSize(1), 2);
+  EXPECT_EQ(file->literal(), literal);
+}
+
+TEST(FlatLiteralFileTest, DetectsFormat) {
+  Literal literal = LiteralUtil::CreateR1<float>({1.0f, 2.0f});
+  std::string flat_path = TempPath();
+  TF_ASSERT_OK(FlatLiteralFile::Write(literal, flat_path));
+  std::string proto_path = TempPath();
+  TF_ASSERT_OK(tsl::WriteBinaryProto(tsl::Env::Default(), proto_path,
+                                     literal.ToProto()));
+
+  TF_ASSERT_OK_AND_ASSIGN(bool is_flat,
+                          FlatLiteralFile::IsFlatLiteralFile(flat_path));
+  EXPECT_TRUE(is_flat);
+  TF_ASSERT_OK_AND_ASSIGN(is_flat,
+                          FlatLiteralFile::IsFlatLiteralFile(proto_path));
+  EXPECT_FALSE(is_flat);
+  EXPECT_FALSE(FlatLiteralFile::Open(proto_path).ok());
+}
+
+TEST(FlatLiteralFileTest, RejectsCorruptFiles) {
+  Literal literal = LiteralUtil::CreateR1<float>({1.0f, 2.0f, 3.0f});
+  std::string path = TempPath();
+  TF_ASSERT_OK(FlatLiteralFile::Write(literal, path));
+  std::string contents;
+  TF_ASSERT_OK(tsl::ReadFileToString(tsl::Env::Default(), path, &contents));
+
+  // Truncated payload.
+  TF_ASSERT_OK(tsl::WriteStringToFile(tsl::Env::Default(), path,
+                                      contents.substr(0, contents.size() - 4)));
+  EXPECT_FALSE(FlatLiteralFile::Open(path).ok());
+
+  // Unknown version.
+  std::string future = contents;
+  future[8] = 2;
+  TF_ASSERT_OK(tsl::WriteStringToFile(tsl::Env::Default(), path, future));
+  EXPECT_FALSE(FlatLiteralFile::Open(path).ok());
+
+  // Buffers aligned to less than FlatLiteralFile::kAlignment.
+  std::string misaligned = contents;
+  misaligned[12] = 4;
+  misaligned[13] = 0;
+  TF_ASSERT_OK(tsl::WriteStringToFile(tsl::Env::Default(), path, misaligned));
+  EXPECT_FALSE(FlatLiteralFile::Open(path).ok());
+
+  // Truncated header.
+  TF_ASSERT_OK(tsl::WriteStringToFile(tsl::Env::Default(), path,
+                                      contents.substr(0, 20)));
+  EXPECT_FALSE(FlatLiteralFile::Open(path).ok());
+}
+
+}  // namespace
+}  // namespace xla
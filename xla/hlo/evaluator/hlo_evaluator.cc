@@ -15,6 +15,7 @@ limitations under the License.
 #include "xla/hlo/evaluator/hlo_evaluator.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <complex>
 #include <cstdint>
@@ -32,10 +33,12 @@ limitations under the License.
 #include "absl/algorithm/container.h"
 #include "absl/base/internal/endian.h"
 #include "absl/cleanup/cleanup.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/inlined_vector.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/span.h"
 #include "xla/hlo/evaluator/hlo_evaluator_typed_visitor.h"
 #include "xla/hlo/ir/hlo_casting_utils.h"
@@ -72,115 +75,87 @@ namespace xla {
 
 namespace {
 
-template <typename OperandT>
-StatusOr<Literal> Compare(const Shape& shape, ComparisonDirection direction,
-                          LiteralSlice lhs_literal, LiteralSlice rhs_literal) {
-  std::function<bool(OperandT, OperandT)> compare_op;
-  switch (direction) {
-    case ComparisonDirection::kEq:
-      compare_op = [](OperandT lhs_el, OperandT rhs_el) {
-        return lhs_el == rhs_el;
-      };
-      break;
-    case ComparisonDirection::kNe:
-      compare_op = [](OperandT lhs_el, OperandT rhs_el) {
-        return lhs_el != rhs_el;
-      };
-      break;
-    case ComparisonDirection::kGe:
-      compare_op = [](OperandT lhs_el, OperandT rhs_el) {
-        return lhs_el >= rhs_el;
-      };
-      break;
-    case ComparisonDirection::kGt:
-      compare_op = [](OperandT lhs_el, OperandT rhs_el) {
-        return lhs_el > rhs_el;
-      };
-      break;
-    case ComparisonDirection::kLe:
-      compare_op = [](OperandT lhs_el, OperandT rhs_el) {
-        return lhs_el <= rhs_el;
-      };
-      break;
-    case ComparisonDirection::kLt:
-      compare_op = [](OperandT lhs_el, OperandT rhs_el) {
-        return lhs_el < rhs_el;
-      };
-      break;
-  }
-
+// Populates a PRED literal of the given shape with `compare_op` applied to
+// each pair of elements. When both operands are laid out like the result, the
+// flat buffers are compared with a single linear index.
+template <typename OperandT, typename CompareOp>
+StatusOr<Literal> PopulateComparison(const Shape& shape,
+                                     const CompareOp& compare_op,
+                                     const LiteralSlice& lhs_literal,
+                                     const LiteralSlice& rhs_literal) {
   Literal result(shape);
-  TF_RETURN_IF_ERROR(
-      result.Populate<bool>([&](absl::Span<const int64_t> multi_index) {
+  if (HasSameLinearLayout(result.shape(), lhs_literal.shape()) &&
+      HasSameLinearLayout(result.shape(), rhs_literal.shape())) {
+    const OperandT* lhs_data = lhs_literal.data<OperandT>().data();
+    const OperandT* rhs_data = rhs_literal.data<OperandT>().data();
+    bool* result_data = result.data<bool>().data();
+    ForEachLinearRangeParallel(
+        result.element_count(), [&](int64_t begin, int64_t end) {
+          for (int64_t i = begin; i < end; ++i) {
+            result_data[i] = compare_op(lhs_data[i], rhs_data[i]);
+          }
+        });
+    return std::move(result);
+  }
+  TF_RETURN_IF_ERROR(result.PopulateParallel<bool>(
+      [&](absl::Span<const int64_t> multi_index, int) {
         return compare_op(lhs_literal.Get<OperandT>(multi_index),
                           rhs_literal.Get<OperandT>(multi_index));
       }));
-
-  return std::move(result);
-}
-
-template <>
-StatusOr<Literal> Compare<complex64>(const Shape& shape,
-                                     ComparisonDirection direction,
-                                     LiteralSlice lhs_literal,
-                                     LiteralSlice rhs_literal) {
-  std::function<bool(complex64, complex64)> compare_op;
-  switch (direction) {
-    case ComparisonDirection::kEq:
-      compare_op = [](complex64 lhs_el, complex64 rhs_el) {
-        return lhs_el == rhs_el;
-      };
-      break;
-    case ComparisonDirection::kNe:
-      compare_op = [](complex64 lhs_el, complex64 rhs_el) {
-        return lhs_el != rhs_el;
-      };
-      break;
-    default:
-      LOG(FATAL) << "unhandled direction for conversion to Comparison: "
-                 << ComparisonDirectionToString(direction);
-  }
-
-  Literal result(shape);
-  TF_RETURN_IF_ERROR(
-      result.Populate<bool>([&](absl::Span<const int64_t> multi_index) {
-        return compare_op(lhs_literal.Get<complex64>(multi_index),
-                          rhs_literal.Get<complex64>(multi_index));
-      }));
-
   return std::move(result);
 }
 
-template <>
-StatusOr<Literal> Compare<complex128>(const Shape& shape,
-                                      ComparisonDirection direction,
-                                      LiteralSlice lhs_literal,
-                                      LiteralSlice rhs_literal) {
-  std::function<bool(complex128, complex128)> compare_op;
-  switch (direction) {
-    case ComparisonDirection::kEq:
-      compare_op = [](complex128 lhs_el, complex128 rhs_el) {
-        return lhs_el == rhs_el;
-      };
-      break;
-    case ComparisonDirection::kNe:
-      compare_op = [](complex128 lhs_el, complex128 rhs_el) {
-        return lhs_el != rhs_el;
-      };
-      break;
-    default:
-      LOG(FATAL) << "unhandled direction for conversion to Comparison: "
-                 << ComparisonDirectionToString(direction);
+template <typename OperandT>
+StatusOr<Literal> Compare(const Shape& shape, ComparisonDirection direction,
+                          LiteralSlice lhs_literal, LiteralSlice rhs_literal) {
+  auto populate = [&](const auto& compare_op) {
+    return PopulateComparison<OperandT>(shape, compare_op, lhs_literal,
+                                        rhs_literal);
+  };
+  if constexpr (is_complex_v<OperandT>) {
+    switch (direction) {
+      case ComparisonDirection::kEq:
+        return populate([](OperandT lhs_el, OperandT rhs_el) {
+          return lhs_el == rhs_el;
+        });
+      case ComparisonDirection::kNe:
+        return populate([](OperandT lhs_el, OperandT rhs_el) {
+          return lhs_el != rhs_el;
+        });
+      default:
+        LOG(FATAL) << "unhandled direction for conversion to Comparison: "
+                   << ComparisonDirectionToString(direction);
+    }
+  } else {
+    switch (direction) {
+      case ComparisonDirection::kEq:
+        return populate([](OperandT lhs_el, OperandT rhs_el) {
+          return lhs_el == rhs_el;
+        });
+      case ComparisonDirection::kNe:
+        return populate([](OperandT lhs_el, OperandT rhs_el) {
+          return lhs_el != rhs_el;
+        });
+      case ComparisonDirection::kGe:
+        return populate([](OperandT lhs_el, OperandT rhs_el) {
+          return lhs_el >= rhs_el;
+        });
+      case ComparisonDirection::kGt:
+        return populate([](OperandT lhs_el, OperandT rhs_el) {
+          return lhs_el > rhs_el;
+        });
+      case ComparisonDirection::kLe:
+        return populate([](OperandT lhs_el, OperandT rhs_el) {
+          return lhs_el <= rhs_el;
+        });
+      case ComparisonDirection::kLt:
+        return populate([](OperandT lhs_el, OperandT rhs_el) {
+          return lhs_el < rhs_el;
+        });
+    }
   }
-
-  Literal result(shape);
-  TF_RETURN_IF_ERROR(
-      result.Populate<bool>([&](absl::Span<const int64_t> multi_index) {
-        return compare_op(lhs_literal.Get<complex128>(multi_index),
-                          rhs_literal.Get<complex128>(multi_index));
-      }));
-
-  return std::move(result);
+  return InvalidArgument("Unknown comparison direction: %s",
+                         ComparisonDirectionToString(direction));
 }
 
 std::optional<bool> GetInstructionStaticValueAsBool(
@@ -850,6 +825,123 @@ HloEvaluator::HloEvaluator(int64_t max_loop_iterations)
       });
 }
 
+namespace {
+
+// Bounds on the released literals kept around for reuse by a single
+// evaluation. The count keeps the search in Allocate short; the bytes bound how
+// much memory is held beyond the live results.
+constexpr int64_t kMaxFreeLiterals = 8;
+constexpr int64_t kMaxFreeLiteralBytes = 64 * 1024 * 1024;
+
+int64_t LiteralSizeInBytes(const Literal& literal) {
+  int64_t size = 0;
+  ShapeUtil::ForEachSubshape(
+      literal.shape(), [&](const Shape& subshape, const ShapeIndex& index) {
+        if (subshape.IsArray()) {
+          size += ShapeUtil::ByteSizeOfElements(subshape);
+        }
+      });
+  return size;
+}
+
+}  // namespace
+
+HloEvaluator::EvaluatedLiterals::~EvaluatedLiterals() {
+  absl::MutexLock lock(&mu_);
+  for (const auto& [hlo, size] : recorded_bytes_) {
+    memory_usage_->Add(-size);
+  }
+}
+
+void HloEvaluator::EvaluatedLiterals::RecordSize(const HloInstruction* hlo) {
+  absl::MutexLock lock(&mu_);
+  int64_t size = LiteralSizeInBytes(literals_.at(hlo));
+  int64_t& recorded = recorded_bytes_[hlo];
+  memory_usage_->Add(size - recorded);
+  recorded = size;
+}
+
+bool HloEvaluator::EvaluatedLiterals::MaybeKeepForReuse(Literal& literal) {
+  // Dynamic literals are not reused because their dynamic sizes would leak
+  // into the next result.
+  if (!literal.shape().IsArray() || !literal.shape().is_static() ||
+      free_literals_.size() >= kMaxFreeLiterals) {
+    return false;
+  }
+  const int64_t size = LiteralSizeInBytes(literal);
+  if (free_literal_bytes_ + size > kMaxFreeLiteralBytes) {
+    return false;
+  }
+  free_literal_bytes_ += size;
+  free_literals_.push_back(std::move(literal));
+  return true;
+}
+
+void HloEvaluator::EvaluatedLiterals::Release(const HloInstruction* hlo) {
+  Literal literal;
+  {
+    absl::MutexLock lock(&mu_);
+    auto it = literals_.find(hlo);
+    if (it == literals_.end()) {
+      return;
+    }
+    literal = std::move(it->second);
+    literals_.erase(it);
+    auto recorded = recorded_bytes_.find(hlo);
+    if (recorded != recorded_bytes_.end()) {
+      memory_usage_->Add(-recorded->second);
+      recorded_bytes_.erase(recorded);
+    }
+    MaybeKeepForReuse(literal);
+  }
+  // Otherwise `literal` is destroyed outside of the lock.
+}
+
+Literal HloEvaluator::EvaluatedLiterals::Allocate(const Shape& shape) {
+  {
+    absl::MutexLock lock(&mu_);
+    for (auto it = free_literals_.begin(); it != free_literals_.end(); ++it) {
+      if (Shape::Equal()(it->shape(), shape)) {
+        Literal literal = std::move(*it);
+        free_literals_.erase(it);
+        free_literal_bytes_ -= LiteralSizeInBytes(literal);
+        return literal;
+      }
+    }
+  }
+  return Literal(shape);
+}
+
+void HloEvaluator::EvaluatedLiterals::clear() {
+  absl::node_hash_map<const HloInstruction*, Literal> literals;
+  std::vector<Literal> free_literals;
+  {
+    absl::MutexLock lock(&mu_);
+    for (const auto& [hlo, size] : recorded_bytes_) {
+      memory_usage_->Add(-size);
+    }
+    recorded_bytes_.clear();
+    literals.swap(literals_);
+    free_literals.swap(free_literals_);
+    free_literal_bytes_ = 0;
+  }
+  // The literals are destroyed outside of the lock.
+}
+
+void HloEvaluator::EvaluatedLiterals::set_memory_usage(
+    std::shared_ptr<MemoryUsage> memory_usage) {
+  absl::MutexLock lock(&mu_);
+  CHECK(literals_.empty());
+  memory_usage_ = std::move(memory_usage);
+}
+
+std::unique_ptr<HloEvaluator> HloEvaluator::CreateEmbeddedEvaluator() {
+  std::unique_ptr<HloEvaluator> embedded =
+      CreateEmbedded(max_loop_iterations_);
+  embedded->evaluated_.set_memory_usage(evaluated_.memory_usage());
+  return embedded;
+}
+
 StatusOr<Literal> HloEvaluator::Evaluate(
     const HloComputation& computation,
     absl::Span<const Literal* const> arg_literals) {
@@ -897,18 +989,151 @@ StatusOr<Literal> HloEvaluator::Evaluate(
   }
   engine_.seed(seed_);
 
-  TF_RETURN_IF_ERROR(computation.Accept(this));
+  // GetDimensionSize reads the results of instructions that are not among its
+  // operands, so nothing can be released early when it may be evaluated.
+  pending_users_.clear();
+  if (dynamic_dimension_inference_ == nullptr) {
+    for (const HloInstruction* instruction : computation.instructions()) {
+      // Constants and parameters are not stored in evaluated_.
+      if (instruction != computation.root_instruction() &&
+          !instruction->IsConstant() &&
+          instruction->opcode() != HloOpcode::kParameter) {
+        pending_users_[instruction].store(instruction->user_count(),
+                                          std::memory_order_relaxed);
+      }
+    }
+  }
+
+  const bool evaluate_in_parallel =
+      thread_pool_ != nullptr && computation.instruction_count() > 1 &&
+      dynamic_dimension_inference_ == nullptr &&
+      absl::c_none_of(computation.instructions(),
+                      [](const HloInstruction* instruction) {
+                        return instruction->opcode() == HloOpcode::kRng;
+                      });
+  if (evaluate_in_parallel) {
+    TF_RETURN_IF_ERROR(EvaluateInParallel(computation));
+  } else {
+    TF_RETURN_IF_ERROR(computation.Accept(this));
+  }
   const Literal& result =
       GetEvaluatedLiteralFor(computation.root_instruction());
   if (VLOG_IS_ON(100)) {
     for (const HloInstruction* instr : computation.instructions()) {
-      VLOG(100) << instr->name() << " = " << GetEvaluatedLiteralFor(instr);
+      // Intermediate results have been released.
+      if (IsAlreadyEvaluated(instr)) {
+        VLOG(100) << instr->name() << " = " << GetEvaluatedLiteralFor(instr);
+      }
     }
   }
   if (!result.IsKnown()) {
     return MakeEvalErrorDueToParamOrInfeed(*computation.root_instruction());
   }
-  return result.Clone();
+  return TakeResult(computation.root_instruction());
+}
+
+Status HloEvaluator::EvaluateInParallel(const HloComputation& computation) {
+  std::vector<HloInstruction*> post_order =
+      computation.MakeInstructionPostOrder();
+  const int64_t num_instructions = post_order.size();
+  absl::flat_hash_map<const HloInstruction*, int64_t> index;
+  index.reserve(num_instructions);
+  for (int64_t i = 0; i < num_instructions; ++i) {
+    index[post_order[i]] = i;
+  }
+
+  // The dataflow graph, using post-order indices as node ids. An instruction
+  // becomes ready once all of its operands and control predecessors have been
+  // evaluated. Results are released by Postprocess.
+  struct Node {
+    std::vector<int64_t> successors;
+    std::atomic<int64_t> pending_predecessors{0};
+  };
+  std::vector<Node> nodes(num_instructions);
+  for (int64_t i = 0; i < num_instructions; ++i) {
+    const HloInstruction* instruction = post_order[i];
+    Node& node = nodes[i];
+    for (const HloInstruction* user : instruction->users()) {
+      node.successors.push_back(index.at(user));
+    }
+    for (const HloInstruction* successor :
+         instruction->control_successors()) {
+      node.successors.push_back(index.at(successor));
+    }
+    node.pending_predecessors.store(
+        instruction->unique_operands().size() +
+            instruction->control_predecessors().size(),
+        std::memory_order_relaxed);
+  }
+
+  absl::Mutex mu;
+  Status status;
+  int64_t in_flight = 0;
+  int64_t num_evaluated = 0;
+
+  // Evaluates instruction `i` and everything that becomes ready as a result
+  // of it. The first ready successor is evaluated on the calling thread and
+  // the others are handed to the thread pool.
+  std::function<void(int64_t)> run = [&](int64_t i) {
+    while (true) {
+      HloInstruction* instruction = post_order[i];
+      Status instruction_status = Preprocess(instruction);
+      if (instruction_status.ok()) {
+        instruction_status = instruction->Visit(this);
+      }
+      if (instruction_status.ok()) {
+        instruction_status = Postprocess(instruction);
+      }
+      if (!instruction_status.ok()) {
+        absl::MutexLock lock(&mu);
+        status.Update(instruction_status);
+        --in_flight;
+        return;
+      }
+
+      int64_t next = -1;
+      {
+        absl::MutexLock lock(&mu);
+        ++num_evaluated;
+        if (!status.ok()) {
+          --in_flight;
+          return;
+        }
+        for (int64_t successor : nodes[i].successors) {
+          if (nodes[successor].pending_predecessors.fetch_sub(
+                  1, std::memory_order_acq_rel) != 1) {
+            continue;
+          }
+          if (next < 0) {
+            next = successor;
+          } else {
+            ++in_flight;
+            thread_pool_->Schedule([&run, successor] { run(successor); });
+          }
+        }
+        if (next < 0) {
+          --in_flight;
+          return;
+        }
+      }
+      i = next;
+    }
+  };
+
+  {
+    absl::MutexLock lock(&mu);
+    for (int64_t i = 0; i < num_instructions; ++i) {
+      if (nodes[i].pending_predecessors.load(std::memory_order_relaxed) == 0) {
+        ++in_flight;
+        thread_pool_->Schedule([&run, i] { run(i); });
+      }
+    }
+    mu.Await(absl::Condition(
+        +[](int64_t* in_flight) { return *in_flight == 0; }, &in_flight));
+  }
+  TF_RETURN_IF_ERROR(status);
+  TF_RET_CHECK(num_evaluated == num_instructions);
+  return FinishVisit(computation.root_instruction());
 }
 
 StatusOr<Literal> HloEvaluator::Evaluate(
@@ -916,6 +1141,7 @@ StatusOr<Literal> HloEvaluator::Evaluate(
     bool recursively_evaluate_nonconstant_operands) {
   arg_literals_.clear();
   evaluated_.clear();
+  pending_users_.clear();
   call_graph_cache_.reset();
   tuple_points_to_analysis_cache_.reset();
   auto enable_partial_evaluation_cleanup =
@@ -928,7 +1154,17 @@ StatusOr<Literal> HloEvaluator::Evaluate(
   if (!result.IsKnown()) {
     return MakeEvalErrorDueToParamOrInfeed(*instruction);
   }
-  return result.Clone();
+  return TakeResult(instruction);
+}
+
+Literal HloEvaluator::TakeResult(const HloInstruction* instruction) {
+  // Constants and parameters own their literals, everything else can be moved
+  // out instead of copied.
+  Literal result = evaluated_.contains(instruction)
+                       ? std::move(evaluated_.at(instruction))
+                       : GetEvaluatedLiteralFor(instruction).Clone();
+  evaluated_.clear();
+  return result;
 }
 
 bool HloEvaluator::TryEvaluate(HloInstruction* instruction, Literal* result,
@@ -3307,8 +3543,7 @@ Status HloEvaluator::HandleCall(HloInstruction* call) {
     arg_literals.push_back(&arg_literal);
   }
 
-  std::unique_ptr<HloEvaluator> embedded_evaluator =
-      CreateEmbedded(max_loop_iterations_);
+  std::unique_ptr<HloEvaluator> embedded_evaluator = CreateEmbeddedEvaluator();
   embedded_evaluator->set_dynamic_dimension_inference(
       dynamic_dimension_inference_);
   TF_ASSIGN_OR_RETURN(Literal result,
@@ -3343,8 +3578,7 @@ Status HloEvaluator::HandleFusion(HloInstruction* fusion) {
     arg_literals.push_back(&arg_literal);
   }
 
-  std::unique_ptr<HloEvaluator> embedded_evaluator =
-      CreateEmbedded(max_loop_iterations_);
+  std::unique_ptr<HloEvaluator> embedded_evaluator = CreateEmbeddedEvaluator();
   embedded_evaluator->set_dynamic_dimension_inference(
       dynamic_dimension_inference_);
   TF_ASSIGN_OR_RETURN(Literal result, embedded_evaluator->Evaluate(
@@ -3369,8 +3603,7 @@ Status HloEvaluator::HandleConditional(HloInstruction* conditional) {
   const auto& branch_computation_arg =
       GetEvaluatedLiteralFor(conditional->operand(1 + branch_index));
 
-  std::unique_ptr<HloEvaluator> embedded_evaluator =
-      CreateEmbedded(max_loop_iterations_);
+  std::unique_ptr<HloEvaluator> embedded_evaluator = CreateEmbeddedEvaluator();
   embedded_evaluator->set_dynamic_dimension_inference(
       dynamic_dimension_inference_);
   TF_ASSIGN_OR_RETURN(Literal result,
@@ -3504,11 +3737,9 @@ Status HloEvaluator::HandleWhile(HloInstruction* while_hlo) {
   }
   bool keep_going = true;
   int64_t iteration_count = 0;
-  std::unique_ptr<HloEvaluator> cond_evaluator =
-      CreateEmbedded(max_loop_iterations_);
+  std::unique_ptr<HloEvaluator> cond_evaluator = CreateEmbeddedEvaluator();
   cond_evaluator->set_dynamic_dimension_inference(dynamic_dimension_inference_);
-  std::unique_ptr<HloEvaluator> loop_body_evaluator =
-      CreateEmbedded(max_loop_iterations_);
+  std::unique_ptr<HloEvaluator> loop_body_evaluator = CreateEmbeddedEvaluator();
   loop_body_evaluator->set_dynamic_dimension_inference(
       dynamic_dimension_inference_);
   while (keep_going) {
@@ -3661,8 +3892,7 @@ Status HloEvaluator::HandleSort(HloInstruction* sort) {
       << "Unexpected out-of-bound sort dimension " << sort_dim
       << " accessing increment of size " << increment.size();
   increment[sort_dim] = sort_dim_elements;
-  std::unique_ptr<HloEvaluator> embedded_evaluator =
-      CreateEmbedded(max_loop_iterations_);
+  std::unique_ptr<HloEvaluator> embedded_evaluator = CreateEmbeddedEvaluator();
   // Iterate through each dimension except 'sort_dim'.
   TF_RETURN_IF_ERROR(ShapeUtil::ForEachIndexWithStatus(
       key_shape, zero_base, key_shape.dimensions(), increment,
@@ -3951,7 +4181,7 @@ Status HloEvaluator::HandleReduce(HloInstruction* instr) {
   std::vector<std::unique_ptr<HloEvaluator>> embedded_evaluators;
   embedded_evaluators.reserve(num_threads);
   for (int i = 0; i < num_threads; ++i) {
-    embedded_evaluators.push_back(CreateEmbedded(max_loop_iterations_));
+    embedded_evaluators.push_back(CreateEmbeddedEvaluator());
   }
 
   absl::InlinedVector<Literal, 1> results(num_args);
@@ -4054,6 +4284,32 @@ Status HloEvaluator::Postprocess(HloInstruction* hlo) {
                                           hlo_shape.layout())) {
     evaluated_.at(hlo) = evaluated_.at(hlo).Relayout(hlo_shape);
   }
+
+  if (evaluated_.contains(hlo)) {
+    evaluated_.RecordSize(hlo);
+  }
+  const MemoryUsage& memory_usage = *evaluated_.memory_usage();
+  if (memory_usage.limit_bytes > 0 &&
+      memory_usage.live_bytes() > memory_usage.limit_bytes) {
+    return ResourceExhausted(
+        "Evaluating %s needs more than the memory limit of %d bytes",
+        hlo->name(), memory_usage.limit_bytes);
+  }
+
+  // Release results that are no longer needed.
+  auto release_if_dead = [&](const HloInstruction* instruction) {
+    auto it = pending_users_.find(instruction);
+    if (it != pending_users_.end() &&
+        it->second.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      evaluated_.Release(instruction);
+    }
+  };
+  for (const HloInstruction* operand : hlo->unique_operands()) {
+    release_if_dead(operand);
+  }
+  if (hlo->user_count() == 0 && pending_users_.contains(hlo)) {
+    evaluated_.Release(hlo);
+  }
   return OkStatus();
 }
 
@@ -4080,6 +4336,25 @@ std::unique_ptr<Array2D<T>> MatmulArray2DImpl(
       /*transpose_rhs=*/0);
   return result;
 }
+
+template <typename T>
+void MatmulRowMajorImpl(
+    const T* lhs, const T* rhs, T* out, int64_t m, int64_t n, int64_t k,
+    const std::function<void(const void* run_options_ptr, T* out, T* lhs,
+                             T* rhs, int64_t m, int64_t n, int64_t k,
+                             int32_t transpose_lhs, int32_t transpose_rhs)>&
+        impl_fn) {
+  if (k == 0) {
+    std::fill(out, out + m * n, T{0});
+    return;
+  }
+  // The runtime expects column-major matrices, so compute the transposed
+  // product `out^T = rhs^T x lhs^T` instead.
+  impl_fn(/*run_options_ptr=*/nullptr, out, const_cast<T*>(rhs),
+          const_cast<T*>(lhs), n, m, k,
+          /*transpose_lhs=*/0,
+          /*transpose_rhs=*/0);
+}
 }  // namespace
 
 std::unique_ptr<Array2D<Eigen::half>> HloEvaluator::MatmulArray2D(
@@ -4120,4 +4395,41 @@ std::unique_ptr<Array2D<int32_t>> HloEvaluator::MatmulArray2D(
       lhs, rhs, __xla_cpu_runtime_EigenSingleThreadedMatMulS32);
 }
 
+void HloEvaluator::MatmulRowMajor(const float* lhs, const float* rhs,
+                                  float* out, int64_t m, int64_t n,
+                                  int64_t k) {
+  MatmulRowMajorImpl<float>(lhs, rhs, out, m, n, k,
+                            __xla_cpu_runtime_EigenSingleThreadedMatMulF32);
+}
+
+void HloEvaluator::MatmulRowMajor(const double* lhs, const double* rhs,
+                                  double* out, int64_t m, int64_t n,
+                                  int64_t k) {
+  MatmulRowMajorImpl<double>(lhs, rhs, out, m, n, k,
+                             __xla_cpu_runtime_EigenSingleThreadedMatMulF64);
+}
+
+void HloEvaluator::MatmulRowMajor(const std::complex<float>* lhs,
+                                  const std::complex<float>* rhs,
+                                  std::complex<float>* out, int64_t m,
+                                  int64_t n, int64_t k) {
+  MatmulRowMajorImpl<std::complex<float>>(
+      lhs, rhs, out, m, n, k, __xla_cpu_runtime_EigenSingleThreadedMatMulC64);
+}
+
+void HloEvaluator::MatmulRowMajor(const std::complex<double>* lhs,
+                                  const std::complex<double>* rhs,
+                                  std::complex<double>* out, int64_t m,
+                                  int64_t n, int64_t k) {
+  MatmulRowMajorImpl<std::complex<double>>(
+      lhs, rhs, out, m, n, k, __xla_cpu_runtime_EigenSingleThreadedMatMulC128);
+}
+
+void HloEvaluator::MatmulRowMajor(const int32_t* lhs, const int32_t* rhs,
+                                  int32_t* out, int64_t m, int64_t n,
+                                  int64_t k) {
+  MatmulRowMajorImpl<int32_t>(lhs, rhs, out, m, n, k,
+                              __xla_cpu_runtime_EigenSingleThreadedMatMulS32);
+}
+
 }  // namespace xla
@@ -18,12 +18,16 @@ limitations under the License.
 
 #define _USE_MATH_DEFINES
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <optional>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/node_hash_map.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/span.h"
 #include "xla/array2d.h"
 #include "xla/hlo/ir/dfs_hlo_visitor_with_default.h"
@@ -40,6 +44,7 @@ limitations under the License.
 #include "xla/statusor.h"
 #include "xla/util.h"
 #include "xla/xla_data.pb.h"
+#include "tsl/platform/threadpool.h"
 
 namespace xla {
 
@@ -77,7 +82,8 @@ std::optional<ParsedWhileLoop> PatternMatchParseWhileLoop(
 
 // Responsible for evaluating HLO and obtain literal as the evaluation results.
 //
-// This class is not thread-safe.
+// This class is not thread-safe. It may however evaluate the instructions of a
+// computation concurrently, see set_thread_pool().
 class HloEvaluator : public DfsHloVisitorWithDefault {
  public:
   // Only evaluate up to max_loop_iterations per while-loop execution if
@@ -203,6 +209,38 @@ class HloEvaluator : public DfsHloVisitorWithDefault {
   // Enable the fast path for certain operations like dot or convolution.
   void set_use_fast_path(bool value) { use_fast_path_ = value; }
 
+  // When set, Evaluate(computation) schedules the instructions of the
+  // computation on `thread_pool` as soon as all of their operands have been
+  // evaluated, so that independent instructions run concurrently, and drops
+  // the result of every instruction other than the root once its last user
+  // has been evaluated.
+  //
+  // Computations called by control flow and other ops (e.g. while bodies or
+  // reducers) are still evaluated sequentially, as are computations that
+  // contain kRng, whose results depend on the evaluation order. The custom
+  // call handler may be called concurrently and must be thread-safe.
+  //
+  // The pool must outlive the evaluator, and Evaluate must not be called from
+  // one of its threads. Pass nullptr to restore sequential evaluation.
+  void set_thread_pool(tsl::thread::ThreadPool* thread_pool) {
+    thread_pool_ = thread_pool;
+  }
+
+  // Limits the number of bytes held by evaluated literals, including those of
+  // embedded evaluators. Evaluation fails with a ResourceExhausted error once
+  // the limit is exceeded. Zero or negative values disable the limit.
+  void set_memory_limit_bytes(int64_t limit_bytes) {
+    evaluated_.memory_usage()->limit_bytes = limit_bytes;
+  }
+
+  // Returns the largest number of bytes held by evaluated literals at any
+  // point since construction or the last ResetPeakMemoryUsage(), including
+  // those of embedded evaluators.
+  int64_t peak_memory_usage_bytes() const {
+    return evaluated_.memory_usage()->peak_bytes();
+  }
+  void ResetPeakMemoryUsage() { evaluated_.memory_usage()->ResetPeak(); }
+
   // Handles evaluation of a custom-call op.
   // Operand literals are provided in |operands| and implementations must
   // populate |output| before returning.
@@ -236,6 +274,24 @@ class HloEvaluator : public DfsHloVisitorWithDefault {
   static std::unique_ptr<Array2D<int32_t>> MatmulArray2D(
       const Array2D<int32_t>& lhs, const Array2D<int32_t>& rhs);
 
+  // Computes `out = lhs x rhs` with Eigen for the row-major matrices `lhs` of
+  // shape [m, k] and `rhs` of shape [k, n], writing the row-major [m, n]
+  // result to `out`.
+  static void MatmulRowMajor(const float* lhs, const float* rhs, float* out,
+                             int64_t m, int64_t n, int64_t k);
+  static void MatmulRowMajor(const double* lhs, const double* rhs, double* out,
+                             int64_t m, int64_t n, int64_t k);
+  static void MatmulRowMajor(const std::complex<float>* lhs,
+                             const std::complex<float>* rhs,
+                             std::complex<float>* out, int64_t m, int64_t n,
+                             int64_t k);
+  static void MatmulRowMajor(const std::complex<double>* lhs,
+                             const std::complex<double>* rhs,
+                             std::complex<double>* out, int64_t m, int64_t n,
+                             int64_t k);
+  static void MatmulRowMajor(const int32_t* lhs, const int32_t* rhs,
+                             int32_t* out, int64_t m, int64_t n, int64_t k);
+
  protected:
   // Evaluates the given instruction, and stores the evaluation result in the
   // evaluated_ map.
@@ -252,6 +308,24 @@ class HloEvaluator : public DfsHloVisitorWithDefault {
   Status EvaluateParameterFromCallerArgument(HloInstruction* parameter,
                                              const ShapeIndex& shape_index);
 
+  // Evaluates all instructions of `computation` on thread_pool_ in dataflow
+  // order. See set_thread_pool().
+  Status EvaluateInParallel(const HloComputation& computation);
+
+  // Returns the evaluated literal of `instruction` and releases all other
+  // results, including the literals kept for reuse.
+  Literal TakeResult(const HloInstruction* instruction);
+
+  // Creates an evaluator for a nested computation that shares the memory
+  // accounting and limit of this one.
+  std::unique_ptr<HloEvaluator> CreateEmbeddedEvaluator();
+
+  // Returns an uninitialized literal of the given array shape, possibly
+  // reusing the buffer of a released intermediate result.
+  Literal AllocateLiteral(const Shape& shape) {
+    return evaluated_.Allocate(shape);
+  }
+
   // Make HloEvaluatorTypedVisitor a friend because it is logically part of this
   // class.
   //
@@ -387,10 +461,10 @@ class HloEvaluator : public DfsHloVisitorWithDefault {
       return *arg_literals_.at(hlo->parameter_number());
     }
 
-    auto it = evaluated_.find(hlo);
-    CHECK(it != evaluated_.end())
+    const Literal* literal = evaluated_.Find(hlo);
+    CHECK(literal != nullptr)
         << "could not find evaluated value for: " << hlo->ToString();
-    return it->second;
+    return *literal;
   }
 
   // Returns true if the given hlo has been evaluated and cached.
@@ -402,8 +476,8 @@ class HloEvaluator : public DfsHloVisitorWithDefault {
     if (hlo->opcode() == HloOpcode::kParameter && !arg_literals_.empty()) {
       return true;
     }
-    auto it = evaluated_.find(hlo);
-    if (it == evaluated_.end()) {
+    const Literal* literal = evaluated_.Find(hlo);
+    if (literal == nullptr) {
       return false;
     }
     // We may evaluate some elements of a tuple-shaped instruction and mark
@@ -412,23 +486,119 @@ class HloEvaluator : public DfsHloVisitorWithDefault {
     // are needed. By marking the other elements undetermined, we allow the
     // evaluator to update the cached tuple literal when more elements are
     // evaluated.
-    return it->second.IsDetermined(shape_index);
+    return literal->IsDetermined(shape_index);
   }
 
+  // Bytes held by the literals of an evaluator and of the embedded evaluators
+  // it creates.
+  class MemoryUsage {
+   public:
+    void Add(int64_t bytes) {
+      int64_t live = live_bytes_.fetch_add(bytes) + bytes;
+      int64_t peak = peak_bytes_.load();
+      while (live > peak && !peak_bytes_.compare_exchange_weak(peak, live)) {
+      }
+    }
+    int64_t live_bytes() const { return live_bytes_.load(); }
+    int64_t peak_bytes() const { return peak_bytes_.load(); }
+    void ResetPeak() { peak_bytes_.store(live_bytes_.load()); }
+
+    // Zero or negative means unlimited.
+    int64_t limit_bytes = 0;
+
+   private:
+    std::atomic<int64_t> live_bytes_{0};
+    std::atomic<int64_t> peak_bytes_{0};
+  };
+
+  // Map from instructions to their evaluated literals. Literals are stored in
+  // place and references to them stay valid until their entry is released.
+  //
+  // Released array literals are kept around for reuse by Allocate() until the
+  // next clear(), so that later instructions of an evaluation reuse the
+  // buffers of dead intermediate results. They are not counted in
+  // memory_usage(), and how many bytes are kept is bounded.
+  //
+  // The map itself is thread-safe so that instructions can be evaluated
+  // concurrently, but the literals are not: a literal must only be written by
+  // the instruction that produces it, before any of its users run.
+  class EvaluatedLiterals {
+   public:
+    EvaluatedLiterals() : memory_usage_(std::make_shared<MemoryUsage>()) {}
+    ~EvaluatedLiterals();
+
+    Literal& operator[](const HloInstruction* hlo) {
+      absl::MutexLock lock(&mu_);
+      return literals_[hlo];
+    }
+    Literal& at(const HloInstruction* hlo) {
+      absl::MutexLock lock(&mu_);
+      return literals_.at(hlo);
+    }
+    // Returns nullptr if `hlo` has no entry.
+    const Literal* Find(const HloInstruction* hlo) const {
+      absl::MutexLock lock(&mu_);
+      auto it = literals_.find(hlo);
+      return it == literals_.end() ? nullptr : &it->second;
+    }
+    bool contains(const HloInstruction* hlo) const {
+      absl::MutexLock lock(&mu_);
+      return literals_.contains(hlo);
+    }
+
+    // Accounts for the current size of the literal of `hlo` in
+    // memory_usage().
+    void RecordSize(const HloInstruction* hlo);
+
+    // Removes the entry of `hlo`, keeping its literal for reuse if possible.
+    void Release(const HloInstruction* hlo);
+
+    // Returns an uninitialized literal of the given array shape, reusing a
+    // released literal of the same shape if there is one.
+    Literal Allocate(const Shape& shape);
+
+    // Removes all entries and drops the literals kept for reuse.
+    void clear();
+
+    const std::shared_ptr<MemoryUsage>& memory_usage() const {
+      return memory_usage_;
+    }
+    // Must only be called while there are no entries.
+    void set_memory_usage(std::shared_ptr<MemoryUsage> memory_usage);
+
+   private:
+    // Moves `literal` to free_literals_ if it can be reused.
+    bool MaybeKeepForReuse(Literal& literal) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+    mutable absl::Mutex mu_;
+    // Storing Literal in place requires the container to have pointer
+    // stability so we cannot use flat_hash_map.
+    absl::node_hash_map<const HloInstruction*, Literal> literals_
+        ABSL_GUARDED_BY(mu_);
+    // Bytes accounted for each entry by RecordSize.
+    absl::flat_hash_map<const HloInstruction*, int64_t> recorded_bytes_
+        ABSL_GUARDED_BY(mu_);
+    std::vector<Literal> free_literals_ ABSL_GUARDED_BY(mu_);
+    int64_t free_literal_bytes_ ABSL_GUARDED_BY(mu_) = 0;
+    std::shared_ptr<MemoryUsage> memory_usage_;
+  };
+
   // Tracks the HLO instruction and its evaluated literal result.
   //
   // Parameters and constants aren't stored here, see implementation of
   // GetEvaluatedLiteralFor.
   //
-  // TODO(b/35950897): have better memory management here to free instructions
-  // that are no longer a parent for any other subsequent instruction in
-  // post-ordering.
+  // Evaluate(computation) releases the result of an instruction as soon as all
+  // of its users have been evaluated, see pending_users_.
   //
   // Must be cleared for each evaluation.
-  //
-  // Storing Literal in place requires the container to have pointer stability
-  // so we cannot use flat_hash_map any more.
-  absl::node_hash_map<const HloInstruction*, Literal> evaluated_;
+  EvaluatedLiterals evaluated_;
+
+  // For each instruction of the computation evaluated by Evaluate(computation)
+  // whose result can be released, the number of its users that have not been
+  // evaluated yet. Empty when evaluating single instructions.
+  absl::node_hash_map<const HloInstruction*, std::atomic<int64_t>>
+      pending_users_;
   // Set by EvaluateInternal and opportunitiscally used by the HandleXXX
   // functions. When non-empty, the HandleXXX function may evaluate the
   // instruction at only the given shape index.
@@ -485,6 +655,9 @@ class HloEvaluator : public DfsHloVisitorWithDefault {
                                   absl::Span<const Literal*> operands)>
       custom_call_handler_;
 
+  // Optional thread pool to evaluate independent instructions on.
+  tsl::thread::ThreadPool* thread_pool_ = nullptr;
+
   HloEvaluator(const HloEvaluator&) = delete;
   HloEvaluator& operator=(const HloEvaluator&) = delete;
 };
@@ -23,6 +23,8 @@ limitations under the License.
 #include <vector>
 
 #include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "xla/client/xla_builder.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
@@ -42,9 +44,11 @@ limitations under the License.
 #include "xla/util.h"
 #include "xla/xla_data.pb.h"
 #include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
 #include "tsl/platform/status.h"
 #include "tsl/platform/test.h"
 #include "tsl/platform/test_benchmark.h"
+#include "tsl/platform/threadpool.h"
 
 namespace xla {
 namespace {
@@ -2622,6 +2626,81 @@ void BM_ReducePrecisely(::testing::benchmark::State& state) {
 
 BENCHMARK(BM_ReducePrecisely);
 
+// A chain of elementwise ops over operands that share the result layout, so
+// every op takes the flat-buffer path.
+void BM_ElementwiseOps(::testing::benchmark::State& state) {
+  const int64_t num_elements = state.range(0);
+  HloComputation::Builder b("BM_ElementwiseOps");
+  HloModuleConfig config;
+  config.set_debug_options(GetDebugOptionsFromFlags());
+  HloModule module("BM_ElementwiseOps", config);
+
+  Shape shape = ShapeUtil::MakeShape(F32, {num_elements});
+  Shape pred_shape = ShapeUtil::MakeShape(PRED, {num_elements});
+  HloInstruction* x = b.AddInstruction(HloInstruction::CreateConstant(
+      LiteralUtil::CreateR1<float>(std::vector<float>(num_elements, 1.5f))));
+  HloInstruction* y = b.AddInstruction(HloInstruction::CreateConstant(
+      LiteralUtil::CreateR1<float>(std::vector<float>(num_elements, -2.0f))));
+  HloInstruction* negate = b.AddInstruction(
+      HloInstruction::CreateUnary(shape, HloOpcode::kNegate, y));
+  HloInstruction* multiply = b.AddInstruction(
+      HloInstruction::CreateBinary(shape, HloOpcode::kMultiply, x, negate));
+  HloInstruction* compare = b.AddInstruction(HloInstruction::CreateCompare(
+      pred_shape, multiply, x, ComparisonDirection::kGt));
+  b.AddInstruction(HloInstruction::CreateTernary(shape, HloOpcode::kSelect,
+                                                 compare, multiply, x));
+  module.AddEntryComputation(b.Build());
+
+  HloEvaluator hlo_eval;
+  for (auto s : state) {
+    hlo_eval.Evaluate(module, {}).value();
+  }
+  state.SetItemsProcessed(state.iterations() * num_elements);
+}
+
+BENCHMARK(BM_ElementwiseOps)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 22);
+
+// A batched F32 dot of [batch, size, size] matrices. The second argument
+// selects the Eigen kernels (1) or the blocked loops (0).
+void BM_BatchDot(::testing::benchmark::State& state) {
+  const int64_t batch = state.range(0);
+  const int64_t size = state.range(1);
+  HloComputation::Builder b("BM_BatchDot");
+  HloModuleConfig config;
+  config.set_debug_options(GetDebugOptionsFromFlags());
+  HloModule module("BM_BatchDot", config);
+
+  Shape shape = ShapeUtil::MakeShape(F32, {batch, size, size});
+  Array3D<float> values(batch, size, size);
+  values.FillRandom(1.0f);
+  HloInstruction* lhs = b.AddInstruction(HloInstruction::CreateConstant(
+      LiteralUtil::CreateR3FromArray3D(values)));
+  HloInstruction* rhs = b.AddInstruction(HloInstruction::CreateConstant(
+      LiteralUtil::CreateR3FromArray3D(values)));
+  DotDimensionNumbers dot_dnums;
+  dot_dnums.add_lhs_batch_dimensions(0);
+  dot_dnums.add_rhs_batch_dimensions(0);
+  dot_dnums.add_lhs_contracting_dimensions(2);
+  dot_dnums.add_rhs_contracting_dimensions(1);
+  b.AddInstruction(HloInstruction::CreateDot(
+      shape, lhs, rhs, dot_dnums, HloTestBase::DefaultPrecisionConfig(2)));
+  module.AddEntryComputation(b.Build());
+
+  HloEvaluator hlo_eval;
+  hlo_eval.set_use_fast_path(state.range(2) != 0);
+  for (auto s : state) {
+    hlo_eval.Evaluate(module, {}).value();
+  }
+  state.SetItemsProcessed(state.iterations() * batch * size * size * size);
+}
+
+BENCHMARK(BM_BatchDot)
+    ->Args({1, 256, 0})
+    ->Args({1, 256, 1})
+    ->Args({16, 128, 0})
+    ->Args({16, 128, 1})
+    ->Args({1, 1024, 1});
+
 TEST_P(HloEvaluatorBf16Test, ReduceAdd) {
   HloComputation::Builder b(TestName());
 
@@ -4580,6 +4659,441 @@ TEST_F(HloEvaluatorTest, EvaluateCustomCall_ManyInputs) {
   EXPECT_TRUE(absl::c_equal(expected_data, actual_literal.data<uint32_t>()));
 }
 
+TEST_F(HloEvaluatorTest, ParallelEvaluationMatchesSequential) {
+  const absl::string_view hlo_text = R"(
+  HloModule ParallelEvaluation
+
+  add {
+    lhs = f32[] parameter(0)
+    rhs = f32[] parameter(1)
+    ROOT add = f32[] add(lhs, rhs)
+  }
+
+  cond {
+    state = (s32[], f32[8,8]) parameter(0)
+    i = s32[] get-tuple-element(state), index=0
+    limit = s32[] constant(4)
+    ROOT lt = pred[] compare(i, limit), direction=LT
+  }
+
+  body {
+    state = (s32[], f32[8,8]) parameter(0)
+    i = s32[] get-tuple-element(state), index=0
+    one = s32[] constant(1)
+    next_i = s32[] add(i, one)
+    x = f32[8,8] get-tuple-element(state), index=1
+    y = f32[8,8] dot(x, x), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    ROOT next = (s32[], f32[8,8]) tuple(next_i, y)
+  }
+
+  ENTRY main {
+    p0 = f32[8,8] parameter(0)
+    p1 = f32[8,8] parameter(1)
+    scale = f32[] constant(0.125)
+    scale_b = f32[8,8] broadcast(scale), dimensions={}
+    a = f32[8,8] multiply(p0, scale_b)
+    b = f32[8,8] multiply(p1, scale_b)
+    c = f32[8,8] dot(a, b), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    d = f32[8,8] dot(b, a), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+    e = f32[8,8] add(c, d), control-predecessors={b}
+    f = f32[8,8] subtract(a, b)
+    zero = s32[] constant(0)
+    init = (s32[], f32[8,8]) tuple(zero, f)
+    loop = (s32[], f32[8,8]) while(init), condition=cond, body=body
+    g = f32[8,8] get-tuple-element(loop), index=1
+    unused = f32[8,8] negate(g)
+    h = f32[8,8] maximum(e, g)
+    zero_f = f32[] constant(0)
+    sum = f32[8] reduce(h, zero_f), dimensions={1}, to_apply=add
+    ROOT result = (f32[8], f32[8,8], f32[8,8]) tuple(sum, h, a)
+  }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  std::vector<Literal> args = MakeFakeArguments(m_.get()).value();
+
+  HloEvaluator sequential;
+  TF_ASSERT_OK_AND_ASSIGN(Literal expected,
+                          sequential.Evaluate(*m_, {&args[0], &args[1]}));
+
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "evaluator_test", 4);
+  HloEvaluator parallel;
+  parallel.set_thread_pool(&pool);
+  // Evaluate repeatedly to shake out ordering problems.
+  for (int i = 0; i < 20; ++i) {
+    TF_ASSERT_OK_AND_ASSIGN(Literal actual,
+                            parallel.Evaluate(*m_, {&args[0], &args[1]}));
+    EXPECT_TRUE(LiteralTestUtil::Equal(expected, actual));
+  }
+}
+
+TEST_F(HloEvaluatorTest, ParallelEvaluationRunsIndependentInstructions) {
+  const absl::string_view hlo_text = R"(
+  HloModule ParallelEvaluation
+  ENTRY main {
+    p0 = u32[1] parameter(0)
+    p1 = u32[1] parameter(1)
+    a = u32[1] custom-call(p0), custom_call_target="rendezvous"
+    b = u32[1] custom-call(p1), custom_call_target="rendezvous"
+    ROOT sum = u32[1] add(a, b)
+  }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  std::vector<Literal> args = MakeFakeArguments(m_.get()).value();
+
+  // Both custom calls wait for each other, which only succeeds if they are
+  // evaluated concurrently.
+  absl::Mutex mu;
+  int arrived = 0;
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "evaluator_test", 2);
+  HloEvaluator evaluator;
+  evaluator.set_thread_pool(&pool);
+  evaluator.set_custom_call_handler(
+      [&](HloInstruction* custom_call,
+          absl::Span<const Literal*> operands) -> StatusOr<Literal> {
+        absl::MutexLock lock(&mu);
+        ++arrived;
+        if (!mu.AwaitWithTimeout(absl::Condition(
+                                     +[](int* arrived) { return *arrived == 2; },
+                                     &arrived),
+                                 absl::Seconds(30))) {
+          return InternalError("Custom calls were not evaluated concurrently");
+        }
+        return operands[0]->Clone();
+      });
+  TF_ASSERT_OK_AND_ASSIGN(Literal result,
+                          evaluator.Evaluate(*m_, {&args[0], &args[1]}));
+  EXPECT_EQ(result.data<uint32_t>()[0],
+            args[0].data<uint32_t>()[0] + args[1].data<uint32_t>()[0]);
+}
+
+TEST_F(HloEvaluatorTest, ParallelEvaluationReturnsFirstError) {
+  const absl::string_view hlo_text = R"(
+  HloModule ParallelEvaluation
+  ENTRY main {
+    p0 = f32[16] parameter(0)
+    a = f32[16] exponential(p0)
+    b = f32[16] custom-call(p0), custom_call_target="fails"
+    c = f32[16] add(a, b)
+    ROOT d = f32[16] negate(c)
+  }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  std::vector<Literal> args = MakeFakeArguments(m_.get()).value();
+
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "evaluator_test", 4);
+  HloEvaluator evaluator;
+  evaluator.set_thread_pool(&pool);
+  evaluator.set_custom_call_handler(
+      [](HloInstruction* custom_call, absl::Span<const Literal*> operands) {
+        return InternalError("Test error");
+      });
+  EXPECT_EQ(evaluator.Evaluate(*m_, {&args[0]}).status().code(),
+            ::tsl::error::INTERNAL);
+}
+
+TEST_F(HloEvaluatorTest, ReleasesIntermediateResults) {
+  constexpr int kChainLength = 16;
+  HloComputation::Builder b(TestName());
+  Shape shape = ShapeUtil::MakeShapeWithDescendingLayout(F32, {256, 256});
+  HloInstruction* value =
+      b.AddInstruction(HloInstruction::CreateParameter(0, shape, "param"));
+  for (int i = 0; i < kChainLength; ++i) {
+    value = b.AddInstruction(
+        HloInstruction::CreateUnary(shape, HloOpcode::kNegate, value));
+  }
+  m_->AddEntryComputation(b.Build());
+  Literal arg = LiteralUtil::CreateFullWithDescendingLayout<float>(
+      {256, 256}, 1.0f);
+
+  TF_ASSERT_OK_AND_ASSIGN(Literal result, Evaluate({&arg}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(arg, result));
+
+  // Only the operand and the result of the instruction being evaluated are
+  // alive at any time. Released buffers kept for reuse are not counted.
+  const int64_t literal_bytes = ShapeUtil::ByteSizeOf(shape);
+  EXPECT_GE(evaluator_.peak_memory_usage_bytes(), literal_bytes);
+  EXPECT_LE(evaluator_.peak_memory_usage_bytes(), 2 * literal_bytes);
+}
+
+TEST_F(HloEvaluatorTest, DoesNotKeepLiteralsAcrossEvaluations) {
+  Shape big_shape = ShapeUtil::MakeShapeWithDescendingLayout(F32, {256, 256});
+  Shape small_shape = ShapeUtil::MakeShapeWithDescendingLayout(F32, {16});
+  auto make_negate_chain = [&](const Shape& shape) {
+    HloComputation::Builder b(TestName());
+    HloInstruction* value =
+        b.AddInstruction(HloInstruction::CreateParameter(0, shape, "param"));
+    for (int i = 0; i < 4; ++i) {
+      value = b.AddInstruction(
+          HloInstruction::CreateUnary(shape, HloOpcode::kNegate, value));
+    }
+    return b.Build();
+  };
+  HloComputation* big =
+      m_->AddEmbeddedComputation(make_negate_chain(big_shape));
+  HloComputation* small =
+      m_->AddEntryComputation(make_negate_chain(small_shape));
+  Literal big_arg =
+      LiteralUtil::CreateFullWithDescendingLayout<float>({256, 256}, 1.0f);
+  Literal small_arg = LiteralUtil::CreateR1<float>(std::vector<float>(16, 1));
+
+  // Like constant folding, evaluate several computations with one evaluator.
+  // Nothing of the first evaluation is held on to by the second.
+  TF_ASSERT_OK(evaluator_.Evaluate(*big, {&big_arg}).status());
+  evaluator_.ResetPeakMemoryUsage();
+  TF_ASSERT_OK(evaluator_.Evaluate(*small, {&small_arg}).status());
+  EXPECT_LE(evaluator_.peak_memory_usage_bytes(),
+            2 * ShapeUtil::ByteSizeOf(small_shape));
+}
+
+TEST_F(HloEvaluatorTest, ReleasesIntermediateResultsOfWhileBodies) {
+  const absl::string_view hlo_text = R"(
+  HloModule WhileLoop
+
+  cond {
+    state = (s32[], f32[128,128]) parameter(0)
+    i = s32[] get-tuple-element(state), index=0
+    limit = s32[] constant(10)
+    ROOT lt = pred[] compare(i, limit), direction=LT
+  }
+
+  body {
+    state = (s32[], f32[128,128]) parameter(0)
+    i = s32[] get-tuple-element(state), index=0
+    one = s32[] constant(1)
+    next_i = s32[] add(i, one)
+    x = f32[128,128] get-tuple-element(state), index=1
+    a = f32[128,128] add(x, x)
+    b = f32[128,128] multiply(a, a)
+    c = f32[128,128] subtract(b, a)
+    d = f32[128,128] subtract(c, x)
+    ROOT next = (s32[], f32[128,128]) tuple(next_i, d)
+  }
+
+  ENTRY main {
+    x = f32[128,128] parameter(0)
+    zero = s32[] constant(0)
+    init = (s32[], f32[128,128]) tuple(zero, x)
+    loop = (s32[], f32[128,128]) while(init), condition=cond, body=body
+    ROOT result = f32[128,128] get-tuple-element(loop), index=1
+  }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  Literal arg = LiteralUtil::CreateFullWithDescendingLayout<float>(
+      {128, 128}, 0.0f);
+  TF_ASSERT_OK_AND_ASSIGN(Literal result, Evaluate({&arg}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(arg, result));
+
+  // The intermediate results of each iteration are released, so the peak
+  // does not grow with the trip count.
+  const int64_t literal_bytes = 128 * 128 * sizeof(float);
+  EXPECT_LE(evaluator_.peak_memory_usage_bytes(), 16 * literal_bytes);
+}
+
+TEST_F(HloEvaluatorTest, MemoryLimit) {
+  HloComputation::Builder b(TestName());
+  Shape shape = ShapeUtil::MakeShapeWithDescendingLayout(F32, {256, 256});
+  HloInstruction* param =
+      b.AddInstruction(HloInstruction::CreateParameter(0, shape, "param"));
+  HloInstruction* negate = b.AddInstruction(
+      HloInstruction::CreateUnary(shape, HloOpcode::kNegate, param));
+  b.AddInstruction(
+      HloInstruction::CreateBinary(shape, HloOpcode::kAdd, param, negate));
+  m_->AddEntryComputation(b.Build());
+  Literal arg = LiteralUtil::CreateFullWithDescendingLayout<float>(
+      {256, 256}, 1.0f);
+
+  evaluator_.set_memory_limit_bytes(ShapeUtil::ByteSizeOf(shape) / 2);
+  EXPECT_EQ(Evaluate({&arg}).status().code(),
+            ::tsl::error::RESOURCE_EXHAUSTED);
+
+  evaluator_.set_memory_limit_bytes(2 * ShapeUtil::ByteSizeOf(shape));
+  TF_ASSERT_OK_AND_ASSIGN(Literal result, Evaluate({&arg}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(
+      LiteralUtil::CreateFullWithDescendingLayout<float>({256, 256}, 0.0f),
+      result));
+}
+
+// Elementwise ops on operands laid out like the result walk the flat buffers
+// directly; the others go through multi-dimensional indices. Both must agree,
+// and the arrays are big enough to be split into parallel chunks.
+TEST_F(HloEvaluatorTest, ElementwiseOpsWithMixedLayouts) {
+  const absl::string_view hlo_text = R"(
+  HloModule ElementwiseOpsWithMixedLayouts
+
+  ENTRY main {
+    a = f32[300,500]{1,0} parameter(0)
+    b = f32[300,500]{1,0} parameter(1)
+    p = pred[300,500]{1,0} parameter(2)
+    a_t = f32[300,500]{0,1} parameter(3)
+    b_t = f32[300,500]{0,1} parameter(4)
+    p_t = pred[300,500]{0,1} parameter(5)
+    negate = f32[300,500]{1,0} negate(a)
+    multiply = f32[300,500]{1,0} multiply(a, b)
+    compare = pred[300,500]{1,0} compare(a, b), direction=LT
+    select = f32[300,500]{1,0} select(p, a, b)
+    clamp = f32[300,500]{1,0} clamp(b, a, b)
+    negate_t = f32[300,500]{1,0} negate(a_t)
+    multiply_t = f32[300,500]{1,0} multiply(a, b_t)
+    compare_t = pred[300,500]{1,0} compare(a_t, b), direction=LT
+    select_t = f32[300,500]{1,0} select(p_t, a, b_t)
+    clamp_t = f32[300,500]{1,0} clamp(b_t, a, b)
+    ROOT tuple = (f32[300,500]{1,0}, f32[300,500]{1,0}, pred[300,500]{1,0},
+                  f32[300,500]{1,0}, f32[300,500]{1,0}, f32[300,500]{1,0},
+                  f32[300,500]{1,0}, pred[300,500]{1,0}, f32[300,500]{1,0},
+                  f32[300,500]{1,0})
+      tuple(negate, multiply, compare, select, clamp, negate_t, multiply_t,
+            compare_t, select_t, clamp_t)
+  }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+
+  Array2D<float> a_values(300, 500);
+  Array2D<float> b_values(300, 500);
+  Array2D<bool> p_values(300, 500);
+  for (int64_t i = 0; i < 300; ++i) {
+    for (int64_t j = 0; j < 500; ++j) {
+      a_values(i, j) = static_cast<float>((i * 7 + j * 13) % 101) - 50.0f;
+      b_values(i, j) = static_cast<float>((i * 11 + j * 3) % 97) - 48.0f;
+      p_values(i, j) = (i + j) % 3 == 0;
+    }
+  }
+  Literal a = LiteralUtil::CreateR2FromArray2D(a_values);
+  Literal b = LiteralUtil::CreateR2FromArray2D(b_values);
+  Literal p = LiteralUtil::CreateR2FromArray2D(p_values);
+  Literal a_t = a.Relayout(LayoutUtil::MakeLayout({0, 1}));
+  Literal b_t = b.Relayout(LayoutUtil::MakeLayout({0, 1}));
+  Literal p_t = p.Relayout(LayoutUtil::MakeLayout({0, 1}));
+  TF_ASSERT_OK_AND_ASSIGN(Literal result,
+                          Evaluate({&a, &b, &p, &a_t, &b_t, &p_t}));
+  std::vector<Literal> elements = result.DecomposeTuple();
+  ASSERT_EQ(elements.size(), 10);
+
+  for (int64_t i = 0; i < 300; ++i) {
+    for (int64_t j = 0; j < 500; ++j) {
+      const float x = a_values(i, j);
+      const float y = b_values(i, j);
+      ASSERT_EQ(elements[0].Get<float>({i, j}), -x);
+      ASSERT_EQ(elements[1].Get<float>({i, j}), x * y);
+      ASSERT_EQ(elements[2].Get<bool>({i, j}), x < y);
+      ASSERT_EQ(elements[3].Get<float>({i, j}), p_values(i, j) ? x : y);
+      ASSERT_EQ(elements[4].Get<float>({i, j}), y);
+    }
+  }
+  for (int k = 0; k < 5; ++k) {
+    EXPECT_TRUE(LiteralTestUtil::Equal(elements[k], elements[k + 5]))
+        << "element " << k;
+  }
+}
+
+TEST_F(HloEvaluatorTest, DotGeneralMatchesNaiveLoops) {
+  const absl::string_view hlo_text = R"(
+  HloModule DotGeneral
+
+  ENTRY main {
+    lhs = s32[2,3,4,5] parameter(0)
+    rhs = s32[5,2,6,4] parameter(1)
+    ROOT dot = s32[2,3,6] dot(lhs, rhs), lhs_batch_dims={0},
+      rhs_batch_dims={1}, lhs_contracting_dims={2,3},
+      rhs_contracting_dims={3,0}
+  }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+
+  Array4D<int32_t> lhs_values(2, 3, 4, 5);
+  lhs_values.FillWithMultiples(1);
+  Array4D<int32_t> rhs_values(5, 2, 6, 4);
+  rhs_values.Each([](absl::Span<const int64_t> index, int32_t* value) {
+    *value = (index[0] * 5 + index[1] * 7 + index[2] * 3 + index[3]) % 11 - 5;
+  });
+  Literal lhs = LiteralUtil::CreateR4FromArray4D(lhs_values);
+  Literal rhs = LiteralUtil::CreateR4FromArray4D(rhs_values);
+
+  Array3D<int32_t> expected(2, 3, 6);
+  for (int64_t b = 0; b < 2; ++b) {
+    for (int64_t i = 0; i < 3; ++i) {
+      for (int64_t j = 0; j < 6; ++j) {
+        int32_t sum = 0;
+        for (int64_t k0 = 0; k0 < 4; ++k0) {
+          for (int64_t k1 = 0; k1 < 5; ++k1) {
+            sum += lhs_values(b, i, k0, k1) * rhs_values(k1, b, j, k0);
+          }
+        }
+        expected(b, i, j) = sum;
+      }
+    }
+  }
+
+  for (bool use_fast_path : {false, true}) {
+    evaluator_.set_use_fast_path(use_fast_path);
+    TF_ASSERT_OK_AND_ASSIGN(Literal result, Evaluate({&lhs, &rhs}));
+    EXPECT_TRUE(LiteralTestUtil::Equal(
+        LiteralUtil::CreateR3FromArray3D(expected), result))
+        << "use_fast_path=" << use_fast_path;
+  }
+}
+
+TEST_F(HloEvaluatorTest, GroupedConvolutionMatchesNaiveLoops) {
+  const absl::string_view hlo_text = R"(
+  HloModule GroupedConvolution
+
+  ENTRY main {
+    input = s32[2,5,4,4] parameter(0)
+    kernel = s32[3,2,2,6] parameter(1)
+    ROOT conv = s32[2,5,4,6] convolution(input, kernel),
+      window={size=3x2 stride=2x1 pad=1_1x0_2 lhs_dilate=2x1 rhs_dilate=1x2
+              rhs_reversal=0x1},
+      dim_labels=b01f_01io->b01f, feature_group_count=2
+  }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+
+  Array4D<int32_t> input_values(2, 5, 4, 4);
+  input_values.FillWithMultiples(1);
+  Array4D<int32_t> kernel_values(3, 2, 2, 6);
+  kernel_values.Each([](absl::Span<const int64_t> index, int32_t* value) {
+    *value = (index[0] * 3 + index[1] * 5 + index[2] * 7 + index[3]) % 9 - 4;
+  });
+  Literal input = LiteralUtil::CreateR4FromArray4D(input_values);
+  Literal kernel = LiteralUtil::CreateR4FromArray4D(kernel_values);
+
+  Array4D<int32_t> expected(2, 5, 4, 6);
+  expected.Each([&](absl::Span<const int64_t> index, int32_t* value) {
+    const int64_t b = index[0];
+    const int64_t oy = index[1];
+    const int64_t ox = index[2];
+    const int64_t of = index[3];
+    const int64_t group = of / 3;
+    int32_t sum = 0;
+    for (int64_t ky = 0; ky < 3; ++ky) {
+      for (int64_t kx = 0; kx < 2; ++kx) {
+        // The input is dilated by 2 along y and padded by 1 on either side.
+        const int64_t dilated_y = oy * 2 - 1 + ky;
+        if (dilated_y % 2 != 0 || dilated_y < 0 || dilated_y / 2 >= 5) {
+          continue;
+        }
+        // The kernel is dilated by 2 along x and reversed.
+        const int64_t x = ox + kx * 2;
+        if (x >= 4) {
+          continue;
+        }
+        for (int64_t c = 0; c < 2; ++c) {
+          sum += input_values(b, dilated_y / 2, x, group * 2 + c) *
+                 kernel_values(ky, 1 - kx, c, of);
+        }
+      }
+    }
+    *value = sum;
+  });
+
+  for (bool use_fast_path : {false, true}) {
+    evaluator_.set_use_fast_path(use_fast_path);
+    TF_ASSERT_OK_AND_ASSIGN(Literal result, Evaluate({&input, &kernel}));
+    EXPECT_TRUE(LiteralTestUtil::Equal(
+        LiteralUtil::CreateR4FromArray4D(expected), result))
+        << "use_fast_path=" << use_fast_path;
+  }
+}
+
 TEST_F(HloEvaluatorTest, IsFiniteF16) {
   const absl::string_view hlo_text = R"(
   HloModule test
@@ -35,14 +35,15 @@ limitations under the License.
 #include "absl/base/casts.h"
 #include "absl/container/inlined_vector.h"
 #include "absl/types/span.h"
-#include "xla/array2d.h"
 #include "xla/hlo/evaluator/hlo_evaluator.h"
 #include "xla/hlo/ir/hlo_casting_utils.h"
 #include "xla/hlo/ir/hlo_instructions.h"
+#include "xla/layout_util.h"
 #include "xla/literal.h"
 #include "xla/literal_util.h"
 #include "xla/primitive_util.h"
 #include "xla/service/shape_inference.h"
+#include "xla/shape_util.h"
 #include "xla/util.h"
 #include "xla/xla_data.pb.h"
 #include "tsl/platform/statusor.h"
@@ -131,6 +132,119 @@ struct UintWithSize<8> {
 template <size_t kBytes>
 using UintWithSizeType = typename UintWithSize<kBytes>::type;
 
+// Returns true if the elements of the literals with shapes `result` and
+// `operand` are stored in the same order, so that an elementwise op can walk
+// both flat buffers with a single linear index instead of going through
+// multi-dimensional indices.
+inline bool HasSameLinearLayout(const Shape& result, const Shape& operand) {
+  return result.IsArray() && operand.IsArray() && result.is_static() &&
+         operand.is_static() && ShapeUtil::SameDimensions(result, operand) &&
+         LayoutUtil::IsDenseArray(result) &&
+         LayoutUtil::IsDenseArray(operand) &&
+         result.layout().minor_to_major() == operand.layout().minor_to_major();
+}
+
+// Calls `fn(begin, end)` for disjoint ranges that together cover [0, size).
+// Large ranges are split into chunks that are processed in parallel; the
+// chunks are big enough for the loops in `fn` to be vectorized.
+template <typename Fn>
+void ForEachLinearRangeParallel(int64_t size, const Fn& fn) {
+  constexpr int64_t kChunkSize = 64 * 1024;
+  const int64_t num_chunks = CeilOfRatio(size, kChunkSize);
+  if (num_chunks <= 1) {
+    fn(int64_t{0}, size);
+    return;
+  }
+  ShapeUtil::ForEachIndexParallel(
+      ShapeUtil::MakeShape(S64, {num_chunks}),
+      [&](absl::Span<const int64_t> chunk, int) -> StatusOr<bool> {
+        const int64_t begin = chunk[0] * kChunkSize;
+        fn(begin, std::min(size, begin + kChunkSize));
+        return true;
+      });
+}
+
+// Computes `out = lhs x rhs` for the row-major matrices `lhs` of shape [m, k]
+// and `rhs` of shape [k, n]. The loops are blocked so that a panel of `rhs`
+// stays in cache while it is applied to a block of rows, but every output
+// element is still accumulated in the order of the contracted index, exactly
+// like a naive loop would.
+template <typename T>
+void BlockedMatmul(const T* lhs, const T* rhs, T* out, int64_t m, int64_t n,
+                   int64_t k) {
+  using AccumulatorT = decltype(ToArithmeticSafeType(std::declval<T>()));
+  constexpr int64_t kBlockRows = 16;
+  constexpr int64_t kBlockCols = 256;
+  constexpr int64_t kBlockDepth = 128;
+  std::vector<AccumulatorT> accumulators(kBlockRows * kBlockCols);
+  for (int64_t row_begin = 0; row_begin < m; row_begin += kBlockRows) {
+    const int64_t rows = std::min(kBlockRows, m - row_begin);
+    for (int64_t col_begin = 0; col_begin < n; col_begin += kBlockCols) {
+      const int64_t cols = std::min(kBlockCols, n - col_begin);
+      std::fill(accumulators.begin(), accumulators.end(), AccumulatorT{0});
+      for (int64_t depth_begin = 0; depth_begin < k;
+           depth_begin += kBlockDepth) {
+        const int64_t depth = std::min(kBlockDepth, k - depth_begin);
+        for (int64_t i = 0; i < rows; ++i) {
+          AccumulatorT* acc = &accumulators[i * kBlockCols];
+          const T* lhs_row = lhs + (row_begin + i) * k + depth_begin;
+          for (int64_t p = 0; p < depth; ++p) {
+            const AccumulatorT lhs_value = ToArithmeticSafeType(lhs_row[p]);
+            const T* rhs_row = rhs + (depth_begin + p) * n + col_begin;
+            for (int64_t j = 0; j < cols; ++j) {
+              acc[j] += lhs_value * ToArithmeticSafeType(rhs_row[j]);
+            }
+          }
+        }
+      }
+      for (int64_t i = 0; i < rows; ++i) {
+        const AccumulatorT* acc = &accumulators[i * kBlockCols];
+        T* out_row = out + (row_begin + i) * n + col_begin;
+        for (int64_t j = 0; j < cols; ++j) {
+          out_row[j] = static_cast<T>(acc[j]);
+        }
+      }
+    }
+  }
+}
+
+// Computes `out[b] = lhs[b] x rhs[b]` for a batch of row-major matrices with
+// `lhs[b]` of shape [m, k] and `rhs[b]` of shape [k, n]. The rows of every
+// product are split into tasks that run in parallel, and each task calls
+// `matmul(lhs, rhs, out, rows, n, k)` with the same contract as
+// BlockedMatmul.
+template <typename T, typename MatmulFn>
+void BatchMatmulParallel(const T* lhs, const T* rhs, T* out, int64_t batch,
+                         int64_t m, int64_t n, int64_t k,
+                         const MatmulFn& matmul) {
+  if (batch == 0 || m == 0 || n == 0) {
+    return;
+  }
+  // Each task should perform at least this many multiply-adds, so that the
+  // cost of scheduling it is negligible.
+  constexpr int64_t kMinTaskSize = 1 << 20;
+  const int64_t row_size = std::max<int64_t>(n * k, 1);
+  const int64_t rows_per_task =
+      std::min(m, std::max<int64_t>(kMinTaskSize / row_size, 1));
+  const int64_t tasks_per_batch = CeilOfRatio(m, rows_per_task);
+  auto run_task = [&](int64_t b, int64_t task) {
+    const int64_t row_begin = task * rows_per_task;
+    const int64_t rows = std::min(rows_per_task, m - row_begin);
+    matmul(lhs + (b * m + row_begin) * k, rhs + b * k * n,
+           out + (b * m + row_begin) * n, rows, n, k);
+  };
+  if (batch * tasks_per_batch == 1) {
+    run_task(0, 0);
+    return;
+  }
+  ShapeUtil::ForEachIndexParallel(
+      ShapeUtil::MakeShape(S64, {batch, tasks_per_batch}),
+      [&](absl::Span<const int64_t> task, int) -> StatusOr<bool> {
+        run_task(task[0], task[1]);
+        return true;
+      });
+}
+
 // Templated DfsHloVisitor for use by HloEvaluator.
 //
 // Typically ReturnT here indicates the resulting literal type of each evaluated
@@ -179,24 +293,24 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
   explicit HloEvaluatorTypedVisitor(HloEvaluator* p) : parent_(p) {}
 
   // The following higher-order functions convert a function with ElementwiseT
-  // to a function with ReturnT.
-  std::function<ReturnT(ReturnT)> ConvertUnaryFunction(
-      const std::function<ElementwiseT(ElementwiseT)>& unary_op) {
+  // to a function with ReturnT. They take the function by template parameter
+  // rather than as a std::function so that it can be inlined into the loops
+  // of the elementwise ops below.
+  template <typename UnaryOp>
+  static auto ConvertUnaryFunction(const UnaryOp& unary_op) {
     return [&unary_op](ReturnT arg) {
       return static_cast<ReturnT>(unary_op(static_cast<ElementwiseT>(arg)));
     };
   }
-  std::function<ReturnT(ReturnT, ReturnT)> ConvertBinaryFunction(
-      const std::function<ElementwiseT(ElementwiseT, ElementwiseT)>&
-          binary_op) {
+  template <typename BinaryOp>
+  static auto ConvertBinaryFunction(const BinaryOp& binary_op) {
     return [&binary_op](ReturnT arg1, ReturnT arg2) {
       return static_cast<ReturnT>(binary_op(static_cast<ElementwiseT>(arg1),
                                             static_cast<ElementwiseT>(arg2)));
     };
   }
-  std::function<ReturnT(ReturnT, ReturnT, ReturnT)> ConvertTernaryFunction(
-      const std::function<ElementwiseT(ElementwiseT, ElementwiseT,
-                                       ElementwiseT)>& ternary_op) {
+  template <typename TernaryOp>
+  static auto ConvertTernaryFunction(const TernaryOp& ternary_op) {
     return [&ternary_op](ReturnT arg1, ReturnT arg2, ReturnT arg3) {
       return static_cast<ReturnT>(ternary_op(static_cast<ElementwiseT>(arg1),
                                              static_cast<ElementwiseT>(arg2),
@@ -883,8 +997,8 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
       };
       TF_ASSIGN_OR_RETURN(
           parent_->evaluated_[clamp],
-          ElementwiseTernaryOp(clamp,
-                               std::move(ConvertTernaryFunction(clamp_op))));
+          (ElementwiseTernaryOp<ReturnT, ReturnT, ReturnT>(
+              clamp, ConvertTernaryFunction(clamp_op))));
       return OkStatus();
     }
     return UnsupportedTypeError(clamp);
@@ -893,15 +1007,15 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
   Status HandleSelect(HloInstruction* select) override {
     CHECK(!ShapeUtil::IsScalar(select->operand(0)->shape()));
     CHECK(select->shape().IsArray());
-    std::function<ReturnT(bool, ReturnT, ReturnT)> select_op =
-        [](bool pred, ReturnT on_true, ReturnT on_false) {
-          if (pred) {
-            return on_true;
-          }
-          return on_false;
-        };
-    TF_ASSIGN_OR_RETURN(parent_->evaluated_[select],
-                        ElementwiseTernaryOp(select, std::move(select_op)));
+    auto select_op = [](bool pred, ReturnT on_true, ReturnT on_false) {
+      if (pred) {
+        return on_true;
+      }
+      return on_false;
+    };
+    TF_ASSIGN_OR_RETURN(
+        parent_->evaluated_[select],
+        (ElementwiseTernaryOp<bool, ReturnT, ReturnT>(select, select_op)));
     return OkStatus();
   }
 
@@ -935,9 +1049,217 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
     return OkStatus();
   }
 
+  // Computes a convolution without batch groups as one matrix multiplication
+  // per feature group (im2col): the input windows are gathered into a patch
+  // matrix with one row per output position and one column per kernel
+  // position and input feature, which is multiplied by the kernel reshaped
+  // to [kernel positions * input features, output features].
+  Status HandleConvolutionWithIm2Col(HloInstruction* conv,
+                                     const Literal& lhs_literal,
+                                     const Literal& rhs_literal) {
+    const auto& window = conv->window();
+    const auto& dnums = conv->convolution_dimension_numbers();
+    const int64_t num_spatial_dims = dnums.input_spatial_dimensions_size();
+    const Shape& lhs_shape = lhs_literal.shape();
+    const Shape& rhs_shape = rhs_literal.shape();
+
+    // The input as [batch, spatial dimensions..., features], the kernel as
+    // [spatial dimensions..., input features, output features] and the
+    // output as [batch, spatial dimensions..., features].
+    std::vector<int64_t> input_permutation = {dnums.input_batch_dimension()};
+    std::vector<int64_t> kernel_permutation;
+    std::vector<int64_t> output_permutation(num_spatial_dims + 2);
+    output_permutation[dnums.output_batch_dimension()] = 0;
+    DimensionVector input_spatial_sizes;
+    DimensionVector kernel_spatial_sizes;
+    DimensionVector output_spatial_sizes;
+    std::vector<int64_t> output_dimensions = {
+        lhs_shape.dimensions(dnums.input_batch_dimension())};
+    for (int64_t i = 0; i < num_spatial_dims; ++i) {
+      input_permutation.push_back(dnums.input_spatial_dimensions(i));
+      kernel_permutation.push_back(dnums.kernel_spatial_dimensions(i));
+      output_permutation[dnums.output_spatial_dimensions(i)] = i + 1;
+      input_spatial_sizes.push_back(
+          lhs_shape.dimensions(dnums.input_spatial_dimensions(i)));
+      kernel_spatial_sizes.push_back(
+          rhs_shape.dimensions(dnums.kernel_spatial_dimensions(i)));
+      output_spatial_sizes.push_back(
+          conv->shape().dimensions(dnums.output_spatial_dimensions(i)));
+      output_dimensions.push_back(output_spatial_sizes.back());
+    }
+    input_permutation.push_back(dnums.input_feature_dimension());
+    kernel_permutation.push_back(dnums.kernel_input_feature_dimension());
+    kernel_permutation.push_back(dnums.kernel_output_feature_dimension());
+    output_permutation[dnums.output_feature_dimension()] = num_spatial_dims + 1;
+    output_dimensions.push_back(
+        rhs_shape.dimensions(dnums.kernel_output_feature_dimension()));
+
+    TF_ASSIGN_OR_RETURN(Literal input,
+                        ToRowMajor(lhs_literal, input_permutation));
+    TF_ASSIGN_OR_RETURN(Literal kernel,
+                        ToRowMajor(rhs_literal, kernel_permutation));
+    Literal output(ShapeUtil::MakeShapeWithDescendingLayout(
+        primitive_util::NativeToPrimitiveType<ElementwiseT>(),
+        output_dimensions));
+
+    const int64_t batch = output_dimensions.front();
+    const int64_t input_features =
+        lhs_shape.dimensions(dnums.input_feature_dimension());
+    const int64_t output_features = output_dimensions.back();
+    const int64_t feature_group_count = conv->feature_group_count();
+    const int64_t group_input_features =
+        rhs_shape.dimensions(dnums.kernel_input_feature_dimension());
+    const int64_t group_output_features =
+        output_features / feature_group_count;
+    const int64_t input_spatial_size = Product(input_spatial_sizes);
+    const int64_t kernel_spatial_size = Product(kernel_spatial_sizes);
+    const int64_t output_spatial_size = Product(output_spatial_sizes);
+    const int64_t patch_size = kernel_spatial_size * group_input_features;
+
+    // Writes to `offsets`, for `count` consecutive output positions starting
+    // at `first` and wrapping around, the linear index of the input position
+    // that each kernel position reads, or -1 if it reads padding.
+    const Shape output_spatial_shape =
+        ShapeUtil::MakeShape(S64, output_spatial_sizes);
+    const Shape kernel_spatial_shape =
+        ShapeUtil::MakeShape(S64, kernel_spatial_sizes);
+    auto compute_input_offsets = [&](int64_t first, int64_t count,
+                                     int64_t* offsets) {
+      std::vector<int64_t> output_index =
+          IndexUtil::LinearIndexToMultidimensionalIndex(output_spatial_shape,
+                                                        first);
+      for (int64_t o = 0; o < count; ++o) {
+        DimensionVector kernel_index(num_spatial_dims, 0);
+        for (int64_t w = 0; w < kernel_spatial_size; ++w) {
+          int64_t offset = 0;
+          for (int64_t d = 0; d < num_spatial_dims && offset >= 0; ++d) {
+            const auto& window_dim = window.dimensions(d);
+            // Like the slow path, a reversed kernel position pairs with the
+            // input position of its mirror image.
+            const int64_t window_index =
+                window_dim.window_reversal()
+                    ? kernel_spatial_sizes[d] - 1 - kernel_index[d]
+                    : kernel_index[d];
+            const int64_t undilated_index =
+                output_index[d] * window_dim.stride() -
+                window_dim.padding_low() +
+                window_index * window_dim.window_dilation();
+            if (undilated_index % window_dim.base_dilation() != 0) {
+              offset = -1;
+              break;
+            }
+            const int64_t input_index =
+                undilated_index / window_dim.base_dilation();
+            if (input_index < 0 || input_index >= input_spatial_sizes[d]) {
+              offset = -1;
+              break;
+            }
+            offset = offset * input_spatial_sizes[d] + input_index;
+          }
+          *offsets++ = offset;
+          IndexUtil::BumpIndices(kernel_spatial_shape,
+                                 absl::MakeSpan(kernel_index));
+        }
+        if (!IndexUtil::BumpIndices(output_spatial_shape,
+                                    absl::MakeSpan(output_index))) {
+          absl::c_fill(output_index, 0);
+        }
+      }
+    };
+
+    // The kernel of each group as [kernel positions * input features, output
+    // features of the group].
+    const ElementwiseT* kernel_data = kernel.data<ElementwiseT>().data();
+    std::vector<ElementwiseT> group_kernels;
+    if (feature_group_count > 1) {
+      group_kernels.resize(patch_size * output_features);
+      for (int64_t group = 0; group < feature_group_count; ++group) {
+        for (int64_t i = 0; i < patch_size; ++i) {
+          std::copy_n(kernel_data + i * output_features +
+                          group * group_output_features,
+                      group_output_features,
+                      group_kernels.data() +
+                          (group * patch_size + i) * group_output_features);
+        }
+      }
+    }
+
+    // Bound the size of the patch matrix, and of the input offsets of the
+    // output positions it covers, by processing the output rows in chunks.
+    // The offsets of a chunk are computed once for all feature groups.
+    constexpr int64_t kMaxPatchElements = 1 << 22;
+    const int64_t rows = batch * output_spatial_size;
+    const int64_t rows_per_chunk =
+        std::max<int64_t>(1, kMaxPatchElements / std::max<int64_t>(
+                                                     patch_size, 1));
+    std::vector<int64_t> input_offsets;
+    std::vector<ElementwiseT> patches;
+    std::vector<ElementwiseT> group_output;
+    const ElementwiseT* input_data = input.data<ElementwiseT>().data();
+    ElementwiseT* output_data = output.data<ElementwiseT>().data();
+    for (int64_t row_begin = 0; row_begin < rows;
+         row_begin += rows_per_chunk) {
+      const int64_t chunk_rows = std::min(rows_per_chunk, rows - row_begin);
+      // Row r of the chunk is at output position (row_begin + r) modulo
+      // output_spatial_size, whose offsets are at r % chunk_positions.
+      const int64_t chunk_positions =
+          std::min(chunk_rows, output_spatial_size);
+      input_offsets.resize(chunk_positions * kernel_spatial_size);
+      compute_input_offsets(row_begin % output_spatial_size, chunk_positions,
+                            input_offsets.data());
+      patches.resize(chunk_rows * patch_size);
+      for (int64_t group = 0; group < feature_group_count; ++group) {
+        for (int64_t r = 0; r < chunk_rows; ++r) {
+          const int64_t b = (row_begin + r) / output_spatial_size;
+          const int64_t* offsets = input_offsets.data() +
+                                   (r % chunk_positions) * kernel_spatial_size;
+          ElementwiseT* patch = patches.data() + r * patch_size;
+          for (int64_t w = 0; w < kernel_spatial_size; ++w) {
+            ElementwiseT* features = patch + w * group_input_features;
+            if (offsets[w] < 0) {
+              std::fill_n(features, group_input_features, ElementwiseT{0});
+              continue;
+            }
+            std::copy_n(input_data +
+                            (b * input_spatial_size + offsets[w]) *
+                                input_features +
+                            group * group_input_features,
+                        group_input_features, features);
+          }
+        }
+        if (feature_group_count == 1) {
+          BatchMatmul(patches.data(), kernel_data,
+                      output_data + row_begin * output_features,
+                      /*batch=*/1, chunk_rows, output_features, patch_size);
+          continue;
+        }
+        group_output.resize(chunk_rows * group_output_features);
+        BatchMatmul(patches.data(),
+                    group_kernels.data() +
+                        group * patch_size * group_output_features,
+                    group_output.data(), /*batch=*/1, chunk_rows,
+                    group_output_features, patch_size);
+        for (int64_t r = 0; r < chunk_rows; ++r) {
+          std::copy_n(group_output.data() + r * group_output_features,
+                      group_output_features,
+                      output_data + (row_begin + r) * output_features +
+                          group * group_output_features);
+        }
+      }
+    }
+
+    TF_ASSIGN_OR_RETURN(
+        parent_->evaluated_[conv],
+        FromRowMajor(std::move(output), output_permutation, conv->shape()));
+    return OkStatus();
+  }
+
   Status HandleConvolutionWithLiterals(HloInstruction* conv,
                                        const Literal& lhs_literal,
                                        const Literal& rhs_literal) {
+    if (CanUseMatmul(conv) && conv->batch_group_count() == 1) {
+      return HandleConvolutionWithIm2Col(conv, lhs_literal, rhs_literal);
+    }
     const auto& window = conv->window();
     const Shape& result_shape = conv->shape();
     const Shape& lhs_shape = lhs_literal.shape();
@@ -1191,86 +1513,164 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
   }
 
   Status HandleDot(HloInstruction* dot) override {
-    if (dot->dot_dimension_numbers().rhs_contracting_dimensions_size() == 1 &&
-        parent_->use_fast_path_ &&
-        ShapeUtil::SameElementType(dot->operand(0)->shape(), dot->shape()) &&
-        ShapeUtil::SameElementType(dot->operand(1)->shape(), dot->shape())) {
-      return HandleDot<ElementwiseT>(dot);
+    if (CanUseMatmul(dot)) {
+      return HandleDotWithMatmul(dot);
     }
     return HandleDotSlowPath(dot);
   }
 
-  template <typename NativeT, typename std::enable_if_t<
-                                  std::is_same_v<NativeT, float>>* = nullptr>
-  Status HandleDot(HloInstruction* dot) {
-    const HloInstruction* lhs = dot->operand(0);
-    const HloInstruction* rhs = dot->operand(1);
-    CHECK(dot->shape().IsArray());
-    CHECK(lhs->shape().IsArray());
-    CHECK(rhs->shape().IsArray());
+  // Returns true if `instruction`, a dot or a convolution, can be computed
+  // with BatchMatmul.
+  static bool CanUseMatmul(const HloInstruction* instruction) {
+    if constexpr (std::is_same_v<ReturnT, bool>) {
+      return false;
+    }
+    if (absl::c_linear_search(
+            instruction->precision_config().operand_precision(),
+            PrecisionConfig::PACKED_NIBBLE)) {
+      return false;
+    }
+    return instruction->shape().IsArray() &&
+           instruction->shape().is_static() &&
+           absl::c_all_of(instruction->operands(),
+                          [](const HloInstruction* operand) {
+                            return operand->shape().IsArray() &&
+                                   operand->shape().is_static();
+                          });
+  }
+
+  // Computes `out[b] = lhs[b] x rhs[b]` for a batch of row-major matrices.
+  // Uses Eigen when the evaluator is allowed to take fast paths and Eigen
+  // supports the type. Otherwise uses BlockedMatmul, which produces the same
+  // results as the naive loops of the slow paths.
+  void BatchMatmul(const ElementwiseT* lhs, const ElementwiseT* rhs,
+                   ElementwiseT* out, int64_t batch, int64_t m, int64_t n,
+                   int64_t k) {
+    if constexpr (std::is_same_v<ElementwiseT, float> ||
+                  std::is_same_v<ElementwiseT, double> ||
+                  std::is_same_v<ElementwiseT, complex64> ||
+                  std::is_same_v<ElementwiseT, complex128> ||
+                  std::is_same_v<ElementwiseT, int32_t>) {
+      if (parent_->use_fast_path_) {
+        BatchMatmulParallel(
+            lhs, rhs, out, batch, m, n, k,
+            [](const ElementwiseT* lhs_block, const ElementwiseT* rhs_block,
+               ElementwiseT* out_block, int64_t rows, int64_t cols,
+               int64_t depth) {
+              HloEvaluator::MatmulRowMajor(lhs_block, rhs_block, out_block,
+                                           rows, cols, depth);
+            });
+        return;
+      }
+    }
+    BatchMatmulParallel(lhs, rhs, out, batch, m, n, k,
+                        BlockedMatmul<ElementwiseT>);
+  }
+
+  // Returns `literal` converted to ElementwiseT, with its dimensions permuted
+  // by `permutation` (see Literal::Transpose), as a dense row-major array.
+  static StatusOr<Literal> ToRowMajor(const Literal& literal,
+                                      absl::Span<const int64_t> permutation) {
+    Literal transposed = literal.Transpose(permutation);
+    if (!LayoutUtil::IsMonotonicWithDim0Major(transposed.shape().layout())) {
+      transposed = transposed.Relayout(
+          LayoutUtil::GetDefaultLayoutForRank(transposed.shape().rank()));
+    }
+    const PrimitiveType type =
+        primitive_util::NativeToPrimitiveType<ElementwiseT>();
+    if (transposed.shape().element_type() != type) {
+      return transposed.Convert(type);
+    }
+    return std::move(transposed);
+  }
 
-    const auto& dnums = dot->dot_dimension_numbers();
+  // The inverse of ToRowMajor: permutes the dimensions of the row-major
+  // `literal` by `permutation` and converts it to the element type and layout
+  // of `shape`.
+  static StatusOr<Literal> FromRowMajor(Literal literal,
+                                        absl::Span<const int64_t> permutation,
+                                        const Shape& shape) {
+    if (!absl::c_is_sorted(permutation)) {
+      literal = literal.Transpose(permutation);
+    }
+    if (literal.shape().element_type() != shape.element_type()) {
+      TF_ASSIGN_OR_RETURN(literal, literal.Convert(shape.element_type()));
+    }
+    if (shape.has_layout() &&
+        !LayoutUtil::Equal(literal.shape().layout(), shape.layout())) {
+      literal = literal.Relayout(shape.layout());
+    }
+    return std::move(literal);
+  }
 
-    const int64_t lhs_rank = lhs->shape().rank();
-    const int64_t rhs_rank = rhs->shape().rank();
-
-    CHECK(ShapeUtil::SameElementType(lhs->shape(), rhs->shape()));
-    CHECK(ShapeUtil::SameElementType(lhs->shape(), dot->shape()));
-
-    // There must be 1 and only 1 Contracting dimension for lhs and rhs.
-    const int64_t lhs_contracting_dimension =
-        dnums.lhs_contracting_dimensions(0);
-    const int64_t rhs_contracting_dimension =
-        dnums.rhs_contracting_dimensions(0);
-    // Contracted dimension sizes must be the same.
-    CHECK_EQ(lhs->shape().dimensions(lhs_contracting_dimension),
-             rhs->shape().dimensions(rhs_contracting_dimension))
-        << "lhs contracted dimension: "
-        << lhs->shape().dimensions(lhs_contracting_dimension)
-        << " rhs contracted dimension: "
-        << rhs->shape().dimensions(rhs_contracting_dimension);
-
-    // The fast path is for a simple rank 2 dot with default layout operands.
-    if (lhs_rank != 2 || rhs_rank != 2 || lhs_contracting_dimension != 1 ||
-        rhs_contracting_dimension != 0 ||
-        !LayoutUtil::Equal(lhs->shape().layout(),
-                           LayoutUtil::GetDefaultLayoutForR2()) ||
-        !LayoutUtil::Equal(rhs->shape().layout(),
-                           LayoutUtil::GetDefaultLayoutForR2()) ||
-        !LayoutUtil::Equal(dot->shape().layout(),
-                           LayoutUtil::GetDefaultLayoutForR2())) {
-      return HandleDotSlowPath(dot);
+  // Computes a dot as a batch of matrix multiplications: the operands are
+  // transposed into row-major [batch, m, k] and [batch, k, n] arrays, where
+  // m and n are the products of the non-contracting dimensions of the lhs and
+  // the rhs and k is the product of the contracting dimensions. The result of
+  // shape [batch, m, n] is then already in the dimension order of the dot.
+  Status HandleDotWithMatmul(HloInstruction* dot) {
+    const auto& dnums = dot->dot_dimension_numbers();
+    const Shape& lhs_shape = dot->operand(0)->shape();
+    const Shape& rhs_shape = dot->operand(1)->shape();
+    CHECK_EQ(dnums.lhs_batch_dimensions_size(),
+             dnums.rhs_batch_dimensions_size());
+    CHECK_EQ(dnums.lhs_contracting_dimensions_size(),
+             dnums.rhs_contracting_dimensions_size());
+
+    int64_t batch = 1;
+    int64_t m = 1;
+    int64_t n = 1;
+    int64_t k = 1;
+    std::vector<int64_t> lhs_permutation;
+    std::vector<int64_t> rhs_permutation;
+    for (int64_t i = 0; i < dnums.lhs_batch_dimensions_size(); ++i) {
+      lhs_permutation.push_back(dnums.lhs_batch_dimensions(i));
+      rhs_permutation.push_back(dnums.rhs_batch_dimensions(i));
+      batch *= lhs_shape.dimensions(dnums.lhs_batch_dimensions(i));
+    }
+    for (int64_t i = 0; i < lhs_shape.rank(); ++i) {
+      if (!absl::c_linear_search(dnums.lhs_contracting_dimensions(), i) &&
+          !absl::c_linear_search(dnums.lhs_batch_dimensions(), i)) {
+        lhs_permutation.push_back(i);
+        m *= lhs_shape.dimensions(i);
+      }
+    }
+    for (int64_t i = 0; i < dnums.lhs_contracting_dimensions_size(); ++i) {
+      lhs_permutation.push_back(dnums.lhs_contracting_dimensions(i));
+      rhs_permutation.push_back(dnums.rhs_contracting_dimensions(i));
+      k *= lhs_shape.dimensions(dnums.lhs_contracting_dimensions(i));
+    }
+    for (int64_t i = 0; i < rhs_shape.rank(); ++i) {
+      if (!absl::c_linear_search(dnums.rhs_contracting_dimensions(), i) &&
+          !absl::c_linear_search(dnums.rhs_batch_dimensions(), i)) {
+        rhs_permutation.push_back(i);
+        n *= rhs_shape.dimensions(i);
+      }
     }
 
-    const PrimitiveType native_ty =
-        primitive_util::NativeToPrimitiveType<NativeT>();
-    Literal lhs_literal =
-        parent_->GetEvaluatedLiteralFor(lhs).Convert(native_ty).value();
-    Literal rhs_literal =
-        parent_->GetEvaluatedLiteralFor(rhs).Convert(native_ty).value();
-    const int64_t contracted_dimension_size =
-        lhs->shape().dimensions(lhs_contracting_dimension);
-    Array2D<NativeT> lhs_array(lhs->shape().dimensions(0),
-                               contracted_dimension_size);
-    lhs_array.SetValues(lhs_literal.data<NativeT>());
-    Array2D<NativeT> rhs_array(contracted_dimension_size,
-                               rhs->shape().dimensions(1));
-    rhs_array.SetValues(rhs_literal.data<NativeT>());
-    std::unique_ptr<Array2D<NativeT>> result_array =
-        HloEvaluator::MatmulArray2D(lhs_array, rhs_array);
-    Literal result(ShapeUtil::MakeShape(native_ty, dot->shape().dimensions()));
-    result.PopulateR2FromArray2D(*result_array);
-    parent_->evaluated_[dot] =
-        std::move(result).Convert(dot->shape().element_type()).value();
+    TF_ASSIGN_OR_RETURN(
+        Literal lhs,
+        ToRowMajor(parent_->GetEvaluatedLiteralFor(dot->operand(0)),
+                   lhs_permutation));
+    TF_ASSIGN_OR_RETURN(
+        Literal rhs,
+        ToRowMajor(parent_->GetEvaluatedLiteralFor(dot->operand(1)),
+                   rhs_permutation));
+    Literal result(ShapeUtil::MakeShapeWithDescendingLayout(
+        primitive_util::NativeToPrimitiveType<ElementwiseT>(),
+        dot->shape().dimensions()));
+    BatchMatmul(lhs.data<ElementwiseT>().data(),
+                rhs.data<ElementwiseT>().data(),
+                result.data<ElementwiseT>().data(), batch, m, n, k);
+
+    std::vector<int64_t> identity(dot->shape().rank());
+    absl::c_iota(identity, 0);
+    TF_ASSIGN_OR_RETURN(
+        parent_->evaluated_[dot],
+        FromRowMajor(std::move(result), identity, dot->shape()));
     return OkStatus();
   }
 
-  template <typename NativeT, typename std::enable_if_t<
-                                  !std::is_same_v<NativeT, float>>* = nullptr>
-  Status HandleDot(HloInstruction* dot) {
-    return HandleDotSlowPath(dot);
-  }
-
   Status HandleDotSlowPathWithLiterals(HloInstruction* dot,
                                        const Literal& lhs_literal,
                                        const Literal& rhs_literal) {
@@ -1868,7 +2268,7 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
     embedded_evaluators.reserve(num_threads);
     for (int i = 0; i < num_threads; ++i) {
       embedded_evaluators.push_back(
-          parent_->CreateEmbedded(parent_->max_loop_iterations_));
+          parent_->CreateEmbeddedEvaluator());
     }
 
     // For each resulting dimension, calculate and assign computed value.
@@ -2481,23 +2881,42 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
     return std::move(result);
   }
 
-  StatusOr<Literal> ElementWiseUnaryOp(
-      HloInstruction* instruction,
-      const std::function<ElementwiseT(ElementwiseT)>& unary_op) {
-    const Literal& operand_literal =
-        parent_->GetEvaluatedLiteralFor(instruction->operand(0));
-    TF_ASSIGN_OR_RETURN(
-        auto result_literal,
-        (HloEvaluator::ElementWiseUnaryOpImpl<ReturnT, ReturnT>(
-            instruction, ConvertUnaryFunction(unary_op), operand_literal)));
+  // The elementwise ops below walk the flat buffers of the operands with a
+  // single linear index when all of them are laid out like the result, which
+  // is the common case. Otherwise they fall back to populating the result by
+  // multi-dimensional index.
+  template <typename UnaryOp>
+  StatusOr<Literal> ElementWiseUnaryOp(HloInstruction* instruction,
+                                       const UnaryOp& unary_op) {
+    const auto& shape = instruction->shape();
+    const auto* operand = instruction->operand(0);
+    TF_RET_CHECK(ShapeUtil::SameDimensions(shape, operand->shape()));
 
-    return std::move(result_literal);
+    const Literal& operand_literal = parent_->GetEvaluatedLiteralFor(operand);
+    const auto converted_op = ConvertUnaryFunction(unary_op);
+
+    Literal result = parent_->AllocateLiteral(shape);
+    if (HasSameLinearLayout(result.shape(), operand_literal.shape())) {
+      const ReturnT* operand_data = operand_literal.data<ReturnT>().data();
+      ReturnT* result_data = result.data<ReturnT>().data();
+      ForEachLinearRangeParallel(
+          result.element_count(), [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; ++i) {
+              result_data[i] = converted_op(operand_data[i]);
+            }
+          });
+      return std::move(result);
+    }
+    TF_RETURN_IF_ERROR(result.PopulateParallel<ReturnT>(
+        [&](absl::Span<const int64_t> multi_index, int) {
+          return converted_op(operand_literal.Get<ReturnT>(multi_index));
+        }));
+    return std::move(result);
   }
 
-  StatusOr<Literal> ElementWiseBinaryOp(
-      HloInstruction* instruction,
-      const std::function<ElementwiseT(ElementwiseT, ElementwiseT)>&
-          binary_op) {
+  template <typename BinaryOp>
+  StatusOr<Literal> ElementWiseBinaryOp(HloInstruction* instruction,
+                                        const BinaryOp& binary_op) {
     const auto& shape = instruction->shape();
     const auto* lhs = instruction->operand(0);
     const auto* rhs = instruction->operand(1);
@@ -2506,22 +2925,34 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
 
     const Literal& lhs_literal = parent_->GetEvaluatedLiteralFor(lhs);
     const Literal& rhs_literal = parent_->GetEvaluatedLiteralFor(rhs);
-
-    Literal result(shape);
-
+    const auto converted_op = ConvertBinaryFunction(binary_op);
+
+    Literal result = parent_->AllocateLiteral(shape);
+    if (HasSameLinearLayout(result.shape(), lhs_literal.shape()) &&
+        HasSameLinearLayout(result.shape(), rhs_literal.shape())) {
+      const ReturnT* lhs_data = lhs_literal.data<ReturnT>().data();
+      const ReturnT* rhs_data = rhs_literal.data<ReturnT>().data();
+      ReturnT* result_data = result.data<ReturnT>().data();
+      ForEachLinearRangeParallel(
+          result.element_count(), [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; ++i) {
+              result_data[i] = converted_op(lhs_data[i], rhs_data[i]);
+            }
+          });
+      return std::move(result);
+    }
     TF_RETURN_IF_ERROR(result.PopulateParallel<ReturnT>(
         [&](absl::Span<const int64_t> multi_index, int) {
-          return ConvertBinaryFunction(binary_op)(
-              lhs_literal.Get<ReturnT>(multi_index),
-              rhs_literal.Get<ReturnT>(multi_index));
+          return converted_op(lhs_literal.Get<ReturnT>(multi_index),
+                              rhs_literal.Get<ReturnT>(multi_index));
         }));
     return std::move(result);
   }
 
-  template <typename LhsType, typename RhsType, typename EhsType>
-  StatusOr<Literal> ElementwiseTernaryOp(
-      HloInstruction* instruction,
-      const std::function<ReturnT(LhsType, RhsType, EhsType)>& ternary_op) {
+  template <typename LhsType, typename RhsType, typename EhsType,
+            typename TernaryOp>
+  StatusOr<Literal> ElementwiseTernaryOp(HloInstruction* instruction,
+                                         const TernaryOp& ternary_op) {
     const auto& shape = instruction->shape();
     const auto* lhs = instruction->operand(0);
     const auto* rhs = instruction->operand(1);
@@ -2534,8 +2965,23 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
     const Literal& rhs_literal = parent_->GetEvaluatedLiteralFor(rhs);
     const Literal& ehs_literal = parent_->GetEvaluatedLiteralFor(ehs);
 
-    Literal result(shape);
-
+    Literal result = parent_->AllocateLiteral(shape);
+    if (HasSameLinearLayout(result.shape(), lhs_literal.shape()) &&
+        HasSameLinearLayout(result.shape(), rhs_literal.shape()) &&
+        HasSameLinearLayout(result.shape(), ehs_literal.shape())) {
+      const LhsType* lhs_data = lhs_literal.data<LhsType>().data();
+      const RhsType* rhs_data = rhs_literal.data<RhsType>().data();
+      const EhsType* ehs_data = ehs_literal.data<EhsType>().data();
+      ReturnT* result_data = result.data<ReturnT>().data();
+      ForEachLinearRangeParallel(
+          result.element_count(), [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; ++i) {
+              result_data[i] =
+                  ternary_op(lhs_data[i], rhs_data[i], ehs_data[i]);
+            }
+          });
+      return std::move(result);
+    }
     TF_RETURN_IF_ERROR(result.PopulateParallel<ReturnT>(
         [&](absl::Span<const int64_t> multi_index, int) {
           return ternary_op(lhs_literal.Get<LhsType>(multi_index),
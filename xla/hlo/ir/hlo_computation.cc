@@ -140,8 +140,12 @@ HloInstruction* HloComputation::AddInstruction(
 HloInstruction* HloComputation::AddInstructionInternal(
     std::unique_ptr<HloInstruction> instruction) {
   if (parent() != nullptr) {
-    instruction->UniquifyName(&parent()->instruction_name_uniquer());
-    instruction->SetUniqueId(parent()->NewUniqueInstructionId());
+    if (parent()->defer_instruction_uniquification()) {
+      instruction->SetUniqueId(parent()->NewProvisionalInstructionId());
+    } else {
+      instruction->UniquifyName(&parent()->instruction_name_uniquer());
+      instruction->SetUniqueId(parent()->NewUniqueInstructionId());
+    }
   }
   instruction->set_parent(this);
   HloInstruction* pinst = instruction.get();
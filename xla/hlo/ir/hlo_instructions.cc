@@ -1456,10 +1456,46 @@ HloConstantInstruction::HloConstantInstruction(Literal literal,
 HloConstantInstruction::HloConstantInstruction(const Shape& shape)
     : HloInstruction(HloOpcode::kConstant, shape) {}
 
+const Literal& HloConstantInstruction::literal() const {
+  if (lazy_literal_ != nullptr) {
+    absl::call_once(lazy_literal_->once, [this] {
+      StatusOr<Literal> literal = lazy_literal_->factory();
+      TF_CHECK_OK(literal.status())
+          << "Failed to create the literal of " << name();
+      CHECK(Shape::Equal().MinorToMajorOnlyInLayout()(literal->shape(),
+                                                      shape()))
+          << literal->shape().ToString(true) << " vs "
+          << shape().ToString(true);
+      literal_ = std::move(literal).value();
+      // Releases whatever the literal was created from.
+      lazy_literal_->factory = nullptr;
+      lazy_literal_->created.store(true, std::memory_order_release);
+    });
+  }
+  return *literal_;
+}
+
+Literal* HloConstantInstruction::mutable_literal() {
+  literal();
+  return &literal_.value();
+}
+
+void HloConstantInstruction::SetLazyLiteral(
+    std::function<StatusOr<Literal>()> literal_factory) {
+  CHECK(!HasLiteral());
+  lazy_literal_ = std::make_unique<LazyLiteral>();
+  lazy_literal_->factory = std::move(literal_factory);
+}
+
+bool HloConstantInstruction::IsLiteralPending() const {
+  return lazy_literal_ != nullptr &&
+         !lazy_literal_->created.load(std::memory_order_acquire);
+}
+
 HloInstructionProto HloConstantInstruction::ToProto() const {
   HloInstructionProto proto = HloInstruction::ToProto();
-  if (literal_.has_value()) {
-    *proto.mutable_literal() = literal_->ToProto();
+  if (HasLiteral()) {
+    *proto.mutable_literal() = literal().ToProto();
   }
   return proto;
 }
@@ -1480,7 +1516,7 @@ void HloConstantInstruction::RelayoutConstant(const Layout& new_layout,
 
   if (!mutable_array_subshape->has_layout() ||
       !LayoutUtil::Equal(mutable_array_subshape->layout(), new_layout)) {
-    *literal_ = literal_->Relayout(new_layout, shape_index);
+    *mutable_literal() = literal().Relayout(new_layout, shape_index);
     *mutable_array_subshape->mutable_layout() = new_layout;
   }
 }
@@ -1497,15 +1533,14 @@ std::unique_ptr<HloInstruction>
 HloConstantInstruction::CloneWithNewOperandsImpl(
     const Shape& shape, absl::Span<HloInstruction* const> new_operands,
     HloCloneContext* context) const {
-  if (!literal_.has_value()) {
+  if (!HasLiteral()) {
     return std::make_unique<HloConstantInstruction>(this->shape());
   }
-  CHECK(literal_.has_value());
   // Literal's shape may have no/different tiling info. Use this instruction's
   // shape instead.
-  CHECK(Shape::Equal().MinorToMajorOnlyInLayout()(literal_->shape(),
+  CHECK(Shape::Equal().MinorToMajorOnlyInLayout()(literal().shape(),
                                                   this->shape()));
-  return std::make_unique<HloConstantInstruction>(literal_->Clone(),
+  return std::make_unique<HloConstantInstruction>(literal().Clone(),
                                                   this->shape());
 }
 
@@ -1513,7 +1548,7 @@ std::string HloConstantInstruction::OperandsToStringWithCanonicalNameMap(
     const HloPrintOptions& options,
     CanonicalNameMap* canonical_name_map) const {
   if (options.print_only_essential_constants()) {
-    if (!literal_.has_value()) {
+    if (!HasLiteral()) {
       return "{...}";
     }
     if (literal().IsAll(0)) {
@@ -1523,18 +1558,18 @@ std::string HloConstantInstruction::OperandsToStringWithCanonicalNameMap(
       return "1";
     }
     if (shape().IsInteger()) {
-      return literal_->ToStringWithoutShapeOneline();
+      return literal().ToStringWithoutShapeOneline();
     }
     return "{...}";
   }
 
   // For constants, show the actual value in place of an empty operand list.
-  if (literal_.has_value() &&
+  if (HasLiteral() &&
       ((shape().IsArray() && ShapeUtil::ElementsIn(shape()) <= 10) ||
        options.print_large_constants())) {
     // Literal::ToString emits multidimensional arrays over multiple
     // lines. Compact this into one line by stripping out white space.
-    return literal_->ToStringWithoutShapeOneline();
+    return literal().ToStringWithoutShapeOneline();
   } else {
     // Do not show large constants or tuples.
     return "{...}";
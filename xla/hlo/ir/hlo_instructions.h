@@ -18,6 +18,7 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_HLO_IR_HLO_INSTRUCTIONS_H_
 #define TENSORFLOW_COMPILER_XLA_HLO_IR_HLO_INSTRUCTIONS_H_
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <optional>
@@ -25,6 +26,7 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/base/call_once.h"
 #include "absl/container/inlined_vector.h"
 #include "absl/functional/function_ref.h"
 #include "absl/strings/string_view.h"
@@ -1103,11 +1105,21 @@ class HloConstantInstruction : public HloInstruction {
   // Used when the literal is too large and dropped.
   explicit HloConstantInstruction(const Shape& shape);
   // Returns the literal associated with this instruction.
-  const Literal& literal() const { return *literal_; }
+  const Literal& literal() const;
   // Returns the (mutable) literal associated with this instruction.
-  Literal* mutable_literal() { return &literal_.value(); }
+  Literal* mutable_literal();
   // Returns whether there is literal associated with this instruction.
-  bool HasLiteral() const { return literal_.has_value(); }
+  bool HasLiteral() const {
+    return lazy_literal_ != nullptr || literal_.has_value();
+  }
+  // Makes `literal_factory` create the literal of a constant without one the
+  // first time it is accessed, so that large literals that are never used
+  // don't take up memory. The literal must have the shape of this instruction,
+  // up to tiling.
+  void SetLazyLiteral(std::function<StatusOr<Literal>()> literal_factory);
+  // Returns whether the literal is created on first access and hasn't been
+  // yet.
+  bool IsLiteralPending() const;
   // Returns a serialized representation of this instruction.
   HloInstructionProto ToProto() const override;
 
@@ -1135,7 +1147,18 @@ class HloConstantInstruction : public HloInstruction {
   std::unique_ptr<HloInstruction> CloneWithNewOperandsImpl(
       const Shape& shape, absl::Span<HloInstruction* const> new_operands,
       HloCloneContext* context) const override;
-  std::optional<Literal> literal_;
+
+  // A literal created on first access.
+  struct LazyLiteral {
+    absl::once_flag once;
+    std::function<StatusOr<Literal>()> factory;
+    std::atomic<bool> created{false};
+  };
+
+  // Set while the literal is created on first access; literal_ must only be
+  // accessed after lazy_literal_->once.
+  mutable std::optional<Literal> literal_;
+  std::unique_ptr<LazyLiteral> lazy_literal_;
 };
 
 // Abstract class that represents an HLO instruction that "calls" a computation.
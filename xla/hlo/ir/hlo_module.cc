@@ -32,9 +32,13 @@ limitations under the License.
 #include "absl/container/flat_hash_set.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
+#include "xla/flat_literal_file.h"
+#include "xla/hlo/ir/hlo_casting_utils.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_instructions.h"
 #include "xla/hlo/ir/hlo_schedule.h"
+#include "xla/layout_util.h"
 #include "xla/map_util.h"
 #include "xla/service/compilation_environments.h"
 #include "xla/service/computation_placer.h"
@@ -43,11 +47,15 @@ limitations under the License.
 #include "xla/service/mapped_ptr_container_sorter.h"
 #include "xla/shape_util.h"
 #include "xla/status_macros.h"
+#include "xla/types.h"
+#include "xla/util.h"
 #include "xla/xla_data.pb.h"
 #include "tsl/lib/gtl/map_util.h"
+#include "tsl/platform/env.h"
 #include "tsl/platform/errors.h"
 #include "tsl/platform/fingerprint.h"
 #include "tsl/platform/logging.h"
+#include "tsl/platform/path.h"
 #include "tsl/platform/status.h"
 #include "tsl/platform/statusor.h"
 
@@ -356,6 +364,27 @@ StatusOr<HloModuleProtoWithConfig> HloModule::ToProtoWithConfig() const {
   return result;
 }
 
+void HloModule::UniquifyDeferredInstructions(
+    absl::Span<HloComputation* const> computations) {
+  CHECK(defer_instruction_uniquification_);
+  defer_instruction_uniquification_ = false;
+  // Provisional ids were handed out starting at next_unique_id_, which was not
+  // advanced meanwhile.
+  const int first_provisional_id = next_unique_id_;
+  if (next_provisional_id_.load() == first_provisional_id) {
+    return;
+  }
+  for (HloComputation* computation : computations) {
+    for (HloInstruction* instruction : computation->instructions()) {
+      if (instruction->unique_id() >= first_provisional_id) {
+        instruction->ClearUniqueIdInternal();
+        instruction->UniquifyName(&instruction_name_uniquer_);
+        instruction->SetUniqueId(NewUniqueInstructionId());
+      }
+    }
+  }
+}
+
 Status HloModule::CheckUniqueNamesAndIdsForComputationsAndInstructions() const {
   absl::flat_hash_set<std::string> computation_names;
   absl::flat_hash_set<int> computation_ids;
@@ -390,7 +419,254 @@ StatusOr<std::unique_ptr<HloModule>> HloModule::CreateFromProto(
     bool prohibit_empty_literal) {
   VLOG(2) << "CreateFromProto()";
   XLA_VLOG_LINES(3, proto.DebugString());
+  return CreateFromProtoImpl(
+      proto, module_config,
+      [&](int index,
+          const absl::flat_hash_map<int64_t, HloComputation*>&
+              computation_map) {
+        return HloComputation::CreateFromProto(proto.computations(index),
+                                               computation_map,
+                                               prohibit_empty_literal);
+      });
+}
+
+namespace {
+
+// Returns the size of the arrays of a literal of the given shape.
+int64_t LiteralArraysByteSize(const Shape& shape) {
+  int64_t size = 0;
+  ShapeUtil::ForEachSubshape(
+      shape, [&](const Shape& subshape, const ShapeIndex& /*index*/) {
+        if (subshape.IsArray()) {
+          size += ShapeUtil::ByteSizeOfElements(subshape);
+        }
+      });
+  return size;
+}
+
+// Checks that `proto` holds as many values, or bytes for the types stored as
+// byte strings, as a literal of `shape` has, so that a malformed constant fails
+// to load rather than when its literal is created.
+Status ValidateLiteralProto(const LiteralProto& proto, const Shape& shape,
+                            bool prohibit_empty_literal) {
+  if (shape.IsTuple()) {
+    if (proto.tuple_literals_size() != ShapeUtil::TupleElementCount(shape)) {
+      return InvalidArgument(
+          "Expected %d tuple elements in LiteralProto, has %d",
+          ShapeUtil::TupleElementCount(shape), proto.tuple_literals_size());
+    }
+    for (int i = 0; i < proto.tuple_literals_size(); ++i) {
+      TF_RETURN_IF_ERROR(ValidateLiteralProto(proto.tuple_literals(i),
+                                              shape.tuple_shapes(i),
+                                              prohibit_empty_literal));
+    }
+    return OkStatus();
+  }
+  if (!shape.IsArray()) {
+    return OkStatus();
+  }
+  const int64_t elements = ShapeUtil::ElementsIn(shape);
+  int64_t expected = elements;
+  int64_t actual;
+  switch (shape.element_type()) {
+    case PRED:
+      actual = proto.preds_size();
+      break;
+    case S8:
+      actual = proto.s8s().size();
+      break;
+    case U8:
+      actual = proto.u8s().size();
+      break;
+    case S16:
+      actual = proto.s16s().size();
+      expected = elements * sizeof(int16_t);
+      break;
+    case U16:
+      actual = proto.u16s().size();
+      expected = elements * sizeof(uint16_t);
+      break;
+    case F16:
+      actual = proto.f16s().size();
+      expected = elements * sizeof(half);
+      break;
+    case BF16:
+      actual = proto.bf16s().size();
+      expected = elements * sizeof(bfloat16);
+      break;
+    case S32:
+      actual = proto.s32s_size();
+      break;
+    case U32:
+      actual = proto.u32s_size();
+      break;
+    case S64:
+      actual = proto.s64s_size();
+      break;
+    case U64:
+      actual = proto.u64s_size();
+      break;
+    case F32:
+      actual = proto.f32s_size();
+      break;
+    case F64:
+      actual = proto.f64s_size();
+      break;
+    case C64:
+      actual = proto.c64s_size();
+      expected = elements * 2;
+      break;
+    case C128:
+      actual = proto.c128s_size();
+      expected = elements * 2;
+      break;
+    default:
+      return InvalidArgument("Unsupported literal shape: %s",
+                             ShapeUtil::HumanString(shape));
+  }
+  if (actual != expected && (prohibit_empty_literal || actual != 0)) {
+    return InvalidArgument(
+        "LiteralProto of shape %s has %d values or bytes, expected %d",
+        ShapeUtil::HumanString(shape), actual, expected);
+  }
+  return OkStatus();
+}
+
+// A flat literal file that holds the literal of a constant until the literal
+// is created. The file is deleted with this object.
+class LazyConstantFile {
+ public:
+  static StatusOr<std::shared_ptr<LazyConstantFile>> Create(
+      const LiteralSlice& literal, const std::string& dir, int64_t id) {
+    tsl::Env* env = tsl::Env::Default();
+    std::string path =
+        tsl::io::JoinPath(dir, absl::StrCat("constant.", id, "."));
+    if (!env->CreateUniqueFileName(&path, ".xlaflat")) {
+      return InternalError("Failed to create a file name in %s", dir);
+    }
+    auto file = std::shared_ptr<LazyConstantFile>(
+        new LazyConstantFile(env, std::move(path)));
+    TF_RETURN_IF_ERROR(FlatLiteralFile::Write(literal, file->path_, env));
+    TF_ASSIGN_OR_RETURN(file->file_, FlatLiteralFile::Open(file->path_, env));
+    return file;
+  }
+
+  ~LazyConstantFile() {
+    file_.reset();
+    env_->DeleteFile(path_).IgnoreError();
+  }
 
+  Literal CreateLiteral() const { return file_->literal().Clone(); }
+
+ private:
+  LazyConstantFile(tsl::Env* env, std::string path)
+      : env_(env), path_(std::move(path)) {}
+
+  tsl::Env* env_;
+  std::string path_;
+  std::unique_ptr<FlatLiteralFile> file_;
+};
+
+// Moves the literals of the large constants out of `proto`, and returns the
+// functions that create them by instruction id.
+StatusOr<absl::flat_hash_map<int64_t, std::function<StatusOr<Literal>()>>>
+ExtractLazyLiterals(HloComputationProto* proto,
+                    const HloModule::IncrementalLoadingOptions& options) {
+  absl::flat_hash_map<int64_t, std::function<StatusOr<Literal>()>> factories;
+  for (HloInstructionProto& instruction_proto :
+       *proto->mutable_instructions()) {
+    if (instruction_proto.opcode() != HloOpcodeString(HloOpcode::kConstant) ||
+        !instruction_proto.has_literal()) {
+      continue;
+    }
+    const Shape literal_shape(instruction_proto.literal().shape());
+    if (LiteralArraysByteSize(literal_shape) < options.lazy_constant_bytes) {
+      continue;
+    }
+    // Literal's shape may have no/different tiling info.
+    if (!Shape::Equal().MinorToMajorOnlyInLayout()(
+            literal_shape, Shape(instruction_proto.shape()))) {
+      return InvalidArgument(
+          "Literal of constant %s has shape %s, expected %s",
+          instruction_proto.name(), literal_shape.ToString(true),
+          Shape(instruction_proto.shape()).ToString(true));
+    }
+    TF_RETURN_IF_ERROR(
+        ShapeUtil::ValidateShapeWithOptionalLayout(literal_shape));
+    if (!LayoutUtil::HasLayout(literal_shape)) {
+      return InvalidArgument("Literal of constant %s has no layout",
+                             instruction_proto.name());
+    }
+    TF_RETURN_IF_ERROR(ValidateLiteralProto(instruction_proto.literal(),
+                                            literal_shape,
+                                            options.prohibit_empty_literal));
+    std::shared_ptr<LiteralProto> literal_proto(
+        instruction_proto.release_literal());
+    if (options.lazy_constant_dir.empty()) {
+      factories[instruction_proto.id()] =
+          [literal_proto, prohibit_empty_literal =
+                              options.prohibit_empty_literal] {
+            return Literal::CreateFromProto(*literal_proto,
+                                            prohibit_empty_literal);
+          };
+      continue;
+    }
+    TF_ASSIGN_OR_RETURN(Literal literal,
+                        Literal::CreateFromProto(
+                            *literal_proto, options.prohibit_empty_literal));
+    literal_proto.reset();
+    TF_ASSIGN_OR_RETURN(
+        std::shared_ptr<LazyConstantFile> file,
+        LazyConstantFile::Create(literal, options.lazy_constant_dir,
+                                 instruction_proto.id()));
+    factories[instruction_proto.id()] = [file]() -> StatusOr<Literal> {
+      return file->CreateLiteral();
+    };
+  }
+  return factories;
+}
+
+}  // namespace
+
+/* static */
+StatusOr<std::unique_ptr<HloModule>> HloModule::CreateFromProtoIncrementally(
+    HloModuleProto proto, const HloModuleConfig& module_config,
+    const IncrementalLoadingOptions& options) {
+  VLOG(2) << "CreateFromProtoIncrementally()";
+  return CreateFromProtoImpl(
+      proto, module_config,
+      [&](int index,
+          const absl::flat_hash_map<int64_t, HloComputation*>& computation_map)
+          -> StatusOr<std::unique_ptr<HloComputation>> {
+        HloComputationProto* computation_proto =
+            proto.mutable_computations(index);
+        TF_ASSIGN_OR_RETURN(auto lazy_literals,
+                            ExtractLazyLiterals(computation_proto, options));
+        TF_ASSIGN_OR_RETURN(std::unique_ptr<HloComputation> computation,
+                            HloComputation::CreateFromProto(
+                                *computation_proto, computation_map,
+                                options.prohibit_empty_literal));
+        // Frees the computation's proto; clearing it would keep its memory.
+        HloComputationProto().Swap(computation_proto);
+        for (HloInstruction* instruction : computation->instructions()) {
+          auto it = lazy_literals.find(instruction->unique_id());
+          if (it != lazy_literals.end() &&
+              instruction->opcode() == HloOpcode::kConstant) {
+            Cast<HloConstantInstruction>(instruction)
+                ->SetLazyLiteral(std::move(it->second));
+          }
+        }
+        return std::move(computation);
+      });
+}
+
+/* static */
+StatusOr<std::unique_ptr<HloModule>> HloModule::CreateFromProtoImpl(
+    const HloModuleProto& proto, const HloModuleConfig& module_config,
+    absl::FunctionRef<StatusOr<std::unique_ptr<HloComputation>>(
+        int index,
+        const absl::flat_hash_map<int64_t, HloComputation*>& computation_map)>
+        create_computation) {
   // The ProgramShape in the passed in module config must match the shapes of
   // the entry parameters and root.
   TF_RET_CHECK(proto.has_host_program_shape())
@@ -422,13 +698,12 @@ StatusOr<std::unique_ptr<HloModule>> HloModule::CreateFromProto(
   absl::flat_hash_map<HloComputation*, int64_t> to_proto_id;
   std::vector<std::unique_ptr<HloComputation>> computations;
   HloComputation* entry = nullptr;
-  for (const HloComputationProto& computation_proto : proto.computations()) {
-    TF_ASSIGN_OR_RETURN(
-        std::unique_ptr<HloComputation> computation,
-        HloComputation::CreateFromProto(computation_proto, computation_map,
-                                        prohibit_empty_literal));
+  for (int i = 0; i < proto.computations_size(); ++i) {
+    // The computation's proto may be released by create_computation.
+    int64_t computation_id = proto.computations(i).id();
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<HloComputation> computation,
+                        create_computation(i, computation_map));
     CHECK_NE(computation.get(), nullptr);
-    int64_t computation_id = computation_proto.id();
     TF_RET_CHECK(computation_id != -1);
     TF_RET_CHECK(!ContainsKey(computation_map, computation_id));
     computation_map[computation_id] = computation.get();
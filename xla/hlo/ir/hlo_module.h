@@ -26,6 +26,8 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
@@ -340,6 +342,28 @@ class HloModule {
       const HloModuleProto& proto, const HloModuleConfig& module_config,
       bool prohibit_empty_literal = true);
 
+  // Options of CreateFromProtoIncrementally.
+  struct IncrementalLoadingOptions {
+    bool prohibit_empty_literal = true;
+    // The literals of constants of at least this many bytes are only created
+    // when they are first accessed.
+    int64_t lazy_constant_bytes = 1 << 20;
+    // If not empty, the literals of large constants are written to flat
+    // literal files in this directory, which are mapped into memory until the
+    // literals are created, instead of being kept in memory as protos. The
+    // files are deleted with the constants.
+    std::string lazy_constant_dir;
+  };
+
+  // Like CreateFromProto, but consumes `proto` to reduce the peak memory use
+  // of loading large modules: the proto of each computation is released as
+  // soon as the computation is built, and the literals of large constants are
+  // moved out of the proto instead of being copied, and only created when
+  // they are used.
+  static StatusOr<std::unique_ptr<HloModule>> CreateFromProtoIncrementally(
+      HloModuleProto proto, const HloModuleConfig& module_config,
+      const IncrementalLoadingOptions& options);
+
   // Convert an HloModule to or from a proto that includes module configuration
   StatusOr<HloModuleProtoWithConfig> ToProtoWithConfig() const;
   static StatusOr<std::unique_ptr<HloModule>> CreateFromProtoWithConfig(
@@ -382,6 +406,32 @@ class HloModule {
     return result;
   }
 
+  // While uniquification is deferred, instructions added to computations of
+  // this module keep their names and get provisional unique ids from a
+  // thread-safe counter. This allows several computations of the module to be
+  // mutated concurrently. UniquifyDeferredInstructions() must be called before
+  // anything relies on names again.
+  void DeferInstructionUniquification() {
+    CHECK(!defer_instruction_uniquification_);
+    defer_instruction_uniquification_ = true;
+    next_provisional_id_.store(next_unique_id_);
+  }
+  bool defer_instruction_uniquification() const {
+    return defer_instruction_uniquification_;
+  }
+
+  // Returns a provisional unique id for an instruction added while
+  // uniquification is deferred.
+  int NewProvisionalInstructionId() { return next_provisional_id_++; }
+
+  // Ends the deferral of uniquification. Instructions with provisional ids
+  // are given final ids and unique names in the order of 'computations' and
+  // of the instructions within each, so the result does not depend on the
+  // order in which the instructions were added. 'computations' must contain
+  // every computation to which instructions were added.
+  void UniquifyDeferredInstructions(
+      absl::Span<HloComputation* const> computations);
+
   // input_output_alias_config indicates the list of aliased buffers that are
   // expected from the module.
   HloInputOutputAliasConfig& input_output_alias_config() {
@@ -532,6 +582,16 @@ class HloModule {
       std::unique_ptr<HloComputation> computation, bool is_entry,
       bool uniquify_identifiers, bool preserve_entry_layouts);
 
+  // Implements CreateFromProto, using `create_computation` to create the
+  // computation at the given index of proto.computations() once the
+  // computations it calls have been created.
+  static StatusOr<std::unique_ptr<HloModule>> CreateFromProtoImpl(
+      const HloModuleProto& proto, const HloModuleConfig& module_config,
+      absl::FunctionRef<StatusOr<std::unique_ptr<HloComputation>>(
+          int index,
+          const absl::flat_hash_map<int64_t, HloComputation*>& computation_map)>
+          create_computation);
+
   std::string name_;
   HloModuleConfig config_;
   HloComputation* entry_computation_ = nullptr;
@@ -549,6 +609,8 @@ class HloModule {
   NameUniquer computation_name_uniquer_{/*separator=*/"."};
   NameUniquer instruction_name_uniquer_{/*separator=*/"."};
   int next_unique_id_ = 0;
+  bool defer_instruction_uniquification_ = false;
+  std::atomic<int> next_provisional_id_{0};
 
   // Used to keep track of the next unique module id that should be assigned.
   static std::atomic<int> next_unique_module_id_;
@@ -31,22 +31,28 @@ limitations under the License.
 #include <vector>
 
 #include "absl/base/casts.h"
+#include "absl/container/inlined_vector.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/span.h"
 #include "xla/index_util.h"
 #include "xla/permutation_util.h"
+#include "xla/pjrt/transpose.h"
 #include "xla/primitive_util.h"
 #include "xla/shape_util.h"
 #include "xla/status_macros.h"
 #include "xla/types.h"
 #include "xla/util.h"
 #include "xla/xla_data.pb.h"
+#include "tsl/platform/cpu_info.h"
+#include "tsl/platform/env.h"
 #include "tsl/platform/errors.h"
 #include "tsl/platform/logging.h"
 #include "tsl/platform/mem.h"
+#include "tsl/platform/threadpool.h"
 #include "tsl/util/byte_swap_array.h"
 
 namespace xla {
@@ -592,6 +598,90 @@ void CopyElementsBetween(absl::Span<NativeT> dest,
         src[IndexUtil::MultidimensionalIndexToLinearIndex(src_shape, index)];
   } while (IndexUtil::BumpIndices(dest_shape, absl::MakeSpan(index)));
 }
+
+// Dense arrays of at least this many bytes are converted and relaid out in
+// parallel on GetLiteralThreadPool().
+constexpr int64_t kMinParallelBytes = 1 << 20;
+
+tsl::thread::ThreadPool* GetLiteralThreadPool() {
+  static tsl::thread::ThreadPool* pool = new tsl::thread::ThreadPool(
+      tsl::Env::Default(), "xla_literal", tsl::port::MaxParallelism());
+  return pool;
+}
+
+// Runs `fn` over shards of [0, n), in parallel if the `bytes` touched in total
+// are large enough to be worth it.
+void ParallelForShards(int64_t n, int64_t bytes,
+                       const std::function<void(int64_t, int64_t)>& fn) {
+  if (bytes < kMinParallelBytes || tsl::port::MaxParallelism() == 1) {
+    fn(0, n);
+    return;
+  }
+  GetLiteralThreadPool()->ParallelFor(n, /*cost_per_unit=*/bytes / n, fn);
+}
+
+// Copies the dense array `src` of shape `src_shape` into `dest` of the
+// compatible shape `dest_shape` with a cache-blocked TransposePlan. Returns
+// false, without copying anything, if the layouts aren't supported.
+bool TransposeBetweenLayouts(const void* src, const Shape& src_shape,
+                             void* dest, const Shape& dest_shape) {
+  const int64_t rank = dest_shape.rank();
+  const Layout& src_layout = src_shape.layout();
+  const Layout& dest_layout = dest_shape.layout();
+  if (rank == 0 || !src_layout.tiles().empty() ||
+      !dest_layout.tiles().empty()) {
+    return false;
+  }
+  const int64_t elem_size =
+      ShapeUtil::ByteSizeOfPrimitiveType(dest_shape.element_type());
+  if (elem_size != 1 && elem_size != 2 && elem_size != 4 && elem_size != 8 &&
+      elem_size != 16) {
+    return false;
+  }
+  if (ShapeUtil::IsZeroElementArray(dest_shape)) {
+    return true;
+  }
+
+  // TransposePlan works on physical dimensions, in major-to-minor order.
+  absl::InlinedVector<int64_t, 8> dims(rank);
+  absl::InlinedVector<int64_t, 8> src_position(rank);
+  for (int64_t i = 0; i < rank; ++i) {
+    const int64_t dim = src_layout.minor_to_major(rank - 1 - i);
+    dims[i] = src_shape.dimensions(dim);
+    src_position[dim] = i;
+  }
+  absl::InlinedVector<int64_t, 8> permutation(rank);
+  for (int64_t i = 0; i < rank; ++i) {
+    permutation[i] = src_position[dest_layout.minor_to_major(rank - 1 - i)];
+  }
+
+  const int64_t size_bytes = ShapeUtil::ByteSizeOfElements(dest_shape);
+  tsl::thread::ThreadPool* pool = size_bytes >= kMinParallelBytes
+                                      ? GetLiteralThreadPool()
+                                      : nullptr;
+  std::shared_ptr<TransposePlan> plan;
+  {
+    static absl::Mutex mu(absl::kConstInit);
+    static TransposePlanCache* cache = new TransposePlanCache(/*capacity=*/16);
+    absl::MutexLock lock(&mu);
+    StatusOr<std::shared_ptr<TransposePlan>> cached_plan = cache->GetOrCreate(
+        elem_size, dims, permutation, TransposePlan::Tiling{},
+        TransposePlan::Tiling{}, TransposePlan::Transformation::kNone,
+        pool == nullptr ? 1 : pool->NumThreads());
+    if (!cached_plan.ok()) {
+      return false;
+    }
+    plan = *std::move(cached_plan);
+  }
+  if (pool == nullptr) {
+    plan->Execute(src, dest);
+  } else {
+    plan->Execute(src, dest, [pool](std::function<void()> fn) {
+      pool->Schedule(std::move(fn));
+    });
+  }
+  return true;
+}
 }  // namespace
 
 int32_t LiteralBase::Piece::GetDynamicSize(int64_t dim_index) const {
@@ -655,7 +745,9 @@ Status LiteralBase::Piece::CopyFrom(const LiteralBase::Piece& src,
   if (ShapeUtil::Equal(subshape(), src.subshape())) {
     // If the layouts are equal it's faster just to memcpy.
     memcpy(buffer(), src.buffer(), src.size_bytes_dense());
-  } else {
+  } else if (only_dynamic_bound ||
+             !TransposeBetweenLayouts(src.buffer(), src.subshape(), buffer(),
+                                      subshape())) {
     std::vector<int64_t> origin(subshape().rank(), 0);
     switch (subshape().element_type()) {
 #define COPY_ELEMENTS(XLA_T, NATIVE_T)                                      \
@@ -1546,9 +1638,48 @@ Literal ConvertBetweenNativeTypesWithConverter(const LiteralBase& src_literal,
   auto dest_data = result_literal.template data<NativeDestT>();
   int64_t num_elements = src_literal.element_count();
 
-  for (int64_t i = 0; i < num_elements; ++i) {
-    dest_data[i] = converter(src_data[i]);
-  }
+  ParallelForShards(
+      num_elements, num_elements * (sizeof(NativeSrcT) + sizeof(NativeDestT)),
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          dest_data[i] = converter(src_data[i]);
+        }
+      });
+  return result_literal;
+}
+
+// Conversions between F32 and the 16-bit floating point types, which Eigen
+// vectorizes with round-to-nearest-even semantics matching static_cast.
+template <typename NativeSrcT, typename NativeDestT>
+constexpr bool IsVectorizedFloatConversion() {
+  return (std::is_same<NativeSrcT, float>::value &&
+          (std::is_same<NativeDestT, half>::value ||
+           std::is_same<NativeDestT, bfloat16>::value)) ||
+         (std::is_same<NativeDestT, float>::value &&
+          (std::is_same<NativeSrcT, half>::value ||
+           std::is_same<NativeSrcT, bfloat16>::value));
+}
+
+template <typename NativeSrcT, typename NativeDestT>
+Literal ConvertBetweenNativeFloatTypesVectorized(
+    const LiteralBase& src_literal) {
+  CHECK(src_literal.shape().IsArray());
+  Literal result_literal(ShapeUtil::ChangeElementType(
+      src_literal.shape(),
+      primitive_util::NativeToPrimitiveType<NativeDestT>()));
+  const NativeSrcT* src_data = src_literal.data<NativeSrcT>().data();
+  NativeDestT* dest_data = result_literal.template data<NativeDestT>().data();
+  int64_t num_elements = src_literal.element_count();
+
+  ParallelForShards(
+      num_elements, num_elements * (sizeof(NativeSrcT) + sizeof(NativeDestT)),
+      [&](int64_t begin, int64_t end) {
+        using SrcArray = Eigen::Array<NativeSrcT, Eigen::Dynamic, 1>;
+        using DestArray = Eigen::Array<NativeDestT, Eigen::Dynamic, 1>;
+        Eigen::Map<DestArray>(dest_data + begin, end - begin) =
+            Eigen::Map<const SrcArray>(src_data + begin, end - begin)
+                .template cast<NativeDestT>();
+      });
   return result_literal;
 }
 
@@ -1608,6 +1739,10 @@ typename std::enable_if<!(std::is_floating_point<NativeSrcT>::value &&
                                std::is_same<NativeDestT, complex128>::value)),
                         Literal>::type
 ConvertBetweenNativeTypes(const LiteralBase& src_literal) {
+  if constexpr (IsVectorizedFloatConversion<NativeSrcT, NativeDestT>()) {
+    return ConvertBetweenNativeFloatTypesVectorized<NativeSrcT, NativeDestT>(
+        src_literal);
+  }
   auto converter = [](NativeSrcT src) { return static_cast<NativeDestT>(src); };
   return ConvertBetweenNativeTypesWithConverter<NativeSrcT, NativeDestT>(
       src_literal, converter);
@@ -2789,17 +2924,19 @@ BorrowingLiteral::BorrowingLiteral(absl::Span<const char* const> src_buf_ptrs,
                                    const Shape& shape)
     : LiteralBase(), shape_(std::make_unique<Shape>(shape)) {
   CHECK(shape_->IsTuple());
-  CHECK(!ShapeUtil::IsNestedTuple(*shape_));
-  CHECK_EQ(src_buf_ptrs.size(), ShapeUtil::TupleElementCount(*shape_));
   root_piece_ = Piece();
   root_piece_.set_subshape(shape_.get());
   BuildPieceSubtree(*shape_, &root_piece_);
 
-  for (int i = 0, end = src_buf_ptrs.size(); i < end; ++i) {
-    const auto& src_shape = shape_->tuple_shapes(i);
-    CHECK(src_shape.IsArray());
-    root_piece_.child(i).set_buffer(const_cast<char*>(src_buf_ptrs[i]));
-  }
+  size_t i = 0;
+  root_piece_.ForEachMutableSubpiece(
+      [&](const ShapeIndex& index, Piece* piece) {
+        if (piece->subshape().IsArray()) {
+          CHECK_LT(i, src_buf_ptrs.size());
+          piece->set_buffer(const_cast<char*>(src_buf_ptrs[i++]));
+        }
+      });
+  CHECK_EQ(i, src_buf_ptrs.size());
 }
 
 }  // namespace xla
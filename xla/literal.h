@@ -1189,10 +1189,11 @@ class BorrowingLiteral : public LiteralBase {
   // data interpretered as indicated by 'shape'.
   // This constructor is only used for array shapes.
   BorrowingLiteral(const char* src_buf_ptr, const Shape& shape);
-  // Similar as above, except to be used for constructing non-nested tuples.
+  // Similar as above, except to be used for constructing (possibly nested)
+  // tuples. 'src_buf_ptrs' holds one buffer for each array subshape of 'shape',
+  // in the order in which ShapeUtil::ForEachSubshape visits them.
   BorrowingLiteral(absl::Span<const char* const> src_buf_ptrs,
                    const Shape& shape);
-  // TODO(b/79707221): adding constructors for nested tuples as well.
 
  private:
   // Recursively builds the subtree for the given piece and sets the subshapes
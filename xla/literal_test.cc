@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "xla/literal.h"
 
+#include <cmath>
 #include <cstdint>
 #include <limits>
 #include <memory>
@@ -786,6 +787,30 @@ TEST_F(LiteralUtilTest, TestR4RelayoutEquivalence) {
   EXPECT_EQ(literal_r4_2x2x3x3_dim0minor_, dim0major_relaid_to_dim0minor);
 }
 
+TEST_F(LiteralUtilTest, RelayoutLargeR3) {
+  // Large enough to be relaid out in parallel.
+  Literal original(
+      ShapeUtil::MakeShapeWithDenseLayout(F32, {64, 96, 80}, {2, 1, 0}));
+  ASSERT_TRUE(original
+                  .Populate<float>([](absl::Span<const int64_t> indexes) {
+                    return indexes[0] * 10000 + indexes[1] * 100 + indexes[2];
+                  })
+                  .ok());
+  for (const auto& minor_to_major :
+       std::vector<std::vector<int64_t>>{{0, 1, 2}, {0, 2, 1}, {1, 0, 2}}) {
+    Literal relaid =
+        original.Relayout(LayoutUtil::MakeLayout(minor_to_major));
+    EXPECT_EQ(original, relaid);
+    EXPECT_EQ(relaid.Relayout(LayoutUtil::MakeLayout({2, 1, 0})).data<float>(),
+              original.data<float>());
+  }
+
+  Literal pred = LiteralUtil::CreateR2WithLayout<bool>(
+      {{true, false, false}, {false, true, true}}, layout_r2_dim0major_);
+  EXPECT_THAT(pred.Relayout(layout_r2_dim0minor_).data<bool>(),
+              ElementsAre(true, false, false, true, false, true));
+}
+
 TEST_F(LiteralUtilTest, TestR2LinearLayout) {
   // Test expected memory layout of R2 dim0-minor (column-major) literal.
   auto mat_dim0minor = LiteralUtil::CreateR2WithLayout<int32_t>(
@@ -1339,6 +1364,48 @@ TEST_F(LiteralUtilTest, ConvertR4) {
   EXPECT_EQ(expected, converted);
 }
 
+TEST_F(LiteralUtilTest, ConvertLargeF32To16BitFloats) {
+  // Large enough to be converted in parallel, and covering rounding ties and
+  // special values.
+  std::vector<float> values(1 << 19);
+  for (int64_t i = 0; i < values.size(); ++i) {
+    values[i] = absl::bit_cast<float>(static_cast<uint32_t>(i * 8191));
+  }
+  values[0] = std::numeric_limits<float>::quiet_NaN();
+  values[1] = std::numeric_limits<float>::infinity();
+  values[2] = -std::numeric_limits<float>::infinity();
+  values[3] = 1.0f + std::numeric_limits<float>::epsilon() * 0x7fff;
+  Literal f32 = LiteralUtil::CreateR1<float>(values);
+
+  TF_ASSERT_OK_AND_ASSIGN(Literal bf16, f32.Convert(BF16));
+  TF_ASSERT_OK_AND_ASSIGN(Literal f16, f32.Convert(F16));
+  for (int64_t i = 0; i < values.size(); ++i) {
+    if (std::isnan(values[i])) {
+      EXPECT_TRUE(std::isnan(static_cast<float>(bf16.Get<bfloat16>({i}))));
+      EXPECT_TRUE(std::isnan(static_cast<float>(f16.Get<half>({i}))));
+      continue;
+    }
+    EXPECT_EQ(absl::bit_cast<uint16_t>(bf16.Get<bfloat16>({i})),
+              absl::bit_cast<uint16_t>(static_cast<bfloat16>(values[i])))
+        << values[i];
+    EXPECT_EQ(absl::bit_cast<uint16_t>(f16.Get<half>({i})),
+              absl::bit_cast<uint16_t>(static_cast<half>(values[i])))
+        << values[i];
+  }
+
+  TF_ASSERT_OK_AND_ASSIGN(Literal from_bf16, bf16.Convert(F32));
+  TF_ASSERT_OK_AND_ASSIGN(Literal from_f16, f16.Convert(F32));
+  for (int64_t i = 0; i < values.size(); ++i) {
+    if (std::isnan(values[i])) {
+      continue;
+    }
+    EXPECT_EQ(from_bf16.Get<float>({i}),
+              static_cast<float>(bf16.Get<bfloat16>({i})));
+    EXPECT_EQ(from_f16.Get<float>({i}),
+              static_cast<float>(f16.Get<half>({i})));
+  }
+}
+
 TEST_F(LiteralUtilTest, ConvertIfTypesMatch) {
   // clang-format off
   auto s8 = LiteralUtil::CreateR4WithLayout<int8_t>({{
@@ -1718,6 +1785,28 @@ TEST_F(LiteralUtilTest, BorrowingLiteralFromMultipleBufferPtrs) {
       literal_tuple.Get<int64_t>(/*multi_index=*/{2}, /*shape_index=*/{0}), 3);
 }
 
+TEST_F(LiteralUtilTest, BorrowingLiteralFromNestedTuple) {
+  std::vector<int32_t> one_two = {1, 2};
+  std::vector<float> half = {0.5f};
+  std::vector<int32_t> seven = {7};
+  const Shape s32_shape = ShapeUtil::MakeShape(S32, {2});
+  const Shape f32_shape = ShapeUtil::MakeShape(F32, {});
+  const Shape scalar_s32_shape = ShapeUtil::MakeShape(S32, {});
+  const Shape shape = ShapeUtil::MakeTupleShape(
+      {ShapeUtil::MakeTupleShape({s32_shape, f32_shape}), scalar_s32_shape});
+
+  std::vector<const char*> src_buf_ptrs = {
+      reinterpret_cast<const char*>(one_two.data()),
+      reinterpret_cast<const char*>(half.data()),
+      reinterpret_cast<const char*>(seven.data())};
+  BorrowingLiteral literal(src_buf_ptrs, shape);
+
+  EXPECT_EQ(literal.Get<int32_t>({1}, {0, 0}), 2);
+  EXPECT_EQ(literal.Get<float>({}, {0, 1}), 0.5f);
+  EXPECT_EQ(literal.Get<int32_t>({}, {1}), 7);
+  EXPECT_EQ(literal.data<int32_t>({0, 0}).data(), one_two.data());
+}
+
 TEST_F(LiteralUtilTest, LiteralMove) {
   Literal matrix = LiteralUtil::CreateR2<float>({{1.0, 2.0}, {3.0, 4.0}});
   Literal literal(std::move(matrix));
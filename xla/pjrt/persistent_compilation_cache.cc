@@ -0,0 +1,219 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/persistent_compilation_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "xla/util.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/file_statistics.h"
+#include "tsl/platform/fingerprint.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/path.h"
+#include "tsl/platform/random.h"
+
+namespace xla {
+namespace {
+
+// Every entry starts with this magic string followed by a 128-bit fingerprint
+// of the payload. Bump the version whenever the entry layout changes.
+constexpr absl::string_view kMagic = "XLAPCC01";
+constexpr size_t kFingerprintSize = 2 * sizeof(uint64_t);
+constexpr size_t kHeaderSize = kMagic.size() + kFingerprintSize;
+
+constexpr absl::string_view kEntrySuffix = ".xla_cache";
+constexpr absl::string_view kTempInfix = ".tmp.";
+// Temporary files older than this were abandoned by a writer that died.
+constexpr int64_t kStaleTempFileAgeNanos =
+    int64_t{10} * 60 * 1000 * 1000 * 1000;
+
+std::string EncodeFingerprint(absl::string_view payload) {
+  tsl::Fprint128 fingerprint = tsl::Fingerprint128(payload);
+  std::string encoded(kFingerprintSize, '\0');
+  std::memcpy(encoded.data(), &fingerprint.low64, sizeof(uint64_t));
+  std::memcpy(encoded.data() + sizeof(uint64_t), &fingerprint.high64,
+              sizeof(uint64_t));
+  return encoded;
+}
+
+bool IsValidKey(absl::string_view key) {
+  return !key.empty() && std::all_of(key.begin(), key.end(), [](char c) {
+    return absl::ascii_isalnum(c) || c == '_' || c == '-';
+  });
+}
+
+// Sets the modification time of the local file `path` to now. Best effort: if
+// it fails, the entry is merely evicted earlier than it would be otherwise.
+void Touch(const std::string& path) {
+#if defined(_WIN32)
+  _utime(path.c_str(), nullptr);
+#else
+  utime(path.c_str(), nullptr);
+#endif
+}
+
+}  // namespace
+
+/*static*/ StatusOr<std::unique_ptr<PersistentCompilationCache>>
+PersistentCompilationCache::Create(std::string directory,
+                                   int64_t max_size_bytes, tsl::Env* env) {
+  if (directory.empty()) {
+    return InvalidArgument("Compilation cache directory must not be empty");
+  }
+  TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(directory));
+  return std::unique_ptr<PersistentCompilationCache>(
+      new PersistentCompilationCache(std::move(directory), max_size_bytes,
+                                     env));
+}
+
+PersistentCompilationCache::PersistentCompilationCache(std::string directory,
+                                                       int64_t max_size_bytes,
+                                                       tsl::Env* env)
+    : directory_(std::move(directory)),
+      max_size_bytes_(max_size_bytes),
+      env_(env) {}
+
+std::string PersistentCompilationCache::EntryPath(absl::string_view key) const {
+  return tsl::io::JoinPath(directory_, absl::StrCat(key, kEntrySuffix));
+}
+
+StatusOr<std::optional<std::string>> PersistentCompilationCache::Get(
+    absl::string_view key) const {
+  if (!IsValidKey(key)) {
+    return InvalidArgument("Invalid compilation cache key: '%s'", key);
+  }
+  const std::string path = EntryPath(key);
+  std::string contents;
+  Status status = tsl::ReadFileToString(env_, path, &contents);
+  if (tsl::errors::IsNotFound(status)) {
+    return std::optional<std::string>();
+  }
+  TF_RETURN_IF_ERROR(status);
+
+  absl::string_view view(contents);
+  if (view.size() < kHeaderSize || !absl::StartsWith(view, kMagic) ||
+      view.substr(kMagic.size(), kFingerprintSize) !=
+          EncodeFingerprint(view.substr(kHeaderSize))) {
+    LOG(WARNING) << "Removing corrupted compilation cache entry " << path;
+    // Another process may have already replaced or removed the entry.
+    env_->DeleteFile(path).IgnoreError();
+    return std::optional<std::string>();
+  }
+  // Eviction removes the entries with the oldest modification time first.
+  Touch(path);
+  num_hits_.fetch_add(1, std::memory_order_relaxed);
+  contents.erase(0, kHeaderSize);
+  return std::optional<std::string>(std::move(contents));
+}
+
+Status PersistentCompilationCache::Put(absl::string_view key,
+                                       absl::string_view value) {
+  if (!IsValidKey(key)) {
+    return InvalidArgument("Invalid compilation cache key: '%s'", key);
+  }
+  const std::string path = EntryPath(key);
+  // Write to a private file first and atomically rename it into place, so
+  // that concurrent readers never observe a partially written entry.
+  const std::string temp_path =
+      absl::StrCat(path, kTempInfix, absl::Hex(tsl::random::New64()));
+  std::string contents;
+  contents.reserve(kHeaderSize + value.size());
+  absl::StrAppend(&contents, kMagic, EncodeFingerprint(value), value);
+
+  Status status = tsl::WriteStringToFile(env_, temp_path, contents);
+  if (status.ok()) {
+    status = env_->RenameFile(temp_path, path);
+  }
+  if (!status.ok()) {
+    env_->DeleteFile(temp_path).IgnoreError();
+    return status;
+  }
+  return EvictIfNeeded();
+}
+
+Status PersistentCompilationCache::EvictIfNeeded() {
+  if (max_size_bytes_ <= 0) {
+    return OkStatus();
+  }
+  std::vector<std::string> children;
+  TF_RETURN_IF_ERROR(env_->GetChildren(directory_, &children));
+
+  // (modification time, size, path) of every entry.
+  std::vector<std::tuple<int64_t, int64_t, std::string>> files;
+  int64_t total_size = 0;
+  const int64_t now_nsec = env_->NowNanos();
+  for (const std::string& child : children) {
+    if (!absl::StrContains(child, kEntrySuffix)) {
+      continue;
+    }
+    std::string path = tsl::io::JoinPath(directory_, child);
+    tsl::FileStatistics stat;
+    if (!env_->Stat(path, &stat).ok() || stat.is_directory) {
+      // Concurrently evicted or renamed by another process.
+      continue;
+    }
+    if (absl::StrContains(child, kTempInfix)) {
+      // Leave the temporary files of writes that may still be in flight, in
+      // this or another process, alone, and reap those left behind by
+      // processes that died mid-write.
+      if (now_nsec - stat.mtime_nsec >= kStaleTempFileAgeNanos) {
+        VLOG(1) << "Deleting stale temporary file " << path;
+        env_->DeleteFile(path).IgnoreError();
+      }
+      continue;
+    }
+    total_size += stat.length;
+    files.emplace_back(stat.mtime_nsec, stat.length, std::move(path));
+  }
+  if (total_size <= max_size_bytes_) {
+    return OkStatus();
+  }
+
+  std::sort(files.begin(), files.end());
+  for (const auto& [mtime_nsec, size, path] : files) {
+    if (total_size <= max_size_bytes_) {
+      break;
+    }
+    VLOG(1) << "Evicting compilation cache entry " << path << " (" << size
+            << " bytes)";
+    Status status = env_->DeleteFile(path);
+    if (!status.ok() && !tsl::errors::IsNotFound(status)) {
+      return status;
+    }
+    total_size -= size;
+  }
+  return OkStatus();
+}
+
+}  // namespace xla
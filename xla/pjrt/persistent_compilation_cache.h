@@ -0,0 +1,89 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef XLA_PJRT_PERSISTENT_COMPILATION_CACHE_H_
+#define XLA_PJRT_PERSISTENT_COMPILATION_CACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "xla/status.h"
+#include "xla/statusor.h"
+#include "tsl/platform/env.h"
+
+namespace xla {
+
+// A content-addressed cache of serialized executables stored as files in a
+// local directory, so that compilation results survive process restarts.
+//
+// Keys are fingerprints computed by the caller; values are opaque bytes. The
+// directory may be shared by several processes at once:
+//  * Entries are written to a uniquely named temporary file and then renamed
+//    into place, so readers observe either a complete entry or none at all.
+//  * Every entry carries a fingerprint of its payload. Truncated or otherwise
+//    corrupted entries are reported as misses and removed.
+//  * After each insertion the total size of the directory is bounded by
+//    evicting the entries with the oldest modification time first. Hits
+//    refresh the modification time of their entry, so eviction is least
+//    recently used first. Entries that disappear underneath a reader because
+//    another process evicted them are reported as misses.
+//  * Eviction does not count or delete temporary files, which may belong to
+//    writes in flight, except that those older than ten minutes were
+//    abandoned by processes that died mid-write and are deleted.
+//
+// The class is thread-safe.
+class PersistentCompilationCache {
+ public:
+  // Creates the cache directory if it does not exist yet. A `max_size_bytes`
+  // of zero or less disables eviction.
+  static StatusOr<std::unique_ptr<PersistentCompilationCache>> Create(
+      std::string directory, int64_t max_size_bytes,
+      tsl::Env* env = tsl::Env::Default());
+
+  // Returns the value stored for `key`, or std::nullopt if there is no valid
+  // entry for it.
+  StatusOr<std::optional<std::string>> Get(absl::string_view key) const;
+
+  // Stores `value` for `key`, replacing any existing entry, and then evicts
+  // old entries until the directory fits into the size budget.
+  Status Put(absl::string_view key, absl::string_view value);
+
+  const std::string& directory() const { return directory_; }
+  int64_t max_size_bytes() const { return max_size_bytes_; }
+  // Number of Get calls through this instance that found a valid entry.
+  int64_t num_hits() const { return num_hits_.load(std::memory_order_relaxed); }
+
+ private:
+  PersistentCompilationCache(std::string directory, int64_t max_size_bytes,
+                             tsl::Env* env);
+
+  std::string EntryPath(absl::string_view key) const;
+
+  // Deletes entries, oldest first, until the directory is within budget.
+  Status EvictIfNeeded();
+
+  const std::string directory_;
+  const int64_t max_size_bytes_;
+  tsl::Env* const env_;
+  mutable std::atomic<int64_t> num_hits_{0};
+};
+
+}  // namespace xla
+
+#endif  // XLA_PJRT_PERSISTENT_COMPILATION_CACHE_H_
@@ -0,0 +1,252 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/pjrt/persistent_compilation_cache.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+#include "absl/strings/str_cat.h"
+#include "xla/test.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/path.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/threadpool.h"
+
+namespace xla {
+namespace {
+
+std::string TestDirectory(absl::string_view name) {
+  return tsl::io::JoinPath(tsl::testing::TmpDir(), "compilation_cache", name);
+}
+
+int64_t DirectorySize(const std::string& directory) {
+  std::vector<std::string> children;
+  TF_CHECK_OK(tsl::Env::Default()->GetChildren(directory, &children));
+  int64_t size = 0;
+  for (const std::string& child : children) {
+    uint64_t file_size;
+    TF_CHECK_OK(tsl::Env::Default()->GetFileSize(
+        tsl::io::JoinPath(directory, child), &file_size));
+    size += file_size;
+  }
+  return size;
+}
+
+TEST(PersistentCompilationCacheTest, RoundTrip) {
+  TF_ASSERT_OK_AND_ASSIGN(auto cache, PersistentCompilationCache::Create(
+                                          TestDirectory("RoundTrip"),
+                                          /*max_size_bytes=*/0));
+
+  TF_ASSERT_OK_AND_ASSIGN(std::optional<std::string> missing,
+                          cache->Get("key0"));
+  EXPECT_FALSE(missing.has_value());
+
+  TF_ASSERT_OK(cache->Put("key0", "value0"));
+  TF_ASSERT_OK(cache->Put("key1", std::string(1000, '\0')));
+  TF_ASSERT_OK_AND_ASSIGN(std::optional<std::string> value0,
+                          cache->Get("key0"));
+  EXPECT_EQ(value0, "value0");
+  TF_ASSERT_OK_AND_ASSIGN(std::optional<std::string> value1,
+                          cache->Get("key1"));
+  EXPECT_EQ(value1, std::string(1000, '\0'));
+
+  TF_ASSERT_OK(cache->Put("key0", "replaced"));
+  TF_ASSERT_OK_AND_ASSIGN(value0, cache->Get("key0"));
+  EXPECT_EQ(value0, "replaced");
+}
+
+TEST(PersistentCompilationCacheTest, SharedBetweenInstances) {
+  const std::string directory = TestDirectory("SharedBetweenInstances");
+  TF_ASSERT_OK_AND_ASSIGN(auto writer, PersistentCompilationCache::Create(
+                                           directory, /*max_size_bytes=*/0));
+  TF_ASSERT_OK(writer->Put("key", "value"));
+
+  TF_ASSERT_OK_AND_ASSIGN(auto reader, PersistentCompilationCache::Create(
+                                           directory, /*max_size_bytes=*/0));
+  TF_ASSERT_OK_AND_ASSIGN(std::optional<std::string> value,
+                          reader->Get("key"));
+  EXPECT_EQ(value, "value");
+}
+
+TEST(PersistentCompilationCacheTest, RejectsInvalidKeys) {
+  TF_ASSERT_OK_AND_ASSIGN(auto cache, PersistentCompilationCache::Create(
+                                          TestDirectory("RejectsInvalidKeys"),
+                                          /*max_size_bytes=*/0));
+  EXPECT_FALSE(cache->Put("", "value").ok());
+  EXPECT_FALSE(cache->Put("../escape", "value").ok());
+  EXPECT_FALSE(cache->Get("a/b").ok());
+}
+
+TEST(PersistentCompilationCacheTest, CorruptedEntryIsAMiss) {
+  const std::string directory = TestDirectory("CorruptedEntryIsAMiss");
+  TF_ASSERT_OK_AND_ASSIGN(auto cache, PersistentCompilationCache::Create(
+                                          directory, /*max_size_bytes=*/0));
+  TF_ASSERT_OK(cache->Put("key", "some serialized executable"));
+
+  std::vector<std::string> children;
+  TF_ASSERT_OK(tsl::Env::Default()->GetChildren(directory, &children));
+  ASSERT_EQ(children.size(), 1);
+  const std::string path = tsl::io::JoinPath(directory, children[0]);
+  std::string contents;
+  TF_ASSERT_OK(tsl::ReadFileToString(tsl::Env::Default(), path, &contents));
+  // Simulate a torn write by truncating the entry.
+  TF_ASSERT_OK(tsl::WriteStringToFile(
+      tsl::Env::Default(), path, contents.substr(0, contents.size() - 3)));
+
+  TF_ASSERT_OK_AND_ASSIGN(std::optional<std::string> value, cache->Get("key"));
+  EXPECT_FALSE(value.has_value());
+  // The corrupted entry is removed.
+  EXPECT_TRUE(tsl::errors::IsNotFound(tsl::Env::Default()->FileExists(path)));
+}
+
+TEST(PersistentCompilationCacheTest, EvictsToStayWithinBudget) {
+  const std::string directory = TestDirectory("EvictsToStayWithinBudget");
+  constexpr int64_t kMaxSizeBytes = 4 * 1024;
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto cache, PersistentCompilationCache::Create(directory, kMaxSizeBytes));
+
+  for (int i = 0; i < 16; ++i) {
+    TF_ASSERT_OK(cache->Put(absl::StrCat("key", i), std::string(1000, 'x')));
+    EXPECT_LE(DirectorySize(directory), kMaxSizeBytes);
+  }
+  int hits = 0;
+  for (int i = 0; i < 16; ++i) {
+    TF_ASSERT_OK_AND_ASSIGN(std::optional<std::string> value,
+                            cache->Get(absl::StrCat("key", i)));
+    hits += value.has_value();
+  }
+  EXPECT_GT(hits, 0);
+  EXPECT_LT(hits, 16);
+}
+
+TEST(PersistentCompilationCacheTest, EvictsLeastRecentlyUsedFirst) {
+  const std::string directory = TestDirectory("EvictsLeastRecentlyUsedFirst");
+  // Room for two of the entries below, but not for three.
+  constexpr int64_t kMaxSizeBytes = 2500;
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto cache, PersistentCompilationCache::Create(directory, kMaxSizeBytes));
+  // Sleep between the accesses so that their modification times differ even
+  // on file systems with a coarse timestamp granularity.
+  auto sleep = [] { tsl::Env::Default()->SleepForMicroseconds(50 * 1000); };
+
+  TF_ASSERT_OK(cache->Put("key0", std::string(1000, 'x')));
+  TF_ASSERT_OK(cache->Put("key1", std::string(1000, 'x')));
+  sleep();
+  // Reading key0 makes key1 the least recently used entry.
+  TF_ASSERT_OK_AND_ASSIGN(std::optional<std::string> value, cache->Get("key0"));
+  EXPECT_TRUE(value.has_value());
+  EXPECT_EQ(cache->num_hits(), 1);
+  sleep();
+  TF_ASSERT_OK(cache->Put("key2", std::string(1000, 'x')));
+
+  TF_ASSERT_OK_AND_ASSIGN(value, cache->Get("key0"));
+  EXPECT_TRUE(value.has_value());
+  TF_ASSERT_OK_AND_ASSIGN(value, cache->Get("key1"));
+  EXPECT_FALSE(value.has_value());
+  TF_ASSERT_OK_AND_ASSIGN(value, cache->Get("key2"));
+  EXPECT_TRUE(value.has_value());
+  EXPECT_EQ(cache->num_hits(), 3);
+}
+
+TEST(PersistentCompilationCacheTest, EvictionOnlyReapsStaleTemporaryFiles) {
+  const std::string directory =
+      TestDirectory("EvictionOnlyReapsStaleTemporaryFiles");
+  tsl::Env* env = tsl::Env::Default();
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto cache, PersistentCompilationCache::Create(directory, 2500));
+  // Temporary files as written by Put in other processes: one still being
+  // written and one abandoned a day ago.
+  const std::string in_flight =
+      tsl::io::JoinPath(directory, "other0.xla_cache.tmp.1");
+  const std::string abandoned =
+      tsl::io::JoinPath(directory, "other1.xla_cache.tmp.2");
+  TF_ASSERT_OK(tsl::WriteStringToFile(env, in_flight, std::string(2000, 'x')));
+  TF_ASSERT_OK(tsl::WriteStringToFile(env, abandoned, std::string(2000, 'x')));
+#if defined(_WIN32)
+  struct _utimbuf times;
+#else
+  struct utimbuf times;
+#endif
+  times.actime = times.modtime = env->NowSeconds() - 24 * 60 * 60;
+#if defined(_WIN32)
+  ASSERT_EQ(_utime(abandoned.c_str(), &times), 0);
+#else
+  ASSERT_EQ(utime(abandoned.c_str(), &times), 0);
+#endif
+
+  TF_ASSERT_OK(cache->Put("key0", std::string(1000, 'x')));
+  TF_ASSERT_OK(cache->Put("key1", std::string(1000, 'x')));
+  TF_EXPECT_OK(env->FileExists(in_flight));
+  EXPECT_TRUE(tsl::errors::IsNotFound(env->FileExists(abandoned)));
+  // The in-flight file doesn't count towards the budget.
+  TF_ASSERT_OK_AND_ASSIGN(std::optional<std::string> value, cache->Get("key0"));
+  EXPECT_TRUE(value.has_value());
+  TF_ASSERT_OK_AND_ASSIGN(value, cache->Get("key1"));
+  EXPECT_TRUE(value.has_value());
+}
+
+TEST(PersistentCompilationCacheTest, ConcurrentWritersAndReaders) {
+  const std::string directory = TestDirectory("ConcurrentWritersAndReaders");
+  constexpr int kNumThreads = 8;
+  constexpr int kNumKeys = 4;
+  std::vector<std::unique_ptr<PersistentCompilationCache>> caches;
+  for (int i = 0; i < kNumThreads; ++i) {
+    // Separate instances stand in for separate processes.
+    TF_ASSERT_OK_AND_ASSIGN(
+        auto cache,
+        PersistentCompilationCache::Create(directory, /*max_size_bytes=*/0));
+    caches.push_back(std::move(cache));
+  }
+
+  {
+    tsl::thread::ThreadPool pool(tsl::Env::Default(), "cache_test",
+                                 kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&, t] {
+        for (int i = 0; i < 50; ++i) {
+          std::string key = absl::StrCat("key", (t + i) % kNumKeys);
+          std::string expected(10000 + (t + i) % kNumKeys, 'a' + t % 26);
+          if (i % 2 == 0) {
+            TF_CHECK_OK(caches[t]->Put(key, expected));
+          } else {
+            StatusOr<std::optional<std::string>> value = caches[t]->Get(key);
+            TF_CHECK_OK(value.status());
+            // Any writer may have stored the entry, but it must be complete.
+            if (value->has_value()) {
+              EXPECT_EQ((*value)->size(), expected.size());
+            }
+          }
+        }
+      });
+    }
+  }
+}
+
+}  // namespace
+}  // namespace xla
@@ -24,6 +24,10 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#if !defined(_WIN32)
+#include <dlfcn.h>
+#endif
+
 #include "xla/util.h"
 #include "tsl/platform/errors.h"
 
@@ -31,14 +35,19 @@ limitations under the License.
 
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/types/span.h"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Host.h"
 #include "xla/client/executable_build_options.h"
 #include "xla/client/xla_computation.h"
 #include "xla/literal.h"
 #include "xla/pjrt/mlir_to_hlo.h"
+#include "xla/pjrt/persistent_compilation_cache.h"
 #include "xla/pjrt/pjrt_client.h"
 #include "xla/pjrt/pjrt_future.h"
 #include "xla/pjrt/semaphore.h"
@@ -55,7 +64,11 @@ limitations under the License.
 #include "xla/shape.h"
 #include "xla/statusor.h"
 #include "xla/xla_data.pb.h"
+#include "tsl/lib/strings/proto_serialization.h"
 #include "tsl/platform/denormal.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/fingerprint.h"
+#include "tsl/platform/protobuf.h"
 #include "tsl/platform/setround.h"
 #include "tsl/profiler/lib/connected_traceme.h"
 #include "tfrt/host_context/async_value_ref.h"  // from @tf_runtime
@@ -169,8 +182,26 @@ StatusOr<std::unique_ptr<PjRtClient>> GetTfrtCpuClient(bool asynchronous,
   TF_ASSIGN_OR_RETURN(std::vector<std::unique_ptr<TfrtCpuDevice>> devices,
                       GetTfrtCpuDevices(asynchronous, cpu_device_count));
 
+  // A broken cache directory must not prevent the client from working; fall
+  // back to compiling every executable.
+  std::unique_ptr<PersistentCompilationCache> compilation_cache;
+  const DebugOptions& debug_options = GetDebugOptionsFromFlags();
+  if (!debug_options.xla_cpu_persistent_cache_dir().empty()) {
+    StatusOr<std::unique_ptr<PersistentCompilationCache>> cache =
+        PersistentCompilationCache::Create(
+            debug_options.xla_cpu_persistent_cache_dir(),
+            debug_options.xla_cpu_persistent_cache_max_size_bytes());
+    if (cache.ok()) {
+      compilation_cache = *std::move(cache);
+    } else {
+      LOG(WARNING) << "Failed to open the persistent compilation cache: "
+                   << cache.status();
+    }
+  }
+
   return std::unique_ptr<PjRtClient>(std::make_unique<TfrtCpuClient>(
-      /*process_index=*/0, std::move(devices), num_threads));
+      /*process_index=*/0, std::move(devices), num_threads,
+      std::move(compilation_cache)));
 }
 
 StatusOr<std::unique_ptr<PjRtClient>> GetTfrtCpuClient(bool asynchronous) {
@@ -179,7 +210,8 @@ StatusOr<std::unique_ptr<PjRtClient>> GetTfrtCpuClient(bool asynchronous) {
 
 TfrtCpuClient::TfrtCpuClient(
     int process_index, std::vector<std::unique_ptr<TfrtCpuDevice>> devices,
-    size_t num_threads)
+    size_t num_threads,
+    std::unique_ptr<PersistentCompilationCache> compilation_cache)
     : process_index_(process_index),
       owned_devices_(std::move(devices)),
       computation_placer_(std::make_unique<ComputationPlacer>()),
@@ -192,7 +224,8 @@ TfrtCpuClient::TfrtCpuClient(
                                       eigen_intraop_pool_->NumThreads())),
       last_collective_launch_event_(
           tfrt::MakeAvailableAsyncValueRef<CpuEvent>()),
-      transpose_cache_(1024) {
+      transpose_cache_(1024),
+      compilation_cache_(std::move(compilation_cache)) {
   for (const std::unique_ptr<TfrtCpuDevice>& device : owned_devices_) {
     devices_.push_back(device.get());
     CHECK(id_to_device_.insert({device->id(), device.get()}).second)
@@ -451,6 +484,160 @@ static StatusOr<std::unique_ptr<xla::Executable>> JitCompile(
                              dummy);
 }
 
+// Bump whenever the contents of the persistent compilation cache key or of
+// the serialized executables change in an incompatible way.
+static constexpr int kPersistentCacheVersion = 1;
+
+// Returns a description of the host that the JIT targets. Executables
+// compiled for one host must not be loaded on a host with different features.
+static std::string HostMachineDescription() {
+  llvm::StringMap<bool> host_features;
+  std::vector<std::string> features;
+  if (llvm::sys::getHostCPUFeatures(host_features)) {
+    for (const auto& feature : host_features) {
+      features.push_back(absl::StrCat(feature.second ? "+" : "-",
+                                      feature.first().str()));
+    }
+  }
+  // StringMap iteration order is unspecified.
+  std::sort(features.begin(), features.end());
+  return absl::StrCat(llvm::sys::getProcessTriple(), ";",
+                      llvm::sys::getHostCPUName().str(), ";",
+                      absl::StrJoin(features, ","));
+}
+
+// Returns a fingerprint of the binary or shared object that contains the
+// compiler, so that executables compiled by one build of XLA are never loaded
+// by another, or nullopt if it cannot be read. Computed once per process.
+static const std::optional<std::string>& CompilerBinaryFingerprint() {
+  static const std::optional<std::string>* const fingerprint =
+      []() -> std::optional<std::string>* {
+#if defined(_WIN32)
+    return new std::optional<std::string>();
+#else
+    Dl_info info;
+    std::string contents;
+    if (dladdr(reinterpret_cast<void*>(&HostMachineDescription), &info) == 0 ||
+        info.dli_fname == nullptr ||
+        !tsl::ReadFileToString(tsl::Env::Default(), info.dli_fname, &contents)
+             .ok()) {
+      LOG(WARNING) << "Cannot fingerprint the XLA binary; the persistent "
+                      "compilation cache is disabled.";
+      return new std::optional<std::string>();
+    }
+    tsl::Fprint128 fingerprint = tsl::Fingerprint128(contents);
+    return new std::optional<std::string>(
+        absl::StrCat(absl::Hex(fingerprint.high64, absl::kZeroPad16),
+                     absl::Hex(fingerprint.low64, absl::kZeroPad16)));
+#endif
+  }();
+  return *fingerprint;
+}
+
+// Computes the persistent compilation cache key: a fingerprint of everything
+// that JitCompile's output depends on.
+static StatusOr<std::string> PersistentCacheKey(
+    const XlaComputation& computation,
+    absl::Span<const Shape* const> argument_layouts,
+    ExecutionOptions execution_options) {
+  // The cache location does not affect the compiled code.
+  execution_options.mutable_debug_options()
+      ->clear_xla_cpu_persistent_cache_dir();
+  execution_options.mutable_debug_options()
+      ->clear_xla_cpu_persistent_cache_max_size_bytes();
+
+  std::string fingerprint_input;
+  auto append = [&](absl::string_view bytes) {
+    // Length-prefix every component so that their concatenation is
+    // unambiguous.
+    absl::StrAppend(&fingerprint_input, bytes.size(), ":", bytes);
+  };
+  auto append_proto = [&](const tsl::protobuf::Message& proto) -> Status {
+    std::string serialized;
+    if (!tsl::SerializeToStringDeterministic(proto, &serialized)) {
+      return Internal("Failed to serialize %s", proto.GetTypeName());
+    }
+    append(serialized);
+    return OkStatus();
+  };
+
+  append(absl::StrCat(kPersistentCacheVersion));
+  const std::optional<std::string>& compiler = CompilerBinaryFingerprint();
+  if (!compiler.has_value()) {
+    return Internal("Failed to fingerprint the compiler binary");
+  }
+  append(*compiler);
+  static const std::string* const host =
+      new std::string(HostMachineDescription());
+  append(*host);
+  TF_RETURN_IF_ERROR(append_proto(computation.proto()));
+  TF_RETURN_IF_ERROR(append_proto(execution_options));
+  for (const Shape* shape : argument_layouts) {
+    TF_RETURN_IF_ERROR(append_proto(shape->ToProto()));
+  }
+
+  tsl::Fprint128 fingerprint = tsl::Fingerprint128(fingerprint_input);
+  return absl::StrCat(absl::Hex(fingerprint.high64, absl::kZeroPad16),
+                      absl::Hex(fingerprint.low64, absl::kZeroPad16));
+}
+
+// Returns the executable stored under `key`, or nullptr if there is none or
+// it cannot be loaded. Cache failures only cost a recompilation.
+static std::unique_ptr<Executable> LoadFromPersistentCache(
+    const PersistentCompilationCache& cache, const std::string& key) {
+  tsl::profiler::TraceMe traceme("LoadFromPersistentCache");
+  StatusOr<std::optional<std::string>> serialized = cache.Get(key);
+  if (!serialized.ok()) {
+    LOG(WARNING) << "Failed to read compilation cache entry " << key << ": "
+                 << serialized.status();
+    return nullptr;
+  }
+  if (!serialized->has_value()) {
+    VLOG(1) << "Compilation cache miss: " << key;
+    return nullptr;
+  }
+
+  cpu::CpuCompiler compiler;
+  auto load = [&]() -> StatusOr<std::unique_ptr<Executable>> {
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<AotCompilationResult> aot_result,
+                        compiler.LoadAotCompilationResult(**serialized));
+    return aot_result->LoadExecutable(&compiler, /*executor=*/nullptr);
+  };
+  StatusOr<std::unique_ptr<Executable>> executable = load();
+  if (!executable.ok()) {
+    LOG(WARNING) << "Failed to load compilation cache entry " << key << ": "
+                 << executable.status();
+    return nullptr;
+  }
+  VLOG(1) << "Compilation cache hit: " << key;
+  return *std::move(executable);
+}
+
+// Serializes `executable` into the cache. Only executables that support
+// serialization (currently those built for the XLA runtime) are stored.
+static void StoreInPersistentCache(PersistentCompilationCache& cache,
+                                   const std::string& key,
+                                   Executable* executable) {
+  tsl::profiler::TraceMe traceme("StoreInPersistentCache");
+  cpu::CpuCompiler compiler;
+  auto serialize = [&]() -> StatusOr<std::string> {
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<AotCompilationResult> aot_result,
+                        compiler.Export(executable));
+    return aot_result->SerializeAsString();
+  };
+  StatusOr<std::string> serialized = serialize();
+  if (!serialized.ok()) {
+    VLOG(1) << "Not caching executable " << key
+            << ", it cannot be serialized: " << serialized.status();
+    return;
+  }
+  Status status = cache.Put(key, *serialized);
+  if (!status.ok()) {
+    LOG(WARNING) << "Failed to write compilation cache entry " << key << ": "
+                 << status;
+  }
+}
+
 StatusOr<std::unique_ptr<PjRtLoadedExecutable>> TfrtCpuClient::Compile(
     const XlaComputation& computation, CompileOptions options) {
   tsl::profiler::TraceMe traceme("TfrtCpuClient::Compile");
@@ -508,9 +695,30 @@ StatusOr<std::unique_ptr<PjRtLoadedExecutable>> TfrtCpuClient::Compile(
                       computation.GetProgramShape());
   ExecutionOptions execution_options =
       CreateExecutionOptions(build_options, &program_shape);
-  TF_ASSIGN_OR_RETURN(std::unique_ptr<Executable> cpu_executable,
-                      JitCompile(computation, argument_layout_pointers,
-                                 build_options, execution_options));
+  std::unique_ptr<Executable> cpu_executable;
+  std::string cache_key;
+  // Only executables built for the XLA runtime can be serialized, so don't
+  // pay for fingerprinting and a cache lookup for any others. Without a
+  // fingerprint of the compiler, stale entries could not be told apart.
+  const bool use_compilation_cache =
+      compilation_cache_ != nullptr &&
+      execution_options.debug_options().xla_cpu_use_xla_runtime() &&
+      CompilerBinaryFingerprint().has_value();
+  if (use_compilation_cache) {
+    TF_ASSIGN_OR_RETURN(
+        cache_key, PersistentCacheKey(computation, argument_layout_pointers,
+                                      execution_options));
+    cpu_executable = LoadFromPersistentCache(*compilation_cache_, cache_key);
+  }
+  if (cpu_executable == nullptr) {
+    TF_ASSIGN_OR_RETURN(cpu_executable,
+                        JitCompile(computation, argument_layout_pointers,
+                                   build_options, execution_options));
+    if (use_compilation_cache) {
+      StoreInPersistentCache(*compilation_cache_, cache_key,
+                             cpu_executable.get());
+    }
+  }
   auto cpu_executable_ptr =
       tensorflow::down_cast<cpu::CpuExecutable*>(cpu_executable.get());
 
@@ -31,6 +31,7 @@ limitations under the License.
 #include "xla/literal.h"
 #include "xla/pjrt/pjrt_client.h"
 #include "xla/pjrt/pjrt_executable.h"
+#include "xla/pjrt/persistent_compilation_cache.h"
 #include "xla/pjrt/pjrt_future.h"
 #include "xla/pjrt/semaphore.h"
 #include "xla/pjrt/tracked_tfrt_cpu_device_buffer.h"
@@ -115,9 +116,13 @@ class TfrtCpuExecutable;
 
 class TfrtCpuClient final : public PjRtClient {
  public:
-  TfrtCpuClient(int process_index,
-                std::vector<std::unique_ptr<TfrtCpuDevice>> devices,
-                size_t num_threads);
+  // If `compilation_cache` is non-null, Compile() looks up executables built
+  // for the XLA runtime in it before invoking the compiler and stores newly
+  // compiled ones in it.
+  TfrtCpuClient(
+      int process_index, std::vector<std::unique_ptr<TfrtCpuDevice>> devices,
+      size_t num_threads,
+      std::unique_ptr<PersistentCompilationCache> compilation_cache = nullptr);
   ~TfrtCpuClient() override;
 
   int process_index() const override { return process_index_; }
@@ -281,6 +286,10 @@ class TfrtCpuClient final : public PjRtClient {
   // major-to-minor layout.
   absl::Mutex transpose_mu_;
   TransposePlanCache transpose_cache_ ABSL_GUARDED_BY(transpose_mu_);
+
+  // Optional on-disk cache of serialized executables, shared with other
+  // processes that use the same directory.
+  std::unique_ptr<PersistentCompilationCache> compilation_cache_;
 };
 
 class TfrtCpuBuffer final : public PjRtBuffer {
@@ -628,6 +637,9 @@ StatusOr<std::unique_ptr<PjRtClient>> GetTfrtCpuClient(bool asynchronous);
 
 // Similar to the function above, but you can set the number of devices
 // explicitly.
+//
+// Both functions enable the persistent compilation cache if the
+// --xla_cpu_persistent_cache_dir flag is set.
 StatusOr<std::unique_ptr<PjRtClient>> GetTfrtCpuClient(bool asynchronous,
                                                        int cpu_device_count);
 
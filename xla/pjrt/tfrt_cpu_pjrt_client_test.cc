@@ -15,13 +15,22 @@ limitations under the License.
 
 #include "xla/pjrt/tfrt_cpu_pjrt_client.h"
 
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "xla/literal_util.h"
+#include "xla/pjrt/persistent_compilation_cache.h"
 #include "xla/service/custom_call_status.h"
 #include "xla/service/custom_call_target_registry.h"
 #include "xla/service/hlo_parser.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/path.h"
+#include "tsl/platform/test.h"
 
 namespace xla {
 namespace {
@@ -72,5 +81,101 @@ ENTRY DonationWithExecutionError() -> f32[2, 2] {
               ::testing::HasSubstr("buffer has been deleted or donated."));
 }
 
+TEST(TfrtCpuClientTest, PersistentCompilationCache) {
+  constexpr char kProgram[] = R"(HloModule PersistentCompilationCache
+ENTRY PersistentCompilationCache {
+  %x = f32[4] parameter(0)
+  ROOT %add = f32[4] add(%x, %x)
+})";
+  const std::string directory = tsl::io::JoinPath(
+      tsl::testing::TmpDir(), "TfrtCpuClientTest_PersistentCompilationCache");
+
+  TF_ASSERT_OK_AND_ASSIGN(auto hlo_module,
+                          ParseAndReturnUnverifiedModule(kProgram, {}));
+  XlaComputation xla_computation(hlo_module->ToProto());
+  CompileOptions compile_options;
+  // Only XLA runtime executables can be serialized.
+  compile_options.executable_build_options.mutable_debug_options()
+      ->set_xla_cpu_use_xla_runtime(true);
+
+  // Each client stands in for a separate process sharing the cache directory.
+  const PersistentCompilationCache* cache_ptr = nullptr;
+  auto make_client = [&]() -> StatusOr<std::unique_ptr<TfrtCpuClient>> {
+    TF_ASSIGN_OR_RETURN(auto cache,
+                        PersistentCompilationCache::Create(
+                            directory, /*max_size_bytes=*/0));
+    cache_ptr = cache.get();
+    std::vector<std::unique_ptr<TfrtCpuDevice>> devices;
+    devices.push_back(
+        std::make_unique<TfrtCpuDevice>(/*id=*/0, /*asynchronous=*/true));
+    return std::make_unique<TfrtCpuClient>(
+        /*process_index=*/0, std::move(devices), /*num_threads=*/2,
+        std::move(cache));
+  };
+
+  for (int i = 0; i < 2; ++i) {
+    TF_ASSERT_OK_AND_ASSIGN(auto client, make_client());
+    TF_ASSERT_OK_AND_ASSIGN(auto pjrt_executable,
+                            client->Compile(xla_computation, compile_options));
+    // The first client compiles and stores the executable, the second one
+    // loads it.
+    EXPECT_EQ(cache_ptr->num_hits(), i);
+
+    std::vector<std::string> entries;
+    TF_ASSERT_OK(tsl::Env::Default()->GetChildren(directory, &entries));
+    EXPECT_EQ(entries.size(), 1);
+
+    std::vector<float> data = {1, 2, 3, 4};
+    Shape shape = ShapeUtil::MakeShape(F32, {4});
+    TF_ASSERT_OK_AND_ASSIGN(
+        auto buffer,
+        client->BufferFromHostBuffer(
+            data.data(), shape.element_type(), shape.dimensions(),
+            /*byte_strides=*/std::nullopt,
+            PjRtClient::HostBufferSemantics::kImmutableOnlyDuringCall, nullptr,
+            client->addressable_devices()[0]));
+    TF_ASSERT_OK_AND_ASSIGN(
+        auto result,
+        pjrt_executable->Execute(/*argument_handles=*/{{buffer.get()}},
+                                 /*options=*/{}));
+    TF_ASSERT_OK_AND_ASSIGN(auto literal, result[0][0]->ToLiteralSync());
+    EXPECT_EQ(*literal, LiteralUtil::CreateR1<float>({2, 4, 6, 8}));
+  }
+}
+
+TEST(TfrtCpuClientTest, PersistentCompilationCacheSkipsLegacyRuntime) {
+  constexpr char kProgram[] = R"(HloModule LegacyRuntime
+ENTRY LegacyRuntime {
+  %x = f32[4] parameter(0)
+  ROOT %add = f32[4] add(%x, %x)
+})";
+  const std::string directory =
+      tsl::io::JoinPath(tsl::testing::TmpDir(),
+                        "TfrtCpuClientTest_PersistentCompilationCacheSkips");
+  TF_ASSERT_OK_AND_ASSIGN(auto hlo_module,
+                          ParseAndReturnUnverifiedModule(kProgram, {}));
+  XlaComputation xla_computation(hlo_module->ToProto());
+  CompileOptions compile_options;
+  compile_options.executable_build_options.mutable_debug_options()
+      ->set_xla_cpu_use_xla_runtime(false);
+
+  TF_ASSERT_OK_AND_ASSIGN(auto cache, PersistentCompilationCache::Create(
+                                          directory, /*max_size_bytes=*/0));
+  std::vector<std::unique_ptr<TfrtCpuDevice>> devices;
+  devices.push_back(
+      std::make_unique<TfrtCpuDevice>(/*id=*/0, /*asynchronous=*/true));
+  TfrtCpuClient client(/*process_index=*/0, std::move(devices),
+                       /*num_threads=*/2, std::move(cache));
+  for (int i = 0; i < 2; ++i) {
+    TF_ASSERT_OK(client.Compile(xla_computation, compile_options).status());
+  }
+
+  // Executables for the legacy runtime can't be serialized, so they are
+  // neither looked up nor stored.
+  std::vector<std::string> entries;
+  TF_ASSERT_OK(tsl::Env::Default()->GetChildren(directory, &entries));
+  EXPECT_TRUE(entries.empty());
+}
+
 }  // namespace
 }  // namespace xla
@@ -72,6 +72,7 @@ limitations under the License.
 #include <algorithm>
 #include <functional>
 #include <numeric>
+#include <optional>
 #include <stack>
 #include <string>
 #include <utility>
@@ -79,9 +80,11 @@ limitations under the License.
 #include "absl/algorithm/container.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
+#include "absl/strings/string_view.h"
 #include "absl/synchronization/blocking_counter.h"
 #include "absl/types/span.h"
 #include "absl/types/variant.h"
+#include "third_party/eigen3/Eigen/Core"
 #include "xla/permutation_util.h"
 #include "xla/pjrt/transpose_kernels.h"
 #include "xla/status.h"
@@ -124,6 +127,53 @@ void ConvertF64ToEf57(const double* input, float* output, int n) {
   }
 }
 
+template <typename From, typename To>
+void ConvertElements(const char* __restrict input, char* __restrict output,
+                     int64_t n) {
+  using FromArray = Eigen::Array<From, Eigen::Dynamic, 1>;
+  using ToArray = Eigen::Array<To, Eigen::Dynamic, 1>;
+  Eigen::Map<ToArray>(reinterpret_cast<To*>(output), n) =
+      Eigen::Map<const FromArray>(reinterpret_cast<const From*>(input), n)
+          .template cast<To>();
+}
+
+// Applies `transformation` to a contiguous run of input elements, producing
+// `n` contiguous output elements of type T.
+template <typename T, TransposePlan::Transformation transformation>
+void TransformRun(const char* __restrict a, char* __restrict b, int64_t n) {
+  switch (transformation) {
+    case TransposePlan::Transformation::kNone:
+      std::memcpy(b, a, n * sizeof(T));
+      break;
+    case TransposePlan::Transformation::kF64ToEf57:
+      DCHECK_EQ(n % 2, 0);
+      ConvertF64ToEf57(reinterpret_cast<const double*>(a),
+                       reinterpret_cast<float*>(b), n / 2);
+      break;
+    case TransposePlan::Transformation::kF32ToBf16:
+      ConvertElements<float, Eigen::bfloat16>(a, b, n);
+      break;
+    case TransposePlan::Transformation::kF32ToF16:
+      ConvertElements<float, Eigen::half>(a, b, n);
+      break;
+    case TransposePlan::Transformation::kBf16ToF32:
+      ConvertElements<Eigen::bfloat16, float>(a, b, n);
+      break;
+    case TransposePlan::Transformation::kF16ToF32:
+      ConvertElements<Eigen::half, float>(a, b, n);
+      break;
+    case TransposePlan::Transformation::kS8ToS32:
+      ConvertElements<int8_t, int32_t>(a, b, n);
+      break;
+    case TransposePlan::Transformation::kU8ToU32:
+      ConvertElements<uint8_t, uint32_t>(a, b, n);
+      break;
+    case TransposePlan::Transformation::kS32ToS64:
+      ConvertElements<int32_t, int64_t>(a, b, n);
+      break;
+  }
+}
+
 template <typename T, int inner_bs,
           TransposePlan::Transformation transformation>
 void MacroKernel(const char* __restrict a, int64_t lda, int outer_bs_a,
@@ -135,16 +185,17 @@ void MacroKernel(const char* __restrict a, int64_t lda, int outer_bs_a,
 
   // TODO(phawkins): consider adding prefetching and streaming stores.
 
-  if (transformation == TransposePlan::Transformation::kF64ToEf57) {
-    DCHECK_EQ(outer_bs_a * inner_bs % 2, 0);
-    float* p = reinterpret_cast<float*>(scratch);
+  if (transformation != TransposePlan::Transformation::kNone) {
+    // Transform the input block into the scratch buffer, then transpose the
+    // scratch buffer.
+    T* p = reinterpret_cast<T*>(scratch);
     for (int i = 0; i < outer_bs_b * inner_bs; ++i) {
-      ConvertF64ToEf57(reinterpret_cast<const double*>(a + lda * i),
-                       p + outer_bs_a * inner_bs * i,
-                       outer_bs_a * inner_bs / 2);
+      TransformRun<T, transformation>(
+          a + lda * i, reinterpret_cast<char*>(p + outer_bs_a * inner_bs * i),
+          outer_bs_a * inner_bs);
     }
     a = reinterpret_cast<const char*>(scratch);
-    lda = outer_bs_a * inner_bs * sizeof(float);
+    lda = outer_bs_a * inner_bs * sizeof(T);
   }
 
   for (int i = 0; i < outer_bs_a; ++i) {
@@ -296,31 +347,30 @@ void Transpose(const char* __restrict a, int outer_bs_a, char* __restrict b,
   }
 }
 
-template <typename T>
+template <typename T, TransposePlan::Transformation transformation>
 void TransposeConstStride1(const char* __restrict a, char* __restrict b,
                            TransposePlan::Node const* __restrict node) {
   a += node[0].start * node[0].lda;
   b += node[0].start * node[0].ldb;
   if (node[0].is_inner_dim_in_a) {
-    int64_t num_bytes = (node->end - node->start) * sizeof(T);
-    std::memcpy(b, a, num_bytes);
+    TransformRun<T, transformation>(a, b, node->end - node->start);
   } else if (node[1].is_inner_dim_in_a) {
     int64_t offset_a = node[1].start * node[1].lda;
     int64_t offset_b = node[1].start * node[1].ldb;
-    int64_t num_bytes = (node[1].end - node[1].start) * sizeof(T);
+    int64_t num_elems = node[1].end - node[1].start;
     a += offset_a;
     b += offset_b;
     for (int64_t i = node[0].start; i < node[0].end; ++i) {
-      std::memcpy(b, a, num_bytes);
+      TransformRun<T, transformation>(a, b, num_elems);
       a += node[0].lda;
       b += node[0].ldb;
     }
     if (node[0].trailing_tile_next_node_inc) {
-      TransposeConstStride1<T>(a - offset_a, b - offset_b,
+      TransposeConstStride1<T, transformation>(a - offset_a, b - offset_b,
                                node + node[0].trailing_tile_next_node_inc);
     }
   } else if (node[2].is_inner_dim_in_a) {
-    int64_t num_bytes = (node[2].end - node[2].start) * sizeof(T);
+    int64_t num_elems = node[2].end - node[2].start;
     int64_t offset_a1 = node[1].start * node[1].lda;
     int64_t offset_b1 = node[1].start * node[1].ldb;
     int64_t offset_a2 = node[2].start * node[2].lda;
@@ -331,12 +381,12 @@ void TransposeConstStride1(const char* __restrict a, char* __restrict b,
       const char* a1 = a;
       char* b1 = b;
       for (int64_t j = node[1].start; j < node[1].end; ++j) {
-        std::memcpy(b1, a1, num_bytes);
+        TransformRun<T, transformation>(a1, b1, num_elems);
         a1 += node[1].lda;
         b1 += node[1].ldb;
       }
       if (node[1].trailing_tile_next_node_inc) {
-        TransposeConstStride1<T>(
+        TransposeConstStride1<T, transformation>(
             a1 - offset_a2, b1 - offset_b2,
             &node[1] + node[1].trailing_tile_next_node_inc);
       }
@@ -344,7 +394,7 @@ void TransposeConstStride1(const char* __restrict a, char* __restrict b,
       b += node[0].ldb;
     }
     if (node[0].trailing_tile_next_node_inc) {
-      TransposeConstStride1<T>(a - offset_a1 - offset_a2,
+      TransposeConstStride1<T, transformation>(a - offset_a1 - offset_a2,
                                b - offset_b1 - offset_b2,
                                node + node[0].trailing_tile_next_node_inc);
     }
@@ -353,19 +403,19 @@ void TransposeConstStride1(const char* __restrict a, char* __restrict b,
       const char* a1 = a + node[1].start * node[1].lda;
       char* b1 = b + node[1].start * node[1].ldb;
       for (int64_t j = node[1].start; j < node[1].end; ++j) {
-        TransposeConstStride1<T>(a1, b1, node + 2);
+        TransposeConstStride1<T, transformation>(a1, b1, node + 2);
         a1 += node[1].lda;
         b1 += node[1].ldb;
       }
       if (node[1].trailing_tile_next_node_inc) {
-        TransposeConstStride1<T>(
+        TransposeConstStride1<T, transformation>(
             a1, b1, &node[1] + node[1].trailing_tile_next_node_inc);
       }
       a += node[0].lda;
       b += node[0].ldb;
     }
     if (node[0].trailing_tile_next_node_inc) {
-      TransposeConstStride1<T>(a, b,
+      TransposeConstStride1<T, transformation>(a, b,
                                node + node[0].trailing_tile_next_node_inc);
     }
   }
@@ -375,8 +425,8 @@ template <typename T, TransposePlan::Transformation transformation>
 void TransposePlan::ExecuteTyped(const char* a, char* b,
                                  absl::Span<Node const> nodes) const {
   if (inner_kernel_is_memcpy_) {
-    DCHECK(transformation_ == Transformation::kNone);
-    TransposeConstStride1<T>(a, b, nodes.data());
+    DCHECK(transformation_ != Transformation::kF64ToEf57);
+    TransposeConstStride1<T, transformation>(a, b, nodes.data());
   } else {
     std::unique_ptr<char[]> scratch;
     if (scratch_size_ > 0) {
@@ -462,6 +512,36 @@ void TransposePlan::Execute(
   char* bc = static_cast<char*>(b);
 
   auto execute_by_type = [&](absl::Span<Node const> nodes) {
+    // Transformations other than kNone imply an element size, which is
+    // validated when the plan is created.
+    switch (transformation_) {
+      case Transformation::kNone:
+        break;
+      case Transformation::kF64ToEf57:
+        ExecuteTyped<uint32_t, Transformation::kF64ToEf57>(ac, bc, nodes);
+        return;
+      case Transformation::kF32ToBf16:
+        ExecuteTyped<uint16_t, Transformation::kF32ToBf16>(ac, bc, nodes);
+        return;
+      case Transformation::kF32ToF16:
+        ExecuteTyped<uint16_t, Transformation::kF32ToF16>(ac, bc, nodes);
+        return;
+      case Transformation::kBf16ToF32:
+        ExecuteTyped<uint32_t, Transformation::kBf16ToF32>(ac, bc, nodes);
+        return;
+      case Transformation::kF16ToF32:
+        ExecuteTyped<uint32_t, Transformation::kF16ToF32>(ac, bc, nodes);
+        return;
+      case Transformation::kS8ToS32:
+        ExecuteTyped<uint32_t, Transformation::kS8ToS32>(ac, bc, nodes);
+        return;
+      case Transformation::kU8ToU32:
+        ExecuteTyped<uint32_t, Transformation::kU8ToU32>(ac, bc, nodes);
+        return;
+      case Transformation::kS32ToS64:
+        ExecuteTyped<uint64_t, Transformation::kS32ToS64>(ac, bc, nodes);
+        return;
+    }
     switch (elem_size_in_bytes_) {
       case 1:
         ExecuteTyped<uint8_t, Transformation::kNone>(ac, bc, nodes);
@@ -470,12 +550,7 @@ void TransposePlan::Execute(
         ExecuteTyped<uint16_t, Transformation::kNone>(ac, bc, nodes);
         break;
       case 4:
-        if (transformation_ == Transformation::kNone) {
-          ExecuteTyped<uint32_t, Transformation::kNone>(ac, bc, nodes);
-        } else {
-          DCHECK(transformation_ == Transformation::kF64ToEf57);
-          ExecuteTyped<uint32_t, Transformation::kF64ToEf57>(ac, bc, nodes);
-        }
+        ExecuteTyped<uint32_t, Transformation::kNone>(ac, bc, nodes);
         break;
       case 8:
         ExecuteTyped<uint64_t, Transformation::kNone>(ac, bc, nodes);
@@ -664,6 +739,53 @@ int64_t TransposePlan::OutputNumElems() const {
   return size;
 }
 
+// For element type conversion transformations, returns the sizes in bytes of
+// the input and output element types. Returns std::nullopt for other
+// transformations, which do not change the element size.
+static std::optional<std::pair<int64_t, int64_t>> ConversionElemSizes(
+    TransposePlan::Transformation transformation) {
+  switch (transformation) {
+    case TransposePlan::Transformation::kNone:
+    case TransposePlan::Transformation::kF64ToEf57:
+      return std::nullopt;
+    case TransposePlan::Transformation::kF32ToBf16:
+    case TransposePlan::Transformation::kF32ToF16:
+      return std::make_pair(4, 2);
+    case TransposePlan::Transformation::kBf16ToF32:
+    case TransposePlan::Transformation::kF16ToF32:
+      return std::make_pair(2, 4);
+    case TransposePlan::Transformation::kS8ToS32:
+    case TransposePlan::Transformation::kU8ToU32:
+      return std::make_pair(1, 4);
+    case TransposePlan::Transformation::kS32ToS64:
+      return std::make_pair(4, 8);
+  }
+}
+
+static absl::string_view TransformationToString(
+    TransposePlan::Transformation transformation) {
+  switch (transformation) {
+    case TransposePlan::Transformation::kNone:
+      return "none";
+    case TransposePlan::Transformation::kF64ToEf57:
+      return "ef57";
+    case TransposePlan::Transformation::kF32ToBf16:
+      return "f32_to_bf16";
+    case TransposePlan::Transformation::kF32ToF16:
+      return "f32_to_f16";
+    case TransposePlan::Transformation::kBf16ToF32:
+      return "bf16_to_f32";
+    case TransposePlan::Transformation::kF16ToF32:
+      return "f16_to_f32";
+    case TransposePlan::Transformation::kS8ToS32:
+      return "s8_to_s32";
+    case TransposePlan::Transformation::kU8ToU32:
+      return "u8_to_u32";
+    case TransposePlan::Transformation::kS32ToS64:
+      return "s32_to_s64";
+  }
+}
+
 // Parses and validates a tiling specification, and populates `tiling`.
 static Status ParseTilingSpecification(
     int ndim, absl::Span<int64_t const> tiling_spec,
@@ -917,6 +1039,16 @@ StatusOr<std::unique_ptr<TransposePlan>> TransposePlan::Create(
       return InvalidArgument("Unsupported elem_size_in_bytes=%d",
                              elem_size_in_bytes);
   }
+  plan->input_elem_size_in_bytes_ = elem_size_in_bytes;
+  if (auto conversion = ConversionElemSizes(transformation)) {
+    if (elem_size_in_bytes != conversion->second) {
+      return InvalidArgument(
+          "Transformation %s requires an element size of %d bytes, got %d",
+          TransformationToString(transformation), conversion->second,
+          elem_size_in_bytes);
+    }
+    plan->input_elem_size_in_bytes_ = conversion->first;
+  }
   plan->num_elems_ = std::accumulate(dims.begin(), dims.end(), int64_t{1},
                                      std::multiplies<int64_t>());
   plan->original_a_dims_.resize(ndim);
@@ -947,7 +1079,7 @@ StatusOr<std::unique_ptr<TransposePlan>> TransposePlan::Create(
       int64_t stride = input_strides_in_bytes.at(k);
       // If there is a dimension with size equal to the element size, sort it
       // last. This ensures that we place any stride-1 dimension last.
-      bool is_stride1 = stride == elem_size_in_bytes;
+      bool is_stride1 = stride == plan->input_elem_size_in_bytes_;
       // If there are multiple stride-1 dimensions, we'd prefer the one that
       // matches the stride-1 dimension of the output.
       // Failing that, we'd just prefer the largest stride-1 dimension last.
@@ -984,8 +1116,8 @@ StatusOr<std::unique_ptr<TransposePlan>> TransposePlan::Create(
     plan->a_dims_ = plan->original_a_dims_;
     plan->permutation_.resize(ndim);
     absl::c_copy(permutation, plan->permutation_.begin());
-    ComputeStrides(plan->elem_size_in_bytes_, plan->a_dims_, plan->a_tiling_,
-                   plan->lda_, plan->lda_tile_);
+    ComputeStrides(plan->input_elem_size_in_bytes_, plan->a_dims_,
+                   plan->a_tiling_, plan->lda_, plan->lda_tile_);
   }
 
   auto is_not_one = [](int64_t x) { return x != 1; };
@@ -1018,6 +1150,16 @@ StatusOr<std::unique_ptr<TransposePlan>> TransposePlan::Create(
             "multiple of 2",
             sizeof(float));
       }
+      break;
+    case Transformation::kF32ToBf16:
+    case Transformation::kF32ToF16:
+    case Transformation::kBf16ToF32:
+    case Transformation::kF16ToF32:
+    case Transformation::kS8ToS32:
+    case Transformation::kU8ToU32:
+    case Transformation::kS32ToS64:
+      // Element sizes were validated above.
+      break;
   }
 
   plan->Initialize();
@@ -1050,12 +1192,12 @@ void TransposePlan::Initialize() {
   // If the plan is 0-dimensional, or the innermost dimension of A is not of
   // stride 1, adds a trivial size 1 dimension. The transpose kernels rely on
   // the presence of a stride-1 innermost dimension in the input.
-  if (lda_.empty() || stride_pos1a != elem_size_in_bytes_) {
+  if (lda_.empty() || stride_pos1a != input_elem_size_in_bytes_) {
     int dim = static_cast<int>(a_dims_.size());
     permutation_.push_back(dim);
     inverse_permutation.push_back(dim);
     a_dims_.push_back(1);
-    lda_.push_back(elem_size_in_bytes_);
+    lda_.push_back(input_elem_size_in_bytes_);
     lda_tile_.push_back(1);
     a_tiling_.push_back(1);
     b_tiling_.push_back(1);
@@ -1196,15 +1338,16 @@ void TransposePlan::Initialize() {
     BuildPlanNodes(inverse_permutation, thread_id, nodes_[thread_id]);
   }
 
-  switch (transformation_) {
-    case Transformation::kNone:
-      scratch_size_ = 0;
-      break;
-    case Transformation::kF64ToEf57:
-      scratch_size_ = sizeof(float) * inner_block_elems_ * inner_block_elems_ *
-                      outer_block_elems_a_ * outer_block_elems_b_;
-      DCHECK(!inner_kernel_is_memcpy_);
-      break;
+  // Transformations other than kNone are applied to each macrokernel block in
+  // a scratch buffer before it is transposed. The memcpy kernel transforms
+  // directly into the output.
+  if (transformation_ == Transformation::kNone || inner_kernel_is_memcpy_) {
+    DCHECK(transformation_ != Transformation::kF64ToEf57);
+    scratch_size_ = 0;
+  } else {
+    scratch_size_ = elem_size_in_bytes_ * inner_block_elems_ *
+                    inner_block_elems_ * outer_block_elems_a_ *
+                    outer_block_elems_b_;
   }
 }
 
@@ -1298,15 +1441,6 @@ std::string TransposePlan::ToString() const {
     return absl::StrAppend(out, loop.dim_in_a,
                            loop.tile_interior ? "[tile]" : "");
   };
-  std::string transformation_str;
-  switch (transformation_) {
-    case Transformation::kNone:
-      transformation_str = "none";
-      break;
-    case Transformation::kF64ToEf57:
-      transformation_str = "ef57";
-      break;
-  }
   return absl::StrFormat(
       "elem_size=%d a_dims=%s b_dims=%s permutation=%s a_tiling=%s b_tiling=%s "
       "lda=%s lda_tile=%s ldb=%s ldb_tile=%s loop_order=%s "
@@ -1321,7 +1455,8 @@ std::string TransposePlan::ToString() const {
       absl::StrJoin(ldb_tile_, ","),
       absl::StrJoin(loop_order_, ",", format_loop_order),
       absl::StrJoin(loop_parallelism_, ","), outer_block_elems_a_,
-      outer_block_elems_b_, inner_block_elems_, transformation_str,
+      outer_block_elems_b_, inner_block_elems_,
+      TransformationToString(transformation_),
       scratch_size_, nodes_str);
 }
 
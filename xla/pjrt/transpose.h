@@ -83,6 +83,18 @@ class TransposePlan {
     // Convert doubles into the ef57 extended precision pair-of-floats
     // representation used on TPU.
     kF64ToEf57 = 1,
+
+    // Element type conversions, in which the input and output element sizes
+    // differ. For these transformations `elem_size_in_bytes` is the size of
+    // the output element type; input strides are in units of input bytes.
+    // Floating point narrowing rounds to nearest even.
+    kF32ToBf16 = 2,
+    kF32ToF16 = 3,
+    kBf16ToF32 = 4,
+    kF16ToF32 = 5,
+    kS8ToS32 = 6,
+    kU8ToU32 = 7,
+    kS32ToS64 = 8,
   };
 
   static StatusOr<std::unique_ptr<TransposePlan>> Create(
@@ -110,6 +122,10 @@ class TransposePlan {
 
   size_t ElemSizeInBytes() const { return elem_size_in_bytes_; }
 
+  // Size of each input element in bytes. Differs from ElemSizeInBytes() only
+  // for element type conversion transformations.
+  size_t InputElemSizeInBytes() const { return input_elem_size_in_bytes_; }
+
   // Input and output size, in number of elements. Ignores any input striding,
   // but accounts for tiling.
   int64_t InputNumElems() const;
@@ -168,6 +184,9 @@ class TransposePlan {
   // Size of each element in bytes.
   int64_t elem_size_in_bytes_;
 
+  // Size of each input element in bytes, before any transformation.
+  int64_t input_elem_size_in_bytes_;
+
   // Number of elements in the input array.
   int64_t num_elems_;
 
@@ -228,9 +247,10 @@ class TransposePlan {
   int outer_block_elems_b_ = 4;
 
   // Transformations to apply to the input before transposition.
-  // Currently the only supported transformation is EF57 conversion, which is
-  // a pair-of-floats extended precision representation used on TPU. We
-  // support fusing transformations with the transpose for two reasons:
+  // The supported transformations are EF57 conversion, which is a
+  // pair-of-floats extended precision representation used on TPU, and element
+  // type conversions. We support fusing transformations with the transpose
+  // for two reasons:
   // (a) it makes sense to fuse cheap computations with a memory-bandwidth
   //     bound transformation, and
   // (b) it allows us to support non-trivial striding.
@@ -191,7 +191,8 @@ int64_t IndexToLinearIndex(absl::Span<int64_t const> shape,
 // tiled layout.
 template <typename T>
 std::vector<T> TileArray(const Array<T>& in, absl::Span<int64_t const> tiling) {
-  std::vector<T> out(SizeOfTiledArray(in.dimensions(), tiling), -1);
+  std::vector<T> out(SizeOfTiledArray(in.dimensions(), tiling),
+                     static_cast<T>(-1));
   if (in.num_elements() == 0) {
     return out;
   }
@@ -382,6 +383,52 @@ class TransposeTest : public ::testing::TestWithParam<TransposeTestCase> {
 
     EXPECT_EQ(expected_tiled_output, output);
   }
+
+  // Tests a transpose fused with an element type conversion from `From` to
+  // `To`.
+  template <typename From, typename To>
+  void TestConvertingTranspose(TransposePlan::Transformation transformation,
+                               int parallelism) {
+    const TransposeTestCase test = GetParam();
+    tsl::thread::ThreadPool threadpool(tsl::Env::Default(), "Transpose",
+                                       parallelism);
+    std::vector<int64_t> output_dims = Permute(test.dims, test.permutation);
+    TF_ASSERT_OK_AND_ASSIGN(
+        auto plan, TransposePlan::Create(
+                       sizeof(To), test.dims, test.permutation,
+                       TransposePlan::Tiling{test.input_tiling},
+                       TransposePlan::Tiling{test.output_tiling},
+                       transformation, parallelism));
+    VLOG(1) << plan->ToString();
+    EXPECT_EQ(plan->InputElemSizeInBytes(), sizeof(From));
+    xla::Array<From> untiled_input(test.dims);
+    // The fractional part exercises rounding of narrowing conversions.
+    for (int64_t i = 0; i < untiled_input.num_elements(); ++i) {
+      untiled_input.data()[i] =
+          static_cast<From>(static_cast<float>(i % 100) + 0.125f);
+    }
+    xla::Array<From> transposed_input(output_dims);
+    TransposeUsingEigen(untiled_input.data(), transposed_input.data(),
+                        test.dims, output_dims, test.permutation);
+    xla::Array<To> expected_untiled_output(output_dims);
+    for (int64_t i = 0; i < transposed_input.num_elements(); ++i) {
+      expected_untiled_output.data()[i] =
+          static_cast<To>(transposed_input.data()[i]);
+    }
+
+    auto tiled_input = TileArray(untiled_input, test.input_tiling);
+    auto expected_tiled_output =
+        TileArray(expected_untiled_output, test.output_tiling);
+
+    std::vector<To> output(
+        SizeOfTiledArray(plan->OutputDims(), test.output_tiling),
+        static_cast<To>(-1));
+    plan->Execute(
+        tiled_input.data(), output.data(),
+        [&](std::function<void()> fn) { threadpool.Schedule(std::move(fn)); });
+
+    EXPECT_EQ(expected_tiled_output, output);
+  }
 };
 
 TEST_P(TransposeTest, TransposeInt8) { TestTranspose<int8_t>(1); }
@@ -393,6 +440,40 @@ TEST_P(TransposeTest, TransposeInt128) { TestTranspose<absl::int128>(1); }
 TEST_P(TransposeTest, ParallelTransposeInt8) { TestTranspose<int8_t>(16); }
 TEST_P(TransposeTest, ParallelTransposeInt32) { TestTranspose<int32_t>(16); }
 
+TEST_P(TransposeTest, ConvertF32ToBf16) {
+  TestConvertingTranspose<float, Eigen::bfloat16>(
+      TransposePlan::Transformation::kF32ToBf16, 1);
+}
+TEST_P(TransposeTest, ConvertF32ToF16) {
+  TestConvertingTranspose<float, Eigen::half>(
+      TransposePlan::Transformation::kF32ToF16, 1);
+}
+TEST_P(TransposeTest, ConvertBf16ToF32) {
+  TestConvertingTranspose<Eigen::bfloat16, float>(
+      TransposePlan::Transformation::kBf16ToF32, 1);
+}
+TEST_P(TransposeTest, ConvertF16ToF32) {
+  TestConvertingTranspose<Eigen::half, float>(
+      TransposePlan::Transformation::kF16ToF32, 1);
+}
+TEST_P(TransposeTest, ConvertS8ToS32) {
+  TestConvertingTranspose<int8_t, int32_t>(
+      TransposePlan::Transformation::kS8ToS32, 1);
+}
+TEST_P(TransposeTest, ConvertU8ToU32) {
+  TestConvertingTranspose<uint8_t, uint32_t>(
+      TransposePlan::Transformation::kU8ToU32, 1);
+}
+TEST_P(TransposeTest, ConvertS32ToS64) {
+  TestConvertingTranspose<int32_t, int64_t>(
+      TransposePlan::Transformation::kS32ToS64, 1);
+}
+
+TEST_P(TransposeTest, ParallelConvertF32ToBf16) {
+  TestConvertingTranspose<float, Eigen::bfloat16>(
+      TransposePlan::Transformation::kF32ToBf16, 16);
+}
+
 INSTANTIATE_TEST_SUITE_P(TransposeTestInstance, TransposeTest,
                          ::testing::ValuesIn(GetTransposeTestCases()));
 
@@ -433,6 +514,38 @@ TEST(TransposeTest, NegativeStrides2D) {
   EXPECT_EQ(expected, output);
 }
 
+TEST(TransposeTest, ConvertWithStrides) {
+  xla::Array<int8_t> input = {
+      {1, 2, 3, 4},
+      {5, 6, 7, -8},
+      {9, 10, 11, -12},
+  };
+  xla::Array<int32_t> expected = {
+      {4, -8, -12},
+      {3, 7, 11},
+      {2, 6, 10},
+      {1, 5, 9},
+  };
+  xla::Array<int32_t> output({4, 3});
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto plan,
+      TransposePlan::Create(
+          sizeof(int32_t), {3, 4}, /*permutation=*/{1, 0},
+          TransposePlan::Striding{{4 * sizeof(int8_t), -int64_t{1}}},
+          TransposePlan::Tiling{}, TransposePlan::Transformation::kS8ToS32));
+  plan->Execute(input.data() + 3, output.data());
+  EXPECT_EQ(expected, output);
+}
+
+TEST(TransposeTest, InvalidConversionElementSize) {
+  auto plan = TransposePlan::Create(
+      sizeof(float), {3, 4}, {1, 0}, TransposePlan::Tiling{},
+      TransposePlan::Tiling{}, TransposePlan::Transformation::kF32ToBf16);
+  EXPECT_EQ(plan.status().code(), tsl::error::INVALID_ARGUMENT);
+  EXPECT_THAT(plan.status().error_message(),
+              testing::HasSubstr("requires an element size of 2 bytes"));
+}
+
 static std::vector<TransposeTestCase> BenchmarkCases() {
   return std::vector<TransposeTestCase>{
       TransposeTestCase(/*dims=*/{256, 256},
@@ -521,6 +634,54 @@ static void BM_Transpose_float(const TransposeTestCase& bm, int parallelism,
   BM_Transpose<float>(bm, parallelism, state);
 }
 
+// Transposes and converts float to bfloat16 in a single fused pass.
+static void BM_Transpose_float_to_bf16(const TransposeTestCase& bm,
+                                       int parallelism,
+                                       ::testing::benchmark::State& state) {
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto plan,
+      TransposePlan::Create(sizeof(Eigen::bfloat16), bm.dims, bm.permutation,
+                            TransposePlan::Tiling{}, TransposePlan::Tiling{},
+                            TransposePlan::Transformation::kF32ToBf16,
+                            parallelism));
+  Array<float> input(bm.dims);
+  input.FillIota(0);
+  std::vector<int64_t> output_dims = Permute(bm.dims, bm.permutation);
+  Array<Eigen::bfloat16> output(output_dims);
+  tsl::thread::ThreadPool threadpool(tsl::Env::Default(), "Transpose",
+                                     parallelism);
+  for (auto s : state) {
+    plan->Execute(input.data(), output.data(), [&](std::function<void()> fn) {
+      threadpool.Schedule(std::move(fn));
+    });
+    tsl::testing::DoNotOptimize(output);
+  }
+}
+
+// Transposes float and then converts the result to bfloat16 in a second pass,
+// for comparison with BM_Transpose_float_to_bf16.
+static void BM_TransposeThenConvert_float_to_bf16(
+    const TransposeTestCase& bm, int parallelism,
+    ::testing::benchmark::State& state) {
+  CHECK_EQ(parallelism, 1);
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto plan, TransposePlan::Create(sizeof(float), bm.dims, bm.permutation));
+  Array<float> input(bm.dims);
+  input.FillIota(0);
+  std::vector<int64_t> output_dims = Permute(bm.dims, bm.permutation);
+  Array<float> transposed(output_dims);
+  Array<Eigen::bfloat16> output(output_dims);
+  for (auto s : state) {
+    plan->Execute(input.data(), transposed.data());
+    Eigen::Map<Eigen::Array<Eigen::bfloat16, Eigen::Dynamic, 1>>(
+        output.data(), output.num_elements()) =
+        Eigen::Map<const Eigen::Array<float, Eigen::Dynamic, 1>>(
+            transposed.data(), transposed.num_elements())
+            .cast<Eigen::bfloat16>();
+    tsl::testing::DoNotOptimize(output);
+  }
+}
+
 static void* benchmarks = []() {
   using BenchmarkFn =
       void (*)(const TransposeTestCase&, int, testing::benchmark::State&);
@@ -530,6 +691,12 @@ static void* benchmarks = []() {
           {"BM_Transpose_uint8", BM_Transpose_uint8, {1, 4, 8}},  //
           {"BM_Eigen_float", BM_Eigen_float, {1}},
           {"BM_Transpose_float", BM_Transpose_float, {1, 4, 8}},  //
+          {"BM_TransposeThenConvert_float_to_bf16",
+           BM_TransposeThenConvert_float_to_bf16,
+           {1}},
+          {"BM_Transpose_float_to_bf16",
+           BM_Transpose_float_to_bf16,
+           {1, 4, 8}},  //
   };
   auto benchmark_cases = BenchmarkCases();
   for (const auto& benchmark_case : benchmark_cases) {
@@ -575,4 +742,32 @@ TEST(TransposePlanCache, Basics) {
   EXPECT_TRUE(p1.get() != p1b.get());
 }
 
+TEST(TransposePlanCache, KeysOnTransformation) {
+  TransposePlanCache cache(4);
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto p1, cache.GetOrCreate(
+                   /*elem_size_in_bytes=*/2, /*dims=*/{4, 8},
+                   /*permutation=*/{1, 0}, TransposePlan::Tiling{},
+                   TransposePlan::Tiling{},
+                   TransposePlan::Transformation::kF32ToBf16));
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto p2, cache.GetOrCreate(
+                   /*elem_size_in_bytes=*/2, /*dims=*/{4, 8},
+                   /*permutation=*/{1, 0}, TransposePlan::Tiling{},
+                   TransposePlan::Tiling{},
+                   TransposePlan::Transformation::kF32ToF16));
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto p3, cache.GetOrCreate(/*elem_size_in_bytes=*/2, /*dims=*/{4, 8},
+                                 /*permutation=*/{1, 0}));
+  TF_ASSERT_OK_AND_ASSIGN(
+      auto p1a, cache.GetOrCreate(
+                    /*elem_size_in_bytes=*/2, /*dims=*/{4, 8},
+                    /*permutation=*/{1, 0}, TransposePlan::Tiling{},
+                    TransposePlan::Tiling{},
+                    TransposePlan::Transformation::kF32ToBf16));
+  EXPECT_TRUE(p1.get() != p2.get());
+  EXPECT_TRUE(p1.get() != p3.get());
+  EXPECT_TRUE(p1.get() == p1a.get());
+}
+
 }  // namespace xla
@@ -417,10 +417,109 @@ bool AlgebraicSimplifierVisitor::Run(HloComputation* computation,
                                      const AlgebraicSimplifierOptions& options,
                                      AlgebraicSimplifier* simplifier) {
   ResetState(computation);
-  TF_CHECK_OK(computation->Accept(this));
+  if (options.use_worklist()) {
+    TF_CHECK_OK(RunWithWorklist());
+  } else {
+    TF_CHECK_OK(computation->Accept(this));
+  }
   return changed();
 }
 
+Status AlgebraicSimplifierVisitor::RunWithWorklist() {
+  // Same bound as the default iteration limit of HloPassFix. Rewrites which
+  // undo each other would otherwise keep the worklist from draining.
+  constexpr int64_t kMaxRounds = 25;
+  const bool changed_before = changed();
+  bool changed_in_run = false;
+
+  // The first round visits every instruction, later rounds the instructions
+  // affected by the rewrites of the previous round.
+  std::vector<HloInstruction*> round = computation_->MakeInstructionPostOrder();
+  int max_unique_id = -1;
+  for (const HloInstruction* hlo : round) {
+    max_unique_id = std::max(max_unique_id, hlo->unique_id());
+  }
+  // Removed instructions are only deleted once the pass has finished, so the
+  // worklist may keep pointers to them.
+  auto removed = [&](const HloInstruction* hlo) {
+    return hlo->parent() != computation_;
+  };
+  const int64_t visits_before = worklist_visits_;
+  const int64_t sweep_visits_before = worklist_sweep_visits_;
+  int64_t num_rounds = 0;
+  while (!round.empty()) {
+    if (num_rounds == kMaxRounds) {
+      VLOG(1) << "Worklist of computation " << computation_->name()
+              << " did not drain after " << kMaxRounds << " rounds";
+      break;
+    }
+    ++num_rounds;
+    worklist_sweep_visits_ += computation_->instruction_count();
+
+    bool changed_in_round = false;
+    std::vector<HloInstruction*> next_round;
+    absl::flat_hash_set<HloInstruction*> queued;
+    auto enqueue = [&](HloInstruction* hlo) {
+      if (!removed(hlo) && queued.insert(hlo).second) {
+        next_round.push_back(hlo);
+      }
+    };
+    for (HloInstruction* hlo : round) {
+      if (removed(hlo)) {
+        continue;
+      }
+      const std::vector<HloInstruction*> users = hlo->users();
+      const HloInstruction::InstructionVector operands = hlo->operands();
+      ResetChanged();
+      TF_RETURN_IF_ERROR(Preprocess(hlo));
+      TF_RETURN_IF_ERROR(hlo->Visit(this));
+      TF_RETURN_IF_ERROR(Postprocess(hlo));
+      ++worklist_visits_;
+      if (!changed()) {
+        continue;
+      }
+      changed_in_round = true;
+      for (HloInstruction* operand : operands) {
+        enqueue(operand);
+      }
+      enqueue(hlo);
+      for (HloInstruction* user : users) {
+        enqueue(user);
+      }
+    }
+
+    if (changed_in_round) {
+      changed_in_run = true;
+      // Rewrites may also create instructions further away from the visited
+      // one, e.g. when a broadcast is sunk below its users. New instructions
+      // are recognized by their ids, which exceed those of all instructions
+      // that existed before; ids which are not assigned yet are new as well.
+      int new_max_unique_id = max_unique_id;
+      for (HloInstruction* hlo : computation_->instructions()) {
+        if (hlo->unique_id() >= 0 && hlo->unique_id() <= max_unique_id) {
+          continue;
+        }
+        new_max_unique_id = std::max(new_max_unique_id, hlo->unique_id());
+        enqueue(hlo);
+        for (HloInstruction* user : hlo->users()) {
+          enqueue(user);
+        }
+      }
+      max_unique_id = new_max_unique_id;
+    }
+    round = std::move(next_round);
+  }
+
+  VLOG(1) << "Simplified " << computation_->name() << " in " << num_rounds
+          << " rounds with " << worklist_visits_ - visits_before
+          << " visits instead of "
+          << worklist_sweep_visits_ - sweep_visits_before;
+  if (changed_before || changed_in_run) {
+    MarkAsChanged();
+  }
+  return OkStatus();
+}
+
 bool AlgebraicSimplifierVisitor::SameShape(const HloInstruction* lhs,
                                            const HloInstruction* rhs) const {
   return SameShape(lhs->shape(), rhs->shape());
@@ -7220,6 +7319,15 @@ StatusOr<bool> AlgebraicSimplifier::Run(
       changed = true;
     }
   }
+  if (options_.use_worklist()) {
+    worklist_visits_ += visitor.worklist_visits();
+    worklist_visits_saved_ +=
+        visitor.worklist_sweep_visits() - visitor.worklist_visits();
+    VLOG(1) << name() << " visited " << visitor.worklist_visits()
+            << " instructions, saving "
+            << visitor.worklist_sweep_visits() - visitor.worklist_visits()
+            << " visits over re-running on whole computations";
+  }
   return changed;
 }
 
@@ -179,6 +179,15 @@ class AlgebraicSimplifierOptions {
   bool minmax_propagate_nan() const { return minmax_propagate_nan_; }
   void set_minmax_propagate_nan(bool val) { minmax_propagate_nan_ = val; }
 
+  // If true, the simplifier revisits the instructions affected by a rewrite
+  // (the rewritten instruction, its users and operands and any instructions it
+  // created) until none of them changes, instead of visiting every instruction
+  // exactly once. Each computation is then simplified to a fixed point in a
+  // single run, so an enclosing HloPassFix does not need an extra iteration
+  // over the whole module for every round of rewrites.
+  void set_use_worklist(bool use_worklist) { use_worklist_ = use_worklist; }
+  bool use_worklist() const { return use_worklist_; }
+
  private:
   // Metadata struct can be used to store any metadata information encapsulated
   // with the AlgebraicSimplierOptions that can be later used in an
@@ -207,6 +216,7 @@ class AlgebraicSimplifierOptions {
   bool enable_sink_broadcast_{true};
   int64_t very_small_gather_size_{4};
   bool minmax_propagate_nan_{true};
+  bool use_worklist_{false};
   Metadata metadata_;
 };
 
@@ -236,14 +246,25 @@ class AlgebraicSimplifier : public HloModulePass {
     return constant;
   }
 
+  // Number of instructions visited so far in worklist mode.
+  int64_t worklist_visits() const { return worklist_visits_; }
+  // Number of visits worklist mode saved compared to re-running the simplifier
+  // over whole computations until nothing changes.
+  int64_t worklist_visits_saved() const { return worklist_visits_saved_; }
+
  protected:
   AlgebraicSimplifierOptions options_;
+
+ private:
+  int64_t worklist_visits_ = 0;
+  int64_t worklist_visits_saved_ = 0;
 };
 
 // AlgebraicSimplifierVisitor traverses the HLO computation and reduces certain
 // algebraic expressions to simplified forms. Note: This only supports
-// simplifications that simply look at the operands of an instruction. For the
-// more general case a worklist based approach would be needed.
+// simplifications that simply look at the operands of an instruction. With
+// AlgebraicSimplifierOptions::use_worklist() the instructions around each
+// rewrite are revisited until the computation reaches a fixed point.
 class AlgebraicSimplifierVisitor : public DfsHloRewriteVisitor {
  public:
   explicit AlgebraicSimplifierVisitor(const AlgebraicSimplifierOptions& options,
@@ -349,6 +370,13 @@ class AlgebraicSimplifierVisitor : public DfsHloRewriteVisitor {
            const AlgebraicSimplifierOptions& options,
            AlgebraicSimplifier* simplifier);
 
+  // Number of instructions visited in worklist mode, summed over all runs.
+  int64_t worklist_visits() const { return worklist_visits_; }
+  // Number of instructions a whole-computation fixed point would have visited
+  // for the same runs: every instruction once per round of rewrites, the last
+  // of which finds nothing to simplify.
+  int64_t worklist_sweep_visits() const { return worklist_sweep_visits_; }
+
   // Compute a function that maps from bitcasted dimensions to the resulting
   // ones. Returns the function as a vector if successful; std::optional
   // otherwise.
@@ -521,6 +549,10 @@ class AlgebraicSimplifierVisitor : public DfsHloRewriteVisitor {
   // Useful when we want to use the same visitor over multiple computations.
   void ResetState(HloComputation* computation);
 
+  // Simplifies computation_ to a fixed point, revisiting only the instructions
+  // affected by each rewrite.
+  Status RunWithWorklist();
+
   // Current HloComputation instance the AlgebraicSimplifierVisitor is
   // traversing.
   HloComputation* computation_;
@@ -529,6 +561,9 @@ class AlgebraicSimplifierVisitor : public DfsHloRewriteVisitor {
   absl::flat_hash_map<PrimitiveType, HloComputation*> scalar_add_computations_;
 
   AlgebraicSimplifier* simplifier_ = nullptr;
+
+  int64_t worklist_visits_ = 0;
+  int64_t worklist_sweep_visits_ = 0;
 };
 
 }  // namespace xla
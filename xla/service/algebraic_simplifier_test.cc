@@ -8992,5 +8992,28 @@ TEST_F(AlgebraicSimplifierTest,
               after_rewrite_rev_dims);
 }
 
+TEST_F(AlgebraicSimplifierTest, WorklistReachesFixedPointInOneRun) {
+  const char* kModuleStr = R"(
+    HloModule m
+    test {
+      p = f32[4,8] parameter(0)
+      t1 = f32[8,4] transpose(p), dimensions={1,0}
+      r1 = f32[32] reshape(t1)
+      r2 = f32[8,4] reshape(r1)
+      t2 = f32[4,8] transpose(r2), dimensions={1,0}
+      ROOT n = f32[4,8] negate(t2)
+    }
+  )";
+  TF_ASSERT_OK_AND_ASSIGN(auto m, ParseAndReturnVerifiedModule(kModuleStr));
+  AlgebraicSimplifierOptions options = default_options_;
+  options.set_use_worklist(true);
+  AlgebraicSimplifier worklist_simplifier(options);
+  ASSERT_TRUE(worklist_simplifier.Run(m.get()).value());
+  EXPECT_THAT(m->entry_computation()->root_instruction(),
+              GmockMatch(m::Negate(m::Parameter(0))));
+  EXPECT_GT(worklist_simplifier.worklist_visits_saved(), 0);
+  EXPECT_FALSE(worklist_simplifier.Run(m.get()).value());
+}
+
 }  // namespace
 }  // namespace xla
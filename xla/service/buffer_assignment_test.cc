@@ -23,10 +23,12 @@ limitations under the License.
 #include <vector>
 
 #include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "xla/hlo/ir/dfs_hlo_visitor_with_default.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
 #include "xla/hlo/ir/hlo_opcode.h"
 #include "xla/hlo/ir/hlo_schedule.h"
 #include "xla/literal.h"
@@ -46,6 +48,7 @@ limitations under the License.
 #include "xla/types.h"
 #include "xla/xla_data.pb.h"
 #include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace xla {
 namespace {
@@ -3110,5 +3113,56 @@ ENTRY entry_computation {
   EXPECT_EQ(dus9_alloc_slice.allocation(), dus5_alloc_slice.allocation());
   EXPECT_EQ(dus9_alloc_slice, dus5_alloc_slice);
 }
+
+// A module of `count` adds spread over 64 interleaved chains of different
+// shapes, where each add reads the two previous values of its chain, so that
+// buffers of many sizes have overlapping live ranges.
+std::unique_ptr<HloModule> MakeBenchmarkModule(int64_t count) {
+  constexpr int64_t kChains = 64;
+  auto module = std::make_unique<HloModule>("benchmark", HloModuleConfig());
+  HloComputation::Builder builder("entry");
+  std::vector<std::pair<HloInstruction*, HloInstruction*>> chains;
+  for (int64_t chain = 0; chain < kChains; ++chain) {
+    HloInstruction* param = builder.AddInstruction(
+        HloInstruction::CreateParameter(
+            chain, ShapeUtil::MakeShape(F32, {16 * (chain + 1)}),
+            absl::StrCat("p", chain)));
+    chains.push_back({param, param});
+  }
+  for (int64_t i = 0; i < count; ++i) {
+    auto& [previous, current] = chains[i % kChains];
+    HloInstruction* add = builder.AddInstruction(HloInstruction::CreateBinary(
+        current->shape(), HloOpcode::kAdd, previous, current));
+    previous = current;
+    current = add;
+  }
+  std::vector<HloInstruction*> outputs;
+  for (const auto& [previous, current] : chains) {
+    outputs.push_back(current);
+  }
+  builder.AddInstruction(HloInstruction::CreateTuple(outputs));
+  module->AddEntryComputation(builder.Build());
+  return module;
+}
+
+void BM_BufferAssignment(::testing::benchmark::State& state) {
+  std::unique_ptr<HloModule> module = MakeBenchmarkModule(state.range(0));
+  auto size_fn = [](const BufferValue& buffer) {
+    return ShapeUtil::ByteSizeOf(buffer.shape(), sizeof(void*));
+  };
+  HloSchedule schedule = ScheduleModule(module.get(), size_fn).value();
+  for (auto s : state) {
+    std::unique_ptr<BufferAssignment> assignment =
+        BufferAssigner::Run(
+            module.get(), std::make_unique<SequentialHloOrdering>(schedule),
+            size_fn, [](LogicalBuffer::Color) { return 1; },
+            /*allocate_buffers_for_constants=*/true)
+            .value();
+    tsl::testing::DoNotOptimize(assignment);
+  }
+}
+
+BENCHMARK(BM_BufferAssignment)->Arg(1 << 10)->Arg(100000);
+
 }  // namespace
 }  // namespace xla
@@ -15,6 +15,9 @@ limitations under the License.
 
 #include "xla/service/compilation_cache.h"
 
+#include <algorithm>
+#include <memory>
+#include <tuple>
 #include <utility>
 
 #include "xla/types.h"
@@ -35,16 +38,36 @@ int64_t GetUniqueId() {
   return id;
 }
 
+// Executables whose backend does not report a code size are accounted as
+// zero bytes, i.e. they are only bounded by the number of entries.
+int64_t ExecutableSizeBytes(const Executable& executable) {
+  return std::max<int64_t>(executable.SizeOfGeneratedCodeInBytes(), 0);
+}
+
 }  // namespace
 
-ExecutionHandle CompilationCache::Insert(
-    std::unique_ptr<Executable> executable) {
+CompilationCache::CompilationCache(int64_t max_size_bytes, int64_t max_entries)
+    : max_size_bytes_(max_size_bytes), max_entries_(max_entries) {}
+
+ExecutionHandle CompilationCache::Insert(std::unique_ptr<Executable> executable,
+                                         absl::Duration compile_time) {
   absl::MutexLock lock(&mutex_);
 
   CacheKey key = GetUniqueId();
   VLOG(2) << "inserting cache key: " << key;
   CHECK_EQ(cache_.count(key), 0);
-  cache_.emplace(key, std::move(executable));
+  Entry entry;
+  entry.size_bytes = ExecutableSizeBytes(*executable);
+  entry.cost = std::max(absl::ToDoubleSeconds(compile_time), 0.0) /
+               std::max<int64_t>(entry.size_bytes, 1);
+  entry.executable = std::move(executable);
+  entry.eviction_key = {inflation_ + entry.cost, use_counter_++, key};
+  eviction_order_.insert(entry.eviction_key);
+  ++stats_.insertions;
+  ++stats_.entries;
+  stats_.size_bytes += entry.size_bytes;
+  cache_.emplace(key, std::move(entry));
+  EvictToFit(/*keep=*/key);
 
   ExecutionHandle handle;
   handle.set_handle(key);
@@ -52,18 +75,82 @@ ExecutionHandle CompilationCache::Insert(
 }
 
 StatusOr<std::shared_ptr<Executable>> CompilationCache::LookUp(
-    const ExecutionHandle& handle) const {
+    const ExecutionHandle& handle) {
   absl::MutexLock lock(&mutex_);
 
   CacheKey key = handle.handle();
   VLOG(2) << "looking up cache key: " << key;
-  if (cache_.count(key) == 0) {
+  auto it = cache_.find(key);
+  if (it == cache_.end()) {
     VLOG(2) << "cache key not found: " << key;
-    return InvalidArgumentStrCat("can not find executable with handle ", key);
-  } else {
-    auto& result = cache_.at(key);
-    VLOG(2) << "hit executable: " << result->module().name();
-    return result;
+    ++stats_.misses;
+    return InvalidArgumentStrCat("can not find executable with handle ", key,
+                                 "; it may have been evicted");
+  }
+  ++stats_.hits;
+  Touch(key, it->second);
+  const std::shared_ptr<Executable>& result = it->second.executable;
+  VLOG(2) << "hit executable: " << result->module().name();
+  return result;
+}
+
+Status CompilationCache::Evict(const ExecutionHandle& handle) {
+  absl::MutexLock lock(&mutex_);
+  if (!cache_.contains(handle.handle())) {
+    return NotFound("can not find executable with handle %d",
+                    handle.handle());
+  }
+  Remove(handle.handle());
+  ++stats_.evictions;
+  return OkStatus();
+}
+
+void CompilationCache::Clear() {
+  absl::MutexLock lock(&mutex_);
+  stats_.evictions += cache_.size();
+  cache_.clear();
+  eviction_order_.clear();
+  stats_.entries = 0;
+  stats_.size_bytes = 0;
+}
+
+CompilationCache::Stats CompilationCache::stats() const {
+  absl::MutexLock lock(&mutex_);
+  return stats_;
+}
+
+void CompilationCache::Touch(CacheKey key, Entry& entry) {
+  eviction_order_.erase(entry.eviction_key);
+  entry.eviction_key = {inflation_ + entry.cost, use_counter_++, key};
+  eviction_order_.insert(entry.eviction_key);
+}
+
+void CompilationCache::Remove(CacheKey key) {
+  auto it = cache_.find(key);
+  CHECK(it != cache_.end());
+  eviction_order_.erase(it->second.eviction_key);
+  --stats_.entries;
+  stats_.size_bytes -= it->second.size_bytes;
+  cache_.erase(it);
+}
+
+void CompilationCache::EvictToFit(CacheKey keep) {
+  auto over_budget = [&] {
+    return (max_size_bytes_ > 0 && stats_.size_bytes > max_size_bytes_) ||
+           (max_entries_ > 0 && stats_.entries > max_entries_);
+  };
+  auto it = eviction_order_.begin();
+  while (over_budget() && it != eviction_order_.end()) {
+    auto [priority, last_use, key] = *it++;
+    if (key == keep) {
+      continue;
+    }
+    VLOG(2) << "evicting cache key: " << key;
+    // Aging: everything that survives this eviction is at least as valuable
+    // as the evicted entry was.
+    inflation_ = std::max(inflation_, priority);
+    Remove(key);
+    ++stats_.evictions;
   }
 }
 
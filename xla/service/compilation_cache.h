@@ -16,11 +16,15 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_COMPILATION_CACHE_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_COMPILATION_CACHE_H_
 
-#include <map>
+#include <cstdint>
 #include <memory>
+#include <set>
 #include <string>
+#include <tuple>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "xla/service/executable.h"
 #include "xla/service/hlo_module_config.h"
 #include "xla/types.h"
@@ -29,28 +33,84 @@ namespace xla {
 
 // A cache which stores Executables indexed by computation handle and version.
 //
-// TODO(b/119042872): Provide mechanism for removing computations from the
-// compilation cache.
+// The cache can be bounded by the total size of the generated code and by the
+// number of entries. When a bound is exceeded, entries are evicted in
+// GreedyDual-Size order: every entry has a priority of
+//
+//   inflation + compile_time / size
+//
+// which is refreshed on every hit, and the entry with the lowest priority is
+// evicted first. The inflation value is raised to the priority of each evicted
+// entry, so entries that have not been used for a while age out even if they
+// were expensive to compile. Ties, including all entries whose compile time is
+// unknown, are broken in least-recently-used order.
+//
+// Executables are handed out as shared_ptrs, so evicting an entry never
+// invalidates an executable that is still running.
 class CompilationCache {
  public:
-  CompilationCache() {}
-
-  ExecutionHandle Insert(std::unique_ptr<Executable> executable);
+  struct Stats {
+    int64_t hits = 0;
+    int64_t misses = 0;
+    int64_t insertions = 0;
+    int64_t evictions = 0;
+    // Current number of entries and the sum of their sizes.
+    int64_t entries = 0;
+    int64_t size_bytes = 0;
+  };
+
+  // A bound of zero or less disables the corresponding limit.
+  explicit CompilationCache(int64_t max_size_bytes = 0,
+                            int64_t max_entries = 0);
+
+  // Inserts `executable` and returns its handle. `compile_time` is the time it
+  // took to build the executable and makes it proportionally more expensive
+  // to evict. May evict other entries to stay within the bounds; the new entry
+  // itself is never evicted by its own insertion.
+  ExecutionHandle Insert(std::unique_ptr<Executable> executable,
+                         absl::Duration compile_time = absl::ZeroDuration());
 
   // Lookup the Executable for the specified handle in the cache. Return a
   // shared_ptr to the Executable if it exists in the cache.
-  StatusOr<std::shared_ptr<Executable>> LookUp(
-      const ExecutionHandle& handle) const;
+  StatusOr<std::shared_ptr<Executable>> LookUp(const ExecutionHandle& handle);
 
- protected:
-  mutable absl::Mutex mutex_;
+  // Removes the entry for `handle`. Returns NotFound if there is none.
+  Status Evict(const ExecutionHandle& handle);
 
-  using CacheKey = int64_t;
+  // Removes all entries. Counters other than the current size are preserved.
+  void Clear();
 
-  absl::flat_hash_map<CacheKey, std::shared_ptr<Executable>> cache_
-      ABSL_GUARDED_BY(mutex_);
+  Stats stats() const;
 
  private:
+  using CacheKey = int64_t;
+  // (priority, last use, key): entries are evicted in ascending order.
+  using EvictionKey = std::tuple<double, int64_t, CacheKey>;
+
+  struct Entry {
+    std::shared_ptr<Executable> executable;
+    int64_t size_bytes;
+    double cost;
+    EvictionKey eviction_key;
+  };
+
+  // Recomputes the priority of `entry` after a use.
+  void Touch(CacheKey key, Entry& entry) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void Remove(CacheKey key) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Evicts entries other than `keep` until the cache is within its bounds.
+  void EvictToFit(CacheKey keep) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const int64_t max_size_bytes_;
+  const int64_t max_entries_;
+
+  mutable absl::Mutex mutex_;
+
+  absl::flat_hash_map<CacheKey, Entry> cache_ ABSL_GUARDED_BY(mutex_);
+  std::set<EvictionKey> eviction_order_ ABSL_GUARDED_BY(mutex_);
+  double inflation_ ABSL_GUARDED_BY(mutex_) = 0.0;
+  int64_t use_counter_ ABSL_GUARDED_BY(mutex_) = 0;
+  Stats stats_ ABSL_GUARDED_BY(mutex_);
+
   CompilationCache(const CompilationCache&) = delete;
   CompilationCache& operator=(const CompilationCache&) = delete;
 };
@@ -0,0 +1,166 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/compilation_cache.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/time/time.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/executable.h"
+#include "xla/service/hlo_module_config.h"
+#include "xla/test.h"
+#include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/statusor.h"
+
+namespace xla {
+namespace {
+
+// An executable that only reports the size of its generated code.
+class FakeExecutable : public Executable {
+ public:
+  explicit FakeExecutable(int64_t size_bytes)
+      : Executable(std::make_shared<HloModule>("fake", HloModuleConfig())),
+        size_bytes_(size_bytes) {}
+
+  StatusOr<ExecutionOutput> ExecuteAsyncOnStream(
+      const ServiceExecutableRunOptions* run_options,
+      std::vector<ExecutionInput> arguments,
+      HloExecutionProfile* hlo_execution_profile) override {
+    return Unimplemented("FakeExecutable cannot be executed");
+  }
+
+  int64_t SizeOfGeneratedCodeInBytes() const override { return size_bytes_; }
+
+ private:
+  int64_t size_bytes_;
+};
+
+ExecutionHandle Insert(CompilationCache& cache, int64_t size_bytes,
+                       absl::Duration compile_time = absl::ZeroDuration()) {
+  return cache.Insert(std::make_unique<FakeExecutable>(size_bytes),
+                      compile_time);
+}
+
+bool Contains(CompilationCache& cache, const ExecutionHandle& handle) {
+  return cache.LookUp(handle).ok();
+}
+
+TEST(CompilationCacheTest, UnboundedByDefault) {
+  CompilationCache cache;
+  std::vector<ExecutionHandle> handles;
+  for (int i = 0; i < 100; ++i) {
+    handles.push_back(Insert(cache, 1 << 20));
+  }
+  for (const ExecutionHandle& handle : handles) {
+    EXPECT_TRUE(Contains(cache, handle));
+  }
+  CompilationCache::Stats stats = cache.stats();
+  EXPECT_EQ(stats.insertions, 100);
+  EXPECT_EQ(stats.hits, 100);
+  EXPECT_EQ(stats.evictions, 0);
+  EXPECT_EQ(stats.entries, 100);
+  EXPECT_EQ(stats.size_bytes, 100 << 20);
+}
+
+TEST(CompilationCacheTest, EvictsLeastRecentlyUsedBySize) {
+  CompilationCache cache(/*max_size_bytes=*/300);
+  ExecutionHandle a = Insert(cache, 100);
+  ExecutionHandle b = Insert(cache, 100);
+  ExecutionHandle c = Insert(cache, 100);
+  // Make `a` the most recently used entry.
+  EXPECT_TRUE(Contains(cache, a));
+
+  ExecutionHandle d = Insert(cache, 100);
+  EXPECT_TRUE(Contains(cache, a));
+  EXPECT_FALSE(Contains(cache, b));
+  EXPECT_TRUE(Contains(cache, c));
+  EXPECT_TRUE(Contains(cache, d));
+
+  CompilationCache::Stats stats = cache.stats();
+  EXPECT_EQ(stats.evictions, 1);
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(stats.entries, 3);
+  EXPECT_EQ(stats.size_bytes, 300);
+}
+
+TEST(CompilationCacheTest, EvictsByEntryCount) {
+  CompilationCache cache(/*max_size_bytes=*/0, /*max_entries=*/2);
+  ExecutionHandle a = Insert(cache, -1);
+  ExecutionHandle b = Insert(cache, -1);
+  ExecutionHandle c = Insert(cache, -1);
+  EXPECT_FALSE(Contains(cache, a));
+  EXPECT_TRUE(Contains(cache, b));
+  EXPECT_TRUE(Contains(cache, c));
+  EXPECT_EQ(cache.stats().size_bytes, 0);
+}
+
+TEST(CompilationCacheTest, KeepsExpensiveEntries) {
+  CompilationCache cache(/*max_size_bytes=*/200);
+  ExecutionHandle expensive = Insert(cache, 100, absl::Seconds(60));
+  ExecutionHandle cheap = Insert(cache, 100, absl::Milliseconds(1));
+  ExecutionHandle newest = Insert(cache, 100, absl::Milliseconds(1));
+  // The expensive entry is the least recently used one, but it is kept
+  // because recompiling it costs much more than recompiling the cheap one.
+  EXPECT_TRUE(Contains(cache, expensive));
+  EXPECT_FALSE(Contains(cache, cheap));
+  EXPECT_TRUE(Contains(cache, newest));
+}
+
+TEST(CompilationCacheTest, ExpensiveEntriesAgeOut) {
+  CompilationCache cache(/*max_size_bytes=*/200);
+  ExecutionHandle expensive = Insert(cache, 100, absl::Seconds(1));
+  // Keep inserting entries that are only slightly cheaper; each eviction
+  // raises the priority floor until the unused expensive entry goes too.
+  for (int i = 0; i < 100; ++i) {
+    Insert(cache, 100, absl::Milliseconds(900));
+  }
+  EXPECT_FALSE(Contains(cache, expensive));
+}
+
+TEST(CompilationCacheTest, NeverEvictsTheInsertedEntry) {
+  CompilationCache cache(/*max_size_bytes=*/100);
+  ExecutionHandle a = Insert(cache, 50);
+  ExecutionHandle huge = Insert(cache, 1000);
+  EXPECT_FALSE(Contains(cache, a));
+  EXPECT_TRUE(Contains(cache, huge));
+}
+
+TEST(CompilationCacheTest, EvictAndClear) {
+  CompilationCache cache;
+  ExecutionHandle a = Insert(cache, 10);
+  ExecutionHandle b = Insert(cache, 20);
+
+  TF_EXPECT_OK(cache.Evict(a));
+  EXPECT_FALSE(cache.Evict(a).ok());
+  EXPECT_FALSE(Contains(cache, a));
+  EXPECT_EQ(cache.stats().size_bytes, 20);
+
+  // Evicted executables stay alive for as long as someone holds them.
+  TF_ASSERT_OK_AND_ASSIGN(std::shared_ptr<Executable> held, cache.LookUp(b));
+  cache.Clear();
+  EXPECT_FALSE(Contains(cache, b));
+  EXPECT_EQ(held->SizeOfGeneratedCodeInBytes(), 20);
+
+  CompilationCache::Stats stats = cache.stats();
+  EXPECT_EQ(stats.evictions, 2);
+  EXPECT_EQ(stats.entries, 0);
+  EXPECT_EQ(stats.size_bytes, 0);
+}
+
+}  // namespace
+}  // namespace xla
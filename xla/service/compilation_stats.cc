@@ -15,59 +15,110 @@ limitations under the License.
 
 #include "xla/service/compilation_stats.h"
 
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "xla/types.h"
+#include "xla/util.h"
 #include "tsl/platform/env.h"
+#include "tsl/platform/protobuf.h"
 
 namespace xla {
 
+namespace {
+
+// Returns the peak resident set size of this process in bytes, or 0 if it is
+// not available on this platform.
+int64_t PeakRssBytes() {
+#if defined(__linux__) || defined(__APPLE__)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+    return usage.ru_maxrss;
+#else
+    // Linux reports kilobytes.
+    return int64_t{usage.ru_maxrss} * 1024;
+#endif
+  }
+#endif
+  return 0;
+}
+
+std::string JsonEscape(absl::string_view str) {
+  std::string escaped;
+  escaped.reserve(str.size());
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      escaped.push_back('\\');
+      escaped.push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      absl::StrAppendFormat(&escaped, "\\u%04x", c);
+    } else {
+      escaped.push_back(c);
+    }
+  }
+  return escaped;
+}
+
+}  // namespace
+
 class NoopStats : public CompilationStats {
  public:
   NoopStats() = default;
 
-  void StartPass(absl::string_view pass_name) override {}
+  void StartPass(absl::string_view pass_name, absl::string_view pipeline_name,
+                 bool is_pipeline, int64_t instruction_count) override {}
 
-  void EndPass(absl::string_view pass_name) override {}
+  void EndPass(absl::string_view pass_name, bool changed,
+               int64_t instruction_count, int64_t iterations) override {}
 
   void CompilationReport() override {}
 
   int GetPassesSize() override { return 0; }
+
+  CompilationStatsProto ToProto() const override { return {}; }
 };
 
 class Stats : public CompilationStats {
  public:
   Stats() = default;
 
-  void StartPass(absl::string_view pass_name) override;
+  void StartPass(absl::string_view pass_name, absl::string_view pipeline_name,
+                 bool is_pipeline, int64_t instruction_count) override;
 
-  void EndPass(absl::string_view pass_name) override;
+  void EndPass(absl::string_view pass_name, bool changed,
+               int64_t instruction_count, int64_t iterations) override;
 
   void CompilationReport() override;
 
   int GetPassesSize() override;
 
- private:
-  struct PassInfo {
-    PassInfo(absl::string_view name, double duration)
-        : name(name), duration_ms(duration) {}
+  CompilationStatsProto ToProto() const override;
 
-    std::string name;
-    int num_runs = 1;
-    double duration_ms;
+ private:
+  struct RunningPass {
+    // Index into runs_.
+    int64_t index;
+    int64_t start_peak_rss_bytes;
   };
 
-  // Info about the passes that have been run so far.
-  std::vector<PassInfo> passes_;
-  // Used to avoid nested calls to StartPass.
-  bool pass_running_ = false;
-  std::string current_pass_;
-  // The start time of the currently running pass.
-  uint64_t start_micros_;
+  // Info about the pass runs started so far, in start order.
+  std::vector<CompilationStatsProto::PassRun> runs_;
+  // The runs that have started but not ended yet, innermost last.
+  std::vector<RunningPass> running_;
 };
 
 /* static */
@@ -80,58 +131,144 @@ std::unique_ptr<CompilationStats> CompilationStats::MakeStats() {
   return std::make_unique<Stats>();
 }
 
-void Stats::StartPass(absl::string_view pass_name) {
-  CHECK(!pass_running_) << "Can't start " << pass_name << " while running "
-                        << current_pass_;
-  pass_running_ = true;
-  current_pass_ = std::string(pass_name);
-  start_micros_ = tsl::Env::Default()->NowMicros();
+void Stats::StartPass(absl::string_view pass_name,
+                      absl::string_view pipeline_name, bool is_pipeline,
+                      int64_t instruction_count) {
+  CompilationStatsProto::PassRun& run = runs_.emplace_back();
+  run.set_pass_name(std::string(pass_name));
+  run.set_pipeline_name(std::string(pipeline_name));
+  run.set_is_pipeline(is_pipeline);
+  run.set_depth(running_.size());
+  run.set_instruction_count_before(instruction_count);
+  running_.push_back({static_cast<int64_t>(runs_.size()) - 1, PeakRssBytes()});
+  // Take the timestamp last so that it does not include our own overhead.
+  run.set_start_timestamp_usec(tsl::Env::Default()->NowMicros());
 }
 
-void Stats::EndPass(absl::string_view pass_name) {
-  CHECK(pass_running_);
-  CHECK_EQ(current_pass_, std::string(pass_name));
-  pass_running_ = false;
+void Stats::EndPass(absl::string_view pass_name, bool changed,
+                    int64_t instruction_count, int64_t iterations) {
   uint64_t end_micros = tsl::Env::Default()->NowMicros();
-  double duration_ms = (end_micros - start_micros_) / 1000.0;
-  passes_.push_back(PassInfo(current_pass_, duration_ms));
+  CHECK(!running_.empty()) << "EndPass called for " << pass_name
+                           << " without StartPass";
+  RunningPass running = running_.back();
+  running_.pop_back();
+  CompilationStatsProto::PassRun& run = runs_[running.index];
+  CHECK_EQ(run.pass_name(), pass_name);
+  run.set_end_timestamp_usec(end_micros);
+  run.set_instruction_count_after(instruction_count);
+  run.set_peak_rss_delta_bytes(PeakRssBytes() - running.start_peak_rss_bytes);
+  run.set_iterations(iterations);
+  run.set_changed(changed);
 }
 
-void Stats::CompilationReport() {
-  CHECK(!pass_running_) << "EndPass never called for " << current_pass_;
-  absl::flat_hash_map<std::string, PassInfo> summary;
-  double total_duration = 0;
-
-  for (auto& pass_run : passes_) {
-    auto pass_name = pass_run.name;
-    total_duration += pass_run.duration_ms;
-    auto it = summary.find(pass_name);
-    if (it == summary.end()) {
-      summary.insert(std::make_pair(pass_name, pass_run));
-    } else {
-      ++summary.at(pass_name).num_runs;
-      summary.at(pass_name).duration_ms += pass_run.duration_ms;
+CompilationStatsProto Stats::ToProto() const {
+  CompilationStatsProto proto;
+  absl::flat_hash_map<std::string, CompilationStatsProto::PassSummary> summary;
+  for (const CompilationStatsProto::PassRun& run : runs_) {
+    *proto.add_runs() = run;
+    auto [it, inserted] = summary.try_emplace(run.pass_name());
+    CompilationStatsProto::PassSummary& pass_summary = it->second;
+    if (inserted) {
+      pass_summary.set_pass_name(run.pass_name());
+      pass_summary.set_is_pipeline(run.is_pipeline());
     }
+    pass_summary.set_num_runs(pass_summary.num_runs() + 1);
+    pass_summary.set_total_duration_usec(
+        pass_summary.total_duration_usec() + run.end_timestamp_usec() -
+        run.start_timestamp_usec());
+    pass_summary.set_instruction_count_delta(
+        pass_summary.instruction_count_delta() +
+        run.instruction_count_after() - run.instruction_count_before());
+    pass_summary.set_max_peak_rss_delta_bytes(
+        std::max(pass_summary.max_peak_rss_delta_bytes(),
+                 run.peak_rss_delta_bytes()));
   }
 
-  std::vector<PassInfo> sorted_summary;
+  std::vector<CompilationStatsProto::PassSummary> sorted_summary;
   sorted_summary.reserve(summary.size());
   for (auto& it : summary) {
-    sorted_summary.push_back(it.second);
+    sorted_summary.push_back(std::move(it.second));
   }
-  absl::c_sort(sorted_summary, [](const PassInfo& a, const PassInfo& b) {
+  absl::c_sort(sorted_summary, [](const CompilationStatsProto::PassSummary& a,
+                                  const CompilationStatsProto::PassSummary& b) {
     // Sort passes that take the longest first, break ties using pass names.
-    return std::make_pair(b.duration_ms, a.name) <
-           std::make_pair(a.duration_ms, b.name);
+    return std::make_pair(b.total_duration_usec(), a.pass_name()) <
+           std::make_pair(a.total_duration_usec(), b.pass_name());
   });
+  for (auto& pass_summary : sorted_summary) {
+    *proto.add_summaries() = std::move(pass_summary);
+  }
+  return proto;
+}
+
+void Stats::CompilationReport() {
+  CHECK(running_.empty()) << "EndPass never called for "
+                          << runs_[running_.back().index].pass_name();
+  CompilationStatsProto proto = ToProto();
+  double total_duration = 0;
+  for (const CompilationStatsProto::PassRun& run : proto.runs()) {
+    if (!run.is_pipeline()) {
+      total_duration +=
+          (run.end_timestamp_usec() - run.start_timestamp_usec()) / 1000.0;
+    }
+  }
   LOG(INFO) << "Total runtime (ms) of HLO passes: " << total_duration;
-  LOG(INFO) << "Pass name, num runs, time (ms)";
-  for (auto& pass_info : sorted_summary) {
-    LOG(INFO) << pass_info.name << ", " << pass_info.num_runs << ", "
-              << pass_info.duration_ms;
+  LOG(INFO) << "Pass name, num runs, time (ms), instruction count delta, "
+               "max peak RSS delta (bytes)";
+  for (const CompilationStatsProto::PassSummary& pass_summary :
+       proto.summaries()) {
+    if (pass_summary.is_pipeline()) {
+      continue;
+    }
+    LOG(INFO) << pass_summary.pass_name() << ", " << pass_summary.num_runs()
+              << ", " << pass_summary.total_duration_usec() / 1000.0 << ", "
+              << pass_summary.instruction_count_delta() << ", "
+              << pass_summary.max_peak_rss_delta_bytes();
   }
 }
 
-int Stats::GetPassesSize() { return passes_.size(); }
+int Stats::GetPassesSize() {
+  return absl::c_count_if(runs_, [](const CompilationStatsProto::PassRun& run) {
+    return !run.is_pipeline();
+  });
+}
+
+StatusOr<std::string> CompilationStatsToJson(
+    const CompilationStatsProto& stats) {
+  std::string json;
+  tsl::protobuf::util::JsonPrintOptions json_options;
+  json_options.add_whitespace = true;
+  json_options.always_print_primitive_fields = true;
+  auto status =
+      tsl::protobuf::util::MessageToJsonString(stats, &json, json_options);
+  if (!status.ok()) {
+    return InternalError("MessageToJsonString failed: %s",
+                         std::string{status.message()});
+  }
+  return json;
+}
+
+std::string CompilationStatsToTraceJson(const CompilationStatsProto& stats) {
+  // Complete ("X") events on a single track; nesting follows from the
+  // timestamps.
+  std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (int i = 0; i < stats.runs_size(); ++i) {
+    const CompilationStatsProto::PassRun& run = stats.runs(i);
+    absl::StrAppendFormat(
+        &json,
+        "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":0,"
+        "\"tid\":0,\"ts\":%d,\"dur\":%d,\"args\":{\"pipeline\":\"%s\","
+        "\"instruction_count_before\":%d,\"instruction_count_after\":%d,"
+        "\"peak_rss_delta_bytes\":%d,\"iterations\":%d,\"changed\":%s}}",
+        i == 0 ? "" : ",", JsonEscape(run.pass_name()),
+        run.is_pipeline() ? "pipeline" : "pass", run.start_timestamp_usec(),
+        run.end_timestamp_usec() - run.start_timestamp_usec(),
+        JsonEscape(run.pipeline_name()), run.instruction_count_before(),
+        run.instruction_count_after(), run.peak_rss_delta_bytes(),
+        run.iterations(), run.changed() ? "true" : "false");
+  }
+  absl::StrAppend(&json, "\n]}\n");
+  return json;
+}
 
 }  // namespace xla
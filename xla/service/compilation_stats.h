@@ -16,18 +16,26 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_COMPILATION_STATS_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_COMPILATION_STATS_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
 
 #include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "xla/service/hlo.pb.h"
+#include "xla/statusor.h"
 
 namespace xla {
 
 // This class is used to collect information about HLO passes and print some
 // statistics at the end of compilation. From HloPassPipeline, we call StartPass
-// before the execution of a pass, and EndPass after. Currently, we only collect
-// timing information and how many times each pass was run. In the future, we
-// can add more things, such as the size of the HLO graph after each pass.
+// before the execution of a pass, and EndPass after. For each run of a pass we
+// collect its wall time, the instruction count of the module before and after,
+// and how much the peak resident set size of the process grew.
+//
+// Runs may nest: a pipeline run by another pipeline is itself reported as a
+// pass enclosing the passes it runs, and all of them are reported to the stats
+// of the outermost pipeline.
 class CompilationStats {
  public:
   virtual ~CompilationStats() = default;
@@ -36,15 +44,34 @@ class CompilationStats {
 
   static std::unique_ptr<CompilationStats> MakeStats();
 
-  virtual void StartPass(absl::string_view pass_name) = 0;
+  // Called before running `pass_name` as part of `pipeline_name` on HLO with
+  // `instruction_count` instructions.
+  virtual void StartPass(absl::string_view pass_name,
+                         absl::string_view pipeline_name, bool is_pipeline,
+                         int64_t instruction_count) = 0;
 
-  virtual void EndPass(absl::string_view pass_name) = 0;
+  // Called after the most recently started pass finished. `iterations` is the
+  // number of fixed-point iterations of an HloPassFix pass, zero otherwise.
+  virtual void EndPass(absl::string_view pass_name, bool changed,
+                       int64_t instruction_count, int64_t iterations) = 0;
 
   virtual void CompilationReport() = 0;
 
+  // Returns the number of pass runs recorded, not counting nested pipelines.
   virtual int GetPassesSize() = 0;
+
+  // Returns all recorded runs together with a per-pass summary.
+  virtual CompilationStatsProto ToProto() const = 0;
 };
 
+// Renders `stats` as JSON.
+StatusOr<std::string> CompilationStatsToJson(
+    const CompilationStatsProto& stats);
+
+// Renders `stats` in the Chrome trace event format, which can be opened in
+// Perfetto (ui.perfetto.dev) or chrome://tracing.
+std::string CompilationStatsToTraceJson(const CompilationStatsProto& stats);
+
 }  // namespace xla
 
 #endif  // TENSORFLOW_COMPILER_XLA_SERVICE_COMPILATION_STATS_H_
@@ -113,6 +113,7 @@ limitations under the License.
 #include "xla/service/cpu/conv_canonicalization.h"
 #include "xla/service/cpu/cpu_executable.h"
 #include "xla/service/cpu/cpu_instruction_fusion.h"
+#include "xla/service/cpu/cpu_latency_estimator.h"
 #include "xla/service/cpu/cpu_layout_assignment.h"
 #include "xla/service/cpu/cpu_options.h"
 #include "xla/service/cpu/cpu_shape_verifier.h"
@@ -144,6 +145,7 @@ limitations under the License.
 #include "xla/service/hlo_pass_pipeline.h"
 #include "xla/service/hlo_verifier.h"
 #include "xla/service/indexed_array_analysis.h"
+#include "xla/service/latency_hiding_scheduler.h"
 #include "xla/service/llvm_compiler.h"
 #include "xla/service/llvm_ir/llvm_command_line_options.h"
 #include "xla/service/llvm_ir/llvm_util.h"
@@ -182,8 +184,10 @@ limitations under the License.
 #include "xla/translate/hlo_to_mhlo/hlo_to_mlir_hlo.h"
 #include "xla/util.h"
 #include "xla/xla_data.pb.h"
+#include "tsl/platform/env.h"
 #include "tsl/platform/errors.h"
 #include "tsl/platform/status.h"
+#include "tsl/platform/threadpool.h"
 #include "tsl/protobuf/error_codes.pb.h"
 
 namespace {
@@ -648,7 +652,8 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
 
   // Run the following passes to a fixed point.
   [&pipeline =
-       pipeline.AddPass<HloPassFix<HloPassPipeline>>("simplification")] {
+       pipeline.AddPass<HloPassFix<HloPassPipeline>>("simplification"),
+   module] {
     AddHloVerifier(&pipeline, HloVerifierOpts{}, /*debug_only=*/true);
 
     AlgebraicSimplifierOptions options;
@@ -656,6 +661,9 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
     // TODO(b/209827141): XLA:CPU doesn't propagate NaN through min/max, but
     // other platforms do, so it should be changed.
     options.set_minmax_propagate_nan(false);
+    options.set_use_worklist(module->config()
+                                 .debug_options()
+                                 .xla_algebraic_simplifier_use_worklist());
     pipeline.AddPass<AlgebraicSimplifier>(options);
     pipeline.AddPass<SortSimplifier>();
     pipeline.AddPass<HloDCE>();
@@ -687,7 +695,15 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
   // support libcalls. Disable this for now.
   if (!is_mlir_compile) {
     pipeline.AddPass<TopkRewriter>([](const HloSortInstruction* sort, int64_t) {
-      return sort->operand(0)->shape().element_type() == F32;
+      switch (sort->operand(0)->shape().element_type()) {
+        case F32:
+        case BF16:
+        case F16:
+        case S32:
+          return true;
+        default:
+          return false;
+      }
     });
   }
   pipeline.AddPass<IndexedArrayAnalysisPrinterPass>();
@@ -757,7 +773,8 @@ Status CpuCompiler::RunHloPassesAfterLayoutAssn(
   // duplicate or NOPs, so remove them with algebraic simplification and CSE.
   // Run this to a fixed point.
   [&pipeline = pipeline.AddPass<HloPassFix<HloPassPipeline>>(
-       "simplification after layout assignment")] {
+       "simplification after layout assignment"),
+   module] {
     AddHloVerifier(
         &pipeline,
         HloVerifierOpts{}.MakeLayoutSensitive().WithInstructionCanChangeLayout(
@@ -769,6 +786,9 @@ Status CpuCompiler::RunHloPassesAfterLayoutAssn(
     // TODO(b/209827141): XLA:CPU doesn't propagate NaN through min/max, but
     // other platforms do, so it should be changed.
     options.set_minmax_propagate_nan(false);
+    options.set_use_worklist(module->config()
+                                 .debug_options()
+                                 .xla_algebraic_simplifier_use_worklist());
     pipeline.AddPass<AlgebraicSimplifier>(options);
     pipeline.AddPass<HloDCE>();
     pipeline.AddPass<HloCSE>(/*is_layout_sensitive=*/true);
@@ -818,6 +838,50 @@ int64_t memory_alignment(LogicalBuffer::Color) {
   return cpu_function_runtime::MinAlign();
 }
 
+// Selects an order for emitting the HLO instructions for each computation.
+// Using this sequence enables tighter buffer liveness analysis and reduced
+// memory usage (as compared to using DependencyHloOrdering). If enabled, the
+// latency-hiding scheduler then moves independent work between the start and
+// done of asynchronous collectives and host transfers.
+StatusOr<HloSchedule> ScheduleCpuModule(
+    HloModule* module, const HloCostAnalysis::ShapeSizeFunction& shape_size,
+    const BufferValue::SizeFunction& buffer_size) {
+  MemorySchedulerAlgorithm memory_scheduler = DFSMemoryScheduler;
+  if (module->config()
+          .debug_options()
+          .xla_cpu_enable_peak_memory_reordering()) {
+    PeakMemoryReorderingOptions options;
+    options.base_scheduler = DFSMemoryScheduler;
+    memory_scheduler = PeakMemoryReorderingScheduler(options);
+  }
+  TF_ASSIGN_OR_RETURN(
+      HloSchedule schedule,
+      ScheduleModule(module, buffer_size,
+                     ComputationSchedulerToModuleScheduler(memory_scheduler)));
+  if (!module->config()
+           .debug_options()
+           .xla_cpu_enable_latency_hiding_scheduler()) {
+    return schedule;
+  }
+
+  TF_RETURN_IF_ERROR(module->set_schedule(std::move(schedule)));
+  SchedulerConfig config;
+  auto latency_estimator = std::make_unique<CpuLatencyEstimator>(
+      CpuLatencyEstimator::CalibrationFromDebugOptions(
+          module->config().debug_options()),
+      shape_size, *module);
+  auto async_tracker = std::make_unique<AsyncTracker>(config);
+  auto scheduler_core = std::make_unique<DefaultSchedulerCore>(
+      shape_size, async_tracker.get(), latency_estimator.get(), config);
+  TF_RETURN_IF_ERROR(
+      LatencyHidingScheduler(std::move(latency_estimator),
+                             std::move(async_tracker),
+                             std::move(scheduler_core), shape_size)
+          .Run(module)
+          .status());
+  return module->schedule();
+}
+
 llvm::TargetOptions CompilerTargetOptions(
     const HloModuleConfig& module_config) {
   llvm::TargetOptions target_options;
@@ -1209,13 +1273,9 @@ CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
   const bool embed_ir_in_executable =
       module->config().debug_options().xla_embed_ir_in_executable();
 
-  // Select an order for emitting the HLO instructions for each
-  // computation. Using this sequence enables tighter buffer liveness analysis
-  // and reduced memory usage (as compared to using DependencyHloOrdering).
   TF_ASSIGN_OR_RETURN(HloSchedule schedule,
-                      ScheduleModule(module.get(), BufferSizeBytesFunction(),
-                                     ComputationSchedulerToModuleScheduler(
-                                         DFSMemoryScheduler)));
+                      ScheduleCpuModule(module.get(), ShapeSizeBytesFunction(),
+                                        BufferSizeBytesFunction()));
 
   // Run buffer allocation on the HLO graph.
   TF_ASSIGN_OR_RETURN(
@@ -1313,7 +1373,28 @@ CpuCompiler::CompileLegacyCpuExecutable(std::unique_ptr<HloModule> module) {
   // JIT compile the LLVM IR module to in-memory machine code.
   llvm::orc::ThreadSafeModule thread_safe_module(std::move(llvm_module),
                                                  std::move(llvm_context));
-  cantFail((*jit)->AddModule(std::move(thread_safe_module)));
+  // The IR hooks and dumps see one part of the module at a time when it is
+  // split, so keep it whole if any of them is requested.
+  const int codegen_split_count =
+      DumpingEnabledForHloModule(*module) || user_pre_optimization_hook_ ||
+              user_post_optimization_hook_
+          ? 1
+          : module->config()
+                .debug_options()
+                .xla_cpu_parallel_codegen_split_count();
+  if (codegen_split_count > 1) {
+    XLA_SCOPED_LOGGING_TIMER("CpuCompiler - Parallel LLVM codegen");
+    tsl::thread::ThreadPool thread_pool(tsl::Env::Default(), "xla_cpu_codegen",
+                                        codegen_split_count);
+    if (llvm::Error err = (*jit)->AddModuleSplit(std::move(thread_safe_module),
+                                                 codegen_split_count,
+                                                 &thread_pool)) {
+      return InternalError("Compiling the LLVM module failed: %s",
+                           llvm::toString(std::move(err)));
+    }
+  } else {
+    cantFail((*jit)->AddModule(std::move(thread_safe_module)));
+  }
 
   auto cpu_executable = std::make_unique<CpuExecutable>(
       std::move(*jit), std::move(assignment), std::move(module), function_name,
@@ -1358,14 +1439,10 @@ StatusOr<std::unique_ptr<XlaRuntimeCpuExecutable>> GetXlaRuntimeCpuExecutable(
 StatusOr<std::unique_ptr<CpuExecutable>>
 CpuCompiler::CompileXlaRuntimeCpuExecutable(
     std::unique_ptr<HloModule> hlo_module) {
-  // Select an order for emitting the HLO instructions for each
-  // computation. Using this sequence enables tighter buffer liveness analysis
-  // and reduced memory usage (as compared to using DependencyHloOrdering).
   TF_ASSIGN_OR_RETURN(
       HloSchedule schedule,
-      ScheduleModule(
-          hlo_module.get(), BufferSizeBytesFunction(),
-          ComputationSchedulerToModuleScheduler(DFSMemoryScheduler)));
+      ScheduleCpuModule(hlo_module.get(), ShapeSizeBytesFunction(),
+                        BufferSizeBytesFunction()));
 
   // Run buffer allocation on the HLO graph.
   TF_ASSIGN_OR_RETURN(
@@ -660,5 +660,10 @@ int64_t CpuExecutable::SizeOfGeneratedCodeInBytes() const {
   return jit_->SizeOfGeneratedCodeInBytes();
 }
 
+int64_t CpuExecutable::NumGeneratedObjects() const {
+  if (IsXlaRuntime()) return 0;
+  return jit_->NumGeneratedObjects();
+}
+
 }  // namespace cpu
 }  // namespace xla
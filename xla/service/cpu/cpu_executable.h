@@ -199,6 +199,9 @@ class CpuExecutable : public Executable {
 
   int64_t SizeOfGeneratedCodeInBytes() const override;
 
+  // Number of object files the JIT has loaded for this executable.
+  int64_t NumGeneratedObjects() const;
+
   StatusOr<std::string_view> GetObjFile() const {
     if (!IsXlaRuntime()) return InternalError("Not an XLA Runtime executable");
     return xla_runtime_executable_->GetObjFile();
@@ -0,0 +1,130 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/cpu_latency_estimator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/shape_util.h"
+#include "xla/status.h"
+#include "tsl/platform/logging.h"
+
+namespace xla {
+namespace cpu {
+
+namespace {
+
+constexpr double kMicrosecondsPerSecond = 1e6;
+
+bool IsAsyncPair(const HloInstruction& start, const HloInstruction& done) {
+  if (done.operand_count() != 1 || done.operand(0) != &start) {
+    return false;
+  }
+  switch (start.opcode()) {
+    case HloOpcode::kAllGatherStart:
+    case HloOpcode::kAllReduceStart:
+    case HloOpcode::kAsyncStart:
+    case HloOpcode::kCollectivePermuteStart:
+    case HloOpcode::kCopyStart:
+    case HloOpcode::kRecv:
+    case HloOpcode::kSend:
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+CpuLatencyEstimator::CpuLatencyEstimator(
+    const Calibration& calibration,
+    HloCostAnalysis::ShapeSizeFunction shape_size, const HloModule& module)
+    : calibration_(calibration),
+      shape_size_(std::move(shape_size)),
+      cost_analysis_(shape_size_) {
+  for (const HloComputation* computation : module.MakeNonfusionComputations()) {
+    Status status = computation->Accept(&cost_analysis_);
+    if (!status.ok()) {
+      VLOG(1) << "Cost analysis of " << computation->name()
+              << " failed: " << status;
+    }
+  }
+}
+
+/*static*/ CpuLatencyEstimator::Calibration
+CpuLatencyEstimator::CalibrationFromDebugOptions(
+    const DebugOptions& debug_options) {
+  Calibration calibration;
+  if (debug_options.xla_cpu_latency_estimator_flops_per_second() > 0) {
+    calibration.flops_per_second =
+        debug_options.xla_cpu_latency_estimator_flops_per_second();
+  }
+  if (debug_options.xla_cpu_latency_estimator_bytes_per_second() > 0) {
+    calibration.bytes_per_second =
+        debug_options.xla_cpu_latency_estimator_bytes_per_second();
+    calibration.collective_bytes_per_second = calibration.bytes_per_second;
+  }
+  if (debug_options.xla_cpu_latency_estimator_collective_latency_ns() > 0) {
+    calibration.collective_latency_seconds =
+        debug_options.xla_cpu_latency_estimator_collective_latency_ns() * 1e-9;
+  }
+  return calibration;
+}
+
+LatencyEstimator::TimeCost CpuLatencyEstimator::GetLatencyBetween(
+    const HloGraphNode& from, const HloGraphNode& target) const {
+  const HloInstruction& start = from.GetInstr();
+  const HloInstruction& done = target.GetInstr();
+  // Every other pair of instructions is synchronous.
+  if (!IsAsyncPair(start, done)) {
+    return 0;
+  }
+  // Sends transfer their operand and receives their result.
+  int64_t bytes = ArrayBytes(done.shape());
+  for (const HloInstruction* operand : start.operands()) {
+    bytes = std::max(bytes, ArrayBytes(operand->shape()));
+  }
+  return kMicrosecondsPerSecond *
+         (calibration_.collective_latency_seconds +
+          bytes / calibration_.collective_bytes_per_second);
+}
+
+LatencyEstimator::TimeCost CpuLatencyEstimator::NodeCost(
+    const HloInstruction* instr) const {
+  const double flops = cost_analysis_.flop_count(*instr) +
+                       cost_analysis_.transcendental_count(*instr);
+  const double bytes = cost_analysis_.bytes_accessed(*instr);
+  return kMicrosecondsPerSecond *
+         std::max(flops / calibration_.flops_per_second,
+                  bytes / calibration_.bytes_per_second);
+}
+
+int64_t CpuLatencyEstimator::ArrayBytes(const Shape& shape) const {
+  int64_t bytes = 0;
+  ShapeUtil::ForEachSubshape(
+      shape, [&](const Shape& subshape, const ShapeIndex& /*index*/) {
+        if (subshape.IsArray()) {
+          bytes += shape_size_(subshape);
+        }
+      });
+  return bytes;
+}
+
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,79 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_LATENCY_ESTIMATOR_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_LATENCY_ESTIMATOR_H_
+
+#include <cstdint>
+
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/hlo_cost_analysis.h"
+#include "xla/service/latency_hiding_scheduler.h"
+#include "xla/shape.h"
+#include "xla/xla.pb.h"
+
+namespace xla {
+namespace cpu {
+
+// LatencyEstimator for the CPU backend. Costs are in microseconds and are
+// derived from a Calibration: a kernel costs the larger of its compute and
+// memory time according to an HloCostAnalysis of the module run once at
+// construction, and an asynchronous collective or host transfer costs a fixed
+// latency plus its bytes over the collective bandwidth.
+class CpuLatencyEstimator : public LatencyEstimator {
+ public:
+  struct Calibration {
+    // Sustained single-core arithmetic and memory throughput.
+    double flops_per_second = 1e10;
+    double bytes_per_second = 1e10;
+    // Fixed cost of starting a collective, i.e. of handing work to and
+    // synchronizing with another thread, and the rate at which it moves data.
+    double collective_latency_seconds = 1e-5;
+    double collective_bytes_per_second = 1e10;
+  };
+
+  // Analyzes the non-fusion computations of `module`. Instructions added to
+  // the module afterwards, or which the analysis does not support, cost 0.
+  CpuLatencyEstimator(const Calibration& calibration,
+                      HloCostAnalysis::ShapeSizeFunction shape_size,
+                      const HloModule& module);
+
+  // The default Calibration with the rates set in `debug_options` applied.
+  // The rates are fixed rather than measured so that the schedule, and hence
+  // the compiled executable, does not depend on the load of the host. The
+  // collective bandwidth follows the memory bandwidth.
+  static Calibration CalibrationFromDebugOptions(
+      const DebugOptions& debug_options);
+
+  TimeCost GetLatencyBetween(const HloGraphNode& from,
+                             const HloGraphNode& target) const override;
+  TimeCost NodeCost(const HloInstruction* instr) const override;
+
+  const Calibration& calibration() const { return calibration_; }
+
+ private:
+  // Total size of the array subshapes of `shape`.
+  int64_t ArrayBytes(const Shape& shape) const;
+
+  const Calibration calibration_;
+  const HloCostAnalysis::ShapeSizeFunction shape_size_;
+  HloCostAnalysis cost_analysis_;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_LATENCY_ESTIMATOR_H_
@@ -0,0 +1,151 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/cpu/cpu_latency_estimator.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/service/latency_hiding_scheduler.h"
+#include "xla/shape_util.h"
+#include "xla/tests/hlo_test_base.h"
+#include "xla/xla.pb.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+int64_t ShapeSizeBytes(const Shape& shape) {
+  return ShapeUtil::ByteSizeOf(shape, /*pointer_size=*/8);
+}
+
+// One GFLOP/s and one GB/s make the expected costs easy to derive.
+CpuLatencyEstimator::Calibration TestCalibration() {
+  CpuLatencyEstimator::Calibration calibration;
+  calibration.flops_per_second = 1e9;
+  calibration.bytes_per_second = 1e9;
+  calibration.collective_latency_seconds = 1e-5;
+  calibration.collective_bytes_per_second = 1e9;
+  return calibration;
+}
+
+int64_t Position(absl::Span<HloInstruction* const> sequence,
+                 absl::string_view name) {
+  return absl::c_find_if(sequence,
+                         [&](const HloInstruction* instruction) {
+                           return instruction->name() == name;
+                         }) -
+         sequence.begin();
+}
+
+using CpuLatencyEstimatorTest = HloTestBase;
+
+constexpr char kAllReduceModule[] = R"(
+HloModule m, is_scheduled=true
+
+add {
+  x = f32[] parameter(0)
+  y = f32[] parameter(1)
+  ROOT add = f32[] add(x, y)
+}
+
+ENTRY e {
+  p0 = f32[1024]{0} parameter(0)
+  p1 = f32[256,256]{1,0} parameter(1)
+  ar-start = f32[1024]{0} all-reduce-start(p0), replica_groups={}, to_apply=add
+  ar-done = f32[1024]{0} all-reduce-done(ar-start)
+  dot = f32[256,256]{1,0} dot(p1, p1), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  sum = f32[256,256]{1,0} add(dot, p1)
+  ROOT t = (f32[1024]{0}, f32[256,256]{1,0}) tuple(ar-done, sum)
+}
+)";
+
+TEST_F(CpuLatencyEstimatorTest, CostsFollowCalibration) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kAllReduceModule));
+  CpuLatencyEstimator estimator(TestCalibration(), ShapeSizeBytes, *module);
+  HloComputation* entry = module->entry_computation();
+
+  // An elementwise add is bound by its 3 * 256KiB of memory traffic.
+  EXPECT_NEAR(estimator.NodeCost(entry->GetInstructionWithName("sum")),
+              3 * 256 * 256 * 4 / 1e3, 1e-6);
+  // A dot is bound by its arithmetic.
+  EXPECT_GT(estimator.NodeCost(entry->GetInstructionWithName("dot")),
+            2 * 256 * 256 * 256 / 1e3 - 1e-6);
+
+  // Only async pairs have a latency: the fixed 10us plus 4KiB at 1GB/s.
+  HloGraphNode start(entry->GetInstructionWithName("ar-start"), 0);
+  HloGraphNode done(entry->GetInstructionWithName("ar-done"), 1);
+  HloGraphNode dot(entry->GetInstructionWithName("dot"), 2);
+  HloGraphNode sum(entry->GetInstructionWithName("sum"), 3);
+  EXPECT_NEAR(estimator.GetLatencyBetween(start, done), 10 + 4.096, 1e-6);
+  EXPECT_EQ(estimator.GetLatencyBetween(dot, sum), 0);
+  EXPECT_EQ(estimator.GetLatencyBetween(start, dot), 0);
+}
+
+TEST_F(CpuLatencyEstimatorTest, SchedulerOverlapsAllReduceWithDot) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kAllReduceModule));
+  SchedulerConfig config;
+  auto latency_estimator = std::make_unique<CpuLatencyEstimator>(
+      TestCalibration(), ShapeSizeBytes, *module);
+  auto async_tracker = std::make_unique<AsyncTracker>(config);
+  auto scheduler_core = std::make_unique<DefaultSchedulerCore>(
+      ShapeSizeBytes, async_tracker.get(), latency_estimator.get(), config);
+  TF_ASSERT_OK_AND_ASSIGN(
+      bool changed,
+      LatencyHidingScheduler(std::move(latency_estimator),
+                             std::move(async_tracker),
+                             std::move(scheduler_core), ShapeSizeBytes)
+          .Run(module.get()));
+  EXPECT_TRUE(changed);
+
+  const std::vector<HloInstruction*>& sequence =
+      module->schedule().sequence(module->entry_computation()).instructions();
+  EXPECT_LT(Position(sequence, "ar-start"), Position(sequence, "dot"));
+  EXPECT_LT(Position(sequence, "dot"), Position(sequence, "ar-done"));
+}
+
+TEST(CpuLatencyEstimatorCalibrationTest, CalibrationFromDebugOptions) {
+  DebugOptions debug_options;
+  const CpuLatencyEstimator::Calibration defaults;
+  CpuLatencyEstimator::Calibration calibration =
+      CpuLatencyEstimator::CalibrationFromDebugOptions(debug_options);
+  EXPECT_EQ(calibration.flops_per_second, defaults.flops_per_second);
+  EXPECT_EQ(calibration.bytes_per_second, defaults.bytes_per_second);
+  EXPECT_EQ(calibration.collective_latency_seconds,
+            defaults.collective_latency_seconds);
+  EXPECT_EQ(calibration.collective_bytes_per_second,
+            defaults.collective_bytes_per_second);
+
+  debug_options.set_xla_cpu_latency_estimator_flops_per_second(2000000000);
+  debug_options.set_xla_cpu_latency_estimator_bytes_per_second(int64_t{3000000000});
+  debug_options.set_xla_cpu_latency_estimator_collective_latency_ns(500);
+  calibration = CpuLatencyEstimator::CalibrationFromDebugOptions(debug_options);
+  EXPECT_EQ(calibration.flops_per_second, 2e9);
+  EXPECT_EQ(calibration.bytes_per_second, 3e9);
+  EXPECT_DOUBLE_EQ(calibration.collective_latency_seconds, 500e-9);
+  EXPECT_EQ(calibration.collective_bytes_per_second, 3e9);
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "xla/service/cpu/cpu_runtime.h"
 
+#include <algorithm>
+#include <atomic>
 #include <complex>
 #include <cstdarg>
 #include <cstddef>
@@ -34,6 +36,7 @@ limitations under the License.
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "xla/executable_run_options.h"
 #include "xla/layout_util.h"
 #include "xla/primitive_util.h"
@@ -143,7 +146,11 @@ extern const char* const kStatusIsSuccessSymbolName =
     "__xla_cpu_runtime_StatusIsSuccess";
 extern const char* const kKeyValueSortSymbolName =
     "__xla_cpu_runtime_KeyValueSort";
+extern const char* const kKeySortSymbolName = "__xla_cpu_runtime_KeySort";
 extern const char* const kTopKF32SymbolName = "__xla_cpu_runtime_TopKF32";
+extern const char* const kTopKBF16SymbolName = "__xla_cpu_runtime_TopKBF16";
+extern const char* const kTopKF16SymbolName = "__xla_cpu_runtime_TopKF16";
+extern const char* const kTopKS32SymbolName = "__xla_cpu_runtime_TopKS32";
 extern const char* const kTracingStartSymbolName =
     "__xla_cpu_runtime_TracingStart";
 extern const char* const kTracingEndSymbolName = "__xla_cpu_runtime_TracingEnd";
@@ -363,6 +370,138 @@ class CpuCollectivePermuteRendezvous
   }
 };
 
+// Elementwise reduction functors used by the all-reduce kernels below. Signed
+// integer sums and products are computed in the corresponding unsigned type so
+// that overflow wraps instead of being undefined behavior.
+template <typename T, bool kIsSignedIntegralType>
+struct SumProductTypeForReductionStep {
+  using type = T;
+};
+
+template <typename T>
+struct SumProductTypeForReductionStep<T, /*kIsSignedIntegralType=*/true> {
+  using type = typename std::make_unsigned_t<T>;
+};
+
+template <typename T>
+using SumProductType = typename SumProductTypeForReductionStep<
+    T, std::is_integral<T>::value && std::is_signed<T>::value>::type;
+
+template <typename T>
+struct SumOp {
+  T operator()(T a, T b) const {
+    using U = SumProductType<T>;
+    return absl::bit_cast<T>(
+        static_cast<U>(absl::bit_cast<U>(a) + absl::bit_cast<U>(b)));
+  }
+};
+
+template <typename T>
+struct ProductOp {
+  T operator()(T a, T b) const {
+    using U = SumProductType<T>;
+    return absl::bit_cast<T>(
+        static_cast<U>(absl::bit_cast<U>(a) * absl::bit_cast<U>(b)));
+  }
+};
+
+template <typename T>
+struct MinOp {
+  T operator()(T a, T b) const { return std::min(a, b); }
+};
+
+template <typename T>
+struct MaxOp {
+  T operator()(T a, T b) const { return std::max(a, b); }
+};
+
+// Reduces elements [offset, offset + size) of every input buffer into the
+// first output buffer and then copies the result into the remaining outputs.
+// The inner loops are simple unit-stride loops over raw pointers so that the
+// compiler vectorizes them for each element type.
+//
+// A participant's input and output buffer may alias (in-place all-reduce), but
+// buffers of different participants never do.
+template <typename T, typename ReductionOp>
+void ReduceChunkWithOp(absl::Span<const T* const> inputs,
+                       absl::Span<T* const> outputs, int64_t offset,
+                       int64_t size, ReductionOp op) {
+  T* acc = outputs[0] + offset;
+  const T* first = inputs[0] + offset;
+  if (inputs.size() == 1) {
+    if (acc != first) {
+      std::memcpy(acc, first, size * sizeof(T));
+    }
+  } else {
+    const T* second = inputs[1] + offset;
+    for (int64_t i = 0; i < size; ++i) {
+      acc[i] = op(first[i], second[i]);
+    }
+    for (size_t p = 2; p < inputs.size(); ++p) {
+      const T* in = inputs[p] + offset;
+      for (int64_t i = 0; i < size; ++i) {
+        acc[i] = op(acc[i], in[i]);
+      }
+    }
+  }
+  for (size_t p = 1; p < outputs.size(); ++p) {
+    std::memcpy(outputs[p] + offset, acc, size * sizeof(T));
+  }
+}
+
+template <typename T>
+void ReduceChunk(ReductionKind reduction_kind,
+                 absl::Span<const T* const> inputs,
+                 absl::Span<T* const> outputs, int64_t offset, int64_t size) {
+  switch (reduction_kind) {
+    case ReductionKind::SUM:
+      return ReduceChunkWithOp<T>(inputs, outputs, offset, size, SumOp<T>());
+    case ReductionKind::PRODUCT:
+      return ReduceChunkWithOp<T>(inputs, outputs, offset, size,
+                                  ProductOp<T>());
+    case ReductionKind::MIN:
+    case ReductionKind::MAX:
+      if constexpr (is_complex<T>::value) {
+        LOG(FATAL) << "min/max not valid for complex types";
+      } else if (reduction_kind == ReductionKind::MIN) {
+        return ReduceChunkWithOp<T>(inputs, outputs, offset, size,
+                                    MinOp<T>());
+      } else {
+        return ReduceChunkWithOp<T>(inputs, outputs, offset, size,
+                                    MaxOp<T>());
+      }
+  }
+}
+
+// Returns the [begin, end) range of a buffer with `element_count` elements that
+// participant `rank` out of `num_participants` is responsible for. Slice
+// boundaries are rounded to `alignment` elements so that participants do not
+// write to the same cache lines of the output buffers.
+std::pair<int64_t, int64_t> SliceForRank(int64_t element_count,
+                                         int64_t num_participants, int64_t rank,
+                                         int64_t alignment) {
+  int64_t num_blocks = (element_count + alignment - 1) / alignment;
+  int64_t begin_block = num_blocks * rank / num_participants;
+  int64_t end_block = num_blocks * (rank + 1) / num_participants;
+  return {std::min(element_count, begin_block * alignment),
+          std::min(element_count, end_block * alignment)};
+}
+
+constexpr int64_t kCacheLineBytes = 64;
+
+std::atomic<int64_t> all_reduce_chunk_size_bytes{
+    kDefaultAllReduceChunkSizeBytes};
+
+// The all-reduce is performed cooperatively by all participants as a fused
+// reduce-scatter + all-gather: each participant reduces a disjoint slice of
+// every buffer across the inputs of all participants and writes the result
+// into the outputs of all participants. The slice is processed in chunks of
+// GetAllReduceChunkSizeBytes() bytes so that the partial result is still in
+// cache when it is broadcast.
+//
+// Rendezvous::SubmitParticipant does not let any participant return before
+// all of them have finished RunCollectiveOp, so the outputs are complete once
+// the all-reduce returns.
 class CpuAllReduceRendezvous
     : public Rendezvous<AllReduceParticipantData, std::nullptr_t> {
  public:
@@ -373,184 +512,137 @@ class CpuAllReduceRendezvous
   StatusOr<std::nullptr_t> RunCollectiveOp(
       const AllReduceParticipantData& participant) override {
     PrimitiveType datatype = participant.buffers.front().primitive_type;
-    bool primary = InitializationBarrier();
-
-    if (primary) {
-      switch (datatype) {
-        case S8:
-          DoAllReduce<S8>(participant);
-          break;
-        case PRED:
-        case U8:
-          DoAllReduce<U8>(participant);
-          break;
-        case S16:
-          DoAllReduce<S16>(participant);
-          break;
-        case U16:
-          DoAllReduce<U16>(participant);
-          break;
-        case S32:
-          DoAllReduce<S32>(participant);
-          break;
-        case U32:
-          DoAllReduce<U32>(participant);
-          break;
-        case S64:
-          DoAllReduce<S64>(participant);
-          break;
-        case U64:
-          DoAllReduce<U64>(participant);
-          break;
-        case F16:
-          DoAllReduce<F16>(participant);
-          break;
-        case F32:
-          DoAllReduce<F32>(participant);
-          break;
-        case F64:
-          DoAllReduce<F64>(participant);
-          break;
-        case C64:
-          DoAllReduce<C64>(participant);
-          break;
-        case C128:
-          DoAllReduce<C128>(participant);
-          break;
-        default:
-          LOG(FATAL) << "Unexpected datatype;";
-      }
+    switch (datatype) {
+      case S8:
+        DoAllReduce<S8>(participant);
+        break;
+      case PRED:
+      case U8:
+        DoAllReduce<U8>(participant);
+        break;
+      case S16:
+        DoAllReduce<S16>(participant);
+        break;
+      case U16:
+        DoAllReduce<U16>(participant);
+        break;
+      case S32:
+        DoAllReduce<S32>(participant);
+        break;
+      case U32:
+        DoAllReduce<U32>(participant);
+        break;
+      case S64:
+        DoAllReduce<S64>(participant);
+        break;
+      case U64:
+        DoAllReduce<U64>(participant);
+        break;
+      case F16:
+        DoAllReduce<F16>(participant);
+        break;
+      case F32:
+        DoAllReduce<F32>(participant);
+        break;
+      case F64:
+        DoAllReduce<F64>(participant);
+        break;
+      case C64:
+        DoAllReduce<C64>(participant);
+        break;
+      case C128:
+        DoAllReduce<C128>(participant);
+        break;
+      default:
+        LOG(FATAL) << "Unexpected datatype;";
     }
     return nullptr;
   }
 
  private:
   template <PrimitiveType PT>
-  void DoAllReduce(AllReduceParticipantData participant) {
+  void DoAllReduce(const AllReduceParticipantData& participant) {
     using T = typename primitive_util::PrimitiveTypeToNative<PT>::type;
-    absl::MutexLock lock(&mu_);
-    CHECK(!participants_.empty());
     ReductionKind reduction_kind = participant.reduction_kind;
-    for (const auto& p : participants_) {
-      CHECK(p.reduction_kind == reduction_kind);
-    }
-    int num_participants = participants_.size();
-
-    // participant_idx -> buffer_idx -> buffer.
-    std::vector<std::vector<absl::Span<T>>> input_buffers;
-    std::vector<std::vector<absl::Span<T>>> output_buffers;
-    input_buffers.reserve(num_participants);
-    output_buffers.reserve(num_participants);
-    const AllReduceParticipantData& first_participant = participants_.front();
-
-    int buffers_per_participant = first_participant.buffers.size();
-    for (AllReduceParticipantData& p : participants_) {
-      CHECK_EQ(p.buffers.size(), buffers_per_participant);
-
-      input_buffers.emplace_back();
-      output_buffers.emplace_back();
-      std::vector<absl::Span<T>>& participant_input_buffers =
-          input_buffers.back();
-      std::vector<absl::Span<T>>& participant_output_buffers =
-          output_buffers.back();
-      participant_input_buffers.reserve(p.buffers.size());
-      participant_output_buffers.reserve(p.buffers.size());
-
-      for (int buffer_idx = 0; buffer_idx < buffers_per_participant;
-           buffer_idx++) {
-        auto& participant_buffer = p.buffers[buffer_idx];
-        participant_input_buffers.emplace_back(
-            static_cast<T*>(participant_buffer.source_data.opaque()),
-            participant_buffer.element_count);
-        participant_output_buffers.emplace_back(
-            static_cast<T*>(participant_buffer.destination_data.opaque()),
-            participant_buffer.element_count);
-        CHECK_EQ(participant_buffer.element_count,
-                 first_participant.buffers[buffer_idx].element_count);
+
+    // buffer_idx -> participant_idx -> buffer data.
+    std::vector<std::vector<const T*>> input_buffers;
+    std::vector<std::vector<T*>> output_buffers;
+    std::vector<int64_t> element_counts;
+    int64_t num_participants;
+    int64_t rank = -1;
+
+    // Participants are only appended before the rendezvous barrier, so after
+    // taking a snapshot of the buffer pointers the reduction itself runs
+    // without holding `mu_`.
+    {
+      absl::MutexLock lock(&mu_);
+      CHECK(!participants_.empty());
+      num_participants = participants_.size();
+      // Participants arrive in any order. Combining their inputs in the order
+      // of their device ordinals makes the result, which depends on the order
+      // for floating point sums and products, reproducible.
+      std::vector<const AllReduceParticipantData*> ordered_participants;
+      ordered_participants.reserve(num_participants);
+      for (const AllReduceParticipantData& p : participants_) {
+        ordered_participants.push_back(&p);
+      }
+      std::sort(ordered_participants.begin(), ordered_participants.end(),
+                [](const AllReduceParticipantData* a,
+                   const AllReduceParticipantData* b) {
+                  return a->device_ordinal < b->device_ordinal;
+                });
+      const AllReduceParticipantData& first_participant =
+          *ordered_participants.front();
+      int buffers_per_participant = first_participant.buffers.size();
+
+      input_buffers.resize(buffers_per_participant);
+      output_buffers.resize(buffers_per_participant);
+      element_counts.reserve(buffers_per_participant);
+      for (const AllReduceParticipantData::Buffer& buffer :
+           first_participant.buffers) {
+        element_counts.push_back(buffer.element_count);
       }
-    }
 
-    for (int buffer_idx = 0; buffer_idx < buffers_per_participant;
-         buffer_idx++) {
-      int element_count = first_participant.buffers[buffer_idx].element_count;
-      for (int idx = 0; idx < element_count; idx++) {
-        T out = GetInitialValue<T>(reduction_kind);
-        for (int participant_idx = 0; participant_idx < participants_.size();
-             participant_idx++) {
-          out = PerformReductionStep<T>(
-              reduction_kind, out,
-              input_buffers[participant_idx][buffer_idx][idx]);
+      for (int64_t participant_idx = 0; participant_idx < num_participants;
+           ++participant_idx) {
+        const AllReduceParticipantData& p =
+            *ordered_participants[participant_idx];
+        CHECK(p.reduction_kind == reduction_kind);
+        CHECK_EQ(p.buffers.size(), buffers_per_participant);
+        if (p.device_ordinal == participant.device_ordinal) {
+          CHECK_EQ(rank, -1) << "Duplicate all-reduce participant: "
+                             << participant.ToString();
+          rank = participant_idx;
         }
-        for (int participant_idx = 0; participant_idx < participants_.size();
-             participant_idx++) {
-          output_buffers[participant_idx][buffer_idx][idx] = out;
+        for (int buffer_idx = 0; buffer_idx < buffers_per_participant;
+             ++buffer_idx) {
+          const AllReduceParticipantData::Buffer& participant_buffer =
+              p.buffers[buffer_idx];
+          CHECK_EQ(participant_buffer.element_count,
+                   element_counts[buffer_idx]);
+          input_buffers[buffer_idx].push_back(
+              static_cast<const T*>(participant_buffer.source_data.opaque()));
+          output_buffers[buffer_idx].push_back(
+              static_cast<T*>(participant_buffer.destination_data.opaque()));
         }
       }
     }
-  }
-
-  template <typename T>
-  T GetInitialValue(ReductionKind reduction_kind) {
-    switch (reduction_kind) {
-      case ReductionKind::SUM:
-        return static_cast<T>(0);
-      case ReductionKind::PRODUCT:
-        return static_cast<T>(1);
-      case ReductionKind::MIN:
-        return std::numeric_limits<T>::max();
-      case ReductionKind::MAX:
-        return std::numeric_limits<T>::min();
-    }
-  }
-
-  template <typename T, bool kIsSignedIntegralType>
-  struct SumProductTypeForReductionStep {
-    using type = T;
-  };
-
-  template <typename T>
-  struct SumProductTypeForReductionStep<T, /*kIsSignedIntegralType=*/true> {
-    using type = typename std::make_unsigned_t<T>;
-  };
-
-  template <typename T,
-            typename std::enable_if<!is_complex<T>::value>::type* = nullptr>
-  T PerformReductionStep(ReductionKind reduction_kind, T a, T b) {
-    using SumProductType = typename SumProductTypeForReductionStep<
-        T, std::is_integral<T>::value && std::is_signed<T>::value>::type;
-    switch (reduction_kind) {
-      case ReductionKind::SUM:
-        return absl::bit_cast<T>(
-            static_cast<SumProductType>(absl::bit_cast<SumProductType>(a) +
-                                        absl::bit_cast<SumProductType>(b)));
-      case ReductionKind::PRODUCT:
-        return absl::bit_cast<T>(
-            static_cast<SumProductType>(absl::bit_cast<SumProductType>(a) *
-                                        absl::bit_cast<SumProductType>(b)));
-      case ReductionKind::MIN:
-        return std::min(a, b);
-      case ReductionKind::MAX:
-        return std::max(a, b);
-    }
-  }
-
-  template <typename T,
-            typename std::enable_if<is_complex<T>::value>::type* = nullptr>
-  T PerformReductionStep(ReductionKind reduction_kind, T a, T b) {
-    using SumProductType = typename SumProductTypeForReductionStep<
-        T, std::is_integral<T>::value && std::is_signed<T>::value>::type;
-    switch (reduction_kind) {
-      case ReductionKind::SUM:
-        return absl::bit_cast<T>(
-            static_cast<SumProductType>(absl::bit_cast<SumProductType>(a) +
-                                        absl::bit_cast<SumProductType>(b)));
-      case ReductionKind::PRODUCT:
-        return absl::bit_cast<T>(
-            static_cast<SumProductType>(absl::bit_cast<SumProductType>(a) *
-                                        absl::bit_cast<SumProductType>(b)));
-      case ReductionKind::MIN:
-      case ReductionKind::MAX:
-        LOG(FATAL) << "min/max not valid for complex types";
+    CHECK_NE(rank, -1) << "All-reduce participant not found: "
+                       << participant.ToString();
+
+    const int64_t chunk_elements =
+        std::max<int64_t>(1, GetAllReduceChunkSizeBytes() / sizeof(T));
+    const int64_t alignment = std::max<int64_t>(1, kCacheLineBytes / sizeof(T));
+
+    for (int buffer_idx = 0; buffer_idx < element_counts.size(); ++buffer_idx) {
+      auto [begin, end] = SliceForRank(element_counts[buffer_idx],
+                                       num_participants, rank, alignment);
+      for (int64_t offset = begin; offset < end; offset += chunk_elements) {
+        ReduceChunk<T>(reduction_kind, input_buffers[buffer_idx],
+                       output_buffers[buffer_idx], offset,
+                       std::min(chunk_elements, end - offset));
+      }
     }
   }
 };
@@ -844,6 +936,17 @@ void CollectivePermuteImpl(const ExecutableRunOptions* run_options,
           .status());
 }
 }  // namespace
+
+void SetAllReduceChunkSizeBytes(int64_t chunk_size_bytes) {
+  CHECK_GT(chunk_size_bytes, 0);
+  all_reduce_chunk_size_bytes.store(chunk_size_bytes,
+                                    std::memory_order_relaxed);
+}
+
+int64_t GetAllReduceChunkSizeBytes() {
+  return all_reduce_chunk_size_bytes.load(std::memory_order_relaxed);
+}
+
 }  // namespace runtime
 }  // namespace cpu
 }  // namespace xla
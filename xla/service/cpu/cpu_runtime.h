@@ -26,6 +26,8 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_RUNTIME_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_RUNTIME_H_
 
+#include <cstdint>
+
 #include "xla/executable_run_options.h"
 #include "xla/service/cpu/xfeed_manager.h"
 
@@ -80,7 +82,11 @@ extern const char* const kParallelForkJoinSymbolName;
 extern const char* const kPrintfToStderrSymbolName;
 extern const char* const kStatusIsSuccessSymbolName;
 extern const char* const kKeyValueSortSymbolName;
+extern const char* const kKeySortSymbolName;
 extern const char* const kTopKF32SymbolName;
+extern const char* const kTopKBF16SymbolName;
+extern const char* const kTopKF16SymbolName;
+extern const char* const kTopKS32SymbolName;
 extern const char* const kAllReduceSymbolName;
 extern const char* const kCollectivePermuteSymbolName;
 extern const char* const kPartitionIdSymbolName;
@@ -97,6 +103,15 @@ extern const char* const kXlaCpuRuntimeSymbolNamePrefix;
 // `device_ordinal`.  Note the device ordinal does not name a CPU
 XfeedManager* GetXfeedManager(int device_ordinal);
 
+// Every participant of an in-process all-reduce reduces its own slice of the
+// buffers. The slice is processed in chunks of this many bytes, which bounds
+// the working set of the partial result that is broadcast to all outputs.
+inline constexpr int64_t kDefaultAllReduceChunkSizeBytes = 64 * 1024;
+
+// Sets the all-reduce chunk size for the whole process. Must be positive.
+void SetAllReduceChunkSizeBytes(int64_t chunk_size_bytes);
+int64_t GetAllReduceChunkSizeBytes();
+
 }  // namespace runtime
 }  // namespace cpu
 }  // namespace xla
@@ -15,24 +15,34 @@ limitations under the License.
 #define EIGEN_USE_THREADS
 #include "xla/service/cpu/cpu_runtime.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <tuple>
+#include <vector>
 
 #include "absl/strings/str_format.h"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "xla/array2d.h"
 #include "xla/client/local_client.h"
+#include "xla/executable_run_options.h"
+#include "xla/service/collective_ops_utils.h"
+#include "xla/service/computation_placer.h"
 #include "xla/service/cpu/runtime_custom_call_status.h"
 #include "xla/service/cpu/runtime_matmul.h"
 #include "xla/service/cpu/runtime_matmul_acl.h"
 #include "xla/service/cpu/runtime_matmul_mkl.h"
 #include "xla/service/cpu/runtime_single_threaded_matmul.h"
 #include "xla/service/custom_call_status_internal.h"
+#include "xla/shape_util.h"
 #include "xla/types.h"
+#include "tsl/platform/blocking_counter.h"
 #include "tsl/platform/env.h"
 #include "tsl/platform/logging.h"
 #include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+#include "tsl/platform/threadpool.h"
 
 namespace xla {
 namespace {
@@ -251,5 +261,136 @@ TEST_F(CpuRuntimeTest, FailureStatus) {
   ASSERT_FALSE(__xla_cpu_runtime_StatusIsSuccess(&success_status));
 }
 
+// Runs `__xla_cpu_runtime_AllReduce` with one thread per replica, the way
+// replicated CPU executables call it, and returns the output of every replica.
+std::vector<std::vector<float>> RunAllReduce(
+    tsl::thread::ThreadPool* pool, ReductionKind reduction_kind,
+    std::vector<std::vector<float>>& inputs, bool in_place) {
+  int num_replicas = inputs.size();
+  int64_t num_elements = inputs.front().size();
+  DeviceAssignment device_assignment(num_replicas, /*computation_count=*/1);
+  for (int i = 0; i < num_replicas; ++i) {
+    device_assignment(i, 0) = i;
+  }
+  std::string replica_groups = "{}";
+  std::string shape =
+      ShapeUtil::MakeShapeWithDescendingLayout(F32, {num_elements})
+          .ToProto()
+          .SerializeAsString();
+  RunId run_id;
+
+  std::vector<std::vector<float>> outputs(num_replicas);
+  tsl::BlockingCounter done(num_replicas);
+  for (int i = 0; i < num_replicas; ++i) {
+    outputs[i].resize(num_elements);
+    pool->Schedule([&, i] {
+      ExecutableRunOptions run_options;
+      run_options.set_device_ordinal(i);
+      run_options.set_device_assignment(&device_assignment);
+      run_options.set_run_id(run_id);
+      void* input_buffer = inputs[i].data();
+      void* output_buffer = in_place ? inputs[i].data() : outputs[i].data();
+      __xla_cpu_runtime_AllReduce(
+          &run_options, replica_groups.data(), replica_groups.size(),
+          /*channel_id_present=*/0, /*use_global_device_ids=*/0,
+          /*op_id=*/0, static_cast<int32_t>(reduction_kind), shape.data(),
+          shape.size(), /*num_buffers=*/1, &input_buffer, &output_buffer);
+      done.DecrementCount();
+    });
+  }
+  done.Wait();
+  if (in_place) {
+    return inputs;
+  }
+  return outputs;
+}
+
+std::vector<std::vector<float>> MakeAllReduceInputs(int num_replicas,
+                                                    int64_t num_elements) {
+  std::vector<std::vector<float>> inputs(num_replicas);
+  for (int i = 0; i < num_replicas; ++i) {
+    inputs[i].resize(num_elements);
+    for (int64_t j = 0; j < num_elements; ++j) {
+      inputs[i][j] = static_cast<float>((i + 1) * (j % 17) - i);
+    }
+  }
+  return inputs;
+}
+
+class CpuAllReduceTest
+    : public ::testing::TestWithParam<std::tuple<int, int64_t, bool>> {};
+
+TEST_P(CpuAllReduceTest, MatchesSerialReduction) {
+  auto [num_replicas, num_elements, in_place] = GetParam();
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "all_reduce_test",
+                               num_replicas);
+  // A small chunk size forces several chunks per participant slice.
+  runtime::SetAllReduceChunkSizeBytes(256);
+
+  for (ReductionKind kind : {ReductionKind::SUM, ReductionKind::PRODUCT,
+                             ReductionKind::MIN, ReductionKind::MAX}) {
+    std::vector<std::vector<float>> inputs =
+        MakeAllReduceInputs(num_replicas, num_elements);
+    std::vector<float> expected = inputs[0];
+    for (int i = 1; i < num_replicas; ++i) {
+      for (int64_t j = 0; j < num_elements; ++j) {
+        switch (kind) {
+          case ReductionKind::SUM:
+            expected[j] += inputs[i][j];
+            break;
+          case ReductionKind::PRODUCT:
+            expected[j] *= inputs[i][j];
+            break;
+          case ReductionKind::MIN:
+            expected[j] = std::min(expected[j], inputs[i][j]);
+            break;
+          case ReductionKind::MAX:
+            expected[j] = std::max(expected[j], inputs[i][j]);
+            break;
+        }
+      }
+    }
+    // Participants are combined in the order of their device ordinals, which
+    // here are the replica ids, so even the inexact products must match.
+    std::vector<std::vector<float>> outputs =
+        RunAllReduce(&pool, kind, inputs, in_place);
+    for (int i = 0; i < num_replicas; ++i) {
+      EXPECT_EQ(outputs[i], expected)
+          << "replica " << i << ", kind " << static_cast<int>(kind);
+    }
+  }
+  runtime::SetAllReduceChunkSizeBytes(runtime::kDefaultAllReduceChunkSizeBytes);
+}
+
+INSTANTIATE_TEST_SUITE_P(CpuAllReduceTestInstantiation, CpuAllReduceTest,
+                         ::testing::Combine(::testing::Values(1, 2, 3, 8),
+                                            ::testing::Values(1, 15, 1000,
+                                                              4099),
+                                            ::testing::Bool()));
+
+void BM_AllReduce(::testing::benchmark::State& state) {
+  const int num_replicas = state.range(0);
+  const int64_t num_elements = state.range(1);
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "all_reduce_benchmark",
+                               num_replicas);
+  std::vector<std::vector<float>> inputs =
+      MakeAllReduceInputs(num_replicas, num_elements);
+  for (auto s : state) {
+    RunAllReduce(&pool, ReductionKind::SUM, inputs, /*in_place=*/true);
+  }
+  state.SetBytesProcessed(state.iterations() * num_replicas * num_elements *
+                          sizeof(float));
+}
+BENCHMARK(BM_AllReduce)
+    ->ArgPair(2, 1 << 10)
+    ->ArgPair(2, 1 << 20)
+    ->ArgPair(8, 1 << 10)
+    ->ArgPair(8, 1 << 16)
+    ->ArgPair(8, 1 << 20)
+    ->ArgPair(8, 1 << 24)
+    ->ArgPair(32, 1 << 16)
+    ->ArgPair(32, 1 << 20)
+    ->ArgPair(32, 1 << 22);
+
 }  // namespace
 }  // namespace xla
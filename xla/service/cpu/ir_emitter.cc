@@ -24,6 +24,7 @@ limitations under the License.
 #include <map>
 #include <memory>
 #include <numeric>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -63,6 +64,7 @@ limitations under the License.
 #include "xla/service/cpu/ir_emission_utils.h"
 #include "xla/service/cpu/ir_function.h"
 #include "xla/service/cpu/parallel_loop_emitter.h"
+#include "xla/service/cpu/runtime_key_value_sort.h"
 #include "xla/service/elemental_ir_emitter.h"
 #include "xla/service/llvm_ir/buffer_assignment_util.h"
 #include "xla/service/llvm_ir/dynamic_update_slice_util.h"
@@ -555,6 +557,82 @@ Status IrEmitter::HandleOutfeed(HloInstruction* outfeed) {
   return OkStatus();
 }
 
+namespace {
+
+// Parameters of a sort that can be lowered to __xla_cpu_runtime_KeySort.
+struct KeySortParams {
+  SortKeyKind kind;
+  bool descending;
+};
+
+// Returns the KeySort parameters if `sort` sorts a single array of primitive
+// type with a comparator that is just a LT or GT comparison of its two
+// parameters, and std::nullopt otherwise.
+std::optional<KeySortParams> MatchKeySort(const HloSortInstruction* sort) {
+  if (sort->operand_count() != 1) {
+    return std::nullopt;
+  }
+  PrimitiveType type = sort->keys()->shape().element_type();
+  std::optional<SortKeyKind> kind;
+  switch (type) {
+    case PRED:
+    case U8:
+    case U16:
+    case U32:
+    case U64:
+      kind = SortKeyKind::kUnsigned;
+      break;
+    case S8:
+    case S16:
+    case S32:
+    case S64:
+      kind = SortKeyKind::kSigned;
+      break;
+    case F16:
+    case BF16:
+    case F32:
+    case F64:
+      break;
+    default:
+      return std::nullopt;
+  }
+
+  const HloInstruction* root = sort->to_apply()->root_instruction();
+  if (root->opcode() != HloOpcode::kCompare ||
+      root->operand(0)->opcode() != HloOpcode::kParameter ||
+      root->operand(1)->opcode() != HloOpcode::kParameter) {
+    return std::nullopt;
+  }
+  int64_t lhs_parameter = root->operand(0)->parameter_number();
+  int64_t rhs_parameter = root->operand(1)->parameter_number();
+  if (lhs_parameter == rhs_parameter) {
+    return std::nullopt;
+  }
+  bool descending;
+  switch (root->comparison_direction()) {
+    case ComparisonDirection::kLt:
+      descending = false;
+      break;
+    case ComparisonDirection::kGt:
+      descending = true;
+      break;
+    default:
+      return std::nullopt;
+  }
+  // compare(p1, p0), direction=LT sorts in descending order.
+  if (lhs_parameter == 1) {
+    descending = !descending;
+  }
+  if (!kind.has_value()) {
+    kind = root->comparison_order() == ComparisonOrder::kTotal
+               ? SortKeyKind::kFloatTotalOrder
+               : SortKeyKind::kFloatPartialOrder;
+  }
+  return KeySortParams{*kind, descending};
+}
+
+}  // namespace
+
 Status IrEmitter::HandleSort(HloInstruction* hlo) {
   const HloSortInstruction* sort = Cast<HloSortInstruction>(hlo);
   TF_RETURN_IF_ERROR(EmitTargetAddressForOp(sort));
@@ -614,6 +692,21 @@ Status IrEmitter::HandleSort(HloInstruction* hlo) {
     lower_dimensions *= normalized_keys_shape.dimensions(i);
   }
 
+  // Single-operand sorts with a trivial comparator do not need to call back
+  // into the emitted comparator.
+  if (std::optional<KeySortParams> key_sort = MatchKeySort(sort)) {
+    EmitCallToFunc(
+        runtime::kKeySortSymbolName,
+        {b_.getInt64(higher_dimensions), b_.getInt64(sort_dimension_elements),
+         b_.getInt64(lower_dimensions),
+         PointerCast(destination_addresses[0], b_.getInt8PtrTy()),
+         b_.getInt32(ShapeUtil::ByteSizeOfPrimitiveType(keys_type)),
+         b_.getInt32(static_cast<int32_t>(key_sort->kind)),
+         b_.getInt1(key_sort->descending), GetExecutableRunOptionsArgument()},
+        b_.getVoidTy());
+    return OkStatus();
+  }
+
   CHECK(absl::c_binary_search(thread_local_computations_, sort->to_apply()));
   llvm::Value* values = llvm_ir::EmitAllocaAtFunctionEntryWithCount(
       b_.getInt8PtrTy(), b_.getInt32(sort->operand_count()), "cc_values_alloca",
@@ -2394,7 +2487,6 @@ Status IrEmitter::HandleTopK(HloInstruction* hlo) {
   const HloInstruction* input = hlo->operand(0);
   const int64_t k = hlo->shape().tuple_shapes(0).dimensions().back();
   const bool has_batch = hlo->shape().tuple_shapes(0).dimensions_size() == 2;
-  TF_RET_CHECK(input->shape().element_type() == F32);
   TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(
       hlo->shape().tuple_shapes(0).layout()));
   TF_RET_CHECK(LayoutUtil::IsMonotonicWithDim0Major(
@@ -2414,12 +2506,37 @@ Status IrEmitter::HandleTopK(HloInstruction* hlo) {
       EmitBufferPointer(out_values_slice, hlo->shape().tuple_shapes(0));
   llvm::Value* out_indices_ptr =
       EmitBufferPointer(out_indices_slice, hlo->shape().tuple_shapes(1));
+
+  const char* symbol_name;
+  llvm::Type* element_type;
+  switch (input->shape().element_type()) {
+    case F32:
+      symbol_name = runtime::kTopKF32SymbolName;
+      element_type = b_.getFloatTy();
+      break;
+    case BF16:
+      symbol_name = runtime::kTopKBF16SymbolName;
+      element_type = b_.getInt16Ty();
+      break;
+    case F16:
+      symbol_name = runtime::kTopKF16SymbolName;
+      element_type = b_.getHalfTy();
+      break;
+    case S32:
+      symbol_name = runtime::kTopKS32SymbolName;
+      element_type = b_.getInt32Ty();
+      break;
+    default:
+      return Unimplemented("TopK is not supported for element type %s",
+                           PrimitiveType_Name(input->shape().element_type()));
+  }
   EmitCallToFunc(
-      runtime::kTopKF32SymbolName,
-      {b_.getInt64(has_batch ? input->shape().dimensions(0) : 1),
+      symbol_name,
+      {GetExecutableRunOptionsArgument(),
+       b_.getInt64(has_batch ? input->shape().dimensions(0) : 1),
        b_.getInt64(input->shape().dimensions().back()), b_.getInt64(k),
-       BitCast(values_ptr, b_.getFloatTy()->getPointerTo()),
-       BitCast(out_values_ptr, b_.getFloatTy()->getPointerTo()),
+       BitCast(values_ptr, element_type->getPointerTo()),
+       BitCast(out_values_ptr, element_type->getPointerTo()),
        BitCast(out_indices_ptr, b_.getInt32Ty()->getPointerTo())},
       b_.getVoidTy());
 
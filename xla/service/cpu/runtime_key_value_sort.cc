@@ -14,14 +14,246 @@ limitations under the License.
 ==============================================================================*/
 #include "xla/service/cpu/runtime_key_value_sort.h"
 
+#define EIGEN_USE_THREADS
+
 #include <algorithm>
+#include <array>
+#include <cmath>
 #include <cstring>
+#include <limits>
 #include <memory>
 #include <numeric>
-#include <string>
+#include <utility>
 
 #include "absl/base/dynamic_annotations.h"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "xla/executable_run_options.h"
+
+namespace {
+
+using xla::cpu::SortKeyKind;
+
+// Rough cost in cycles of a single comparison, used to decide how to split the
+// rows across the intra-op thread pool.
+constexpr double kCyclesPerComparison = 10;
+
+// Rows shorter than this are sorted with std::stable_sort on the radix keys,
+// the histogram and scatter passes of the radix sort do not pay off for them.
+constexpr int64_t kMinRadixSortElements = 256;
+
+// We conceptually have a 3-dimensional shape [a, b, c]. b corresponds to the
+// dimension to sort, c is the product of the more minor dimensions (set to 1
+// if b is the most minor dimension), and a is the product of the more major
+// dimensions (set to 1 if b is the most major dimension). There are a * c many
+// rows that we need to sort. Returns the offset of the first element of row
+// 'row'; the 'i'-th element of the row is at offset + i * c.
+//
+// 'row' can be split into two values which index into the 'c' dimension and
+// the 'a' dimension, respectively. 'row' % 'c' is the index into the 'c'
+// dimension, 'row' / 'c' is the index into the 'a' dimension. When calculating
+// the base offset, we need to multiply the index into the 'a' dimension with
+// 'b' * 'c'.
+// 'row' / 'c' * 'c' * 'b' = ('row' - 'row' % 'c') * 'b'.
+int64_t RowBaseOffset(int64_t row, int64_t b, int64_t c) {
+  return row % c + (row - row % c) * b;
+}
+
+// Calls 'fn(first_row, last_row)' on blocks of rows that together cover
+// [0, num_rows). The blocks are processed in parallel on the intra-op thread
+// pool of 'run_options' if 'parallel' is set and there is a thread pool.
+template <typename Fn>
+void ForEachRowBlock(const xla::ExecutableRunOptions* run_options,
+                     bool parallel, int64_t num_rows, int64_t row_elements,
+                     int64_t bytes_per_element, Fn fn) {
+  const Eigen::ThreadPoolDevice* device =
+      run_options == nullptr ? nullptr : run_options->intra_op_thread_pool();
+  if (!parallel || device == nullptr || num_rows < 2) {
+    fn(0, num_rows);
+    return;
+  }
+  double n = static_cast<double>(row_elements);
+  double row_bytes = n * bytes_per_element;
+  Eigen::TensorOpCost cost(
+      /*bytes_loaded=*/row_bytes, /*bytes_stored=*/row_bytes,
+      /*compute_cycles=*/n * std::log2(std::max(n, 2.0)) *
+          kCyclesPerComparison);
+  device->parallelFor(num_rows, cost,
+                      [&](Eigen::Index first, Eigen::Index last) {
+                        fn(first, last);
+                      });
+}
+
+// Reorders the 'n' elements of size 'kSize' of the row starting at 'row' with
+// stride 'stride' (in elements) according to 'indices', using 'scratch' as a
+// buffer of at least n * kSize bytes. The fixed-size memcpy calls compile to
+// plain loads and stores of the element type.
+template <int64_t kSize>
+void PermuteRow(char* row, int64_t stride, int64_t n, const int64_t* indices,
+                char* scratch) {
+  for (int64_t i = 0; i < n; ++i) {
+    std::memcpy(scratch + i * kSize, row + indices[i] * stride * kSize, kSize);
+  }
+  for (int64_t i = 0; i < n; ++i) {
+    std::memcpy(row + i * stride * kSize, scratch + i * kSize, kSize);
+  }
+}
+
+void PermuteRow(char* row, int64_t size, int64_t stride, int64_t n,
+                const int64_t* indices, char* scratch) {
+  switch (size) {
+    case 1:
+      return PermuteRow<1>(row, stride, n, indices, scratch);
+    case 2:
+      return PermuteRow<2>(row, stride, n, indices, scratch);
+    case 4:
+      return PermuteRow<4>(row, stride, n, indices, scratch);
+    case 8:
+      return PermuteRow<8>(row, stride, n, indices, scratch);
+    case 16:
+      return PermuteRow<16>(row, stride, n, indices, scratch);
+  }
+  for (int64_t i = 0; i < n; ++i) {
+    std::memcpy(scratch + i * size, row + indices[i] * stride * size, size);
+  }
+  for (int64_t i = 0; i < n; ++i) {
+    std::memcpy(row + i * stride * size, scratch + i * size, size);
+  }
+}
+
+// Maps the bit pattern of a key to an unsigned integer whose natural order is
+// the requested sort order of the keys.
+template <typename UInt, SortKeyKind kKind>
+struct RadixKey {
+  static constexpr UInt kSignBit = UInt{1} << (sizeof(UInt) * 8 - 1);
+
+  UInt operator()(UInt bits) const {
+    UInt key;
+    switch (kKind) {
+      case SortKeyKind::kUnsigned:
+        key = bits;
+        break;
+      case SortKeyKind::kSigned:
+        key = bits ^ kSignBit;
+        break;
+      case SortKeyKind::kFloatPartialOrder:
+        // -0 and +0 compare equal, so they must get the same key for the sort
+        // to be stable.
+        if (bits == kSignBit) {
+          bits = 0;
+        }
+        [[fallthrough]];
+      case SortKeyKind::kFloatTotalOrder:
+        // -NaN < -Inf < -Finite < -0 < +0 < +Finite < +Inf < +NaN.
+        key = (bits & kSignBit) ? static_cast<UInt>(~bits) : (bits | kSignBit);
+        break;
+    }
+    return key ^ descending_mask;
+  }
+
+  UInt descending_mask;
+};
+
+// Stable LSD radix sort of 'data' by 'key(data[i])' one byte at a time, using
+// 'scratch' as a second buffer of n elements. Passes in which all keys have the
+// same digit are skipped.
+template <typename UInt, typename KeyFn>
+void RadixSort(UInt* data, UInt* scratch, int64_t n, KeyFn key) {
+  constexpr int kNumPasses = sizeof(UInt);
+  std::array<std::array<int64_t, 256>, kNumPasses> histograms = {};
+  for (int64_t i = 0; i < n; ++i) {
+    UInt k = key(data[i]);
+    for (int pass = 0; pass < kNumPasses; ++pass) {
+      ++histograms[pass][(k >> (8 * pass)) & 0xff];
+    }
+  }
+
+  UInt* src = data;
+  UInt* dst = scratch;
+  for (int pass = 0; pass < kNumPasses; ++pass) {
+    const int shift = 8 * pass;
+    std::array<int64_t, 256>& offsets = histograms[pass];
+    if (offsets[(key(src[0]) >> shift) & 0xff] == n) {
+      continue;
+    }
+    int64_t sum = 0;
+    for (int64_t& offset : offsets) {
+      int64_t count = offset;
+      offset = sum;
+      sum += count;
+    }
+    for (int64_t i = 0; i < n; ++i) {
+      UInt v = src[i];
+      dst[offsets[(key(v) >> shift) & 0xff]++] = v;
+    }
+    std::swap(src, dst);
+  }
+  if (src != data) {
+    std::memcpy(data, src, n * sizeof(UInt));
+  }
+}
+
+template <typename UInt, SortKeyKind kKind>
+void KeySort(int64_t a, int64_t b, int64_t c, char* keys, bool descending,
+             const xla::ExecutableRunOptions* run_options) {
+  RadixKey<UInt, kKind> key{descending ? std::numeric_limits<UInt>::max()
+                                       : UInt{0}};
+  ForEachRowBlock(
+      run_options, /*parallel=*/true, a * c, b, sizeof(UInt),
+      [&](int64_t first_row, int64_t last_row) {
+        std::unique_ptr<UInt[]> row_keys(new UInt[b]);
+        std::unique_ptr<UInt[]> scratch(new UInt[b]);
+        for (int64_t row = first_row; row < last_row; ++row) {
+          char* row_start = keys + RowBaseOffset(row, b, c) * sizeof(UInt);
+          // Go through a typed buffer instead of sorting the JIT'd buffer in
+          // place, which also gathers strided rows.
+          if (c == 1) {
+            std::memcpy(row_keys.get(), row_start, b * sizeof(UInt));
+          } else {
+            for (int64_t i = 0; i < b; ++i) {
+              std::memcpy(&row_keys[i], row_start + i * c * sizeof(UInt),
+                          sizeof(UInt));
+            }
+          }
+          if (b < kMinRadixSortElements) {
+            std::stable_sort(row_keys.get(), row_keys.get() + b,
+                             [&](UInt lhs, UInt rhs) {
+                               return key(lhs) < key(rhs);
+                             });
+          } else {
+            RadixSort(row_keys.get(), scratch.get(), b, key);
+          }
+          if (c == 1) {
+            std::memcpy(row_start, row_keys.get(), b * sizeof(UInt));
+          } else {
+            for (int64_t i = 0; i < b; ++i) {
+              std::memcpy(row_start + i * c * sizeof(UInt), &row_keys[i],
+                          sizeof(UInt));
+            }
+          }
+        }
+      });
+}
+
+template <typename UInt>
+void KeySort(int64_t a, int64_t b, int64_t c, char* keys, SortKeyKind kind,
+             bool descending, const xla::ExecutableRunOptions* run_options) {
+  switch (kind) {
+    case SortKeyKind::kUnsigned:
+      return KeySort<UInt, SortKeyKind::kUnsigned>(a, b, c, keys, descending,
+                                                   run_options);
+    case SortKeyKind::kSigned:
+      return KeySort<UInt, SortKeyKind::kSigned>(a, b, c, keys, descending,
+                                                 run_options);
+    case SortKeyKind::kFloatPartialOrder:
+      return KeySort<UInt, SortKeyKind::kFloatPartialOrder>(
+          a, b, c, keys, descending, run_options);
+    case SortKeyKind::kFloatTotalOrder:
+      return KeySort<UInt, SortKeyKind::kFloatTotalOrder>(
+          a, b, c, keys, descending, run_options);
+  }
+}
+
+}  // namespace
 
 ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_KeyValueSort(
     int64_t a, int64_t b, int64_t c, char** values, int32_t values_count,
@@ -34,78 +266,94 @@ ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_KeyValueSort(
   ABSL_ANNOTATE_MEMORY_IS_INITIALIZED(values_primitive_type_size_in_bytes,
                                       values_count * sizeof(int32_t));
 
-  // High-level idea of the iteration/sorting logic:
-  // Conceptually we have a 3-dimensional shape [a, b, c]. b corresponds to the
-  // dimension to sort, c is the product of the more minor dimensions (set to 1
-  // if b is the most minor dimension), and a is the product of the more major
-  // dimensions (set to 1 if b is the most major dimension). There are a * c
-  // many rows that we need to sort. We iterate through these, calculate a
-  // 'base_offset' value which points to the first element in that row, and add
-  // i * c for accessing the 'i'-th element in that row.
-
   int64_t sort_dimension_elements = b;
   int64_t num_iteration_elements = a * c;
   int64_t sort_dimension_offset = c;
 
-  std::unique_ptr<int64_t[]> indices(new int64_t[sort_dimension_elements]);
-  std::unique_ptr<char*[]> comparison_values(new char*[2 * values_count]);
-  std::iota(indices.get(), indices.get() + sort_dimension_elements, 0);
-  std::unique_ptr<std::string[]> reordered_values(
-      new std::string[sort_dimension_elements]);
-  for (int64_t index = 0; index < num_iteration_elements; ++index) {
-    // If the sort should be stable, we have to reinitialize indices to iota to
-    // guarantee that we still keep the relative order in case of ties.
-    if (is_stable && index > 0) {
-      std::iota(indices.get(), indices.get() + sort_dimension_elements, 0);
-    }
-    // 'index' can be split into two values which index into the 'c' dimension
-    // and the 'a' dimension, respectively. 'index' % 'c' is the index into the
-    // 'c' dimension, 'index' / 'c' is the index into the 'a' dimension. When
-    // calculating the base offset, we need to multiply the index into the 'a'
-    // dimension with 'b' * 'c'.
-    // 'index' / 'c' * 'c' * 'b' = ('index' - 'index' % 'c') * 'b'.
-    int64_t base_offset =
-        index % sort_dimension_offset +
-        (index - index % sort_dimension_offset) * sort_dimension_elements;
-    auto compare_function = [&](int64_t a, int64_t b) -> bool {
-      for (int32_t i = 0; i < values_count; ++i) {
-        int64_t memory_index_lhs = (base_offset + a * sort_dimension_offset) *
-                                   values_primitive_type_size_in_bytes[i];
-        int64_t memory_index_rhs = (base_offset + b * sort_dimension_offset) *
-                                   values_primitive_type_size_in_bytes[i];
-        comparison_values[i * 2] = values[i] + memory_index_lhs;
-        comparison_values[i * 2 + 1] = values[i] + memory_index_rhs;
-      }
-      char result = 0;  // Overwritten by less_than.
-      less_than(&result, run_options, comparison_values.get(), nullptr,
-                prof_counters);
-      return result != 0u;
-    };
-    if (is_stable) {
-      std::stable_sort(indices.get(), indices.get() + sort_dimension_elements,
-                       compare_function);
-    } else {
-      std::sort(indices.get(), indices.get() + sort_dimension_elements,
-                compare_function);
-    }
+  int64_t max_primitive_type_size = 0;
+  int64_t bytes_per_element = 0;
+  for (int32_t i = 0; i < values_count; ++i) {
+    max_primitive_type_size = std::max<int64_t>(
+        max_primitive_type_size, values_primitive_type_size_in_bytes[i]);
+    bytes_per_element += values_primitive_type_size_in_bytes[i];
+  }
 
-    // Reorder the values according to the order defined by 'indices'.
-    for (int32_t idx = 0; idx < values_count; ++idx) {
-      for (int64_t i = 0; i < sort_dimension_elements; ++i) {
-        int64_t memory_index =
-            (base_offset + indices[i] * sort_dimension_offset) *
-            values_primitive_type_size_in_bytes[idx];
-
-        reordered_values[i] =
-            std::string(values[idx] + memory_index,
-                        values_primitive_type_size_in_bytes[idx]);
-      }
-      for (int64_t i = 0; i < sort_dimension_elements; ++i) {
-        int64_t memory_index = (base_offset + i * sort_dimension_offset) *
-                               values_primitive_type_size_in_bytes[idx];
-        memcpy(values[idx] + memory_index, reordered_values[i].c_str(),
-               values_primitive_type_size_in_bytes[idx]);
-      }
-    }
+  // The comparator is a thread-local computation without side effects, so rows
+  // can be sorted concurrently. Profile counters are updated non-atomically by
+  // the comparator, so we stay on the calling thread when profiling.
+  bool parallel = prof_counters == nullptr;
+
+  ForEachRowBlock(
+      reinterpret_cast<const xla::ExecutableRunOptions*>(run_options), parallel,
+      num_iteration_elements, sort_dimension_elements, bytes_per_element,
+      [&](int64_t first_row, int64_t last_row) {
+        std::unique_ptr<int64_t[]> indices(
+            new int64_t[sort_dimension_elements]);
+        std::unique_ptr<char*[]> comparison_values(
+            new char*[2 * values_count]);
+        std::unique_ptr<char[]> scratch(
+            new char[sort_dimension_elements * max_primitive_type_size]);
+        for (int64_t row = first_row; row < last_row; ++row) {
+          // Reinitialize indices to iota for every row; a stable sort relies on
+          // it to keep the relative order in case of ties.
+          std::iota(indices.get(), indices.get() + sort_dimension_elements, 0);
+          int64_t base_offset =
+              RowBaseOffset(row, sort_dimension_elements, sort_dimension_offset);
+          auto compare_function = [&](int64_t a, int64_t b) -> bool {
+            for (int32_t i = 0; i < values_count; ++i) {
+              int64_t memory_index_lhs =
+                  (base_offset + a * sort_dimension_offset) *
+                  values_primitive_type_size_in_bytes[i];
+              int64_t memory_index_rhs =
+                  (base_offset + b * sort_dimension_offset) *
+                  values_primitive_type_size_in_bytes[i];
+              comparison_values[i * 2] = values[i] + memory_index_lhs;
+              comparison_values[i * 2 + 1] = values[i] + memory_index_rhs;
+            }
+            char result = 0;  // Overwritten by less_than.
+            less_than(&result, run_options, comparison_values.get(), nullptr,
+                      prof_counters);
+            return result != 0u;
+          };
+          if (is_stable) {
+            std::stable_sort(indices.get(),
+                             indices.get() + sort_dimension_elements,
+                             compare_function);
+          } else {
+            std::sort(indices.get(), indices.get() + sort_dimension_elements,
+                      compare_function);
+          }
+
+          // Reorder the values according to the order defined by 'indices'.
+          for (int32_t idx = 0; idx < values_count; ++idx) {
+            int64_t size = values_primitive_type_size_in_bytes[idx];
+            PermuteRow(values[idx] + base_offset * size, size,
+                       sort_dimension_offset, sort_dimension_elements,
+                       indices.get(), scratch.get());
+          }
+        }
+      });
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_KeySort(
+    int64_t a, int64_t b, int64_t c, char* keys,
+    int32_t key_primitive_type_size_in_bytes, int32_t key_kind,
+    bool descending, char* run_options) {
+  // 'keys' is managed by the JIT code, so msan can't tell it is initialized.
+  ABSL_ANNOTATE_MEMORY_IS_INITIALIZED(
+      keys, a * b * c * key_primitive_type_size_in_bytes);
+
+  const auto* options =
+      reinterpret_cast<const xla::ExecutableRunOptions*>(run_options);
+  SortKeyKind kind = static_cast<SortKeyKind>(key_kind);
+  switch (key_primitive_type_size_in_bytes) {
+    case 1:
+      return KeySort<uint8_t>(a, b, c, keys, kind, descending, options);
+    case 2:
+      return KeySort<uint16_t>(a, b, c, keys, kind, descending, options);
+    case 4:
+      return KeySort<uint32_t>(a, b, c, keys, kind, descending, options);
+    case 8:
+      return KeySort<uint64_t>(a, b, c, keys, kind, descending, options);
   }
 }
@@ -20,6 +20,23 @@ limitations under the License.
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 
+namespace xla {
+namespace cpu {
+
+// How __xla_cpu_runtime_KeySort interprets the bits of the keys.
+enum class SortKeyKind : int32_t {
+  kUnsigned = 0,
+  kSigned = 1,
+  // IEEE floating point keys compared with a partial order: -0 == +0.
+  kFloatPartialOrder = 2,
+  // IEEE floating point keys compared with a total order:
+  // -NaN < -Inf < -Finite < -0 < +0 < +Finite < +Inf < +NaN.
+  kFloatTotalOrder = 3,
+};
+
+}  // namespace cpu
+}  // namespace xla
+
 extern "C" {
 
 // Each entry in 'values' represents a 3-dimensional shape with dimensions
@@ -36,11 +53,26 @@ extern "C" {
 // - pointers to the parameter buffers (char**)
 // - pointers to the buffer tables = nullptr for thread local functions (char**)
 // - profile counters = 'prof_counters' (int64_t*)
+// If 'run_options' has an intra-op thread pool, rows are sorted in parallel.
 extern void __xla_cpu_runtime_KeyValueSort(
     int64_t a, int64_t b, int64_t c, char** values, int32_t values_count,
     int32_t* values_primitive_type_size_in_bytes, bool is_stable,
     char* run_options, int64_t* prof_counters,
     void (*less_than)(char*, char*, char**, char**, int64_t*));
+
+// Specialization of __xla_cpu_runtime_KeyValueSort for a single operand of
+// primitive type whose comparator is a plain less-than or greater-than
+// comparison of the two keys. 'keys' has the same [a, b, c] layout as the
+// entries of 'values' above; its elements have
+// 'key_primitive_type_size_in_bytes' bytes (1, 2, 4 or 8) and are interpreted
+// according to 'key_kind', a xla::cpu::SortKeyKind. The 'b' dimension is sorted
+// into ascending order, or descending order if 'descending' is set, with a
+// stable radix sort and without calling back into generated code.
+extern void __xla_cpu_runtime_KeySort(int64_t a, int64_t b, int64_t c,
+                                      char* keys,
+                                      int32_t key_primitive_type_size_in_bytes,
+                                      int32_t key_kind, bool descending,
+                                      char* run_options);
 }
 
 #endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_KEY_VALUE_SORT_H_
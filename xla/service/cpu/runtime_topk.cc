@@ -15,61 +15,199 @@ limitations under the License.
 
 #include "xla/service/cpu/runtime_topk.h"
 
+#define EIGEN_USE_THREADS
+
 #include <algorithm>
 #include <cstring>
 #include <limits>
 #include <memory>
-#include <numeric>
+#include <type_traits>
 #include <vector>
 
 #include "absl/base/dynamic_annotations.h"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "xla/executable_run_options.h"
+
+namespace {
+
+// Number of elements that are compared against the current k-th largest key
+// at once before any of them is inserted into the heap.
+constexpr int64_t kPrefilterBlockSize = 64;
 
-template <typename T>
-static void TopK(int64_t batch_size, int64_t input_size, int64_t k,
-                 const T* values, T* out_values, int32_t* out_indices) {
+// The heap-based selection is used while k is at most this fraction of the
+// input size, above that an nth_element based selection is faster.
+constexpr int64_t kMaxHeapSelectionRatio = 16;
+
+// Converts 'value' to a signed integer of the same width. Floating point
+// values are compared as integers to enforce a total order of
+// -NaN < -Inf < -Finite < -0 < +0 < +Finite < +Inf < +NaN, which is what the
+// NaN-safe comparators matched by TopkRewriter compute. Integers are their own
+// keys.
+template <typename T, typename Key>
+Key ToKey(T value) {
+  if constexpr (std::is_integral_v<T>) {
+    return value;
+  } else {
+    using UKey = std::make_unsigned_t<Key>;
+    UKey x;
+    std::memcpy(&x, &value, sizeof(x));
+    return static_cast<Key>(x) < 0
+               ? static_cast<Key>(
+                     static_cast<UKey>(std::numeric_limits<Key>::max() - x))
+               : static_cast<Key>(x);
+  }
+}
+
+template <typename Key>
+struct Candidate {
+  Key key;
+  int32_t index;
+};
+
+// Orders candidates from largest to smallest key, with ties broken by the
+// smaller index.
+template <typename Key>
+bool Before(const Candidate<Key>& a, const Candidate<Key>& b) {
+  return a.key > b.key || (a.key == b.key && a.index < b.index);
+}
+
+// Selects the k best candidates with a heap whose top is the worst selected
+// candidate so far. Before inserting any element of a block we first check
+// with a branch-free loop whether any element of the block beats the current
+// threshold; for k much smaller than the input size almost all blocks are
+// rejected by that check.
+template <typename T, typename Key>
+void HeapSelect(const T* values, int64_t input_size, int64_t k,
+                std::vector<Candidate<Key>>& heap) {
+  heap.resize(k);
+  for (int64_t i = 0; i < k; ++i) {
+    heap[i] = {ToKey<T, Key>(values[i]), static_cast<int32_t>(i)};
+  }
+  std::make_heap(heap.begin(), heap.end(), Before<Key>);
+  Key threshold = heap.front().key;
+
+  for (int64_t block = k; block < input_size; block += kPrefilterBlockSize) {
+    int64_t block_end = std::min(input_size, block + kPrefilterBlockSize);
+    bool any_above_threshold = false;
+    for (int64_t i = block; i < block_end; ++i) {
+      any_above_threshold |= ToKey<T, Key>(values[i]) > threshold;
+    }
+    if (!any_above_threshold) {
+      continue;
+    }
+    // Elements are visited in increasing index order, so an element whose key
+    // equals the threshold loses the tie against the top of the heap.
+    for (int64_t i = block; i < block_end; ++i) {
+      Key key = ToKey<T, Key>(values[i]);
+      if (key > threshold) {
+        std::pop_heap(heap.begin(), heap.end(), Before<Key>);
+        heap.back() = {key, static_cast<int32_t>(i)};
+        std::push_heap(heap.begin(), heap.end(), Before<Key>);
+        threshold = heap.front().key;
+      }
+    }
+  }
+  std::sort_heap(heap.begin(), heap.end(), Before<Key>);
+}
+
+// Selects the k best candidates by partitioning all of them around the k-th
+// one and sorting the first k.
+template <typename T, typename Key>
+void PartitionSelect(const T* values, int64_t input_size, int64_t k,
+                     std::vector<Candidate<Key>>& candidates) {
+  candidates.resize(input_size);
+  for (int64_t i = 0; i < input_size; ++i) {
+    candidates[i] = {ToKey<T, Key>(values[i]), static_cast<int32_t>(i)};
+  }
+  auto kth_element = candidates.begin() + k;
+  if (k < input_size) {
+    std::nth_element(candidates.begin(), kth_element, candidates.end(),
+                     Before<Key>);
+  }
+  std::sort(candidates.begin(), kth_element, Before<Key>);
+}
+
+template <typename T, typename Key>
+void TopK(const xla::ExecutableRunOptions* run_options, int64_t batch_size,
+          int64_t input_size, int64_t k, const T* values, T* out_values,
+          int32_t* out_indices) {
   // 'values' is managed by the JIT code, so msan can't tell they are
   // initialized.
   ABSL_ANNOTATE_MEMORY_IS_INITIALIZED(values,
                                       input_size * batch_size * sizeof(T));
+  if (k == 0) {
+    return;
+  }
 
-  std::vector<int32_t> temp_indices(input_size);
-  for (int64_t batch = 0; batch != batch_size; ++batch) {
-    std::iota(temp_indices.begin(), temp_indices.end(), 0);
-
-    const T* values_batch = values + batch * input_size;
-
-    auto convert_to_int = [](T value) {
-      uint32_t x;
-      std::memcpy(&x, &value, sizeof(x));
-      return static_cast<int32_t>(x) < 0
-                 ? std::numeric_limits<int32_t>::max() - x
-                 : x;
-    };
-
-    auto kth_element = temp_indices.begin() + k;
-    std::partial_sort(temp_indices.begin(), kth_element, temp_indices.end(),
-                      [&](size_t i1, size_t i2) {
-                        // Do the comparison in integers to enforce a total
-                        // order of -NaN < -Inf < -0 < +0 < +Inf < +NaN.
-                        int32_t v1 = convert_to_int(values_batch[i1]);
-                        int32_t v2 = convert_to_int(values_batch[i2]);
-                        if (v1 == v2) {
-                          return i1 < i2;  // Stabilize sorting.
-                        }
-                        return v1 > v2;
-                      });
+  bool use_heap = k * kMaxHeapSelectionRatio <= input_size;
+  auto process_batches = [&](int64_t first_batch, int64_t last_batch) {
+    std::vector<Candidate<Key>> candidates;
+    for (int64_t batch = first_batch; batch < last_batch; ++batch) {
+      const T* values_batch = values + batch * input_size;
+      if (use_heap) {
+        HeapSelect<T, Key>(values_batch, input_size, k, candidates);
+      } else {
+        PartitionSelect<T, Key>(values_batch, input_size, k, candidates);
+      }
 
-    T* out_values_batch = out_values + batch * k;
-    int32_t* out_indices_batch = out_indices + batch * k;
-    std::copy(temp_indices.begin(), kth_element, out_indices_batch);
-    for (int64_t i = 0; i < k; i++) {
-      out_values_batch[i] = values_batch[temp_indices[i]];
+      T* out_values_batch = out_values + batch * k;
+      int32_t* out_indices_batch = out_indices + batch * k;
+      for (int64_t i = 0; i < k; ++i) {
+        out_indices_batch[i] = candidates[i].index;
+        out_values_batch[i] = values_batch[candidates[i].index];
+      }
     }
+  };
+
+  const Eigen::ThreadPoolDevice* device =
+      run_options == nullptr ? nullptr : run_options->intra_op_thread_pool();
+  if (device == nullptr || batch_size < 2) {
+    process_batches(0, batch_size);
+    return;
   }
+  double batch_bytes = static_cast<double>(input_size) * sizeof(T);
+  Eigen::TensorOpCost cost(/*bytes_loaded=*/batch_bytes,
+                           /*bytes_stored=*/k * (sizeof(T) + sizeof(int32_t)),
+                           /*compute_cycles=*/input_size * 2.0);
+  device->parallelFor(batch_size, cost,
+                      [&](Eigen::Index first, Eigen::Index last) {
+                        process_batches(first, last);
+                      });
 }
 
+}  // namespace
+
 ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_TopKF32(
-    int64_t batch_size, int64_t input_size, int64_t k, const float* values,
-    float* out_values, int32_t* out_indices) {
-  TopK(batch_size, input_size, k, values, out_values, out_indices);
+    const void* run_options_ptr, int64_t batch_size, int64_t input_size,
+    int64_t k, const float* values, float* out_values, int32_t* out_indices) {
+  TopK<float, int32_t>(
+      static_cast<const xla::ExecutableRunOptions*>(run_options_ptr),
+      batch_size, input_size, k, values, out_values, out_indices);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_TopKBF16(
+    const void* run_options_ptr, int64_t batch_size, int64_t input_size,
+    int64_t k, const Eigen::bfloat16* values, Eigen::bfloat16* out_values,
+    int32_t* out_indices) {
+  TopK<Eigen::bfloat16, int16_t>(
+      static_cast<const xla::ExecutableRunOptions*>(run_options_ptr),
+      batch_size, input_size, k, values, out_values, out_indices);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_TopKF16(
+    const void* run_options_ptr, int64_t batch_size, int64_t input_size,
+    int64_t k, const Eigen::half* values, Eigen::half* out_values,
+    int32_t* out_indices) {
+  TopK<Eigen::half, int16_t>(
+      static_cast<const xla::ExecutableRunOptions*>(run_options_ptr),
+      batch_size, input_size, k, values, out_values, out_indices);
+}
+
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_TopKS32(
+    const void* run_options_ptr, int64_t batch_size, int64_t input_size,
+    int64_t k, const int32_t* values, int32_t* out_values,
+    int32_t* out_indices) {
+  TopK<int32_t, int32_t>(
+      static_cast<const xla::ExecutableRunOptions*>(run_options_ptr),
+      batch_size, input_size, k, values, out_values, out_indices);
 }
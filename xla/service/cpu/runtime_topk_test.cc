@@ -0,0 +1,246 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#define EIGEN_USE_THREADS
+
+#include "xla/service/cpu/runtime_topk.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "xla/executable_run_options.h"
+#include "tsl/platform/cpu_info.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+#include "tsl/platform/threadpool.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// The original single-threaded F32 implementation: a partial_sort over an
+// index array per batch. Used as the oracle for the tests and as the baseline
+// for the benchmarks below.
+void ReferenceTopKF32(int64_t batch_size, int64_t input_size, int64_t k,
+                      const float* values, float* out_values,
+                      int32_t* out_indices) {
+  std::vector<int32_t> temp_indices(input_size);
+  for (int64_t batch = 0; batch != batch_size; ++batch) {
+    std::iota(temp_indices.begin(), temp_indices.end(), 0);
+    const float* values_batch = values + batch * input_size;
+    auto convert_to_int = [](float value) {
+      uint32_t x;
+      std::memcpy(&x, &value, sizeof(x));
+      return static_cast<int32_t>(x) < 0
+                 ? std::numeric_limits<int32_t>::max() - x
+                 : x;
+    };
+    auto kth_element = temp_indices.begin() + k;
+    std::partial_sort(temp_indices.begin(), kth_element, temp_indices.end(),
+                      [&](size_t i1, size_t i2) {
+                        int32_t v1 = convert_to_int(values_batch[i1]);
+                        int32_t v2 = convert_to_int(values_batch[i2]);
+                        if (v1 == v2) {
+                          return i1 < i2;
+                        }
+                        return v1 > v2;
+                      });
+    std::copy(temp_indices.begin(), kth_element, out_indices + batch * k);
+    for (int64_t i = 0; i < k; ++i) {
+      out_values[batch * k + i] = values_batch[temp_indices[i]];
+    }
+  }
+}
+
+// Random values drawn from a small range so that ties are common, with -0.0,
+// +0.0 and NaNs of both signs sprinkled in.
+std::vector<float> MakeInput(int64_t batch_size, int64_t input_size) {
+  std::minstd_rand0 engine(42);
+  std::uniform_int_distribution<int> distribution(-64, 64);
+  std::vector<float> values(batch_size * input_size);
+  for (float& value : values) {
+    value = static_cast<float>(distribution(engine)) / 4.0f;
+  }
+  for (int64_t batch = 0; batch < batch_size && input_size >= 4; ++batch) {
+    float* row = values.data() + batch * input_size;
+    row[0] = -0.0f;
+    row[input_size / 3] = 0.0f;
+    row[input_size / 2] = std::numeric_limits<float>::quiet_NaN();
+    row[input_size - 1] = -std::numeric_limits<float>::quiet_NaN();
+  }
+  return values;
+}
+
+class TopKTest
+    : public ::testing::TestWithParam<std::tuple<int64_t, int64_t, int64_t>> {
+};
+
+TEST_P(TopKTest, F32MatchesReference) {
+  auto [batch_size, input_size, k] = GetParam();
+  std::vector<float> values = MakeInput(batch_size, input_size);
+
+  std::vector<float> expected_values(batch_size * k);
+  std::vector<int32_t> expected_indices(batch_size * k);
+  ReferenceTopKF32(batch_size, input_size, k, values.data(),
+                   expected_values.data(), expected_indices.data());
+
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "topk_test", 4);
+  Eigen::ThreadPoolDevice device(pool.AsEigenThreadPool(), pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+
+  for (const ExecutableRunOptions* options :
+       {static_cast<const ExecutableRunOptions*>(nullptr),
+        static_cast<const ExecutableRunOptions*>(&run_options)}) {
+    std::vector<float> out_values(batch_size * k);
+    std::vector<int32_t> out_indices(batch_size * k);
+    __xla_cpu_runtime_TopKF32(options, batch_size, input_size, k,
+                              values.data(), out_values.data(),
+                              out_indices.data());
+    EXPECT_EQ(out_indices, expected_indices);
+    // Compare bit patterns so that NaNs and signed zeros are checked too.
+    EXPECT_EQ(std::memcmp(out_values.data(), expected_values.data(),
+                          out_values.size() * sizeof(float)),
+              0);
+  }
+}
+
+TEST_P(TopKTest, F16MatchesF32) {
+  auto [batch_size, input_size, k] = GetParam();
+  // Every value in MakeInput is exactly representable as a half, so the
+  // selected indices must be identical to the F32 ones.
+  std::vector<float> values = MakeInput(batch_size, input_size);
+  std::vector<Eigen::half> half_values(values.begin(), values.end());
+
+  std::vector<float> expected_values(batch_size * k);
+  std::vector<int32_t> expected_indices(batch_size * k);
+  ReferenceTopKF32(batch_size, input_size, k, values.data(),
+                   expected_values.data(), expected_indices.data());
+
+  std::vector<Eigen::half> out_values(batch_size * k);
+  std::vector<int32_t> out_indices(batch_size * k);
+  __xla_cpu_runtime_TopKF16(nullptr, batch_size, input_size, k,
+                            half_values.data(), out_values.data(),
+                            out_indices.data());
+  EXPECT_EQ(out_indices, expected_indices);
+
+  std::vector<Eigen::bfloat16> bf16_values(values.begin(), values.end());
+  std::vector<Eigen::bfloat16> bf16_out_values(batch_size * k);
+  __xla_cpu_runtime_TopKBF16(nullptr, batch_size, input_size, k,
+                             bf16_values.data(), bf16_out_values.data(),
+                             out_indices.data());
+  EXPECT_EQ(out_indices, expected_indices);
+}
+
+TEST_P(TopKTest, S32IsSortedAndStable) {
+  auto [batch_size, input_size, k] = GetParam();
+  std::minstd_rand0 engine(7);
+  std::uniform_int_distribution<int32_t> distribution(
+      std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max());
+  std::vector<int32_t> values(batch_size * input_size);
+  for (size_t i = 0; i < values.size(); ++i) {
+    // Alternate between extreme and small values to exercise ties.
+    values[i] = i % 2 == 0 ? distribution(engine) : (i % 5);
+  }
+
+  std::vector<int32_t> out_values(batch_size * k);
+  std::vector<int32_t> out_indices(batch_size * k);
+  __xla_cpu_runtime_TopKS32(nullptr, batch_size, input_size, k, values.data(),
+                            out_values.data(), out_indices.data());
+
+  std::vector<int32_t> order(input_size);
+  for (int64_t batch = 0; batch < batch_size; ++batch) {
+    const int32_t* row = values.data() + batch * input_size;
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](int32_t a, int32_t b) { return row[a] > row[b]; });
+    for (int64_t i = 0; i < k; ++i) {
+      EXPECT_EQ(out_indices[batch * k + i], order[i]);
+      EXPECT_EQ(out_values[batch * k + i], row[order[i]]);
+    }
+  }
+}
+
+// Covers k == 0, k == n, the heap path (k much smaller than n) and the
+// partition path (k close to n).
+INSTANTIATE_TEST_SUITE_P(TopKTestInstantiation, TopKTest,
+                         ::testing::Values(std::make_tuple(1, 1, 1),
+                                           std::make_tuple(3, 100, 0),
+                                           std::make_tuple(1, 100, 100),
+                                           std::make_tuple(5, 100, 10),
+                                           std::make_tuple(2, 5000, 1),
+                                           std::make_tuple(7, 5000, 64),
+                                           std::make_tuple(4, 5000, 1000),
+                                           std::make_tuple(33, 4096, 4000)));
+
+void BM_TopK(::testing::benchmark::State& state, bool use_reference) {
+  const int64_t batch_size = state.range(0);
+  const int64_t input_size = state.range(1);
+  const int64_t k = state.range(2);
+  std::vector<float> values = MakeInput(batch_size, input_size);
+  std::vector<float> out_values(batch_size * k);
+  std::vector<int32_t> out_indices(batch_size * k);
+
+  tsl::thread::ThreadPool pool(tsl::Env::Default(), "topk_benchmark",
+                               tsl::port::MaxParallelism());
+  Eigen::ThreadPoolDevice device(pool.AsEigenThreadPool(), pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+
+  for (auto s : state) {
+    if (use_reference) {
+      ReferenceTopKF32(batch_size, input_size, k, values.data(),
+                       out_values.data(), out_indices.data());
+    } else {
+      __xla_cpu_runtime_TopKF32(&run_options, batch_size, input_size, k,
+                                values.data(), out_values.data(),
+                                out_indices.data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * batch_size * input_size);
+}
+
+void BM_TopKF32(::testing::benchmark::State& state) {
+  BM_TopK(state, /*use_reference=*/false);
+}
+
+void BM_ReferenceTopKF32(::testing::benchmark::State& state) {
+  BM_TopK(state, /*use_reference=*/true);
+}
+
+#define TOPK_BENCHMARK_ARGS(benchmark) \
+  benchmark->Args({1, 1 << 20, 10})    \
+      ->Args({1, 1 << 20, 1024})       \
+      ->Args({512, 4096, 10})          \
+      ->Args({512, 4096, 256})         \
+      ->Args({512, 32768, 1024})       \
+      ->Args({64, 1 << 16, 8192})
+
+TOPK_BENCHMARK_ARGS(BENCHMARK(BM_TopKF32));
+TOPK_BENCHMARK_ARGS(BENCHMARK(BM_ReferenceTopKF32));
+
+#undef TOPK_BENCHMARK_ARGS
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
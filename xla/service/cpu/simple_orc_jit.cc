@@ -21,16 +21,30 @@ limitations under the License.
 #include <cstdio>
 #include <list>
 #include <memory>
+#include <string>
 #include <utility>
+#include <vector>
 
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Analysis/InlineCost.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
 #include "llvm/ExecutionEngine/Orc/ExecutorProcessControl.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Mangler.h"
 #include "llvm/IR/Operator.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
 #include "llvm/Support/CodeGen.h"
 #include "llvm/Support/Host.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/IPO/GlobalDCE.h"
+#include "llvm/Transforms/IPO/Inliner.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
 #include "mlir/ExecutionEngine/CRunnerUtils.h"  // from @llvm-project
 #include "xla/service/cpu/cpu_runtime.h"
 #include "xla/service/cpu/orc_jit_memory_mapper.h"
@@ -55,6 +69,7 @@ limitations under the License.
 #include "xla/service/cpu/windows_compatibility.h"
 #include "xla/service/custom_call_target_registry.h"
 #include "xla/types.h"
+#include "tsl/platform/blocking_counter.h"
 #include "tsl/platform/logging.h"
 
 // Provided by compiler-rt and MLIR.
@@ -106,7 +121,15 @@ SimpleOrcJIT::SimpleOrcJIT(
     LLVMCompiler::ModuleHook pre_optimization_hook,
     LLVMCompiler::ModuleHook post_optimization_hook,
     std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook)
-    : target_machine_(InferTargetMachineForJIT(target_options, opt_level)),
+    : target_options_(target_options),
+      opt_level_(opt_level),
+      optimize_for_size_(optimize_for_size),
+      disable_expensive_passes_(disable_expensive_passes),
+      fast_math_flags_(fast_math_flags),
+      pre_optimization_hook_(std::move(pre_optimization_hook)),
+      post_optimization_hook_(std::move(post_optimization_hook)),
+      post_codegen_hook_(std::move(post_codegen_hook)),
+      target_machine_(InferTargetMachineForJIT(target_options, opt_level)),
       target_triple_(target_machine_->getTargetTriple()),
       data_layout_(target_machine_->createDataLayout()),
       target_process_control_(std::move(target_process_control)),
@@ -116,13 +139,8 @@ SimpleOrcJIT::SimpleOrcJIT(
                       return std::make_unique<llvm::SectionMemoryManager>(
                           orc_jit_memory_mapper::GetInstance());
                     }),
-      compile_layer_(
-          *execution_session_, object_layer_,
-          std::make_unique<CompilerFunctor>(
-              target_machine_.get(), opt_level, optimize_for_size,
-              disable_expensive_passes, fast_math_flags,
-              std::move(pre_optimization_hook),
-              std::move(post_optimization_hook), std::move(post_codegen_hook))),
+      compile_layer_(*execution_session_, object_layer_,
+                     CreateCompilerFunctor(target_machine_.get())),
       main_jit_dylib_(&execution_session_->createBareJITDylib("<main>")),
       gdb_jit_event_listener_(
           llvm::JITEventListener::createGDBRegistrationListener()) {
@@ -226,6 +244,7 @@ void SimpleOrcJIT::notifyObjectLoaded(
     const llvm::RuntimeDyld::LoadedObjectInfo& object_info) {
   gdb_jit_event_listener_->notifyObjectLoaded(key, object, object_info);
   size_of_generated_code_in_bytes_ += object.getData().size();
+  ++num_generated_objects_;
 }
 
 void SimpleOrcJIT::notifyFreeingObject(llvm::JITEventListener::ObjectKey key) {
@@ -236,6 +255,115 @@ llvm::Error SimpleOrcJIT::AddModule(llvm::orc::ThreadSafeModule module) {
   return compile_layer_.add(*main_jit_dylib_, std::move(module));
 }
 
+llvm::Error SimpleOrcJIT::AddModuleSplit(llvm::orc::ThreadSafeModule module,
+                                         int num_parts,
+                                         tsl::thread::ThreadPool* thread_pool) {
+  if (num_parts <= 1) {
+    return AddModule(std::move(module));
+  }
+
+  // An LLVMContext may only be used by one thread at a time, so the parts are
+  // handed to the compiling threads as bitcode rather than as modules.
+  std::vector<llvm::SmallString<0>> parts;
+  module.withModuleDo([&](llvm::Module& llvm_module) {
+    InlineCalls(llvm_module);
+    llvm::SplitModule(
+        llvm_module, num_parts,
+        [&](std::unique_ptr<llvm::Module> part) {
+          // Parts that only declare symbols have nothing to compile.
+          if (llvm::all_of(part->global_values(),
+                           [](const llvm::GlobalValue& value) {
+                             return value.isDeclaration();
+                           })) {
+            return;
+          }
+          llvm::SmallString<0>& bitcode = parts.emplace_back();
+          llvm::raw_svector_ostream bitcode_stream(bitcode);
+          llvm::WriteBitcodeToFile(*part, bitcode_stream);
+        },
+        /*PreserveLocals=*/false);
+  });
+  module = llvm::orc::ThreadSafeModule();
+
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> objects(parts.size());
+  std::vector<std::string> errors(parts.size());
+  tsl::BlockingCounter counter(parts.size());
+  for (size_t i = 0; i < parts.size(); ++i) {
+    thread_pool->Schedule([&, i] {
+      llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> object =
+          CompileBitcode(parts[i]);
+      if (object) {
+        objects[i] = std::move(*object);
+      } else {
+        errors[i] = llvm::toString(object.takeError());
+      }
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+
+  for (size_t i = 0; i < parts.size(); ++i) {
+    if (!errors[i].empty()) {
+      return llvm::make_error<llvm::StringError>(
+          errors[i], llvm::inconvertibleErrorCode());
+    }
+  }
+  for (std::unique_ptr<llvm::MemoryBuffer>& object : objects) {
+    if (llvm::Error err =
+            object_layer_.add(*main_jit_dylib_, std::move(object))) {
+      return err;
+    }
+  }
+  VLOG(1) << "Compiled the module as " << parts.size() << " parts";
+  return llvm::Error::success();
+}
+
+void SimpleOrcJIT::InlineCalls(llvm::Module& module) const {
+  if (opt_level_ == llvm::CodeGenOpt::None) {
+    return;
+  }
+  llvm::LoopAnalysisManager lam;
+  llvm::FunctionAnalysisManager fam;
+  llvm::CGSCCAnalysisManager cgam;
+  llvm::ModuleAnalysisManager mam;
+  llvm::PassBuilder pb(target_machine_.get());
+  pb.registerModuleAnalyses(mam);
+  pb.registerCGSCCAnalyses(cgam);
+  pb.registerFunctionAnalyses(fam);
+  pb.registerLoopAnalyses(lam);
+  pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+  llvm::ModulePassManager pm;
+  pm.addPass(llvm::ModuleInlinerWrapperPass(
+      llvm::getInlineParams(opt_level_, /*SizeOptLevel=*/optimize_for_size_)));
+  // Drops the local functions which are no longer called, rather than
+  // externalizing them in the split.
+  pm.addPass(llvm::GlobalDCEPass());
+  pm.run(module, mam);
+}
+
+std::unique_ptr<CompilerFunctor> SimpleOrcJIT::CreateCompilerFunctor(
+    llvm::TargetMachine* target_machine) const {
+  return std::make_unique<CompilerFunctor>(
+      target_machine, opt_level_, optimize_for_size_, disable_expensive_passes_,
+      fast_math_flags_, pre_optimization_hook_, post_optimization_hook_,
+      post_codegen_hook_);
+}
+
+llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>>
+SimpleOrcJIT::CompileBitcode(llvm::StringRef bitcode) const {
+  llvm::LLVMContext context;
+  llvm::Expected<std::unique_ptr<llvm::Module>> llvm_module =
+      llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, "split_module"),
+                             context);
+  if (!llvm_module) {
+    return llvm_module.takeError();
+  }
+  std::unique_ptr<llvm::TargetMachine> target_machine =
+      InferTargetMachineForJIT(target_options_, opt_level_);
+  return (*CreateCompilerFunctor(target_machine.get()))(**llvm_module);
+}
+
 void SimpleOrcJIT::DoneCompiling() {
   // The target machine takes a non-trivial amount of memory, so once we are
   // done compiling throw it away.
@@ -315,7 +443,11 @@ bool RegisterKnownJITSymbols() {
   REGISTER_CPU_RUNTIME_SYMBOL(ReleaseOutfeedBufferAfterPopulation);
   REGISTER_CPU_RUNTIME_SYMBOL(StatusIsSuccess);
   REGISTER_CPU_RUNTIME_SYMBOL(KeyValueSort);
+  REGISTER_CPU_RUNTIME_SYMBOL(KeySort);
   REGISTER_CPU_RUNTIME_SYMBOL(TopKF32);
+  REGISTER_CPU_RUNTIME_SYMBOL(TopKBF16);
+  REGISTER_CPU_RUNTIME_SYMBOL(TopKF16);
+  REGISTER_CPU_RUNTIME_SYMBOL(TopKS32);
   REGISTER_CPU_RUNTIME_SYMBOL(TracingStart);
   REGISTER_CPU_RUNTIME_SYMBOL(TracingEnd);
 
@@ -20,6 +20,7 @@ limitations under the License.
 #include <string>
 #include <vector>
 
+#include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/ExecutionEngine/JITEventListener.h"
 #include "llvm/ExecutionEngine/Orc/Core.h"
@@ -28,9 +29,11 @@ limitations under the License.
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/Orc/SymbolStringPool.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Target/TargetMachine.h"
 #include "xla/service/cpu/compiler_functor.h"
 #include "xla/types.h"
+#include "tsl/platform/threadpool.h"
 
 namespace xla {
 namespace cpu {
@@ -79,6 +82,19 @@ class SimpleOrcJIT : public llvm::JITEventListener {
 
   llvm::Error AddModule(llvm::orc::ThreadSafeModule module);
 
+  // Splits `module` into `num_parts` modules and optimizes and compiles them
+  // concurrently on `thread_pool`, each in its own LLVMContext with its own
+  // TargetMachine, then adds the resulting objects to the JIT. Calls are
+  // inlined across the whole module before it is split. Local symbols which
+  // remain are externalized by the split; references between the parts are
+  // resolved when the objects are linked. Parts which define nothing are not
+  // compiled.
+  //
+  // The optimization and codegen hooks run once per part, possibly
+  // concurrently.
+  llvm::Error AddModuleSplit(llvm::orc::ThreadSafeModule module, int num_parts,
+                             tsl::thread::ThreadPool* thread_pool);
+
   // Discards objects we no longer need once we are done compiling.
   void DoneCompiling();
 
@@ -99,15 +115,42 @@ class SimpleOrcJIT : public llvm::JITEventListener {
     return size_of_generated_code_in_bytes_;
   }
 
+  // Number of object files loaded into the JIT, e.g. one per compiled part of
+  // a split module.
+  int64_t NumGeneratedObjects() const { return num_generated_objects_; }
+
  private:
   llvm::JITEvaluatedSymbol ResolveRuntimeSymbol(llvm::StringRef name);
 
+  std::unique_ptr<CompilerFunctor> CreateCompilerFunctor(
+      llvm::TargetMachine* target_machine) const;
+
+  // Runs the inliner over `module` at the JIT's optimization level, so that
+  // callees aren't cut off from their callers by AddModuleSplit.
+  void InlineCalls(llvm::Module& module) const;
+
+  // Parses one part of a split module into a new LLVMContext and compiles it
+  // with a new TargetMachine, so that parts can be compiled concurrently.
+  llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> CompileBitcode(
+      llvm::StringRef bitcode) const;
+
   void notifyObjectLoaded(
       llvm::JITEventListener::ObjectKey key,
       const llvm::object::ObjectFile& object,
       const llvm::RuntimeDyld::LoadedObjectInfo& object_info) override;
   void notifyFreeingObject(llvm::JITEventListener::ObjectKey key) override;
 
+  // Everything needed to create a CompilerFunctor for AddModuleSplit.
+  const llvm::TargetOptions target_options_;
+  const llvm::CodeGenOpt::Level opt_level_;
+  const bool optimize_for_size_;
+  const bool disable_expensive_passes_;
+  const llvm::FastMathFlags fast_math_flags_;
+  const LLVMCompiler::ModuleHook pre_optimization_hook_;
+  const LLVMCompiler::ModuleHook post_optimization_hook_;
+  const std::function<void(const llvm::object::ObjectFile&)>
+      post_codegen_hook_;
+
   std::unique_ptr<llvm::TargetMachine> target_machine_;
   llvm::Triple target_triple_;
   const llvm::DataLayout data_layout_;
@@ -117,6 +160,7 @@ class SimpleOrcJIT : public llvm::JITEventListener {
   CompileLayerT compile_layer_;
   llvm::orc::JITDylib* main_jit_dylib_;
   int64_t size_of_generated_code_in_bytes_ = 0;
+  int64_t num_generated_objects_ = 0;
 
   // Non owning pointer to a JIT event listener that registers the JIT events
   // with an attached GDB.
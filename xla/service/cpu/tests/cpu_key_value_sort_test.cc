@@ -13,11 +13,25 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <memory>
+#include <random>
+#include <string>
+#include <vector>
 
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "xla/literal.h"
+#include "xla/primitive_util.h"
 #include "xla/service/cpu/cpu_compiler.h"
 #include "xla/service/cpu/test_target_triple_helper.h"
 #include "xla/service/cpu/tests/cpu_codegen_test.h"
+#include "xla/shape_util.h"
 
 namespace xla {
 namespace cpu {
@@ -40,6 +54,77 @@ ENTRY main {
 
   ROOT result = f32[10] sort(f32[10] a), dimensions={0}, to_apply=compare
 }
+)";
+
+  std::string filecheck_pattern = R"(
+CHECK: call void @__xla_cpu_runtime_KeySort
+CHECK-NOT: @__xla_cpu_runtime_KeyValueSort
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(hlo_text));
+
+  CpuAotCompilationOptions options{
+      /*triple=*/kTargetTripleForHost, /*cpu_name=*/kTargetCpuForHost,
+      /*features=*/"",
+      /*entry_point_name=*/"entry",
+      /*relocation_model=*/CpuAotCompilationOptions::RelocationModel::Static};
+
+  CompileAheadOfTimeAndVerifyIr(std::move(module), options, filecheck_pattern,
+                                /*match_optimized_ir=*/true);
+}
+
+TEST_F(CpuKeyValueSortTest, SortR2DescendingTotalOrder) {
+  const std::string hlo_text = R"(
+HloModule KeyValueSort
+
+compare {
+  p.0.lhs = f32[] parameter(0)
+  p.0.rhs = f32[] parameter(1)
+  ROOT lt = pred[] compare(p.0.rhs, p.0.lhs), direction=LT, type=TOTALORDER
+}
+
+ENTRY main {
+  a = f32[4,10] parameter(0)
+
+  ROOT result = f32[4,10] sort(f32[4,10] a), dimensions={1}, to_apply=compare
+}
+)";
+
+  // Keys are sorted as f32 (4 bytes) in total order (kind 3) descending.
+  std::string filecheck_pattern = R"(
+CHECK: call void @__xla_cpu_runtime_KeySort(i64 4, i64 10, i64 1, {{.*}}, i32 4, i32 3, i1 true
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(hlo_text));
+
+  CpuAotCompilationOptions options{
+      /*triple=*/kTargetTripleForHost, /*cpu_name=*/kTargetCpuForHost,
+      /*features=*/"",
+      /*entry_point_name=*/"entry",
+      /*relocation_model=*/CpuAotCompilationOptions::RelocationModel::Static};
+
+  CompileAheadOfTimeAndVerifyIr(std::move(module), options, filecheck_pattern,
+                                /*match_optimized_ir=*/true);
+}
+
+TEST_F(CpuKeyValueSortTest, SortWithValues) {
+  const std::string hlo_text = R"(
+HloModule KeyValueSort
+
+compare {
+  p.0.lhs = f32[] parameter(0)
+  p.0.rhs = f32[] parameter(1)
+  p.1.lhs = s32[] parameter(2)
+  p.1.rhs = s32[] parameter(3)
+  ROOT lt = pred[] compare(p.0.lhs, p.0.rhs), direction=LT
+}
+
+ENTRY main {
+  a = f32[10] parameter(0)
+  b = s32[10] parameter(1)
+
+  ROOT result = (f32[10], s32[10]) sort(a, b), dimensions={0}, to_apply=compare
+}
 )";
 
   std::string filecheck_pattern = R"(
@@ -58,6 +143,193 @@ CHECK: call void @__xla_cpu_runtime_KeyValueSort
                                 /*match_optimized_ir=*/true);
 }
 
+// Comparators which are lowered to __xla_cpu_runtime_KeySort.
+constexpr absl::string_view kAscending = "compare(lhs, rhs), direction=LT";
+constexpr absl::string_view kDescending = "compare(lhs, rhs), direction=GT";
+constexpr absl::string_view kSwappedDescending =
+    "compare(rhs, lhs), direction=LT";
+
+// Row lengths below and above the one at which KeySort switches from
+// std::stable_sort to a radix sort.
+constexpr int64_t kShortRow = 100;
+constexpr int64_t kLongRow = 1000;
+
+// Returns keys of shape `shape` drawn from `pool`, so that rows have many ties.
+template <typename T>
+Literal RandomKeys(const Shape& shape, const std::vector<T>& pool) {
+  std::minstd_rand0 generator(42);
+  std::uniform_int_distribution<size_t> distribution(0, pool.size() - 1);
+  Literal keys(shape);
+  TF_CHECK_OK(keys.Populate<T>([&](absl::Span<const int64_t> /*index*/) {
+    return pool[distribution(generator)];
+  }));
+  return keys;
+}
+
+std::vector<float> FloatPool(bool nans) {
+  std::vector<float> pool = {-0.0f,
+                             0.0f,
+                             1.0f,
+                             -1.0f,
+                             2.5f,
+                             -1e30f,
+                             1e-30f,
+                             std::numeric_limits<float>::infinity(),
+                             -std::numeric_limits<float>::infinity()};
+  if (nans) {
+    pool.push_back(std::numeric_limits<float>::quiet_NaN());
+    pool.push_back(-std::numeric_limits<float>::quiet_NaN());
+  }
+  return pool;
+}
+
+class CpuKeySortExecutionTest : public CpuCodegenTest {
+ protected:
+  // Sorts `keys` along `dimension` with the comparator root `comparison` of
+  // the parameters `lhs` and `rhs`, once on its own, which is lowered to
+  // __xla_cpu_runtime_KeySort, and once with an iota as a second operand,
+  // which is lowered to the comparator-based __xla_cpu_runtime_KeyValueSort.
+  // Expects bitwise identical keys, which also tells -0 from +0 and NaNs
+  // apart.
+  void ExpectMatchesComparatorSort(const Literal& keys, int64_t dimension,
+                                   absl::string_view comparison) {
+    const Shape& shape = keys.shape();
+    const std::string type =
+        primitive_util::LowercasePrimitiveTypeName(shape.element_type());
+    const std::string keys_shape = ShapeUtil::HumanStringWithLayout(shape);
+    const std::string iota_shape = ShapeUtil::HumanStringWithLayout(
+        ShapeUtil::ChangeElementType(shape, S32));
+    const std::string key_sort = absl::StrFormat(R"(
+HloModule KeySort
+
+compare {
+  lhs = %1$s[] parameter(0)
+  rhs = %1$s[] parameter(1)
+  ROOT compare = pred[] %3$s
+}
+
+ENTRY main {
+  keys = %2$s parameter(0)
+  ROOT sort = %2$s sort(keys), dimensions={%4$d}, is_stable=true,
+    to_apply=compare
+}
+)",
+                                                 type, keys_shape, comparison,
+                                                 dimension);
+    // The iota is part of the result so that it is not simplified away.
+    const std::string key_value_sort = absl::StrFormat(R"(
+HloModule KeyValueSort
+
+compare {
+  lhs = %1$s[] parameter(0)
+  rhs = %1$s[] parameter(1)
+  lhs.index = s32[] parameter(2)
+  rhs.index = s32[] parameter(3)
+  ROOT compare = pred[] %3$s
+}
+
+ENTRY main {
+  keys = %2$s parameter(0)
+  iota = %5$s iota(), iota_dimension=%4$d
+  ROOT sort = (%2$s, %5$s) sort(keys, iota), dimensions={%4$d},
+    is_stable=true, to_apply=compare
+}
+)",
+                                                       type, keys_shape,
+                                                       comparison, dimension,
+                                                       iota_shape);
+
+    TF_ASSERT_OK_AND_ASSIGN(auto key_module,
+                            ParseAndReturnVerifiedModule(key_sort));
+    TF_ASSERT_OK_AND_ASSIGN(auto key_value_module,
+                            ParseAndReturnVerifiedModule(key_value_sort));
+    Literal argument = keys.Clone();
+    Literal actual = ExecuteAndTransfer(std::move(key_module), {&argument})
+                         .Relayout(shape.layout());
+    Literal expected =
+        ExecuteAndTransfer(std::move(key_value_module), {&argument})
+            .DecomposeTuple()[0]
+            .Relayout(shape.layout());
+    ASSERT_EQ(actual.size_bytes(), expected.size_bytes());
+    EXPECT_EQ(std::memcmp(actual.untyped_data(), expected.untyped_data(),
+                          actual.size_bytes()),
+              0)
+        << "Sorting " << keys_shape << " along " << dimension << " with "
+        << comparison << "\nexpected: " << expected.ToString()
+        << "\nactual: " << actual.ToString();
+  }
+};
+
+TEST_F(CpuKeySortExecutionTest, SignedZerosInPartialOrder) {
+  for (int64_t n : {kShortRow, kLongRow}) {
+    Literal keys =
+        RandomKeys(ShapeUtil::MakeShape(F32, {n}), FloatPool(/*nans=*/false));
+    for (absl::string_view comparison :
+         {kAscending, kDescending, kSwappedDescending}) {
+      ExpectMatchesComparatorSort(keys, /*dimension=*/0, comparison);
+    }
+  }
+}
+
+TEST_F(CpuKeySortExecutionTest, NansInTotalOrder) {
+  for (int64_t n : {kShortRow, kLongRow}) {
+    Literal keys =
+        RandomKeys(ShapeUtil::MakeShape(F32, {n}), FloatPool(/*nans=*/true));
+    for (absl::string_view comparison :
+         {kAscending, kDescending, kSwappedDescending}) {
+      ExpectMatchesComparatorSort(
+          keys, /*dimension=*/0, absl::StrCat(comparison, ", type=TOTALORDER"));
+    }
+  }
+}
+
+TEST_F(CpuKeySortExecutionTest, Integers) {
+  for (int64_t n : {kShortRow, kLongRow}) {
+    Literal s32_keys =
+        RandomKeys<int32_t>(ShapeUtil::MakeShape(S32, {n}),
+                            {std::numeric_limits<int32_t>::min(), -256, -1, 0,
+                             1, 255, std::numeric_limits<int32_t>::max()});
+    Literal u8_keys = RandomKeys<uint8_t>(ShapeUtil::MakeShape(U8, {n}),
+                                          {0, 1, 127, 128, 255});
+    for (absl::string_view comparison : {kAscending, kDescending}) {
+      ExpectMatchesComparatorSort(s32_keys, /*dimension=*/0, comparison);
+      ExpectMatchesComparatorSort(u8_keys, /*dimension=*/0, comparison);
+    }
+  }
+}
+
+TEST_F(CpuKeySortExecutionTest, MultipleRows) {
+  for (int64_t n : {kShortRow, kLongRow}) {
+    Literal keys = RandomKeys(ShapeUtil::MakeShapeWithDenseLayout(
+                                  F32, {3, n}, /*minor_to_major=*/{1, 0}),
+                              FloatPool(/*nans=*/false));
+    ExpectMatchesComparatorSort(keys, /*dimension=*/1, kAscending);
+    ExpectMatchesComparatorSort(keys, /*dimension=*/1, kDescending);
+  }
+}
+
+TEST_F(CpuKeySortExecutionTest, StridedRows) {
+  for (int64_t n : {kShortRow, kLongRow}) {
+    // The sorted dimension is not the most minor one, so each row is strided.
+    Literal major = RandomKeys(ShapeUtil::MakeShapeWithDenseLayout(
+                                   F32, {n, 3}, /*minor_to_major=*/{1, 0}),
+                               FloatPool(/*nans=*/true));
+    ExpectMatchesComparatorSort(major, /*dimension=*/0,
+                                "compare(lhs, rhs), direction=LT, "
+                                "type=TOTALORDER");
+    Literal column_major =
+        RandomKeys(ShapeUtil::MakeShapeWithDenseLayout(
+                       F32, {3, n}, /*minor_to_major=*/{0, 1}),
+                   FloatPool(/*nans=*/false));
+    ExpectMatchesComparatorSort(column_major, /*dimension=*/1, kDescending);
+    Literal middle = RandomKeys<int32_t>(
+        ShapeUtil::MakeShapeWithDenseLayout(S32, {2, n, 3},
+                                            /*minor_to_major=*/{2, 1, 0}),
+        {-3, -1, 0, 2, 5});
+    ExpectMatchesComparatorSort(middle, /*dimension=*/1, kAscending);
+  }
+}
+
 }  // namespace
 }  // namespace cpu
 }  // namespace xla
@@ -0,0 +1,135 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "xla/literal.h"
+#include "xla/service/cpu/cpu_executable.h"
+#include "xla/service/cpu/tests/cpu_codegen_test.h"
+#include "xla/service/executable.h"
+#include "xla/tests/literal_test_util.h"
+#include "xla/tests/test_utils.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+using CpuParallelCodegenTest = CpuCodegenTest;
+
+// Compiles a module with several fusions, reductions, a dot and sorts into
+// LLVM modules split into four parts and checks that it computes the same
+// result as when it is compiled into a single module. The sort comparators are
+// called through pointers, so they aren't inlined into the entry function and
+// the split has several functions to distribute.
+TEST_F(CpuParallelCodegenTest, SplitModuleMatchesSingleModule) {
+  const std::string hlo_text = R"(
+HloModule SplitModule
+
+sum {
+  x = f32[] parameter(0)
+  y = f32[] parameter(1)
+  ROOT add = f32[] add(x, y)
+}
+
+less {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  c = f32[] parameter(2)
+  d = f32[] parameter(3)
+  ROOT lt = pred[] compare(a, b), direction=LT
+}
+
+greater {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  c = f32[] parameter(2)
+  d = f32[] parameter(3)
+  ROOT gt = pred[] compare(a, b), direction=GT
+}
+
+less_value {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  c = f32[] parameter(2)
+  d = f32[] parameter(3)
+  ROOT lt = pred[] compare(c, d), direction=LT
+}
+
+ENTRY main {
+  p0 = f32[64,64] parameter(0)
+  p1 = f32[64,64] parameter(1)
+  exp = f32[64,64] exponential(p0)
+  tanh = f32[64,64] tanh(p1)
+  dot = f32[64,64] dot(exp, tanh), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+  sine = f32[64,64] sine(dot)
+  add = f32[64,64] add(sine, p0)
+  zero = f32[] constant(0)
+  rows = f32[64] reduce(add, zero), dimensions={1}, to_apply=sum
+  broadcast = f32[64,64] broadcast(rows), dimensions={0}
+  subtract = f32[64,64] subtract(add, broadcast)
+  transpose = f32[64,64] transpose(subtract), dimensions={1,0}
+  multiply = f32[64,64] multiply(transpose, tanh)
+  columns = f32[64] reduce(multiply, zero), dimensions={0}, to_apply=sum
+  sort0 = (f32[64], f32[64]) sort(rows, columns), dimensions={0},
+    to_apply=less
+  sort1 = (f32[64], f32[64]) sort(columns, rows), dimensions={0},
+    to_apply=greater
+  sort2 = (f32[64,64], f32[64,64]) sort(multiply, add), dimensions={1},
+    to_apply=less_value
+  ROOT tuple = (f32[64,64], (f32[64], f32[64]), (f32[64], f32[64]),
+    (f32[64,64], f32[64,64])) tuple(multiply, sort0, sort1, sort2)
+}
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(hlo_text));
+  TF_ASSERT_OK_AND_ASSIGN(std::vector<Literal> arguments,
+                          MakeFakeArguments(module.get()));
+  std::vector<Literal*> argument_ptrs;
+  for (Literal& argument : arguments) {
+    argument_ptrs.push_back(&argument);
+  }
+
+  std::unique_ptr<HloModule> split_module = module->Clone();
+  DebugOptions debug_options = split_module->config().debug_options();
+  debug_options.set_xla_cpu_parallel_codegen_split_count(4);
+  // Dumping keeps the module whole.
+  debug_options.clear_xla_dump_to();
+  split_module->config().set_debug_options(debug_options);
+
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<Executable> split_executable,
+      test_runner_.CreateExecutable(std::move(split_module),
+                                    /*run_hlo_passes=*/true));
+  EXPECT_GT(static_cast<CpuExecutable*>(split_executable.get())
+                ->NumGeneratedObjects(),
+            1);
+
+  Literal expected = ExecuteAndTransfer(std::move(module), argument_ptrs);
+  std::vector<const Literal*> const_argument_ptrs(argument_ptrs.begin(),
+                                                  argument_ptrs.end());
+  TF_ASSERT_OK_AND_ASSIGN(Literal actual,
+                          test_runner_.ExecuteWithExecutable(
+                              split_executable.get(), const_argument_ptrs));
+  EXPECT_TRUE(LiteralTestUtil::Near(expected, actual, ErrorSpec{1e-5, 1e-5}));
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
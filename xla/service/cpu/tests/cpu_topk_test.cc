@@ -41,7 +41,7 @@ TEST_F(CpuTopKTest, CallRuntimeUnbatched) {
       auto module, HloModule::CreateFromProto(xla_computation.proto(), config));
 
   constexpr char filecheck_pattern[] = R"(
-    CHECK: call void @__xla_cpu_runtime_TopKF32(i64 1, i64 100, i64 10,
+    CHECK: call void @__xla_cpu_runtime_TopKF32(ptr {{.*}}, i64 1, i64 100, i64 10,
   )";
 
   CpuAotCompilationOptions options{
@@ -68,7 +68,7 @@ TEST_F(CpuTopKTest, CallRuntimeBatched) {
       auto module, HloModule::CreateFromProto(xla_computation.proto(), config));
 
   constexpr char filecheck_pattern[] = R"(
-    CHECK: call void @__xla_cpu_runtime_TopKF32(i64 5, i64 100, i64 10,
+    CHECK: call void @__xla_cpu_runtime_TopKF32(ptr {{.*}}, i64 5, i64 100, i64 10,
   )";
 
   CpuAotCompilationOptions options{
@@ -382,6 +382,8 @@ Status GpuCompiler::OptimizeHloModule(
   // "slow" minmax means we propagate nan.
   layout_insensitive_algsimp_opts.set_minmax_propagate_nan(
       !debug_options.xla_gpu_enable_fast_min_max());
+  layout_insensitive_algsimp_opts.set_use_worklist(
+      debug_options.xla_algebraic_simplifier_use_worklist());
 
   const se::Platform* platform = stream_exec->platform();
   if (platform->Name() == "ROCM") {
@@ -789,6 +791,9 @@ Status GpuCompiler::OptimizeHloPostLayoutAssignment(
     // "slow" minmax means we propagate nan.
     options.set_minmax_propagate_nan(
         !hlo_module->config().debug_options().xla_gpu_enable_fast_min_max());
+    options.set_use_worklist(hlo_module->config()
+                                 .debug_options()
+                                 .xla_algebraic_simplifier_use_worklist());
     pipeline.AddPass<HloPassFix<AlgebraicSimplifier>>(options);
 
     // GemmRewriter assumes that all transposes are folded into gemms, but,
@@ -895,6 +900,9 @@ Status GpuCompiler::OptimizeHloPostLayoutAssignment(
     // "slow" minmax means we propagate nan.
     options.set_minmax_propagate_nan(
         !hlo_module->config().debug_options().xla_gpu_enable_fast_min_max());
+    options.set_use_worklist(hlo_module->config()
+                                 .debug_options()
+                                 .xla_algebraic_simplifier_use_worklist());
     pipeline.AddPass<HloPassFix<AlgebraicSimplifier>>(options);
   }
 
@@ -24,6 +24,7 @@ limitations under the License.
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/types/span.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/hlo/ir/hlo_schedule.h"
@@ -356,6 +357,29 @@ class BufferIntervalTree {
   std::list<BufferIntervalTreeNode> node_storage_;
 };
 
+namespace heap_simulator_internal {
+
+// Returns the best-fit chunk of `size` bytes which does not overlap
+// `used_chunks`, with offsets after used chunks rounded up to `alignment`. If
+// preferred_offset is non-negative and the memory there is free, the chunk is
+// placed at that offset. Sweeps the gaps between the used chunks sorted by
+// offset.
+HeapSimulator::Chunk FindBestFitChunk(
+    std::vector<HeapSimulator::Chunk> used_chunks, int64_t size,
+    int64_t alignment, int64_t preferred_offset);
+
+// Like FindBestFitChunk, but reserves `max_size` >= `size` bytes and subtracts
+// the used chunks one at a time, in order, from a map of free chunks. Free
+// chunks are dropped when the part before a used chunk cannot hold `size`
+// bytes, so for max_size > size the result depends on the order of the used
+// chunks. For max_size == size, it returns the same chunk as
+// FindBestFitChunk.
+HeapSimulator::Chunk FindBestFitChunkBySubtraction(
+    absl::Span<const HeapSimulator::Chunk> used_chunks, int64_t size,
+    int64_t max_size, int64_t alignment, int64_t preferred_offset);
+
+}  // namespace heap_simulator_internal
+
 // GlobalDecreasingSizeBestFitHeap collects the live intervals of all buffers,
 // then allocates them in decreasing spatial or temporal size regardless of the
 // alloc/free time. It internally tracks the allocated buffers and their live
@@ -527,10 +551,89 @@ class ChooseBestHeapAlgorithm : public HeapAlgorithm<BufferType> {
   std::vector<std::unique_ptr<HeapAlgorithm<BufferType>>> algorithms_;
 };
 
+// IncrementalHeapSimulator maintains a placement of buffers with known live
+// intervals while callers insert, remove or move them, e.g. to evaluate
+// changes to a schedule or an assignment without re-simulating the whole
+// sequence. Buffers are placed best-fit among the chunks overlapping them in
+// time, which are found through a BufferIntervalTree, and the heap size, the
+// peak of the live bytes and the fragmentation are kept up to date after each
+// change. Unlike GlobalDecreasingSizeBestFitHeap, placements are made in the
+// order of the calls, so the resulting heap depends on that order.
+template <typename BufferType>
+class IncrementalHeapSimulator {
+ public:
+  using Chunk = HeapSimulator::Chunk;
+
+  explicit IncrementalHeapSimulator(int64_t alignment = 1);
+
+  // Places `buffer` of `size` bytes, live over the inclusive interval
+  // [start, end], and returns its chunk. If preferred_offset is non-negative
+  // and the memory there is free during the interval, the buffer is placed at
+  // that offset. The buffer must not already be placed.
+  Chunk Insert(const BufferType* buffer, int64_t size, int64_t start,
+               int64_t end, int64_t preferred_offset = -1);
+
+  // Removes a previously inserted buffer, leaving the other chunks in place.
+  void Remove(const BufferType* buffer);
+
+  // Changes the live interval of a previously inserted buffer and places it
+  // again, keeping its offset if the memory there is still free. Returns the
+  // new chunk.
+  Chunk Move(const BufferType* buffer, int64_t start, int64_t end);
+
+  // Returns the chunk of a previously inserted buffer.
+  const Chunk& GetChunk(const BufferType* buffer) const;
+
+  // Returns the end of the highest placed chunk.
+  int64_t heap_size() const;
+
+  // Returns the largest number of bytes live at any one time, i.e. the heap
+  // size of a placement without fragmentation.
+  int64_t peak_live_bytes() const;
+
+  // Returns the number of bytes of the heap lost to fragmentation.
+  int64_t fragmentation() const { return heap_size() - peak_live_bytes(); }
+
+  int64_t buffer_count() const { return placements_.size(); }
+
+ private:
+  struct Placement {
+    int64_t start;
+    int64_t end;
+    Chunk chunk;
+  };
+
+  void AddPlacement(const Placement& placement);
+  void RemovePlacement(const Placement& placement);
+
+  // Adds `delta` to the live bytes of the times in [start, end], growing the
+  // time horizon as needed.
+  void AddLiveBytes(int64_t start, int64_t end, int64_t delta);
+  void AddLiveBytes(int64_t node, int64_t node_start, int64_t node_end,
+                    int64_t start, int64_t end, int64_t delta);
+
+  int64_t alignment_;
+  BufferIntervalTree interval_tree_;
+  absl::flat_hash_map<const BufferType*, Placement> placements_;
+  // The ends of all placed chunks, whose maximum is the heap size.
+  std::multiset<int64_t> chunk_ends_;
+
+  // A segment tree over time for the live bytes. live_max_[node] is the
+  // maximum of the live bytes in the subtree of `node`, including the bytes
+  // in live_add_[node] which were added to the whole subtree. The root is
+  // node 1 and spans the times [0, time_horizon_).
+  int64_t time_horizon_ = 0;
+  std::vector<int64_t> live_max_;
+  std::vector<int64_t> live_add_;
+};
+
 extern template class GlobalDecreasingSizeBestFitHeap<HloValue>;
 extern template class GlobalDecreasingSizeBestFitHeap<
     MemorySpaceAssignmentRepacker::AllocationBlock>;
 extern template class ChooseBestHeapAlgorithm<HloValue>;
+extern template class IncrementalHeapSimulator<HloValue>;
+extern template class IncrementalHeapSimulator<
+    MemorySpaceAssignmentRepacker::AllocationBlock>;
 
 }  // namespace xla
 
@@ -15,11 +15,17 @@ limitations under the License.
 
 #include "xla/service/heap_simulator.h"
 
+#include <cstdint>
 #include <memory>
+#include <random>
+#include <string>
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/hlo/ir/hlo_module.h"
@@ -27,11 +33,13 @@ limitations under the License.
 #include "xla/service/buffer_value.h"
 #include "xla/service/hlo_ordering.h"
 #include "xla/service/hlo_value.h"
+#include "xla/service/memory_space_assignment_repacking.h"
 #include "xla/service/tuple_points_to_analysis.h"
 #include "xla/status_macros.h"
 #include "xla/tests/hlo_test_base.h"
 #include "tsl/lib/core/status_test_util.h"
 #include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace xla {
 namespace {
@@ -1397,6 +1405,43 @@ TEST_F(GlobalDecreasingSizeBestFitHeapTest, ChunkCandidate) {
   // Preferred offset 15 could not be given because it is occupied.
 }
 
+// The sweep used when no colocation is larger than the buffer must find the
+// same chunk as subtracting the used chunks from a map of free chunks.
+TEST(FindBestFitChunkTest, SweepMatchesSubtraction) {
+  using Chunk = HeapSimulator::Chunk;
+  std::minstd_rand0 engine(42);
+  auto uniform = [&](int64_t limit) {
+    return std::uniform_int_distribution<int64_t>(0, limit - 1)(engine);
+  };
+  for (int iteration = 0; iteration < 100000; ++iteration) {
+    const int64_t alignment = int64_t{2} << uniform(3);
+    std::vector<Chunk> used_chunks(uniform(12));
+    for (Chunk& chunk : used_chunks) {
+      // Used chunks may overlap each other, as they can belong to different
+      // points in time.
+      chunk = Chunk{uniform(40) * alignment, 1 + uniform(50)};
+    }
+    const int64_t size = 1 + uniform(40);
+    int64_t preferred_offset = -1;
+    if (uniform(3) != 0) {
+      preferred_offset = uniform(60) * alignment + uniform(2);
+    }
+    Chunk swept = heap_simulator_internal::FindBestFitChunk(
+        used_chunks, size, alignment, preferred_offset);
+    Chunk subtracted = heap_simulator_internal::FindBestFitChunkBySubtraction(
+        used_chunks, size, /*max_size=*/size, alignment, preferred_offset);
+    ASSERT_EQ(swept.size, subtracted.size);
+    ASSERT_EQ(swept.offset, subtracted.offset)
+        << "size " << size << ", alignment " << alignment
+        << ", preferred offset " << preferred_offset << ", used chunks "
+        << absl::StrJoin(used_chunks, " ",
+                         [](std::string* out, const Chunk& chunk) {
+                           absl::StrAppend(out, "[", chunk.offset, ", ",
+                                           chunk.chunk_end(), ")");
+                         });
+  }
+}
+
 class ConstrainedGlobalDecreasingSizeBestFitHeapTest
     : public HeapAlgorithmTestBase {};
 
@@ -1696,5 +1741,130 @@ TEST_F(IntervalTreeTest, ThreeLevelsRightLeftChunkDifferent) {
   ASSERT_EQ(tree.GetRoot(), nullptr);
 }
 
+class IncrementalHeapSimulatorTest : public HeapAlgorithmTestBase {
+ protected:
+  IncrementalHeapSimulator<HloValue> heap_;
+};
+
+TEST_F(IncrementalHeapSimulatorTest, InsertRemoveAndMove) {
+  using Chunk = HeapSimulator::Chunk;
+  EXPECT_EQ(heap_.Insert(buffer_a_, 10, 0, 5), (Chunk{0, 10}));
+  EXPECT_EQ(heap_.Insert(buffer_b_, 20, 3, 8), (Chunk{10, 20}));
+  // Fits exactly below b, after a is freed.
+  EXPECT_EQ(heap_.Insert(buffer_c_, 10, 6, 9), (Chunk{0, 10}));
+  EXPECT_EQ(heap_.heap_size(), 30);
+  EXPECT_EQ(heap_.peak_live_bytes(), 30);
+  EXPECT_EQ(heap_.fragmentation(), 0);
+  EXPECT_EQ(heap_.buffer_count(), 3);
+
+  heap_.Remove(buffer_b_);
+  EXPECT_EQ(heap_.heap_size(), 10);
+  EXPECT_EQ(heap_.peak_live_bytes(), 10);
+
+  // Moving a past the time horizon keeps its offset and the live bytes.
+  EXPECT_EQ(heap_.Move(buffer_a_, 100, 200), (Chunk{0, 10}));
+  EXPECT_EQ(heap_.heap_size(), 10);
+  EXPECT_EQ(heap_.peak_live_bytes(), 10);
+  // Moving a to overlap c places it above c.
+  EXPECT_EQ(heap_.Move(buffer_a_, 7, 7), (Chunk{10, 10}));
+  EXPECT_EQ(heap_.GetChunk(buffer_a_), (Chunk{10, 10}));
+  EXPECT_EQ(heap_.peak_live_bytes(), 20);
+}
+
+TEST_F(IncrementalHeapSimulatorTest, Fragmentation) {
+  using Chunk = HeapSimulator::Chunk;
+  EXPECT_EQ(heap_.Insert(buffer_a_, 10, 0, 2), (Chunk{0, 10}));
+  EXPECT_EQ(heap_.Insert(buffer_b_, 10, 0, 5), (Chunk{10, 10}));
+  heap_.Remove(buffer_a_);
+  // The hole left by a is too small for c.
+  EXPECT_EQ(heap_.Insert(buffer_c_, 20, 3, 5), (Chunk{20, 20}));
+  EXPECT_EQ(heap_.heap_size(), 40);
+  EXPECT_EQ(heap_.peak_live_bytes(), 30);
+  EXPECT_EQ(heap_.fragmentation(), 10);
+
+  // Moving b out of c's interval and reinserting c removes the hole.
+  heap_.Move(buffer_b_, 6, 8);
+  heap_.Remove(buffer_c_);
+  EXPECT_EQ(heap_.Insert(buffer_c_, 20, 3, 5), (Chunk{0, 20}));
+  EXPECT_EQ(heap_.heap_size(), 20);
+  EXPECT_EQ(heap_.fragmentation(), 0);
+}
+
+TEST_F(IncrementalHeapSimulatorTest, PreferredOffsetAndAlignment) {
+  using Chunk = HeapSimulator::Chunk;
+  IncrementalHeapSimulator<HloValue> heap(/*alignment=*/8);
+  EXPECT_EQ(heap.Insert(buffer_a_, 5, 0, 4, /*preferred_offset=*/16),
+            (Chunk{16, 5}));
+  // The preferred offset is occupied; the gap below a is the best fit.
+  EXPECT_EQ(heap.Insert(buffer_b_, 12, 2, 3, /*preferred_offset=*/16),
+            (Chunk{0, 12}));
+  // Above a, rounded up to the alignment.
+  EXPECT_EQ(heap.Insert(buffer_c_, 8, 2, 2), (Chunk{24, 8}));
+  EXPECT_EQ(heap.heap_size(), 32);
+  EXPECT_EQ(heap.peak_live_bytes(), 25);
+}
+
+using AllocationBlock = MemorySpaceAssignmentRepacker::AllocationBlock;
+
+// Buffers with pseudo-random sizes and live intervals of up to 64 steps in a
+// schedule of `count` steps.
+std::vector<AllocationBlock> MakeBenchmarkBlocks(int64_t count) {
+  std::vector<AllocationBlock> blocks(count);
+  for (int64_t i = 0; i < count; ++i) {
+    AllocationBlock& block = blocks[i];
+    block.id = i;
+    block.start_time = (i * 7919) % count;
+    block.end_time = block.start_time + 1 + (i * 104729) % 64;
+    block.size = 1 + (i * 31337) % 4096;
+    block.offset = -1;
+    block.initial_offset = -1;
+  }
+  return blocks;
+}
+
+// Places all the buffers from scratch, as callers exploring a change to the
+// schedule do without an incremental simulator.
+void BM_HeapFullSimulation(::testing::benchmark::State& state) {
+  std::vector<AllocationBlock> blocks = MakeBenchmarkBlocks(state.range(0));
+  std::vector<std::pair<int64_t, const AllocationBlock*>> events;
+  for (const AllocationBlock& block : blocks) {
+    events.push_back({2 * block.start_time, &block});
+    events.push_back({2 * block.end_time + 1, &block});
+  }
+  absl::c_sort(events);
+  for (auto s : state) {
+    GlobalDecreasingSizeBestFitHeap<AllocationBlock> heap(/*alignment=*/1);
+    for (const auto& [time, block] : events) {
+      if (time % 2 == 0) {
+        heap.Alloc(block, block->size);
+      } else {
+        heap.Free(block, block->size);
+      }
+    }
+    tsl::testing::DoNotOptimize(heap.Finish().heap_size);
+  }
+}
+
+// Moves one buffer at a time and queries the updated heap.
+void BM_HeapIncrementalMove(::testing::benchmark::State& state) {
+  std::vector<AllocationBlock> blocks = MakeBenchmarkBlocks(state.range(0));
+  IncrementalHeapSimulator<AllocationBlock> heap;
+  for (const AllocationBlock& block : blocks) {
+    heap.Insert(&block, block.size, block.start_time, block.end_time);
+  }
+  int64_t iteration = 0;
+  for (auto s : state) {
+    // Alternately delay a buffer by one step and move it back.
+    const AllocationBlock& block = blocks[(iteration / 2) % blocks.size()];
+    const int64_t delay = iteration % 2 == 0 ? 1 : 0;
+    heap.Move(&block, block.start_time + delay, block.end_time + delay);
+    tsl::testing::DoNotOptimize(heap.heap_size() + heap.fragmentation());
+    ++iteration;
+  }
+}
+
+BENCHMARK(BM_HeapFullSimulation)->Arg(1 << 10)->Arg(1 << 14);
+BENCHMARK(BM_HeapIncrementalMove)->Arg(1 << 10)->Arg(1 << 14);
+
 }  // namespace
 }  // namespace xla
@@ -16,11 +16,15 @@ limitations under the License.
 #include "xla/service/hlo_computation_deduplicator.h"
 
 #include <algorithm>
-#include <string>
+#include <cstdint>
 #include <utility>
+#include <vector>
 
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/service/hlo_structural_hasher.h"
 
 namespace xla {
 
@@ -39,21 +43,12 @@ bool HloComputationDeduplicator::ContainsLargeConstants(HloComputation* comp) {
 StatusOr<bool> HloComputationDeduplicator::Run(
     HloModule* module,
     const absl::flat_hash_set<absl::string_view>& execution_threads) {
-  absl::flat_hash_map<std::string, HloComputation*> unique_comps;
+  // Candidates are bucketed by structural hash, which is computed once per
+  // computation and reuses the hashes of the called computations.
+  HloStructuralHasher hasher;
+  absl::flat_hash_map<uint64_t, std::vector<HloComputation*>> unique_comps;
   absl::flat_hash_map<HloComputation*, HloComputation*> replacement;
 
-  // Options to produce a String representation that is similar to
-  // HloPrintOptions::Fingerprint() but does not eliminate constants and not
-  // dive into sub-computations.
-  HloPrintOptions options = HloPrintOptions::Canonical();
-  options.set_print_subcomputation_mode(
-      HloPrintOptions::PrintSubcomputationMode::kOff);
-  options.set_print_infeed_outfeed_config(false);
-  options.set_print_only_essential_constants(true);
-  options.set_print_operand_shape(true);
-  options.set_print_ids(false);
-  options.set_canonicalize_computations(true);
-
   // This comparison function will be used to compare called subcomputations.
   // Since computations in the for-loop below are called in "PostOrder" format
   // we would have visited callees before the caller. If the callees are marked
@@ -82,21 +77,23 @@ StatusOr<bool> HloComputationDeduplicator::Run(
        module->MakeComputationPostOrder(execution_threads)) {
     // Ignore entry computation since it is called from outside and computations
     // with large number of instructions or large-size constants due to increase
-    // in time taken to stringify.
+    // in time taken to compare them.
     if (comp->IsEntryComputation() || comp->instruction_count() > 128 ||
         ContainsLargeConstants(comp)) {
       continue;
     }
-    std::string comp_str = comp->ToString(options);
-    auto poss_dup = unique_comps.find(comp_str);
-    if (poss_dup != unique_comps.end() &&
-        poss_dup->second->Equal(*comp, /* is_layout_sensitive = */ true,
-                                comp_eq)) {
-      VLOG(2) << "Replacing " << comp->name() << " with "
-              << poss_dup->second->name();
-      replacement[comp] = poss_dup->second;
+    std::vector<HloComputation*>& candidates =
+        unique_comps[hasher.ComputationHash(comp)];
+    auto poss_dup =
+        absl::c_find_if(candidates, [&](const HloComputation* candidate) {
+          return candidate->Equal(*comp, /* is_layout_sensitive = */ true,
+                                  comp_eq);
+        });
+    if (poss_dup != candidates.end()) {
+      VLOG(2) << "Replacing " << comp->name() << " with " << (*poss_dup)->name();
+      replacement[comp] = *poss_dup;
     } else {
-      unique_comps[std::move(comp_str)] = comp;
+      candidates.push_back(comp);
     }
   }
   module->ReplaceComputations(replacement);
@@ -0,0 +1,135 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/hlo_computation_pass.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+#include "tsl/platform/blocking_counter.h"
+#include "tsl/platform/errors.h"
+#include "tsl/platform/logging.h"
+
+namespace xla {
+
+namespace {
+
+// Partitions the computations into levels such that a computation only calls
+// computations of lower levels. Computations of the same level can be
+// processed concurrently. Within a level computations stay in post order.
+std::vector<std::vector<HloComputation*>> MakeComputationLevels(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  std::vector<std::vector<HloComputation*>> levels;
+  absl::flat_hash_map<const HloComputation*, int64_t> level_of;
+  for (HloComputation* computation :
+       module->MakeComputationPostOrder(execution_threads)) {
+    int64_t level = 0;
+    for (const HloInstruction* instruction : computation->instructions()) {
+      for (const HloComputation* callee : instruction->called_computations()) {
+        auto it = level_of.find(callee);
+        if (it != level_of.end()) {
+          level = std::max(level, it->second + 1);
+        }
+      }
+    }
+    level_of[computation] = level;
+    if (level >= levels.size()) {
+      levels.resize(level + 1);
+    }
+    levels[level].push_back(computation);
+  }
+  return levels;
+}
+
+}  // namespace
+
+StatusOr<bool> HloComputationPass::RunOnComputations(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads,
+    tsl::thread::ThreadPool* thread_pool) {
+  std::vector<std::vector<HloComputation*>> levels =
+      MakeComputationLevels(module, execution_threads);
+
+  // When computations are processed concurrently, the final ids and names of
+  // the instructions they add are assigned afterwards, both because the
+  // module's id counter and name uniquer are not thread-safe and to make them
+  // independent of the order in which computations finish. If uniquification
+  // is already deferred by an enclosing caller, that caller assigns them.
+  const bool parallel =
+      thread_pool != nullptr &&
+      absl::c_any_of(levels, [](const std::vector<HloComputation*>& level) {
+        return level.size() > 1;
+      });
+  const bool defer_uniquification =
+      parallel && !module->defer_instruction_uniquification();
+  if (defer_uniquification) {
+    module->DeferInstructionUniquification();
+  }
+  Status status;
+  bool changed = false;
+  for (const std::vector<HloComputation*>& level : levels) {
+    std::vector<StatusOr<bool>> results(level.size(), false);
+    if (thread_pool == nullptr || level.size() == 1) {
+      for (int64_t i = 0; i < level.size(); ++i) {
+        results[i] = RunOnComputation(level[i]);
+        if (!results[i].ok()) {
+          break;
+        }
+      }
+    } else {
+      VLOG(2) << "Running " << name() << " on " << level.size()
+              << " computations in parallel";
+      tsl::BlockingCounter counter(level.size());
+      for (int64_t i = 0; i < level.size(); ++i) {
+        thread_pool->Schedule([&, i] {
+          results[i] = RunOnComputation(level[i]);
+          counter.DecrementCount();
+        });
+      }
+      counter.Wait();
+    }
+    // Report the first failure in post order so that errors are deterministic.
+    for (const StatusOr<bool>& result : results) {
+      if (!result.ok()) {
+        status = result.status();
+        break;
+      }
+      changed |= *result;
+    }
+    if (!status.ok()) {
+      break;
+    }
+  }
+  if (defer_uniquification) {
+    // Computations are processed in level order, as in a serial run.
+    std::vector<HloComputation*> computations;
+    for (const std::vector<HloComputation*>& level : levels) {
+      computations.insert(computations.end(), level.begin(), level.end());
+    }
+    module->UniquifyDeferredInstructions(computations);
+  }
+  TF_RETURN_IF_ERROR(status);
+
+  TF_ASSIGN_OR_RETURN(bool module_changed,
+                      RunOnModuleAfterComputations(module, execution_threads));
+  return changed || module_changed;
+}
+
+}  // namespace xla
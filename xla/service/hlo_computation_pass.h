@@ -0,0 +1,81 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_HLO_COMPUTATION_PASS_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_HLO_COMPUTATION_PASS_H_
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/hlo_pass_interface.h"
+#include "xla/statusor.h"
+#include "tsl/platform/threadpool.h"
+
+namespace xla {
+
+// Base class for module passes which rewrite each computation independently of
+// the others. HloPassPipeline runs such passes over the computations of a
+// module on a thread pool (see --xla_hlo_pass_computation_parallelism).
+//
+// RunOnComputation may only mutate the computation it is given: it must not add
+// or remove computations and must not modify any other computation. It may
+// read the computations called by its argument, which are always processed
+// before their callers.
+//
+// When computations are processed concurrently, instructions added while the
+// pass runs get provisional unique ids and keep their names until all
+// computations have been processed. Final ids and names are then assigned in
+// the order a serial run would have created them, so the resulting module does
+// not depend on the number of threads (unless the pass removes instructions it
+// added, whose ids and names a serial run consumes). Consequently
+// RunOnComputation must not rely on the names of instructions it adds.
+class HloComputationPass : public HloModulePass {
+ public:
+  using HloPassInterface::Run;
+  StatusOr<bool> Run(HloModule* module,
+                     const absl::flat_hash_set<absl::string_view>&
+                         execution_threads) override {
+    return RunOnComputations(module, execution_threads,
+                             /*thread_pool=*/nullptr);
+  }
+
+  // Runs the pass, processing computations which do not call each other on
+  // `thread_pool`. A null `thread_pool` processes all computations on the
+  // calling thread.
+  StatusOr<bool> RunOnComputations(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads,
+      tsl::thread::ThreadPool* thread_pool);
+
+  bool IsComputationPass() override { return true; }
+
+ protected:
+  // Runs the pass on a single computation. Returns whether the computation was
+  // changed.
+  virtual StatusOr<bool> RunOnComputation(HloComputation* computation) = 0;
+
+  // Runs on the calling thread once all computations have been processed, for
+  // work which is not computation-local such as removing dead computations.
+  virtual StatusOr<bool> RunOnModuleAfterComputations(
+      HloModule* module,
+      const absl::flat_hash_set<absl::string_view>& execution_threads) {
+    return false;
+  }
+};
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_HLO_COMPUTATION_PASS_H_
@@ -75,6 +75,8 @@ StatusOr<bool> HloConstantFolding::Run(
   auto evaluator = std::make_unique<HloEvaluator>(/*max_loop_iterations=*/0);
   // fast-path lets us e.g. use Eigen for matmuls.
   evaluator->set_use_fast_path(true);
+  evaluator->set_memory_limit_bytes(max_evaluation_memory_bytes_);
+  peak_evaluation_memory_bytes_ = 0;
 
   bool changed = false;
 
@@ -232,9 +234,13 @@ StatusOr<bool> HloConstantFolding::Run(
       // Currently we skip unimplemented operations.
       // TODO(b/35975797): Fold constant computations for more operations.
       Literal result;
-      if (!evaluator->TryEvaluate(
-              instruction, &result,
-              /*recursively_evaluate_nonconstant_operands=*/true)) {
+      evaluator->ResetPeakMemoryUsage();
+      bool evaluated = evaluator->TryEvaluate(
+          instruction, &result,
+          /*recursively_evaluate_nonconstant_operands=*/true);
+      peak_evaluation_memory_bytes_ = std::max(
+          peak_evaluation_memory_bytes_, evaluator->peak_memory_usage_bytes());
+      if (!evaluated) {
         VLOG(2) << "Constant folding failed for instruction: "
                 << instruction->ToString();
         continue;
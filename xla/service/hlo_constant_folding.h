@@ -25,6 +25,12 @@ namespace xla {
 // computation on constants.
 class HloConstantFolding : public HloModulePass {
  public:
+  // Instructions whose evaluation needs more than
+  // `max_evaluation_memory_bytes` of intermediate results are not folded. Zero
+  // or negative values disable the limit.
+  explicit HloConstantFolding(int64_t max_evaluation_memory_bytes = 0)
+      : max_evaluation_memory_bytes_(max_evaluation_memory_bytes) {}
+
   absl::string_view name() const override { return "constant_folding"; }
 
   // Run constant folding operations on the given module. Returns whether the
@@ -34,7 +40,16 @@ class HloConstantFolding : public HloModulePass {
       HloModule* module,
       const absl::flat_hash_set<absl::string_view>& execution_threads) override;
 
+  // The largest amount of memory needed to fold a single instruction during
+  // the last run.
+  int64_t peak_evaluation_memory_bytes() const {
+    return peak_evaluation_memory_bytes_;
+  }
+
  private:
+  const int64_t max_evaluation_memory_bytes_;
+  int64_t peak_evaluation_memory_bytes_ = 0;
+
   // Number of slow constant-folds we've encountered.  Used for firing
   // SlowOperationAlarms.
   static std::atomic<int64_t> slow_op_counter_;
@@ -346,6 +346,30 @@ TEST_F(HloConstantFoldingTest, FoldOpsWhereOneOperandIsBroadcast) {
                                   )));
 }
 
+TEST_F(HloConstantFoldingTest, RespectsEvaluationMemoryLimit) {
+  const char* const kModuleStr = R"(
+  HloModule test
+
+  ENTRY entry {
+    c = f32[4] constant({0,1,2,3})
+    ROOT add = f32[4] add(f32[4] broadcast(f32[] constant(5)), c)
+  })";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kModuleStr));
+  // Evaluating the add needs both the broadcast and the result at once.
+  HloConstantFolding limited(/*max_evaluation_memory_bytes=*/16);
+  TF_ASSERT_OK_AND_ASSIGN(bool result, RunHloPass(&limited, module.get()));
+  EXPECT_FALSE(result);
+
+  HloConstantFolding unlimited;
+  TF_ASSERT_OK_AND_ASSIGN(result, RunHloPass(&unlimited, module.get()));
+  EXPECT_TRUE(result);
+  EXPECT_THAT(module->entry_computation()->root_instruction(),
+              GmockMatch(m::Constant()));
+  // The broadcast and the result, 16 bytes each.
+  EXPECT_EQ(unlimited.peak_evaluation_memory_bytes(), 32);
+}
+
 TEST_F(HloConstantFoldingTest, BigReduceWindow) {
   constexpr absl::string_view kModuleStr = R"(
     HloModule test
@@ -34,6 +34,7 @@ limitations under the License.
 #include "xla/layout_util.h"
 #include "xla/literal.h"
 #include "xla/service/hlo_domain_map.h"
+#include "xla/service/hlo_structural_hasher.h"
 #include "xla/shape_util.h"
 #include "xla/types.h"
 #include "tsl/platform/errors.h"
@@ -157,9 +158,7 @@ struct CseKey {
       }
     }
 
-    for (auto c : instruction->called_computations()) {
-      h = H::combine(std::move(h), c->root_instruction()->opcode());
-    }
+    h = H::combine(std::move(h), key.called_computations_hash);
     switch (instruction->opcode()) {
       case HloOpcode::kSlice:
         return H::combine(std::move(h), instruction->slice_starts(),
@@ -214,13 +213,17 @@ struct CseKey {
     }
   }
   HloInstruction* hlo;
+  // Structural hash of the computations called by `hlo`.
+  uint64_t called_computations_hash;
 };
 
 }  // namespace
 
-StatusOr<bool> HloCSE::Run(
-    HloModule* module,
-    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+StatusOr<bool> HloCSE::RunOnComputation(HloComputation* computation) {
+  if (only_fusion_computations_ && !computation->IsFusionComputation()) {
+    return false;
+  }
+
   bool changed = false;
 
   const auto eq_instructions = [&](const HloInstruction* a,
@@ -236,9 +239,13 @@ StatusOr<bool> HloCSE::Run(
                 ? ShapeUtil::Equal(a->shape(), b->shape())
                 : ShapeUtil::Compatible(a->shape(), b->shape()));
   };
-  const auto eq_computations = [](const HloComputation* lhs,
-                                  const HloComputation* rhs) {
-    return *lhs == *rhs;
+  // Called computations have been processed already, so their structural
+  // hashes are final and rule out most unequal pairs without comparing them.
+  const auto eq_computations = [&](const HloComputation* lhs,
+                                   const HloComputation* rhs) {
+    return lhs == rhs ||
+           (hasher_.ComputationHash(lhs) == hasher_.ComputationHash(rhs) &&
+            *lhs == *rhs);
   };
 
   auto cse_equal = [&](const CseKey& lhs, const CseKey& rhs) {
@@ -246,61 +253,56 @@ StatusOr<bool> HloCSE::Run(
         *rhs.hlo, eq_instructions, eq_computations, is_layout_sensitive_);
   };
 
-  for (auto* computation : module->computations(execution_threads)) {
-    if (only_fusion_computations_ && !computation->IsFusionComputation()) {
+  TF_ASSIGN_OR_RETURN(bool combined,
+                      is_layout_sensitive_
+                          ? CombineConstants<true>(computation)
+                          : CombineConstants<false>(computation));
+  changed |= combined;
+
+  // HLO instructions are grouped into equivalency classes by using the
+  // cse_equal predicate defined above. This set holds a representative
+  // instruction for each class.
+  absl::flat_hash_set<CseKey, absl::Hash<CseKey>, decltype(cse_equal)>
+      representatives(/*N=*/computation->instruction_count() + 1,
+                      absl::Hash<CseKey>{}, cse_equal);
+  for (auto instruction : computation->MakeInstructionPostOrder()) {
+    // If the instruction has zero operands (constants, parameters, etc.) skip
+    // over it.
+    if (instruction->operand_count() == 0 &&
+        instruction->opcode() != HloOpcode::kPartitionId &&
+        instruction->opcode() != HloOpcode::kReplicaId) {
+      continue;
+    }
+    // Skip instructions which have side effects.
+    if (instruction->HasSideEffect()) {
       continue;
     }
 
-    TF_ASSIGN_OR_RETURN(bool combined,
-                        is_layout_sensitive_
-                            ? CombineConstants<true>(computation)
-                            : CombineConstants<false>(computation));
-    changed |= combined;
-
-    // HLO instructions are grouped into equivalency classes by using the
-    // cse_equal predicate defined above. This set holds a representative
-    // instruction for each class.
-    absl::flat_hash_set<CseKey, absl::Hash<CseKey>, decltype(cse_equal)>
-        representatives(/*N=*/computation->instruction_count() + 1,
-                        absl::Hash<CseKey>{}, cse_equal);
-    for (auto instruction : computation->MakeInstructionPostOrder()) {
-      // If the instruction has zero operands (constants, parameters, etc.) skip
-      // over it.
-      if (instruction->operand_count() == 0 &&
-          instruction->opcode() != HloOpcode::kPartitionId &&
-          instruction->opcode() != HloOpcode::kReplicaId) {
-        continue;
-      }
-      // Skip instructions which have side effects.
-      if (instruction->HasSideEffect()) {
-        continue;
-      }
-
-      auto pair = representatives.insert(CseKey{instruction});
-      if (!pair.second) {
-        HloInstruction* equivalent_instruction = pair.first->hlo;
-        TF_RETURN_IF_ERROR(
-            instruction->ReplaceAllUsesWith(equivalent_instruction));
-        TF_RETURN_IF_ERROR(
-            computation->RemoveInstructionAndUnusedOperands(instruction));
-        changed = true;
+    auto pair = representatives.insert(
+        CseKey{instruction, hasher_.CalledComputationsHash(instruction)});
+    if (!pair.second) {
+      HloInstruction* equivalent_instruction = pair.first->hlo;
+      TF_RETURN_IF_ERROR(
+          instruction->ReplaceAllUsesWith(equivalent_instruction));
+      TF_RETURN_IF_ERROR(
+          computation->RemoveInstructionAndUnusedOperands(instruction));
+      changed = true;
+      continue;
+    }
+    for (int64_t i = 0; i < instruction->operand_count(); ++i) {
+      HloInstruction* a = instruction->mutable_operand(i);
+      if (a->opcode() != HloOpcode::kIota) {
         continue;
       }
-      for (int64_t i = 0; i < instruction->operand_count(); ++i) {
-        HloInstruction* a = instruction->mutable_operand(i);
-        if (a->opcode() != HloOpcode::kIota) {
+      for (int64_t j = i + 1; j < instruction->operand_count(); ++j) {
+        HloInstruction* b = instruction->mutable_operand(j);
+        if (a == b || !eq_instructions(a, b)) {
           continue;
         }
-        for (int64_t j = i + 1; j < instruction->operand_count(); ++j) {
-          HloInstruction* b = instruction->mutable_operand(j);
-          if (a == b || !eq_instructions(a, b)) {
-            continue;
-          }
-          TF_RETURN_IF_ERROR(instruction->ReplaceOperandWith(j, a));
-          changed = true;
-          if (b->IsDead()) {
-            TF_RETURN_IF_ERROR(computation->RemoveInstruction(b));
-          }
+        TF_RETURN_IF_ERROR(instruction->ReplaceOperandWith(j, a));
+        changed = true;
+        if (b->IsDead()) {
+          TF_RETURN_IF_ERROR(computation->RemoveInstruction(b));
         }
       }
     }
@@ -308,4 +310,12 @@ StatusOr<bool> HloCSE::Run(
   return changed;
 }
 
+StatusOr<bool> HloCSE::RunOnModuleAfterComputations(
+    HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  // Later passes may change the hashed computations.
+  hasher_.Clear();
+  return false;
+}
+
 }  // namespace xla
@@ -17,7 +17,8 @@ limitations under the License.
 #define TENSORFLOW_COMPILER_XLA_SERVICE_HLO_CSE_H_
 
 #include "xla/hlo/ir/hlo_module.h"
-#include "xla/service/hlo_pass_interface.h"
+#include "xla/service/hlo_computation_pass.h"
+#include "xla/service/hlo_structural_hasher.h"
 
 namespace xla {
 
@@ -25,7 +26,12 @@ namespace xla {
 // and identical instructions with the same operands are commoned. The pass
 // iterates over the instructions in topological order which enables the pass to
 // find arbitrarily large common expressions.
-class HloCSE : public HloModulePass {
+//
+// CSE is computation-local: called computations are only compared, after they
+// have themselves been processed. Instructions calling computations, such as
+// fusions, are bucketed by the structural hashes of their callees, so that
+// only instructions calling structurally identical computations are compared.
+class HloCSE : public HloComputationPass {
  public:
   // If is_layout_sensitive is true, then the simplifier preserves layout during
   // transformation. Otherwise, layout is ignored.
@@ -36,16 +42,20 @@ class HloCSE : public HloModulePass {
   ~HloCSE() override = default;
   absl::string_view name() const override { return "cse"; }
 
-  // Run CSE on the given module. Returns whether the module was changed (common
-  // subexpressions were found and eliminated).
-  using HloPassInterface::Run;
-  StatusOr<bool> Run(
+ private:
+  // Run CSE on the given computation. Returns whether the computation was
+  // changed (common subexpressions were found and eliminated).
+  StatusOr<bool> RunOnComputation(HloComputation* computation) override;
+
+  StatusOr<bool> RunOnModuleAfterComputations(
       HloModule* module,
-      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+      const absl::flat_hash_set<absl::string_view>& execution_threads)
+      override;
 
- private:
   const bool is_layout_sensitive_;
   const bool only_fusion_computations_;
+  // Hashes of the computations processed in the current run.
+  HloStructuralHasher hasher_;
 };
 
 }  // namespace xla
@@ -165,35 +165,20 @@ StatusOr<bool> HloDCE::RecursivelyRemoveDeadComputations(
   return module_contains_dead_code;
 }
 
-StatusOr<bool> HloDCE::Run(
+StatusOr<bool> HloDCE::RunOnModuleAfterComputations(
     HloModule* module,
     const absl::flat_hash_set<absl::string_view>& execution_threads) {
-  bool changed = false;
-
-  VLOG(2) << "Before dce:";
-  XLA_VLOG_LINES(2, module->ToString());
-
-  // Run DCE on each computation.
-  for (auto* computation :
-       module->MakeComputationPostOrder(execution_threads)) {
-    TF_ASSIGN_OR_RETURN(
-        bool changed_for_computation,
-        RunOnComputation(computation, remove_cross_partition_collective_ops_));
-    changed |= changed_for_computation;
-  }
-
   // Now DCE HloComputations.  Keep doing passes through the module until no
   // more computations can be eliminated. The function removes all
   // subcomputations that can be proved to have no remaining live callers.
   TF_ASSIGN_OR_RETURN(
       bool module_contains_dead_code,
       RecursivelyRemoveDeadComputations(module, execution_threads));
-  changed |= module_contains_dead_code;
 
   VLOG(2) << "After dce:";
   XLA_VLOG_LINES(2, module->ToString());
 
-  return changed;
+  return module_contains_dead_code;
 }
 
 }  // namespace xla
@@ -20,7 +20,7 @@ limitations under the License.
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/hlo/ir/hlo_module.h"
-#include "xla/service/hlo_pass_interface.h"
+#include "xla/service/hlo_computation_pass.h"
 #include "xla/statusor.h"
 
 namespace xla {
@@ -34,7 +34,10 @@ namespace xla {
 //
 // This pass does not remove dead parameter instructions, as parameter
 // instructions cannot be deleted.
-class HloDCE : public HloModulePass {
+//
+// Dead instructions are removed computation by computation; dead computations
+// are removed once all computations have been processed.
+class HloDCE : public HloComputationPass {
  public:
   HloDCE() : remove_cross_partition_collective_ops_(false) {}
   explicit HloDCE(bool remove_cross_partition_collective_ops)
@@ -47,14 +50,18 @@ class HloDCE : public HloModulePass {
   static StatusOr<bool> RunOnComputation(
       HloComputation* computation, bool remove_cross_partition_collective_ops);
 
-  // Run the pass on the given module. Returns whether the module was changed
-  // (instructions were removed).
-  using HloPassInterface::Run;
-  StatusOr<bool> Run(
+ private:
+  StatusOr<bool> RunOnComputation(HloComputation* computation) override {
+    return RunOnComputation(computation,
+                            remove_cross_partition_collective_ops_);
+  }
+
+  // Removes the computations which became dead. Returns whether the module was
+  // changed.
+  StatusOr<bool> RunOnModuleAfterComputations(
       HloModule* module,
       const absl::flat_hash_set<absl::string_view>& execution_threads) override;
 
- private:
   // Finds all computations that are not called by any instruction and removes
   // them from the module. Returns whether any dead code was removed.
   StatusOr<bool> RecursivelyRemoveDeadComputations(
@@ -129,6 +129,12 @@ class HloLexer {
   // Returns the location of the current token.
   LocTy GetLoc() const { return token_state_.token_start; }
 
+  // Returns the text from the start of the current token to the end of the
+  // buffer.
+  absl::string_view GetRemainingText() const {
+    return StringViewFromPointers(GetLoc(), buf_.data() + buf_.size());
+  }
+
   // Returns the line and column of a location in the buffer.
   std::pair<unsigned, unsigned> GetLineAndColumn(LocTy location) const;
 
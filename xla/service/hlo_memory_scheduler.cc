@@ -16,14 +16,19 @@ limitations under the License.
 #include "xla/service/hlo_memory_scheduler.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <limits>
 #include <map>
+#include <numeric>
+#include <optional>
 #include <queue>
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/types/span.h"
 #include "xla/hlo/ir/dfs_hlo_visitor_with_default.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_opcode.h"
@@ -410,6 +415,276 @@ int64_t SumLogicalBufferSizes(
   return size;
 }
 
+// The liveness model of ComputeMemoryProfile, with the instructions and the
+// logical buffers of a computation numbered densely so that the profile of an
+// order of the instructions, or of a window of it, is cheap to recompute.
+class SequenceMemoryModel {
+ public:
+  SequenceMemoryModel(const HloComputation& computation,
+                      const TuplePointsToAnalysis& points_to_analysis,
+                      const BufferValue::SizeFunction& size_function,
+                      const absl::flat_hash_map<const HloComputation*, int64_t>&
+                          memory_by_computation) {
+    instructions_.reserve(computation.instruction_count());
+    for (HloInstruction* instruction : computation.instructions()) {
+      instruction_ids_[instruction] = instructions_.size();
+      Instruction& info = instructions_.emplace_back();
+      info.hlo = instruction;
+      for (const HloComputation* called : instruction->called_computations()) {
+        info.step_bytes +=
+            tsl::gtl::FindWithDefault(memory_by_computation, called, 0);
+      }
+    }
+
+    absl::flat_hash_map<const LogicalBuffer*, int64_t> buffer_ids;
+    for (int64_t id = 0; id < instructions_.size(); ++id) {
+      const HloInstruction* instruction = instructions_[id].hlo;
+      if (ListScheduler::IgnoreInstruction(*instruction)) {
+        continue;
+      }
+      for (const LogicalBuffer* buffer :
+           points_to_analysis.GetBuffersDefinedByInstruction(instruction)) {
+        buffer_ids[buffer] = buffers_.size();
+        buffers_.push_back({size_function(*buffer), id});
+        instructions_[id].defined.push_back(buffer_ids[buffer]);
+      }
+    }
+
+    for (int64_t id = 0; id < instructions_.size(); ++id) {
+      Instruction& info = instructions_[id];
+      absl::flat_hash_set<int64_t> used;
+      absl::flat_hash_set<int64_t> predecessors;
+      for (const HloInstruction* operand : info.hlo->operands()) {
+        predecessors.insert(instruction_ids_.at(operand));
+        points_to_analysis.GetPointsToSet(operand).ForEachElement(
+            [&](const ShapeIndex& /*index*/,
+                const PointsToSet::BufferList& buffers) {
+              for (const LogicalBuffer* buffer : buffers) {
+                auto it = buffer_ids.find(buffer);
+                if (it != buffer_ids.end()) {
+                  used.insert(it->second);
+                }
+              }
+            });
+      }
+      for (const HloInstruction* predecessor :
+           info.hlo->control_predecessors()) {
+        predecessors.insert(instruction_ids_.at(predecessor));
+      }
+      info.used.assign(used.begin(), used.end());
+      absl::c_sort(info.used);
+      info.predecessors.assign(predecessors.begin(), predecessors.end());
+      absl::c_sort(info.predecessors);
+      for (int64_t buffer : info.used) {
+        buffers_[buffer].users.push_back(id);
+      }
+    }
+
+    for (const LogicalBuffer* buffer :
+         points_to_analysis.GetPointsToSet(computation.root_instruction())
+             .CreateFlattenedSet()) {
+      auto it = buffer_ids.find(buffer);
+      if (it != buffer_ids.end()) {
+        buffers_[it->second].live_out = true;
+      }
+    }
+  }
+
+  std::vector<int64_t> ToOrder(const HloInstructionSequence& sequence) const {
+    std::vector<int64_t> order;
+    order.reserve(sequence.size());
+    for (const HloInstruction* instruction : sequence.instructions()) {
+      order.push_back(instruction_ids_.at(instruction));
+    }
+    CHECK_EQ(order.size(), instructions_.size());
+    return order;
+  }
+
+  HloInstructionSequence ToSequence(absl::Span<const int64_t> order) const {
+    HloInstructionSequence sequence;
+    for (int64_t id : order) {
+      sequence.push_back(instructions_[id].hlo);
+    }
+    return sequence;
+  }
+
+  // Returns the bytes live at each step of `order`.
+  std::vector<int64_t> Profile(absl::Span<const int64_t> order) const {
+    const int64_t length = order.size();
+    std::vector<int64_t> position(length);
+    for (int64_t step = 0; step < length; ++step) {
+      position[order[step]] = step;
+    }
+    std::vector<int64_t> delta(length + 1, 0);
+    for (const Buffer& buffer : buffers_) {
+      const int64_t start = position[buffer.definer];
+      int64_t end = buffer.live_out ? length - 1 : start;
+      for (int64_t user : buffer.users) {
+        end = std::max(end, position[user]);
+      }
+      delta[start] += buffer.size;
+      delta[end + 1] -= buffer.size;
+    }
+    std::vector<int64_t> profile(length);
+    int64_t live = 0;
+    for (int64_t step = 0; step < length; ++step) {
+      live += delta[step];
+      profile[step] = live + instructions_[order[step]].step_bytes;
+    }
+    return profile;
+  }
+
+  // Finds the move of one instruction within steps [lo, hi] of `order` which
+  // lowers the peak of those steps the most, and returns the steps it moves
+  // from and to, or nullopt if no move lowers it. Buffers which are neither
+  // defined nor used in the window are live either throughout it or not at
+  // all, so only the buffers touched by the window are re-walked.
+  std::optional<std::pair<int64_t, int64_t>> FindBestMove(
+      absl::Span<const int64_t> order, absl::Span<const int64_t> profile,
+      int64_t lo, int64_t hi) const {
+    const int64_t length = hi - lo + 1;
+    std::vector<int64_t> position(order.size());
+    for (int64_t step = 0; step < order.size(); ++step) {
+      position[order[step]] = step;
+    }
+
+    // The buffers touched by the window, with their definer and users as
+    // offsets into the window. A definer before the window is -1.
+    struct WindowBuffer {
+      int64_t size;
+      int64_t definer;
+      std::vector<int64_t> users;
+      bool live_after;
+    };
+    std::vector<WindowBuffer> window_buffers;
+    absl::flat_hash_set<int64_t> touched;
+    for (int64_t step = lo; step <= hi; ++step) {
+      const Instruction& info = instructions_[order[step]];
+      touched.insert(info.defined.begin(), info.defined.end());
+      touched.insert(info.used.begin(), info.used.end());
+    }
+    std::vector<int64_t> touched_sorted(touched.begin(), touched.end());
+    absl::c_sort(touched_sorted);
+    for (int64_t id : touched_sorted) {
+      const Buffer& buffer = buffers_[id];
+      WindowBuffer& window_buffer = window_buffers.emplace_back();
+      window_buffer.size = buffer.size;
+      const int64_t definer_step = position[buffer.definer];
+      window_buffer.definer = definer_step < lo ? -1 : definer_step - lo;
+      window_buffer.live_after = buffer.live_out;
+      for (int64_t user : buffer.users) {
+        const int64_t user_step = position[user];
+        if (user_step > hi) {
+          window_buffer.live_after = true;
+        } else if (user_step >= lo) {
+          window_buffer.users.push_back(user_step - lo);
+        }
+      }
+    }
+
+    // Bytes live at each step of the window for the permutation `slots`,
+    // where slots[i] is the new offset of the instruction at offset i,
+    // excluding the buffers live throughout the window.
+    std::vector<int64_t> delta(length + 1);
+    std::vector<int64_t> window_profile(length);
+    auto evaluate = [&](absl::Span<const int64_t> slots,
+                        absl::Span<const int64_t> permuted) {
+      absl::c_fill(delta, 0);
+      for (const WindowBuffer& buffer : window_buffers) {
+        const int64_t start =
+            buffer.definer < 0 ? 0 : slots[buffer.definer];
+        int64_t end = buffer.live_after ? length - 1 : start;
+        for (int64_t user : buffer.users) {
+          end = std::max(end, slots[user]);
+        }
+        delta[start] += buffer.size;
+        delta[end + 1] -= buffer.size;
+      }
+      int64_t live = 0;
+      for (int64_t slot = 0; slot < length; ++slot) {
+        live += delta[slot];
+        window_profile[slot] =
+            live + instructions_[order[lo + permuted[slot]]].step_bytes;
+      }
+    };
+
+    std::vector<int64_t> identity(length);
+    std::iota(identity.begin(), identity.end(), 0);
+    evaluate(identity, identity);
+    const int64_t base = profile[lo] - window_profile[0];
+    const int64_t peak =
+        *std::max_element(profile.begin() + lo, profile.begin() + hi + 1);
+
+    std::optional<std::pair<int64_t, int64_t>> best_move;
+    std::pair<int64_t, int64_t> best_cost = {peak - base, 0};
+    std::vector<int64_t> permuted(length);
+    std::vector<int64_t> slots(length);
+    auto try_move = [&](int64_t from, int64_t to) {
+      permuted = identity;
+      if (to < from) {
+        std::rotate(permuted.begin() + to, permuted.begin() + from,
+                    permuted.begin() + from + 1);
+      } else {
+        std::rotate(permuted.begin() + from, permuted.begin() + from + 1,
+                    permuted.begin() + to + 1);
+      }
+      for (int64_t slot = 0; slot < length; ++slot) {
+        slots[permuted[slot]] = slot;
+      }
+      evaluate(slots, permuted);
+      // Prefer lower peaks, then less memory over the whole window.
+      std::pair<int64_t, int64_t> cost = {
+          *absl::c_max_element(window_profile),
+          std::accumulate(window_profile.begin(), window_profile.end(),
+                          int64_t{0})};
+      if (cost.first < best_cost.first ||
+          (best_move.has_value() && cost < best_cost)) {
+        best_cost = cost;
+        best_move = {lo + from, lo + to};
+      }
+    };
+
+    for (int64_t from = 0; from < length; ++from) {
+      const int64_t id = order[lo + from];
+      for (int64_t to = from - 1; to >= 0 && !DependsOn(id, order[lo + to]);
+           --to) {
+        try_move(from, to);
+      }
+      for (int64_t to = from + 1;
+           to < length && !DependsOn(order[lo + to], id); ++to) {
+        try_move(from, to);
+      }
+    }
+    return best_move;
+  }
+
+ private:
+  struct Instruction {
+    HloInstruction* hlo;
+    // Bytes used by called computations during the step of the instruction.
+    int64_t step_bytes = 0;
+    std::vector<int64_t> defined;
+    std::vector<int64_t> used;
+    // Operands and control predecessors.
+    std::vector<int64_t> predecessors;
+  };
+  struct Buffer {
+    int64_t size;
+    int64_t definer;
+    std::vector<int64_t> users;
+    bool live_out = false;
+  };
+
+  bool DependsOn(int64_t instruction, int64_t predecessor) const {
+    return absl::c_binary_search(instructions_[instruction].predecessors,
+                                 predecessor);
+  }
+
+  absl::flat_hash_map<const HloInstruction*, int64_t> instruction_ids_;
+  std::vector<Instruction> instructions_;
+  std::vector<Buffer> buffers_;
+};
+
 StatusOr<HloInstructionSequence> ScheduleComputationHelper(
     HloComputation* computation,
     const TuplePointsToAnalysis& points_to_analysis,
@@ -720,6 +995,101 @@ StatusOr<HloSchedule> DefaultModuleScheduler(
   }
 }
 
+MemorySchedulerAlgorithm PeakMemoryReorderingScheduler(
+    PeakMemoryReorderingOptions options) {
+  if (!options.base_scheduler) {
+    options.base_scheduler = DefaultMemoryScheduler;
+  }
+  return [options](HloComputation* computation,
+                   const TuplePointsToAnalysis& points_to_analysis,
+                   const HloAliasAnalysis& alias_analysis,
+                   const BufferValue::SizeFunction& size_function,
+                   const absl::flat_hash_map<const HloComputation*, int64_t>&
+                       memory_by_computation,
+                   const MemorySchedulerPostprocessor& postprocessor,
+                   int64_t* peak_memory) -> StatusOr<HloInstructionSequence> {
+    int64_t base_memory;
+    TF_ASSIGN_OR_RETURN(
+        HloInstructionSequence base_sequence,
+        options.base_scheduler(computation, points_to_analysis, alias_analysis,
+                               size_function, memory_by_computation,
+                               postprocessor, &base_memory));
+
+    SequenceMemoryModel model(*computation, points_to_analysis, size_function,
+                              memory_by_computation);
+    std::vector<int64_t> order = model.ToOrder(base_sequence);
+    std::vector<int64_t> profile = model.Profile(order);
+    const int64_t base_model_peak = *absl::c_max_element(profile);
+    int64_t moves = 0;
+    for (; moves < options.max_moves; ++moves) {
+      const int64_t peak_step = absl::c_max_element(profile) - profile.begin();
+      if (profile[peak_step] <= options.peak_memory_target) {
+        break;
+      }
+      const int64_t lo = std::max<int64_t>(0, peak_step - options.window);
+      const int64_t hi = std::min<int64_t>(order.size() - 1,
+                                           peak_step + options.window);
+      std::optional<std::pair<int64_t, int64_t>> move =
+          model.FindBestMove(order, profile, lo, hi);
+      if (!move.has_value()) {
+        break;
+      }
+      auto [from, to] = *move;
+      if (to < from) {
+        std::rotate(order.begin() + to, order.begin() + from,
+                    order.begin() + from + 1);
+      } else {
+        std::rotate(order.begin() + from, order.begin() + from + 1,
+                    order.begin() + to + 1);
+      }
+      profile = model.Profile(order);
+    }
+    VLOG(2) << "Peak memory reordering of " << computation->name() << ": "
+            << moves << " moves, modeled peak "
+            << HumanReadableNumBytes(base_model_peak) << " -> "
+            << HumanReadableNumBytes(*absl::c_max_element(profile));
+
+    if (moves == 0) {
+      if (peak_memory) {
+        *peak_memory = base_memory;
+      }
+      return base_sequence;
+    }
+    HloInstructionSequence sequence = model.ToSequence(order);
+    if (postprocessor) {
+      sequence = postprocessor(sequence);
+    }
+    TF_ASSIGN_OR_RETURN(
+        const int64_t memory,
+        HeapSimulator::MinimumMemoryForComputation(
+            *computation, sequence, alias_analysis, size_function,
+            &memory_by_computation));
+    VLOG(2) << "Simulated peak " << HumanReadableNumBytes(base_memory)
+            << " -> " << HumanReadableNumBytes(memory);
+    if (memory >= base_memory) {
+      if (peak_memory) {
+        *peak_memory = base_memory;
+      }
+      return base_sequence;
+    }
+    if (peak_memory) {
+      *peak_memory = memory;
+    }
+    return sequence;
+  };
+}
+
+std::vector<int64_t> ComputeMemoryProfile(
+    const HloComputation& computation, const HloInstructionSequence& sequence,
+    const TuplePointsToAnalysis& points_to_analysis,
+    const BufferValue::SizeFunction& size_function,
+    const absl::flat_hash_map<const HloComputation*, int64_t>&
+        memory_by_computation) {
+  SequenceMemoryModel model(computation, points_to_analysis, size_function,
+                            memory_by_computation);
+  return model.Profile(model.ToOrder(sequence));
+}
+
 StatusOr<HloSchedule> ScheduleModule(
     const HloModule* module, const BufferValue::SizeFunction& size_function,
     const ModuleSchedulerAlgorithm& algorithm,
@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_HLO_MEMORY_SCHEDULER_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_HLO_MEMORY_SCHEDULER_H_
 
+#include <cstdint>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
@@ -117,6 +118,43 @@ StatusOr<HloSchedule> DefaultModuleScheduler(
     const absl::flat_hash_set<absl::string_view>& execution_threads,
     int64_t* peak_memory);
 
+struct PeakMemoryReorderingOptions {
+  // Computes the sequence to start from. If not specified, then
+  // DefaultMemoryScheduler is used.
+  MemorySchedulerAlgorithm base_scheduler;
+  // Stop reordering once the peak is at or below this many bytes. Zero keeps
+  // reordering while some move lowers the peak.
+  int64_t peak_memory_target = 0;
+  // Instructions are moved within this many steps of the peak.
+  int64_t window = 16;
+  // Upper bound on the number of moves per computation.
+  int64_t max_moves = 256;
+};
+
+// Lowers the peak memory of the sequence of options.base_scheduler by local
+// search: while the peak is above the target, moves the one instruction within
+// options.window steps of the peak whose move lowers the memory around the peak
+// the most. Moves are evaluated on the liveness model of ComputeMemoryProfile
+// by re-walking only the steps around the peak; the HeapSimulator is run once
+// at the end, and the reordered sequence is only returned if it has a lower
+// peak than the base sequence.
+MemorySchedulerAlgorithm PeakMemoryReorderingScheduler(
+    PeakMemoryReorderingOptions options = {});
+
+// Returns the number of bytes live at each step of `sequence`, which must be a
+// sequence of all the instructions in `computation`. Each logical buffer is
+// live from the step that defines it through its last use, or through the end
+// of the sequence if it is live out of the computation; an instruction also
+// uses the memory of the computations it calls during its step. Parameters and
+// constants are not counted and buffers are never shared, so the peak can
+// differ from the one the HeapSimulator reports.
+std::vector<int64_t> ComputeMemoryProfile(
+    const HloComputation& computation, const HloInstructionSequence& sequence,
+    const TuplePointsToAnalysis& points_to_analysis,
+    const LogicalBuffer::SizeFunction& size_function,
+    const absl::flat_hash_map<const HloComputation*, int64_t>&
+        memory_by_computation);
+
 // Returns an HloSchedule which seeks to minimize the memory required for the
 // module. size_function is the function returning the number of bytes required
 // for a LogicalBuffer. peak_memory (if not nullptr) is set to the largest peak
@@ -27,6 +27,7 @@ limitations under the License.
 #include "xla/service/heap_simulator.h"
 #include "xla/service/hlo_dce.h"
 #include "xla/service/hlo_ordering.h"
+#include "xla/service/tuple_points_to_analysis.h"
 #include "xla/shape_util.h"
 #include "xla/tests/hlo_test_base.h"
 #include "xla/types.h"
@@ -308,6 +309,87 @@ TEST_F(HloSchedulingTest, MultiOutputFusionAccountedCorrectly) {
   EXPECT_TRUE(ordering.ExecutesBefore(exp, fusion));
 }
 
+TEST_F(HloSchedulingTest, ComputeMemoryProfile) {
+  const char* const hlo_string = R"(
+HloModule module
+
+ENTRY entry {
+  p0 = f32[4] parameter(0)
+  a = f32[4] negate(p0)
+  b = f32[4] exponential(a)
+  ROOT c = f32[4] add(a, b)
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  auto size_fn = [](const BufferValue& buffer) {
+    return ShapeUtil::ByteSizeOf(buffer.shape());
+  };
+  HloComputation* entry = module->entry_computation();
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<TuplePointsToAnalysis> points_to,
+                          TuplePointsToAnalysis::Run(module.get()));
+  HloInstructionSequence sequence(entry->MakeInstructionPostOrder());
+
+  // The parameter is not counted, `a` is live until the root and the root is
+  // live out.
+  EXPECT_THAT(ComputeMemoryProfile(*entry, sequence, *points_to, size_fn, {}),
+              ::testing::ElementsAre(0, 16, 32, 48));
+}
+
+TEST_F(HloSchedulingTest, PeakMemoryReorderingLowersPeak) {
+  // The post order computes `big` first and keeps it live while the two large
+  // temporaries of `sum` are computed; computing `big` after `sum` instead
+  // lowers the peak by the size of `big`.
+  const char* const hlo_string = R"(
+HloModule module
+
+add {
+  x = f32[] parameter(0)
+  y = f32[] parameter(1)
+  ROOT add = f32[] add(x, y)
+}
+
+ENTRY entry {
+  p0 = f32[16] parameter(0)
+  zero = f32[] constant(0)
+  big = f32[1024,16] broadcast(p0), dimensions={1}
+  tmp = f32[1024,16] broadcast(p0), dimensions={1}
+  exp = f32[1024,16] exponential(tmp)
+  sum = f32[16] reduce(exp, zero), dimensions={0}, to_apply=add
+  ROOT dot = f32[1024] dot(big, sum), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  auto size_fn = [](const BufferValue& buffer) {
+    return ShapeUtil::ByteSizeOf(buffer.shape());
+  };
+
+  int64_t post_order_peak;
+  TF_ASSERT_OK(ScheduleModule(module.get(), size_fn,
+                              ComputationSchedulerToModuleScheduler(
+                                  PostOrderMemoryScheduler),
+                              {}, &post_order_peak)
+                   .status());
+  PeakMemoryReorderingOptions options;
+  options.base_scheduler = PostOrderMemoryScheduler;
+  int64_t reordered_peak;
+  TF_ASSERT_OK_AND_ASSIGN(
+      HloSchedule schedule,
+      ScheduleModule(module.get(), size_fn,
+                     ComputationSchedulerToModuleScheduler(
+                         PeakMemoryReorderingScheduler(options)),
+                     {}, &reordered_peak));
+  TF_ASSERT_OK(schedule.Verify());
+  EXPECT_LT(reordered_peak, post_order_peak);
+
+  SequentialHloOrdering ordering(schedule);
+  HloComputation* entry = module->entry_computation();
+  EXPECT_TRUE(ordering.ExecutesBefore(entry->GetInstructionWithName("sum"),
+                                      entry->GetInstructionWithName("big")));
+}
+
 TEST_F(HloSchedulingTest, TrivialScheduler) {
   const char* const hlo_string = R"(
 HloModule ModuleWithWhile
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <cstdint>
 #include <memory>
+#include <numeric>
 #include <optional>
 #include <string>
 #include <utility>
@@ -25,8 +26,10 @@ limitations under the License.
 #include <gtest/gtest.h>
 #include "absl/strings/str_cat.h"
 #include "absl/types/span.h"
+#include "xla/hlo/ir/hlo_casting_utils.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
+#include "xla/hlo/ir/hlo_instructions.h"
 #include "xla/literal.h"
 #include "xla/service/computation_placer.h"
 #include "xla/service/hlo_matchers.h"
@@ -39,7 +42,9 @@ limitations under the License.
 #include "xla/xla_data.pb.h"
 #include "tsl/lib/core/status_test_util.h"
 #include "tsl/lib/strings/proto_serialization.h"
+#include "tsl/platform/env.h"
 #include "tsl/platform/errors.h"
+#include "tsl/platform/path.h"
 #include "tsl/platform/statusor.h"
 
 namespace xla {
@@ -389,6 +394,114 @@ ENTRY %axpy.v5 (alpha: f32[], x: f32[2,4], y: f32[2,4]) -> f32[2,4] {
                              op::Broadcast(), op::Multiply(), op::Add()));
 }
 
+// Returns a module whose entry computation adds a large constant to the result
+// of a call to a computation with a small constant.
+std::unique_ptr<HloModule> CreateModuleWithLargeConstant() {
+  auto module =
+      std::make_unique<HloModule>("large_constant", HloModuleConfig());
+  const Shape shape = ShapeUtil::MakeShape(F32, {1024});
+  auto small_builder = HloComputation::Builder("small");
+  small_builder.AddInstruction(
+      HloInstruction::CreateConstant(LiteralUtil::CreateR0<float>(42.0f)));
+  HloComputation* small =
+      module->AddEmbeddedComputation(small_builder.Build());
+
+  std::vector<float> values(1024);
+  std::iota(values.begin(), values.end(), 0.0f);
+  auto builder = HloComputation::Builder("entry");
+  HloInstruction* large = builder.AddInstruction(
+      HloInstruction::CreateConstant(LiteralUtil::CreateR1<float>(values)));
+  HloInstruction* call = builder.AddInstruction(HloInstruction::CreateCall(
+      ShapeUtil::MakeShape(F32, {}), {}, small));
+  HloInstruction* broadcast = builder.AddInstruction(
+      HloInstruction::CreateBroadcast(shape, call, {}));
+  builder.AddInstruction(
+      HloInstruction::CreateBinary(shape, HloOpcode::kAdd, large, broadcast));
+  module->AddEntryComputation(builder.Build());
+  return module;
+}
+
+TEST_F(HloModuleTest, ProtoIncrementalLoadingCreatesLargeConstantsLazily) {
+  std::unique_ptr<HloModule> module = CreateModuleWithLargeConstant();
+  HloModule::IncrementalLoadingOptions options;
+  options.lazy_constant_bytes = 1024;
+  TF_ASSERT_OK_AND_ASSIGN(auto module_copy,
+                          HloModule::CreateFromProtoIncrementally(
+                              module->ToProto(), module->config(), options));
+
+  const auto* large = Cast<HloConstantInstruction>(
+      module_copy->entry_computation()->root_instruction()->operand(0));
+  const auto* small = Cast<HloConstantInstruction>(
+      module_copy->GetComputationWithName("small")->root_instruction());
+  EXPECT_TRUE(large->HasLiteral());
+  EXPECT_TRUE(large->IsLiteralPending());
+  EXPECT_FALSE(small->IsLiteralPending());
+  // Printing doesn't need large literals.
+  EXPECT_EQ(module_copy->ToString(), module->ToString());
+  EXPECT_TRUE(large->IsLiteralPending());
+
+  const HloInstruction* original_large =
+      module->entry_computation()->root_instruction()->operand(0);
+  EXPECT_EQ(large->literal(), original_large->literal());
+  EXPECT_FALSE(large->IsLiteralPending());
+  const HloPrintOptions print_large_constants =
+      HloPrintOptions().set_print_large_constants(true);
+  EXPECT_EQ(module_copy->ToString(print_large_constants),
+            module->ToString(print_large_constants));
+}
+
+TEST_F(HloModuleTest, ProtoIncrementalLoadingRejectsMalformedLargeConstants) {
+  std::unique_ptr<HloModule> module = CreateModuleWithLargeConstant();
+  HloModuleProto proto = module->ToProto();
+  int64_t truncated = 0;
+  for (HloComputationProto& computation : *proto.mutable_computations()) {
+    for (HloInstructionProto& instruction :
+         *computation.mutable_instructions()) {
+      if (instruction.literal().f32s_size() == 1024) {
+        instruction.mutable_literal()->mutable_f32s()->RemoveLast();
+        ++truncated;
+      }
+    }
+  }
+  ASSERT_EQ(truncated, 1);
+
+  HloModule::IncrementalLoadingOptions options;
+  options.lazy_constant_bytes = 1024;
+  auto module_copy = HloModule::CreateFromProtoIncrementally(
+      std::move(proto), module->config(), options);
+  EXPECT_EQ(module_copy.status().code(), tsl::error::INVALID_ARGUMENT);
+}
+
+TEST_F(HloModuleTest, ProtoIncrementalLoadingKeepsLargeConstantsInFiles) {
+  tsl::Env* env = tsl::Env::Default();
+  const std::string dir =
+      tsl::io::JoinPath(::testing::TempDir(), "lazy_constants");
+  TF_ASSERT_OK(env->RecursivelyCreateDir(dir));
+  const std::string pattern = tsl::io::JoinPath(dir, "constant.*");
+  std::vector<std::string> files;
+
+  std::unique_ptr<HloModule> module = CreateModuleWithLargeConstant();
+  HloModule::IncrementalLoadingOptions options;
+  options.lazy_constant_bytes = 1024;
+  options.lazy_constant_dir = dir;
+  TF_ASSERT_OK_AND_ASSIGN(auto module_copy,
+                          HloModule::CreateFromProtoIncrementally(
+                              module->ToProto(), module->config(), options));
+  TF_ASSERT_OK(env->GetMatchingPaths(pattern, &files));
+  EXPECT_EQ(files.size(), 1);
+
+  const HloInstruction* large =
+      module_copy->entry_computation()->root_instruction()->operand(0);
+  EXPECT_TRUE(Cast<HloConstantInstruction>(large)->IsLiteralPending());
+  const HloInstruction* original_large =
+      module->entry_computation()->root_instruction()->operand(0);
+  EXPECT_EQ(large->literal(), original_large->literal());
+  // The file is deleted once the literal has been created.
+  files.clear();
+  TF_ASSERT_OK(env->GetMatchingPaths(pattern, &files));
+  EXPECT_TRUE(files.empty());
+}
+
 TEST_F(HloModuleTest, ProtoSerializationPreservesIds) {
   // Verify that serializing then deserializing an HLO proto preserves the
   // unique IDs of the instruction and module.
@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "xla/service/hlo_parser.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <complex>
 #include <functional>
@@ -33,12 +35,14 @@ limitations under the License.
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/functional/function_ref.h"
+#include "absl/strings/ascii.h"
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/span.h"
 #include "absl/types/variant.h"
 #include "xla/hlo/ir/hlo_casting_utils.h"
@@ -59,6 +63,8 @@ limitations under the License.
 #include "xla/util.h"
 #include "xla/xla_data.pb.h"
 #include "tsl/lib/gtl/map_util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/threadpool.h"
 
 namespace xla {
 
@@ -212,12 +218,86 @@ bool CanInferShape(HloOpcode code) {
   }
 }
 
+// Shared state of the parsers of the batches of computations of a module that
+// is parsed in parallel. Computations may only refer to computations defined
+// earlier in the text, so a parser that refers to a computation of an earlier
+// batch waits for that batch to be parsed.
+class ParallelParseState {
+ public:
+  explicit ParallelParseState(int64_t num_batches)
+      : batch_state_(num_batches, BatchState::kPending) {}
+
+  // Records that the computation `name` is defined by batch `batch`. Returns
+  // false if the name has already been declared.
+  bool DeclareComputation(const std::string& name, int64_t batch) {
+    return batch_of_computation_.emplace(name, batch).second;
+  }
+
+  // Returns the computation `name` if it is defined by a batch before
+  // `batch`, waiting for that batch to be parsed. Returns nullptr if there is
+  // no such computation or its batch failed to parse.
+  HloComputation* WaitForComputation(const std::string& name, int64_t batch) {
+    auto it = batch_of_computation_.find(name);
+    if (it == batch_of_computation_.end() || it->second >= batch) {
+      return nullptr;
+    }
+    const int64_t defining_batch = it->second;
+    absl::MutexLock lock(&mu_);
+    mu_.Await(absl::Condition(
+        +[](BatchState* state) { return *state != BatchState::kPending; },
+        &batch_state_[defining_batch]));
+    auto computation = computations_.find(name);
+    return computation == computations_.end() ? nullptr : computation->second;
+  }
+
+  // Publishes the computations parsed by `batch`, or records that it failed
+  // if `computations` is nullptr.
+  void FinishBatch(
+      int64_t batch,
+      const absl::flat_hash_map<std::string,
+                                std::pair<HloComputation*, const char*>>*
+          computations) {
+    absl::MutexLock lock(&mu_);
+    if (computations == nullptr) {
+      batch_state_[batch] = BatchState::kFailed;
+      failed_ = true;
+      return;
+    }
+    for (const auto& [name, computation] : *computations) {
+      if (!computations_.emplace(name, computation.first).second) {
+        batch_state_[batch] = BatchState::kFailed;
+        failed_ = true;
+        return;
+      }
+    }
+    batch_state_[batch] = BatchState::kDone;
+  }
+
+  bool failed() const {
+    absl::MutexLock lock(&mu_);
+    return failed_;
+  }
+
+ private:
+  enum class BatchState { kPending, kDone, kFailed };
+
+  // Written before parsing starts, read-only afterwards.
+  absl::flat_hash_map<std::string, int64_t> batch_of_computation_;
+
+  mutable absl::Mutex mu_;
+  std::vector<BatchState> batch_state_ ABSL_GUARDED_BY(mu_);
+  absl::flat_hash_map<std::string, HloComputation*> computations_
+      ABSL_GUARDED_BY(mu_);
+  bool failed_ ABSL_GUARDED_BY(mu_) = false;
+};
+
 // Parser for the HloModule::ToString() format text.
 class HloParserImpl : public HloParser {
  public:
   using LocTy = HloLexer::LocTy;
 
-  explicit HloParserImpl(absl::string_view str) : lexer_(str) {}
+  explicit HloParserImpl(absl::string_view str, int num_threads = 1)
+      : lexer_(str), num_threads_(num_threads) {}
 
   // Runs the parser and constructs the resulting HLO in the given (empty)
   // HloModule. Returns the error status in case an error occurred.
@@ -308,6 +388,13 @@ class HloParserImpl : public HloParser {
 
   bool ParseComputations(HloModule* module);
   bool ParseComputation(HloComputation** entry_computation);
+  // Splits the remaining text into batches of computations and parses them
+  // in parallel into computations_. Returns false, leaving this parser
+  // unchanged, if the text can't be parsed that way; the caller then parses
+  // it serially, which also reports any errors.
+  bool ParseComputationsInParallel(HloComputation** entry_computation);
+  // Parses all computations of a batch of a module parsed in parallel.
+  bool ParseComputationBatch(HloComputation** entry_computation);
   bool ParseInstructionList(HloComputation** computation,
                             const std::string& computation_name);
   bool ParseInstruction(HloComputation::Builder* builder,
@@ -560,6 +647,19 @@ class HloParserImpl : public HloParser {
 
   HloLexer lexer_;
 
+  // Maximum number of threads used to parse the computations of a module.
+  int num_threads_ = 1;
+
+  // Set for the parsers of batches of computations of a module parsed in
+  // parallel, to resolve computations defined by other batches.
+  ParallelParseState* parallel_state_ = nullptr;
+  int64_t parallel_batch_ = 0;
+
+  // Whether a name was generated for an anonymous instruction. Generated names
+  // are only unique within a parser, so batches using them can't be parsed in
+  // parallel.
+  bool generated_instruction_names_ = false;
+
   // A stack for the instruction names. The top of the stack stores the
   // instruction name table for the current scope.
   //
@@ -987,11 +1087,13 @@ bool HloParserImpl::ParseHloModule(HloModule* module) {
 // computations ::= (computation)+
 bool HloParserImpl::ParseComputations(HloModule* module) {
   HloComputation* entry_computation = nullptr;
-  do {
-    if (!ParseComputation(&entry_computation)) {
-      return false;
-    }
-  } while (lexer_.GetKind() != TokKind::kEof);
+  if (num_threads_ <= 1 || !ParseComputationsInParallel(&entry_computation)) {
+    do {
+      if (!ParseComputation(&entry_computation)) {
+        return false;
+      }
+    } while (lexer_.GetKind() != TokKind::kEof);
+  }
 
   for (int i = 0; i < computations_.size(); i++) {
     // If entry_computation is not nullptr, it means the computation it pointed
@@ -1021,6 +1123,134 @@ bool HloParserImpl::ParseComputations(HloModule* module) {
   return true;
 }
 
+// Splits the computations of a module into pieces that start at lines
+// beginning with an identifier character in the first column. In the
+// HloModule::ToString() format every computation starts such a line and no
+// other line does. Text that doesn't follow that convention may be split
+// inside a computation; such a piece fails to parse on its own.
+std::vector<absl::string_view> SplitComputations(absl::string_view text) {
+  std::vector<absl::string_view> pieces;
+  size_t start = 0;
+  size_t pos = text.find('\n');
+  while (pos != absl::string_view::npos && pos + 1 < text.size()) {
+    const char c = text[pos + 1];
+    if (absl::ascii_isalpha(static_cast<unsigned char>(c)) || c == '%' ||
+        c == '_') {
+      pieces.push_back(text.substr(start, pos + 1 - start));
+      start = pos + 1;
+    }
+    pos = text.find('\n', pos + 1);
+  }
+  pieces.push_back(text.substr(start));
+  return pieces;
+}
+
+bool HloParserImpl::ParseComputationsInParallel(
+    HloComputation** entry_computation) {
+  // Batches are large enough to amortize the cost of a parser, and small
+  // enough to balance the load between threads.
+  constexpr int64_t kMinBatchBytes = 16 << 10;
+  constexpr int64_t kMaxBatchBytes = 256 << 10;
+
+  absl::string_view text = lexer_.GetRemainingText();
+  const int64_t batch_bytes = std::clamp<int64_t>(
+      text.size() / (4 * num_threads_), kMinBatchBytes, kMaxBatchBytes);
+  std::vector<absl::string_view> pieces = SplitComputations(text);
+  std::vector<absl::string_view> batches;
+  std::vector<std::vector<std::string>> batch_names;
+  for (absl::string_view piece : pieces) {
+    // The name of the computation that starts the piece.
+    HloLexer piece_lexer(piece);
+    if (piece_lexer.Lex() == TokKind::kw_ENTRY) {
+      piece_lexer.Lex();
+    }
+    if (piece_lexer.GetKind() != TokKind::kName &&
+        piece_lexer.GetKind() != TokKind::kIdent) {
+      return false;
+    }
+    if (batches.empty() || batches.back().size() >= batch_bytes) {
+      batches.push_back(piece);
+      batch_names.emplace_back();
+    } else {
+      batches.back() = absl::string_view(
+          batches.back().data(), batches.back().size() + piece.size());
+    }
+    batch_names.back().push_back(piece_lexer.GetStrVal());
+  }
+  const int64_t num_batches = batches.size();
+  if (num_batches < 2) {
+    return false;
+  }
+
+  ParallelParseState state(num_batches);
+  for (int64_t i = 0; i < num_batches; ++i) {
+    for (const std::string& name : batch_names[i]) {
+      if (!state.DeclareComputation(name, i)) {
+        return false;
+      }
+    }
+  }
+
+  // Batches are claimed in text order, so a batch only ever waits for batches
+  // that some thread is already parsing.
+  std::vector<std::unique_ptr<HloParserImpl>> parsers(num_batches);
+  std::vector<HloComputation*> entry_computations(num_batches, nullptr);
+  std::atomic<int64_t> next_batch{0};
+  auto parse_batches = [&] {
+    for (int64_t i = next_batch++; i < num_batches; i = next_batch++) {
+      parsers[i] = std::make_unique<HloParserImpl>(batches[i]);
+      parsers[i]->parallel_state_ = &state;
+      parsers[i]->parallel_batch_ = i;
+      if (!state.failed() &&
+          parsers[i]->ParseComputationBatch(&entry_computations[i])) {
+        state.FinishBatch(i, &parsers[i]->computation_pool_);
+      } else {
+        state.FinishBatch(i, nullptr);
+      }
+    }
+  };
+  {
+    const int num_threads =
+        static_cast<int>(std::min<int64_t>(num_threads_, num_batches));
+    tsl::thread::ThreadPool thread_pool(tsl::Env::Default(), "hlo_parser",
+                                        num_threads);
+    for (int i = 0; i < num_threads; ++i) {
+      thread_pool.Schedule(parse_batches);
+    }
+  }
+  if (state.failed()) {
+    return false;
+  }
+
+  HloComputation* entry = nullptr;
+  for (int64_t i = 0; i < num_batches; ++i) {
+    if (entry_computations[i] != nullptr) {
+      if (entry != nullptr) {
+        return false;
+      }
+      entry = entry_computations[i];
+    }
+  }
+  for (int64_t i = 0; i < num_batches; ++i) {
+    for (auto& computation : parsers[i]->computations_) {
+      computations_.push_back(std::move(computation));
+    }
+    computation_pool_.merge(parsers[i]->computation_pool_);
+  }
+  *entry_computation = entry;
+  return true;
+}
+
+bool HloParserImpl::ParseComputationBatch(HloComputation** entry_computation) {
+  lexer_.Lex();
+  do {
+    if (!ParseComputation(entry_computation)) {
+      return false;
+    }
+  } while (lexer_.GetKind() != TokKind::kEof);
+  return !generated_instruction_names_;
+}
+
 // computation ::= ('ENTRY')? name (param_list_to_shape)? instruction_list(,
 // 'execution_thread='execution_thread)?
 bool HloParserImpl::ParseComputation(HloComputation** entry_computation) {
@@ -1197,6 +1427,7 @@ bool HloParserImpl::ParseInstructionRhs(HloComputation::Builder* builder,
   if (name.empty()) {
     name = name_uniquer_.GetUniqueName(
         absl::StrCat(HloOpcodeString(instruction->opcode()), ".anon"));
+    generated_instruction_names_ = true;
   } else {
     name_uniquer_.GetUniqueName(name);
   }
@@ -4560,6 +4791,12 @@ bool HloParserImpl::ParseComputationName(HloComputation** value) {
   std::pair<HloComputation*, LocTy>* computation =
       tsl::gtl::FindOrNull(computation_pool_, name);
   if (computation == nullptr) {
+    if (parallel_state_ != nullptr) {
+      *value = parallel_state_->WaitForComputation(name, parallel_batch_);
+      if (*value != nullptr) {
+        return true;
+      }
+    }
     return Error(loc, StrCat("computation does not exist: ", name));
   }
   *value = computation->first;
@@ -6062,6 +6299,14 @@ StatusOr<std::unique_ptr<HloModule>> ParseAndReturnUnverifiedModule(
   return ParseAndReturnUnverifiedModule(str, HloModuleConfig());
 }
 
+StatusOr<std::unique_ptr<HloModule>> ParseAndReturnUnverifiedModuleInParallel(
+    absl::string_view str, const HloModuleConfig& config, int num_threads) {
+  auto module = std::make_unique<HloModule>(/*name=*/"_", config);
+  HloParserImpl parser(str, num_threads);
+  TF_RETURN_IF_ERROR(parser.Run(module.get()));
+  return std::move(module);
+}
+
 StatusOr<HloSharding> ParseSharding(absl::string_view str) {
   HloParserImpl parser(str);
   return parser.ParseShardingOnly();
@@ -46,6 +46,15 @@ StatusOr<std::unique_ptr<HloModule>> ParseAndReturnUnverifiedModule(
 StatusOr<std::unique_ptr<HloModule>> ParseAndReturnUnverifiedModule(
     absl::string_view str);
 
+// Like ParseAndReturnUnverifiedModule, but lexes and parses the computations of
+// the module in parallel on up to `num_threads` threads, and links references
+// between computations as they become available. Meant for very large modules
+// in the HloModule::ToString() format. The result is the same as that of the
+// serial parser, which is also used for text that can't be parsed in parallel
+// and to report errors.
+StatusOr<std::unique_ptr<HloModule>> ParseAndReturnUnverifiedModuleInParallel(
+    absl::string_view str, const HloModuleConfig& config, int num_threads);
+
 // Parses sharding from str. str is supposed to contain the body of the
 // sharding, i.e. just the rhs of the "sharding={...}" attribute string, e.g.,
 // "{replicated}".
@@ -37,6 +37,7 @@ limitations under the License.
 #include "tsl/platform/status_matchers.h"
 #include "tsl/platform/statusor.h"
 #include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace xla {
 namespace {
@@ -4208,5 +4209,117 @@ ENTRY test {
               "Layout has physical shape, but is not for a sparse array")));
 }
 
+// Returns the text of a module with `num_fusions` fusion computations that
+// call chains of reducers, so that computations refer to computations that are
+// defined far before them in the text.
+std::string MakeLargeModuleText(int num_fusions) {
+  std::string text = "HloModule large_module\n\n";
+  for (int i = 0; i < num_fusions; ++i) {
+    if (i % 8 == 0) {
+      absl::StrAppend(&text, "%add.", i, " (x: f32[], y: f32[]) -> f32[] {\n",
+                      "  %x = f32[] parameter(0)\n",
+                      "  %y = f32[] parameter(1)\n");
+      if (i == 0) {
+        absl::StrAppend(&text, "  ROOT %add = f32[] add(%x, %y)\n}\n\n");
+      } else {
+        absl::StrAppend(&text, "  ROOT %call = f32[] call(%x, %y), to_apply=",
+                        "%add.", i - 8, "\n}\n\n");
+      }
+    }
+    absl::StrAppend(
+        &text, "%fused_computation.", i,
+        " (p0: f32[64,128], p1: f32[64,128]) -> f32[64] {\n",
+        "  %p0 = f32[64,128]{1,0} parameter(0)\n",
+        "  %p1 = f32[64,128]{1,0} parameter(1)\n",
+        "  %multiply = f32[64,128]{1,0} multiply(%p0, %p1)\n",
+        "  %exponential = f32[64,128]{1,0} exponential(%multiply)\n",
+        "  %constant = f32[] constant(0)\n",
+        "  ROOT %reduce = f32[64]{0} reduce(%exponential, %constant), ",
+        "dimensions={1}, to_apply=%add.", i / 8 * 8, "\n}\n\n");
+  }
+  absl::StrAppend(&text,
+                  "ENTRY %main (a: f32[64,128], b: f32[64,128]) -> f32[64] {\n",
+                  "  %a = f32[64,128]{1,0} parameter(0)\n",
+                  "  %b = f32[64,128]{1,0} parameter(1)\n",
+                  "  %fusion.0 = f32[64]{0} fusion(%a, %b), kind=kLoop, ",
+                  "calls=%fused_computation.0\n");
+  for (int i = 1; i < num_fusions; ++i) {
+    absl::StrAppend(&text, "  %broadcast.", i,
+                    " = f32[64,128]{1,0} broadcast(%fusion.", i - 1,
+                    "), dimensions={0}\n", "  ", i + 1 == num_fusions ? "ROOT " : "",
+                    "%fusion.", i, " = f32[64]{0} fusion(%broadcast.", i,
+                    ", %b), kind=kLoop, calls=%fused_computation.", i, "\n");
+  }
+  absl::StrAppend(&text, "}\n");
+  return text;
+}
+
+TEST(HloParserParallelTest, MatchesSerialParser) {
+  const std::string text = MakeLargeModuleText(/*num_fusions=*/1000);
+  TF_ASSERT_OK_AND_ASSIGN(auto serial, ParseAndReturnUnverifiedModule(text));
+  for (int num_threads : {1, 2, 8}) {
+    TF_ASSERT_OK_AND_ASSIGN(auto parallel,
+                            ParseAndReturnUnverifiedModuleInParallel(
+                                text, HloModuleConfig(), num_threads));
+    EXPECT_EQ(parallel->ToString(), serial->ToString());
+    EXPECT_EQ(parallel->entry_computation()->name(), "main");
+  }
+}
+
+TEST(HloParserParallelTest, ReportsSameErrorAsSerialParser) {
+  // The last fusion refers to a reducer that doesn't exist.
+  std::string text = MakeLargeModuleText(/*num_fusions=*/1000);
+  const size_t pos = text.rfind("to_apply=%add.");
+  text.insert(pos + std::string("to_apply=%add.").size(), "999");
+  const Status serial = ParseAndReturnUnverifiedModule(text).status();
+  ASSERT_FALSE(serial.ok());
+  EXPECT_THAT(serial.error_message(),
+              HasSubstr("computation does not exist: add.999992"));
+  EXPECT_EQ(ParseAndReturnUnverifiedModuleInParallel(text, HloModuleConfig(),
+                                                     /*num_threads=*/8)
+                .status(),
+            serial);
+}
+
+TEST(HloParserParallelTest, AnonymousInstructions) {
+  // Generated instruction names must be the same as those of the serial
+  // parser.
+  std::string text = MakeLargeModuleText(/*num_fusions=*/1000);
+  const size_t pos = text.find("ENTRY");
+  text.insert(pos, R"(%anonymous (p: f32[]) -> f32[] {
+  %p = f32[] parameter(0)
+  ROOT %negate = f32[] negate(f32[] negate(%p))
+}
+
+)");
+  TF_ASSERT_OK_AND_ASSIGN(auto serial, ParseAndReturnUnverifiedModule(text));
+  TF_ASSERT_OK_AND_ASSIGN(auto parallel,
+                          ParseAndReturnUnverifiedModuleInParallel(
+                              text, HloModuleConfig(), /*num_threads=*/8));
+  EXPECT_EQ(parallel->ToString(), serial->ToString());
+}
+
+// The second argument is the number of threads; 0 uses the serial parser.
+void BM_ParseLargeModule(::testing::benchmark::State& state) {
+  const std::string text = MakeLargeModuleText(state.range(0));
+  for (auto s : state) {
+    if (state.range(1) == 0) {
+      TF_CHECK_OK(ParseAndReturnUnverifiedModule(text).status());
+    } else {
+      TF_CHECK_OK(ParseAndReturnUnverifiedModuleInParallel(
+                      text, HloModuleConfig(), state.range(1))
+                      .status());
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+BENCHMARK(BM_ParseLargeModule)
+    ->ArgPair(1 << 10, 0)
+    ->ArgPair(1 << 10, 4)
+    ->ArgPair(1 << 14, 0)
+    ->ArgPair(1 << 14, 4)
+    ->ArgPair(1 << 14, 16);
+
 }  // namespace
 }  // namespace xla
@@ -65,6 +65,7 @@ class HloPassFix : public Pass {
     bool changed = false;
     bool changed_this_iteration = true;
     int64_t iteration_count = 0;
+    iterations_ = 0;
     VLOG(3) << "Running HloPassFix.";
     while (changed_this_iteration) {
       TF_ASSIGN_OR_RETURN(
@@ -73,6 +74,7 @@ class HloPassFix : public Pass {
       changed |= changed_this_iteration;
       VLOG(3) << "changed_this_iteration: " << changed_this_iteration;
       ++iteration_count;
+      iterations_ = iteration_count;
       if (iteration_count == kIterationLimit) {
         VLOG(1) << "Unexpectedly high number of iterations in HLO passes, "
                    "exiting fixed point loop.";
@@ -83,11 +85,14 @@ class HloPassFix : public Pass {
     return changed;
   }
 
+  int64_t fix_point_iterations() const override { return iterations_; }
+
  private:
   Status RunToFixPoint(
       HloModule* module, RunState* run_state,
       const absl::flat_hash_set<absl::string_view>& execution_threads) {
     VLOG(3) << "Running HloPassFix on " << Pass::name();
+    iterations_ = 0;
     while (!run_state->changed_last_iteration.empty()) {
       TF_RETURN_IF_ERROR(
           RunOnChangedComputationsOnce(module, run_state, execution_threads));
@@ -95,6 +100,7 @@ class HloPassFix : public Pass {
               << " changed_this_iteration: "
               << !run_state->changed_last_iteration.empty();
       run_state->IncrementIteration();
+      iterations_ = run_state->iteration;
       if (run_state->iteration == kIterationLimit) {
         VLOG(1) << "Unexpectedly high number of iterations in HLO passes '"
                 << Pass::name() << "' for module '" << module->name()
@@ -127,6 +133,9 @@ class HloPassFix : public Pass {
     }
     return OkStatus();
   }
+
+  // Number of iterations of the last run.
+  int64_t iterations_ = 0;
 };
 
 }  // namespace xla
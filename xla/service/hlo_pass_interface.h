@@ -140,6 +140,14 @@ class HloPassInterface {
       const absl::flat_hash_set<absl::string_view>& execution_threads) = 0;
 
   virtual bool IsPassPipeline() { return false; }
+
+  // Whether this pass derives from HloComputationPass and hence may be run
+  // over independent computations concurrently.
+  virtual bool IsComputationPass() { return false; }
+
+  // Returns the number of iterations the last run of this pass took if it runs
+  // to a fixed point (see HloPassFix), zero otherwise.
+  virtual int64_t fix_point_iterations() const { return 0; }
 };
 
 // Base class for passes which are module-scoped.
@@ -15,21 +15,30 @@ limitations under the License.
 
 #include "xla/service/hlo_pass_pipeline.h"
 
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
+#include <utility>
 
+#include "absl/base/const_init.h"
+#include "absl/cleanup/cleanup.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
+#include "absl/synchronization/mutex.h"
 #include "xla/service/dump.h"
+#include "xla/service/hlo_computation_pass.h"
 #include "xla/service/hlo_graph_dumper.h"
 #include "xla/service/hlo_proto_util.h"
 #include "xla/status_macros.h"
 #include "xla/types.h"
 #include "xla/util.h"
 #include "tsl/platform/errors.h"
+#include "tsl/platform/env.h"
 #include "tsl/platform/logging.h"
+#include "tsl/platform/threadpool.h"
 
 namespace xla {
 
@@ -120,8 +129,74 @@ void SetInstructionMetadata(HloModuleGroup& module_group) {
   }
 }
 
+int64_t InstructionCount(const HloModule& module) {
+  return module.instruction_count();
+}
+
+int64_t InstructionCount(const HloModuleGroup& module_group) {
+  int64_t count = 0;
+  for (const HloModule* module : module_group.modules()) {
+    count += module->instruction_count();
+  }
+  return count;
+}
+
+void DumpPassProfile(const HloModule& module, absl::string_view pipeline_name,
+                     const CompilationStats& stats) {
+  CompilationStatsProto proto = stats.ToProto();
+  StatusOr<std::string> json = CompilationStatsToJson(proto);
+  if (!json.ok()) {
+    LOG(ERROR) << "Could not dump the HLO pass profile: " << json.status();
+    return;
+  }
+  DumpToFileInDirOrStdout(module, "",
+                          absl::StrCat(pipeline_name, ".pass_profile.json"),
+                          *json);
+  DumpToFileInDirOrStdout(
+      module, "", absl::StrCat(pipeline_name, ".pass_profile.trace.json"),
+      CompilationStatsToTraceJson(proto));
+}
+
+// Returns a process-wide thread pool with `parallelism` threads for running
+// computation passes, or nullptr if they should run on the calling thread. The
+// pool's threads never block on the pool, so pipelines running concurrently
+// can share it.
+tsl::thread::ThreadPool* GetComputationPassThreadPool(int parallelism) {
+  if (parallelism <= 1) {
+    return nullptr;
+  }
+  static absl::Mutex mu(absl::kConstInit);
+  static auto* pools =
+      new absl::flat_hash_map<int, std::unique_ptr<tsl::thread::ThreadPool>>();
+  absl::MutexLock lock(&mu);
+  std::unique_ptr<tsl::thread::ThreadPool>& pool = (*pools)[parallelism];
+  if (pool == nullptr) {
+    pool = std::make_unique<tsl::thread::ThreadPool>(
+        tsl::Env::Default(), "hlo_computation_pass", parallelism);
+  }
+  return pool.get();
+}
+
 }  // namespace
 
+/*static*/ StatusOr<bool> HloPassPipeline::RunHelper(
+    HloPassInterface* pass, HloModule* module,
+    const absl::flat_hash_set<absl::string_view>& execution_threads) {
+  bool changed;
+  if (pass->IsComputationPass()) {
+    const int parallelism =
+        module->config().debug_options().xla_hlo_pass_computation_parallelism();
+    TF_ASSIGN_OR_RETURN(
+        changed, static_cast<HloComputationPass*>(pass)->RunOnComputations(
+                     module, execution_threads,
+                     GetComputationPassThreadPool(parallelism)));
+  } else {
+    TF_ASSIGN_OR_RETURN(changed, pass->Run(module, execution_threads));
+  }
+  module->Cleanup();
+  return changed;
+}
+
 template <typename HloT>
 Status HloPassPipeline::RunInvariantCheckers(
     HloT* hlo, absl::string_view after_pass_name,
@@ -176,12 +251,35 @@ StatusOr<bool> HloPassPipeline::RunPassesInternal(
     std::string pass_name = std::string(pass->name());
     VLOG(1) << "  HLO pass " << pass_name;
     VLOG(2) << "  Module hash " << absl::HashOf(*hlo);
-    if (!pass->IsPassPipeline()) {
-      compilation_stats_->StartPass(pass_name);
+    compilation_stats_->StartPass(pass_name, pipeline_name,
+                                  pass->IsPassPipeline(),
+                                  InstructionCount(*hlo));
+    // End the pass on every exit, including errors, so that the stats of the
+    // enclosing pipelines and the final report stay balanced.
+    bool pass_changed = false;
+    absl::Cleanup end_pass = [&] {
+      compilation_stats_->EndPass(pass_name, pass_changed,
+                                  InstructionCount(*hlo),
+                                  pass->fix_point_iterations());
+    };
+    // A nested pipeline without stats of its own reports to ours.
+    HloPassPipeline* nested_pipeline = nullptr;
+    if (pass->IsPassPipeline()) {
+      nested_pipeline = static_cast<HloPassPipeline*>(pass);
+      if (nested_pipeline->compilation_stats_ ==
+          nested_pipeline->empty_compilation_stats_.get()) {
+        nested_pipeline->compilation_stats_ = compilation_stats_;
+      } else {
+        nested_pipeline = nullptr;
+      }
     }
     RecordPassStartMetadata(*hlo, pass_name, pipeline_name);
-    TF_ASSIGN_OR_RETURN(bool pass_changed,
-                        RunHelper(pass, hlo, execution_threads));
+    StatusOr<bool> pass_changed_or = RunHelper(pass, hlo, execution_threads);
+    if (nested_pipeline != nullptr) {
+      nested_pipeline->compilation_stats_ =
+          nested_pipeline->empty_compilation_stats_.get();
+    }
+    TF_ASSIGN_OR_RETURN(pass_changed, std::move(pass_changed_or));
     SetInstructionMetadata(*hlo);
     if (!dump_regex.empty() && (pass_changed || dump_regex != ".*")) {
       MaybeDumpHloAndSaveFilenames(*hlo,
@@ -196,9 +294,6 @@ StatusOr<bool> HloPassPipeline::RunPassesInternal(
       VLOG(3) << "  Pass caused changes " << pass->name();
       TF_RETURN_IF_ERROR(RunInvariantCheckers(hlo, pass_name));
     }
-    if (!pass->IsPassPipeline()) {
-      compilation_stats_->EndPass(pass_name);
-    }
   }
   return changed;
 }
@@ -275,8 +370,23 @@ StatusOr<bool> HloPassPipeline::Run(
   VLOG(1) << "Running HLO pass pipeline on module " << module->name() << ": "
           << name();
 
-  return RunPassesInternal(module, module->config().debug_options(),
-                           execution_threads);
+  // Profile top-level pipelines, i.e. those not reporting to another one, if
+  // requested.
+  const DebugOptions& debug_options = module->config().debug_options();
+  std::unique_ptr<CompilationStats> profile;
+  if (debug_options.xla_dump_hlo_pass_profile() &&
+      compilation_stats_ == empty_compilation_stats_.get() &&
+      DumpingEnabledForHloModule(*module)) {
+    profile = CompilationStats::MakeStats();
+    compilation_stats_ = profile.get();
+  }
+  StatusOr<bool> changed =
+      RunPassesInternal(module, debug_options, execution_threads);
+  if (profile != nullptr) {
+    compilation_stats_ = empty_compilation_stats_.get();
+    DumpPassProfile(*module, name(), *profile);
+  }
+  return changed;
 }
 
 StatusOr<bool> HloPassPipeline::RunOnModuleGroup(
@@ -15,18 +15,30 @@ limitations under the License.
 
 #include "xla/service/hlo_pass_pipeline.h"
 
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "xla/hlo/ir/dfs_hlo_visitor_with_default.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/hlo/ir/hlo_module.h"
+#include "xla/service/compilation_stats.h"
+#include "xla/service/hlo_computation_pass.h"
 #include "xla/service/hlo_parser.h"
+#include "xla/service/hlo_pass_fix.h"
 #include "xla/tests/hlo_test_base.h"
 #include "xla/util.h"
 #include "tsl/lib/core/status_test_util.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/threadpool.h"
 
 namespace xla {
 namespace {
 
 using ::testing::ElementsAre;
+using ::testing::HasSubstr;
 using ::testing::SizeIs;
 using ::testing::StrEq;
 
@@ -133,6 +145,31 @@ class BarBlowerUpper : public HloModulePass {
   }
 };
 
+// A computation pass which negates the root of each computation. It fails if a
+// computation is processed before the computations it calls. It then visits
+// the computation, which requires the added instruction to have a unique id.
+class NegateRootComputationPass : public HloComputationPass {
+ public:
+  absl::string_view name() const override { return "negate-root"; }
+
+ protected:
+  StatusOr<bool> RunOnComputation(HloComputation* computation) override {
+    for (HloInstruction* instruction : computation->instructions()) {
+      for (HloComputation* callee : instruction->called_computations()) {
+        TF_RET_CHECK(callee->root_instruction()->opcode() ==
+                     HloOpcode::kNegate);
+      }
+    }
+    HloInstruction* root = computation->root_instruction();
+    computation->set_root_instruction(
+        computation->AddInstruction(HloInstruction::CreateUnary(
+            root->shape(), HloOpcode::kNegate, root)));
+    FunctionVisitor visitor([](HloInstruction*) { return OkStatus(); });
+    TF_RETURN_IF_ERROR(computation->Accept(&visitor));
+    return true;
+  }
+};
+
 TEST_F(HloPassPipelineTest, ModulePassChanged) {
   // Test an HLO module pass which changes a module.
   const std::string module_str = R"(
@@ -401,5 +438,207 @@ TEST_F(HloPassPipelineTest, SetHloModuleMetadata) {
   }
 }
 
+TEST_F(HloPassPipelineTest, ComputationPassIsIndependentOfParallelism) {
+  // The entry computation calls many computations which all call 'leaf', so
+  // the pass processes them in three waves.
+  constexpr int kNumCallees = 32;
+  std::string module_str = R"(
+HloModule ComputationPass
+
+leaf {
+  p = f32[] parameter(0)
+  ROOT add = f32[] add(p, p)
+}
+)";
+  for (int i = 0; i < kNumCallees; ++i) {
+    absl::StrAppend(&module_str, "\ncallee", i, R"( {
+  p = f32[] parameter(0)
+  ROOT call = f32[] call(p), to_apply=leaf
+}
+)");
+  }
+  absl::StrAppend(&module_str, R"(
+ENTRY main {
+  p = f32[] parameter(0)
+  sum0 = f32[] call(p), to_apply=callee0
+)");
+  for (int i = 1; i < kNumCallees; ++i) {
+    absl::StrAppend(&module_str, "  call", i,
+                    " = f32[] call(p), to_apply=callee", i, "\n");
+    absl::StrAppend(&module_str, i + 1 == kNumCallees ? "  ROOT " : "  ", "sum",
+                    i, " = f32[] add(sum", i - 1, ", call", i, ")\n");
+  }
+  absl::StrAppend(&module_str, "}\n");
+
+  std::vector<std::vector<std::pair<std::string, int>>> results;
+  for (int parallelism : {1, 4}) {
+    TF_ASSERT_OK_AND_ASSIGN(auto module,
+                            ParseAndReturnVerifiedModule(module_str));
+    DebugOptions debug_options = module->config().debug_options();
+    debug_options.set_xla_hlo_pass_computation_parallelism(parallelism);
+    module->config().set_debug_options(debug_options);
+
+    HloPassPipeline pipeline(TestName());
+    pipeline.AddPass<NegateRootComputationPass>();
+    TF_ASSERT_OK_AND_ASSIGN(bool changed, pipeline.Run(module.get()));
+    EXPECT_TRUE(changed);
+    TF_EXPECT_OK(
+        module->CheckUniqueNamesAndIdsForComputationsAndInstructions());
+
+    std::vector<std::pair<std::string, int>> names_and_ids;
+    for (HloComputation* computation : module->computations()) {
+      EXPECT_EQ(computation->root_instruction()->opcode(), HloOpcode::kNegate);
+      for (HloInstruction* instruction : computation->instructions()) {
+        names_and_ids.emplace_back(instruction->name(),
+                                   instruction->unique_id());
+      }
+    }
+    results.push_back(std::move(names_and_ids));
+  }
+  EXPECT_EQ(results[0], results[1]);
+}
+
+TEST_F(HloPassPipelineTest, ComputationPassUniquifiesOnlyWhenParallel) {
+  const std::string module_str = R"(
+HloModule ComputationPass
+
+callee0 {
+  p = f32[] parameter(0)
+  ROOT add = f32[] add(p, p)
+}
+
+callee1 {
+  p = f32[] parameter(0)
+  ROOT multiply = f32[] multiply(p, p)
+}
+
+ENTRY main {
+  p = f32[] parameter(0)
+  call0 = f32[] call(p), to_apply=callee0
+  call1 = f32[] call(p), to_apply=callee1
+  ROOT add = f32[] add(call0, call1)
+}
+)";
+  // Run serially, instructions are uniquified as they are added.
+  {
+    TF_ASSERT_OK_AND_ASSIGN(auto module,
+                            ParseAndReturnVerifiedModule(module_str));
+    NegateRootComputationPass pass;
+    TF_ASSERT_OK_AND_ASSIGN(bool changed, pass.Run(module.get()));
+    EXPECT_TRUE(changed);
+    EXPECT_FALSE(module->defer_instruction_uniquification());
+    TF_EXPECT_OK(
+        module->CheckUniqueNamesAndIdsForComputationsAndInstructions());
+  }
+  // Nested in a caller which already defers uniquification, the caller
+  // uniquifies the added instructions.
+  {
+    TF_ASSERT_OK_AND_ASSIGN(auto module,
+                            ParseAndReturnVerifiedModule(module_str));
+    tsl::thread::ThreadPool thread_pool(tsl::Env::Default(), TestName(), 2);
+    module->DeferInstructionUniquification();
+    NegateRootComputationPass pass;
+    TF_ASSERT_OK_AND_ASSIGN(
+        bool changed,
+        pass.RunOnComputations(module.get(), /*execution_threads=*/{},
+                               &thread_pool));
+    EXPECT_TRUE(changed);
+    EXPECT_TRUE(module->defer_instruction_uniquification());
+    module->UniquifyDeferredInstructions(module->MakeComputationPostOrder());
+    EXPECT_FALSE(module->defer_instruction_uniquification());
+    TF_EXPECT_OK(
+        module->CheckUniqueNamesAndIdsForComputationsAndInstructions());
+  }
+}
+
+TEST_F(HloPassPipelineTest, CompilationStatsCoverNestedPipelines) {
+  const std::string module_str = R"(
+HloModule CompilationStats
+
+ENTRY main {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT foo = f32[] multiply(a, b)
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<VerifiedHloModule> module,
+                          ParseAndReturnVerifiedModule(module_str));
+  std::unique_ptr<CompilationStats> stats = CompilationStats::MakeStats();
+  HloPassPipeline pipeline(TestName(), stats.get());
+  HloPassPipeline& nested =
+      pipeline.AddPass<HloPassFix<HloPassPipeline>>("nested");
+  nested.AddPass<FooToBarModulePass>();
+  pipeline.AddPass<NegateRootComputationPass>();
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, pipeline.Run(module.get()));
+  EXPECT_TRUE(changed);
+  EXPECT_EQ(stats->GetPassesSize(), 3);
+
+  // The fixed-point pipeline renames 'foo' in its first iteration and finds
+  // nothing to do in the second.
+  CompilationStatsProto proto = stats->ToProto();
+  ASSERT_THAT(proto.runs(), SizeIs(4));
+  const CompilationStatsProto::PassRun& fix = proto.runs(0);
+  EXPECT_EQ(fix.pass_name(), "nested");
+  EXPECT_TRUE(fix.is_pipeline());
+  EXPECT_EQ(fix.depth(), 0);
+  EXPECT_EQ(fix.iterations(), 2);
+  EXPECT_TRUE(fix.changed());
+  for (int i : {1, 2}) {
+    const CompilationStatsProto::PassRun& run = proto.runs(i);
+    EXPECT_EQ(run.pass_name(), "foo2bar");
+    EXPECT_EQ(run.pipeline_name(), "nested");
+    EXPECT_EQ(run.depth(), 1);
+    EXPECT_EQ(run.changed(), i == 1);
+    EXPECT_GE(run.start_timestamp_usec(), fix.start_timestamp_usec());
+    EXPECT_LE(run.end_timestamp_usec(), fix.end_timestamp_usec());
+  }
+  const CompilationStatsProto::PassRun& negate = proto.runs(3);
+  EXPECT_EQ(negate.pass_name(), "negate-root");
+  EXPECT_EQ(negate.depth(), 0);
+  EXPECT_EQ(negate.instruction_count_before(), 3);
+  EXPECT_EQ(negate.instruction_count_after(), 4);
+
+  int64_t foo2bar_runs = 0;
+  for (const CompilationStatsProto::PassSummary& summary : proto.summaries()) {
+    if (summary.pass_name() == "foo2bar") {
+      foo2bar_runs = summary.num_runs();
+    }
+  }
+  EXPECT_EQ(foo2bar_runs, 2);
+  EXPECT_THAT(CompilationStatsToTraceJson(proto),
+              HasSubstr(R"("name":"foo2bar","cat":"pass","ph":"X")"));
+}
+
+TEST_F(HloPassPipelineTest, CompilationStatsEndPassesOnError) {
+  const std::string module_str = R"(
+HloModule CompilationStatsOnError
+
+ENTRY main {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT foo = f32[] multiply(a, b)
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<VerifiedHloModule> module,
+                          ParseAndReturnVerifiedModule(module_str));
+  std::unique_ptr<CompilationStats> stats = CompilationStats::MakeStats();
+  HloPassPipeline pipeline(TestName(), stats.get());
+  HloPassPipeline& nested = pipeline.AddPass<HloPassPipeline>("nested");
+  nested.AddInvariantChecker<BarBlowerUpper>();
+  nested.AddPass<FooToBarModulePass>();
+  EXPECT_FALSE(pipeline.Run(module.get()).ok());
+
+  // Both the failing pass and the pipeline around it are ended, so the
+  // report does not find passes which are still running.
+  CompilationStatsProto proto = stats->ToProto();
+  ASSERT_THAT(proto.runs(), SizeIs(2));
+  EXPECT_EQ(proto.runs(0).pass_name(), "nested");
+  EXPECT_EQ(proto.runs(1).pass_name(), "foo2bar");
+  EXPECT_TRUE(proto.runs(1).changed());
+  EXPECT_GE(proto.runs(0).end_timestamp_usec(),
+            proto.runs(1).end_timestamp_usec());
+  stats->CompilationReport();
+}
+
 }  // namespace
 }  // namespace xla
@@ -15,8 +15,14 @@ limitations under the License.
 
 #include "xla/service/hlo_reachability.h"
 
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <queue>
+#include <vector>
 
+#include "absl/algorithm/container.h"
 #include "xla/hlo/ir/hlo_opcode.h"
 
 namespace xla {
@@ -203,4 +209,348 @@ void HloReachabilityMap::UpdateReachabilityThroughInstruction(
   }
 }
 
+namespace {
+
+// Distance between the orders assigned by HloDfsReachability::Build, which
+// leaves room for inserting instructions without relabelling their neighbours.
+constexpr int64_t kOrderSpacing = 1 << 10;
+
+bool IsChannelGroupedCollective(const HloInstruction* hlo) {
+  return (hlo->opcode() == HloOpcode::kAllReduce ||
+          hlo->opcode() == HloOpcode::kReduceScatter) &&
+         hlo->channel_id().has_value();
+}
+
+// The channel under which HloComputation::ComputeChannelDependencies groups
+// 'hlo', if any.
+std::optional<int64_t> GetChannelGroupId(const HloInstruction* hlo) {
+  switch (hlo->opcode()) {
+    case HloOpcode::kSend:
+    case HloOpcode::kRecvDone:
+    case HloOpcode::kAllReduce:
+    case HloOpcode::kAllGather:
+    case HloOpcode::kAllToAll:
+    case HloOpcode::kCollectivePermute:
+    case HloOpcode::kReduceScatter:
+      return hlo->channel_id();
+    default:
+      return std::nullopt;
+  }
+}
+
+}  // namespace
+
+std::unique_ptr<HloDfsReachability> HloDfsReachability::Build(
+    const HloComputation* computation) {
+  std::unique_ptr<HloDfsReachability> result(new HloDfsReachability());
+  result->channel_group_ = computation->ComputeChannelDependencies();
+
+  const std::vector<HloInstruction*> post_order =
+      computation->MakeInstructionPostOrder();
+  result->orders_.reserve(post_order.size());
+  result->used_orders_.reserve(post_order.size());
+  int64_t order = 0;
+  for (const HloInstruction* hlo : post_order) {
+    result->orders_[hlo] = order;
+    result->used_orders_.insert(order);
+    order += kOrderSpacing;
+  }
+  // The post order already accounts for channel dependencies, but make sure
+  // the labels are consistent with every edge we traverse.
+  for (const HloInstruction* hlo : post_order) {
+    result->ForEachPredecessor(hlo, [&](const HloInstruction* predecessor) {
+      if (result->GetOrder(predecessor) >= result->GetOrder(hlo)) {
+        result->Reorder(predecessor, hlo);
+      }
+    });
+  }
+  return result;
+}
+
+void HloDfsReachability::ForEachPredecessor(
+    const HloInstruction* instruction,
+    absl::FunctionRef<void(const HloInstruction*)> fn) const {
+  const auto add_input = [&](const HloInstruction* input) {
+    if (input != instruction) {
+      fn(input);
+    }
+    if (IsChannelGroupedCollective(input)) {
+      auto it = channel_group_.find(*input->channel_id());
+      if (it != channel_group_.end()) {
+        for (const HloInstruction* member : it->second) {
+          if (member != instruction) {
+            fn(member);
+          }
+        }
+      }
+    }
+  };
+  const auto add_dependencies = [&](const HloInstruction* hlo) {
+    for (const HloInstruction* operand : hlo->operands()) {
+      add_input(operand);
+    }
+    for (const HloInstruction* predecessor : hlo->control_predecessors()) {
+      add_input(predecessor);
+    }
+  };
+
+  add_dependencies(instruction);
+  if (instruction->opcode() == HloOpcode::kRecvDone) {
+    auto it = channel_group_.find(*instruction->channel_id());
+    if (it != channel_group_.end()) {
+      for (const HloInstruction* channel : it->second) {
+        if (channel->opcode() == HloOpcode::kSend) {
+          add_input(channel);
+        }
+      }
+    }
+  } else if (IsChannelGroupedCollective(instruction)) {
+    auto it = channel_group_.find(*instruction->channel_id());
+    if (it != channel_group_.end()) {
+      for (const HloInstruction* all_reduce : it->second) {
+        add_dependencies(all_reduce);
+      }
+    }
+  }
+}
+
+void HloDfsReachability::ForEachSuccessor(
+    const HloInstruction* instruction,
+    absl::FunctionRef<void(const HloInstruction*)> fn) const {
+  // Mirrors ForEachPredecessor: a dependency of any instruction in a channel
+  // group is a dependency of the grouped collectives, and the users of a
+  // grouped collective depend on the whole group.
+  const auto add_output = [&](const HloInstruction* output) {
+    if (output != instruction) {
+      fn(output);
+    }
+    std::optional<int64_t> channel_id = GetChannelGroupId(output);
+    if (!channel_id) {
+      return;
+    }
+    auto it = channel_group_.find(*channel_id);
+    if (it != channel_group_.end()) {
+      for (const HloInstruction* member : it->second) {
+        if (member != instruction && IsChannelGroupedCollective(member)) {
+          fn(member);
+        }
+      }
+    }
+  };
+  const auto add_dependents = [&](const HloInstruction* hlo) {
+    for (const HloInstruction* user : hlo->users()) {
+      add_output(user);
+    }
+    for (const HloInstruction* successor : hlo->control_successors()) {
+      add_output(successor);
+    }
+  };
+
+  add_dependents(instruction);
+  std::optional<int64_t> channel_id = GetChannelGroupId(instruction);
+  if (!channel_id) {
+    return;
+  }
+  auto it = channel_group_.find(*channel_id);
+  if (it == channel_group_.end()) {
+    return;
+  }
+  for (const HloInstruction* channel : it->second) {
+    if (channel == instruction) {
+      continue;
+    }
+    if (IsChannelGroupedCollective(channel)) {
+      add_dependents(channel);
+    }
+    if (instruction->opcode() == HloOpcode::kSend &&
+        channel->opcode() == HloOpcode::kRecvDone) {
+      add_output(channel);
+    }
+  }
+}
+
+bool HloDfsReachability::IsReachable(const HloInstruction* a,
+                                     const HloInstruction* b) const {
+  if (a == b) {
+    return true;
+  }
+  const int64_t lower = GetOrder(a);
+  if (GetOrder(b) <= lower) {
+    return false;
+  }
+  // Search backwards from 'b'. Instructions ordered before 'a' cannot be
+  // reached from it, so the search is confined to [order(a), order(b)].
+  std::vector<const HloInstruction*> worklist = {b};
+  absl::flat_hash_set<const HloInstruction*> visited = {b};
+  bool found = false;
+  while (!worklist.empty() && !found) {
+    const HloInstruction* item = worklist.back();
+    worklist.pop_back();
+    ForEachPredecessor(item, [&](const HloInstruction* predecessor) {
+      if (predecessor == a) {
+        found = true;
+      } else if (!found && GetOrder(predecessor) > lower &&
+                 visited.insert(predecessor).second) {
+        worklist.push_back(predecessor);
+      }
+    });
+  }
+  return found;
+}
+
+std::vector<const HloInstruction*> HloDfsReachability::Search(
+    const HloInstruction* start, bool forward, int64_t lower,
+    int64_t upper) const {
+  std::vector<const HloInstruction*> result = {start};
+  absl::flat_hash_set<const HloInstruction*> visited = {start};
+  for (size_t i = 0; i < result.size(); ++i) {
+    const auto visit = [&](const HloInstruction* next) {
+      int64_t order = GetOrder(next);
+      if (order >= lower && order <= upper && visited.insert(next).second) {
+        result.push_back(next);
+      }
+    };
+    if (forward) {
+      ForEachSuccessor(result[i], visit);
+    } else {
+      ForEachPredecessor(result[i], visit);
+    }
+  }
+  return result;
+}
+
+void HloDfsReachability::Reorder(const HloInstruction* from,
+                                 const HloInstruction* to) {
+  const int64_t lower = GetOrder(to);
+  const int64_t upper = GetOrder(from);
+  DCHECK_GE(upper, lower);
+  // The instructions after 'to' that are not after 'from' yet, and the
+  // instructions before 'from' that are not before 'to' yet. The two sets are
+  // disjoint unless the edge closes a cycle.
+  std::vector<const HloInstruction*> forward =
+      Search(to, /*forward=*/true, lower, upper);
+  std::vector<const HloInstruction*> backward =
+      Search(from, /*forward=*/false, lower, upper);
+  CHECK(!absl::c_linear_search(forward, from))
+      << "Edge from " << from->name() << " to " << to->name()
+      << " introduces a cycle";
+
+  // Move all of 'backward' in front of all of 'forward', reusing their orders
+  // and keeping the relative order within each set.
+  const auto by_order = [this](const HloInstruction* a,
+                               const HloInstruction* b) {
+    return GetOrder(a) < GetOrder(b);
+  };
+  absl::c_sort(backward, by_order);
+  absl::c_sort(forward, by_order);
+  std::vector<int64_t> orders;
+  orders.reserve(backward.size() + forward.size());
+  for (const HloInstruction* hlo : backward) {
+    orders.push_back(GetOrder(hlo));
+  }
+  for (const HloInstruction* hlo : forward) {
+    orders.push_back(GetOrder(hlo));
+  }
+  absl::c_sort(orders);
+  auto order_it = orders.begin();
+  for (const HloInstruction* hlo : backward) {
+    orders_[hlo] = *order_it++;
+  }
+  for (const HloInstruction* hlo : forward) {
+    orders_[hlo] = *order_it++;
+  }
+}
+
+void HloDfsReachability::Insert(const HloInstruction* instruction) {
+  int64_t lower = std::numeric_limits<int64_t>::min();
+  int64_t upper = std::numeric_limits<int64_t>::max();
+  ForEachPredecessor(instruction, [&](const HloInstruction* predecessor) {
+    auto it = orders_.find(predecessor);
+    if (it != orders_.end()) {
+      lower = std::max(lower, it->second);
+    }
+  });
+  ForEachSuccessor(instruction, [&](const HloInstruction* successor) {
+    auto it = orders_.find(successor);
+    if (it != orders_.end()) {
+      upper = std::min(upper, it->second);
+    }
+  });
+  if (lower == std::numeric_limits<int64_t>::min()) {
+    lower = (upper == std::numeric_limits<int64_t>::max() ? 0 : upper) -
+            kOrderSpacing;
+  }
+  if (upper == std::numeric_limits<int64_t>::max()) {
+    upper = lower + kOrderSpacing;
+  }
+  int64_t order = lower + std::max<int64_t>(1, (upper - lower) / 2);
+  while (!used_orders_.insert(order).second) {
+    ++order;
+  }
+  orders_[instruction] = order;
+}
+
+void HloDfsReachability::ReorderAround(const HloInstruction* instruction) {
+  ForEachPredecessor(instruction, [&](const HloInstruction* predecessor) {
+    if (GetOrder(predecessor) >= GetOrder(instruction)) {
+      Reorder(predecessor, instruction);
+    }
+  });
+  ForEachSuccessor(instruction, [&](const HloInstruction* successor) {
+    if (GetOrder(instruction) >= GetOrder(successor)) {
+      Reorder(instruction, successor);
+    }
+  });
+}
+
+void HloDfsReachability::UpdateReachabilityThroughInstruction(
+    const HloInstruction* instruction) {
+  // Add 'instruction' and any new instructions connected to it, e.g. the
+  // get-tuple-elements created by multi-output fusion, then repair the order
+  // around each of them.
+  std::vector<const HloInstruction*> updated = {instruction};
+  if (!IsPresent(instruction)) {
+    Insert(instruction);
+  }
+  for (size_t i = 0; i < updated.size(); ++i) {
+    const auto add_new = [&](const HloInstruction* neighbor) {
+      if (!IsPresent(neighbor)) {
+        Insert(neighbor);
+        updated.push_back(neighbor);
+      }
+    };
+    ForEachPredecessor(updated[i], add_new);
+    ForEachSuccessor(updated[i], add_new);
+  }
+  for (const HloInstruction* hlo : updated) {
+    ReorderAround(hlo);
+  }
+}
+
+void HloDfsReachability::Replace(const HloInstruction* original,
+                                 const HloInstruction* replacement) {
+  if (original == replacement) {
+    return;
+  }
+  auto it = orders_.find(original);
+  if (it != orders_.end()) {
+    int64_t order = it->second;
+    orders_.erase(it);
+    if (!IsPresent(replacement)) {
+      orders_[replacement] = order;
+    } else {
+      used_orders_.erase(order);
+    }
+  }
+  UpdateReachabilityThroughInstruction(replacement);
+}
+
+void HloDfsReachability::Remove(const HloInstruction* instruction) {
+  auto it = orders_.find(instruction);
+  if (it != orders_.end()) {
+    used_orders_.erase(it->second);
+    orders_.erase(it);
+  }
+}
+
 }  // namespace xla
@@ -18,10 +18,13 @@ limitations under the License.
 
 #include <cstdio>
 #include <list>
+#include <memory>
 #include <vector>
 
 #include "absl/base/casts.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/functional/function_ref.h"
 #include "absl/types/span.h"
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
@@ -250,6 +253,97 @@ class HloReachabilityMap {
   BitVector tmp_bit_vector_;
 };
 
+// A class for answering reachability queries between the instructions of a
+// computation without materializing the transitive closure.
+//
+// Every instruction is labelled with its position in a topological order of
+// the computation. As an instruction can only reach instructions that come
+// after it, IsReachable(a, b) is answered by a depth-first search backwards
+// from 'b' that never visits instructions ordered before 'a'. Memory use is
+// linear in the number of instructions, and queries between instructions that
+// are close in the graph only touch the instructions between them.
+//
+// Unlike HloReachabilityMap, edges are read from the current state of the
+// computation, so graph edits only need to keep the labels topologically
+// sorted. This is done incrementally with the dynamic topological sort of
+// Pearce and Kelly, which only relabels the instructions between the endpoints
+// of an edge that violates the order. Instructions are identified by address:
+// instructions removed from the computation must be removed from (or replaced
+// in) the map.
+class HloDfsReachability {
+ public:
+  // Labels the instructions of 'computation'. As in HloReachabilityMap::Build,
+  // data, control and channel dependencies are considered for reachability.
+  static std::unique_ptr<HloDfsReachability> Build(
+      const HloComputation* computation);
+
+  // Returns true if "b" is reachable from "a" in the current graph. Trivially
+  // an instruction is reachable from itself.
+  bool IsReachable(const HloInstruction* a, const HloInstruction* b) const;
+
+  // Returns true if "b" is reachable from "a" or "a" is reachable from "b".
+  bool IsConnected(const HloInstruction* a, const HloInstruction* b) const {
+    return IsReachable(a, b) || IsReachable(b, a);
+  }
+
+  // Checks if an instruction is in the reachability map.
+  bool IsPresent(const HloInstruction* a) const { return orders_.contains(a); }
+
+  // Updates the labels after the operands, users or control dependencies of
+  // 'instruction' have changed. 'instruction' and its neighbours are added to
+  // the map if they are not present yet.
+  void UpdateReachabilityThroughInstruction(const HloInstruction* instruction);
+
+  // Replaces the instruction "original" with "replacement" in the reachability
+  // map, and updates the labels around "replacement".
+  void Replace(const HloInstruction* original,
+               const HloInstruction* replacement);
+
+  // Removes an instruction which is no longer part of the graph.
+  void Remove(const HloInstruction* instruction);
+
+ private:
+  HloDfsReachability() = default;
+
+  int64_t GetOrder(const HloInstruction* instruction) const {
+    return FindOrDie(orders_, instruction);
+  }
+
+  // Calls 'fn' for the immediate predecessors (successors) of 'instruction',
+  // including the ones induced by channel dependencies. An instruction may be
+  // visited more than once.
+  void ForEachPredecessor(
+      const HloInstruction* instruction,
+      absl::FunctionRef<void(const HloInstruction*)> fn) const;
+  void ForEachSuccessor(
+      const HloInstruction* instruction,
+      absl::FunctionRef<void(const HloInstruction*)> fn) const;
+
+  // Returns the instructions reachable from (if 'forward') or reaching 'start',
+  // including 'start', whose order is within [lower, upper].
+  std::vector<const HloInstruction*> Search(const HloInstruction* start,
+                                            bool forward, int64_t lower,
+                                            int64_t upper) const;
+
+  // Adds 'instruction' with an order between its present predecessors and
+  // successors if there is room, and right after its predecessors otherwise.
+  void Insert(const HloInstruction* instruction);
+
+  // Relabels the instructions between 'from' and 'to', such that 'from' comes
+  // before 'to', after an edge from 'from' to 'to' has been added.
+  void Reorder(const HloInstruction* from, const HloInstruction* to);
+
+  // Restores the order of all edges adjacent to 'instruction'.
+  void ReorderAround(const HloInstruction* instruction);
+
+  // Position of each instruction in a topological order. Orders are unique,
+  // but not dense, which leaves room to insert instructions.
+  absl::flat_hash_map<const HloInstruction*, int64_t> orders_;
+  absl::flat_hash_set<int64_t> used_orders_;
+
+  HloComputation::ChannelDependencyGroup channel_group_;
+};
+
 }  // namespace xla
 
 #endif  // TENSORFLOW_COMPILER_XLA_SERVICE_HLO_REACHABILITY_H_
@@ -15,13 +15,17 @@ limitations under the License.
 
 #include "xla/service/hlo_reachability.h"
 
+#include <memory>
 #include <set>
+#include <utility>
+#include <vector>
 
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/service/computation_placer.h"
 #include "xla/test.h"
 #include "xla/test_helpers.h"
 #include "xla/tests/hlo_test_base.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace xla {
 
@@ -240,6 +244,248 @@ TEST_F(HloReachabilityTest, ReplaceInstructions) {
   EXPECT_TRUE(reachability->IsReachable(p0, fusion));
 }
 
+// Checks that `reachability` agrees with a freshly built HloReachabilityMap on
+// every pair of instructions in `computation`.
+void ExpectMatchesBitset(const HloComputation* computation,
+                         const HloDfsReachability& reachability) {
+  auto expected = HloReachabilityMap::Build(computation);
+  for (const HloInstruction* a : computation->instructions()) {
+    for (const HloInstruction* b : computation->instructions()) {
+      EXPECT_EQ(reachability.IsReachable(a, b), expected->IsReachable(a, b))
+          << a->name() << " -> " << b->name();
+    }
+  }
+}
+
+TEST_F(HloReachabilityTest, DfsReachability) {
+  Shape r0f32 = ShapeUtil::MakeShape(F32, {});
+  auto builder = HloComputation::Builder(TestName());
+  auto constant1 = builder.AddInstruction(
+      HloInstruction::CreateConstant(LiteralUtil::CreateR0<float>(1.0f)));
+  auto constant2 = builder.AddInstruction(
+      HloInstruction::CreateConstant(LiteralUtil::CreateR0<float>(2.0f)));
+  auto add = builder.AddInstruction(HloInstruction::CreateBinary(
+      r0f32, HloOpcode::kAdd, constant1, constant2));
+  auto negate = builder.AddInstruction(
+      HloInstruction::CreateUnary(r0f32, HloOpcode::kNegate, constant2));
+  auto exp = builder.AddInstruction(
+      HloInstruction::CreateUnary(r0f32, HloOpcode::kExp, negate));
+  auto mul = builder.AddInstruction(
+      HloInstruction::CreateBinary(r0f32, HloOpcode::kMultiply, add, exp));
+  auto copy = builder.AddInstruction(
+      HloInstruction::CreateUnary(r0f32, HloOpcode::kCopy, exp));
+
+  auto module = CreateNewVerifiedModule();
+  auto computation =
+      module->AddEntryComputation(builder.Build(/*root_instruction=*/mul));
+
+  TF_CHECK_OK(add->AddControlDependencyTo(exp));
+  auto reachability = HloDfsReachability::Build(computation);
+
+  EXPECT_TRUE(reachability->IsReachable(constant1, exp));
+  EXPECT_TRUE(reachability->IsReachable(constant1, copy));
+  EXPECT_FALSE(reachability->IsReachable(copy, constant1));
+  EXPECT_FALSE(reachability->IsReachable(negate, add));
+  EXPECT_TRUE(reachability->IsConnected(constant1, copy));
+  EXPECT_FALSE(reachability->IsConnected(negate, add));
+  ExpectMatchesBitset(computation, *reachability);
+
+  ASSERT_IS_OK(add->RemoveControlDependencyTo(exp));
+  reachability->UpdateReachabilityThroughInstruction(exp);
+  EXPECT_FALSE(reachability->IsReachable(constant1, exp));
+  ExpectMatchesBitset(computation, *reachability);
+}
+
+TEST_F(HloReachabilityTest, DfsChannelReachability) {
+  const Shape shape = ShapeUtil::MakeShape(F32, {5, 7});
+  HloComputation::Builder builder("ChannelReachability");
+  auto param = builder.AddInstruction(
+      HloInstruction::CreateParameter(0, shape, "param"));
+  auto token0 = builder.AddInstruction(HloInstruction::CreateToken());
+  auto send =
+      builder.AddInstruction(HloInstruction::CreateSend(param, token0, 1));
+  auto send_done = builder.AddInstruction(HloInstruction::CreateSendDone(send));
+  auto token1 = builder.AddInstruction(HloInstruction::CreateToken());
+  auto recv =
+      builder.AddInstruction(HloInstruction::CreateRecv(shape, token1, 1));
+  auto recv_done = builder.AddInstruction(HloInstruction::CreateRecvDone(recv));
+
+  auto module = CreateNewVerifiedModule();
+  module->config().set_use_spmd_partitioning(false);
+  module->config().set_static_device_assignment(DeviceAssignment(1, 2));
+  auto computation = module->AddEntryComputation(builder.Build(recv_done));
+  auto reachability = HloDfsReachability::Build(computation);
+  EXPECT_TRUE(reachability->IsReachable(param, recv_done));
+  EXPECT_FALSE(reachability->IsReachable(send, recv));
+  EXPECT_FALSE(reachability->IsReachable(send_done, recv));
+  ExpectMatchesBitset(computation, *reachability);
+}
+
+TEST_F(HloReachabilityTest, DfsReachabilityIncrementalUpdates) {
+  auto module = ParseAndReturnVerifiedModule(R"(
+    HloModule test
+
+    ENTRY entry {
+      p0 = f32[8]{0} parameter(0)
+      a = f32[8]{0} negate(p0)
+      b = f32[8]{0} exponential(p0)
+      c = f32[8]{0} add(a, b)
+      d = f32[8]{0} sqrt(b)
+      ROOT t = (f32[8]{0}, f32[8]{0}) tuple(d, c)
+    })")
+                    .value();
+  HloComputation* computation = module->entry_computation();
+  auto reachability = HloDfsReachability::Build(computation);
+  HloInstruction* b = FindInstruction(module.get(), "b");
+  HloInstruction* c = FindInstruction(module.get(), "c");
+  HloInstruction* d = FindInstruction(module.get(), "d");
+  ExpectMatchesBitset(computation, *reachability);
+
+  // `d` comes before `c` in the post order, so this edge forces a reorder.
+  TF_ASSERT_OK(c->AddControlDependencyTo(d));
+  reachability->UpdateReachabilityThroughInstruction(d);
+  EXPECT_TRUE(reachability->IsReachable(c, d));
+  ExpectMatchesBitset(computation, *reachability);
+  TF_ASSERT_OK(c->RemoveControlDependencyTo(d));
+  reachability->UpdateReachabilityThroughInstruction(d);
+  EXPECT_FALSE(reachability->IsReachable(c, d));
+
+  // Fuse `c`, then multi-output fuse `b` into the fusion. This makes `d` use a
+  // new get-tuple-element of the fusion.
+  HloInstruction* fusion =
+      computation->AddInstruction(HloInstruction::CreateFusion(
+          c->shape(), HloInstruction::FusionKind::kLoop, c));
+  TF_ASSERT_OK(computation->ReplaceInstruction(c, fusion));
+  reachability->Replace(c, fusion);
+  EXPECT_FALSE(reachability->IsPresent(c));
+  ExpectMatchesBitset(computation, *reachability);
+
+  fusion->FuseInstructionIntoMultiOutput(b);
+  TF_ASSERT_OK(computation->RemoveInstruction(b));
+  reachability->Remove(b);
+  reachability->UpdateReachabilityThroughInstruction(fusion);
+  EXPECT_TRUE(reachability->IsPresent(d->operand(0)));
+  EXPECT_TRUE(reachability->IsReachable(fusion, d));
+  ExpectMatchesBitset(computation, *reachability);
+}
+
+// Builds a computation of `size` additions in two independent chains. Each
+// addition uses the previous one in its chain and a pseudo-randomly chosen one
+// among the 32 before that.
+std::unique_ptr<HloModule> MakeBenchmarkModule(int64_t size) {
+  HloComputation::Builder builder("reachability_benchmark");
+  const Shape shape = ShapeUtil::MakeShape(F32, {});
+  std::vector<HloInstruction*> instructions = {
+      builder.AddInstruction(
+          HloInstruction::CreateParameter(0, shape, "param0")),
+      builder.AddInstruction(
+          HloInstruction::CreateParameter(1, shape, "param1"))};
+  uint64_t state = 42;
+  for (int64_t i = 2; i < size; ++i) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    int64_t other = i - 2 - 2 * (state >> 59);
+    if (other < 0) {
+      other = i % 2;
+    }
+    instructions.push_back(builder.AddInstruction(HloInstruction::CreateBinary(
+        shape, HloOpcode::kAdd, instructions[i - 2], instructions[other])));
+  }
+  auto module = std::make_unique<HloModule>("reachability_benchmark",
+                                            HloModuleConfig());
+  module->AddEntryComputation(builder.Build());
+  return module;
+}
+
+// Pairs of instructions at most 64 apart, as queried by fusion passes.
+std::vector<std::pair<const HloInstruction*, const HloInstruction*>>
+MakeBenchmarkQueries(const HloComputation* computation) {
+  std::vector<HloInstruction*> post_order =
+      computation->MakeInstructionPostOrder();
+  std::vector<std::pair<const HloInstruction*, const HloInstruction*>> queries;
+  for (int64_t i = 0; i + 64 < static_cast<int64_t>(post_order.size());
+       i += 7) {
+    queries.emplace_back(post_order[i], post_order[i + 1 + i % 64]);
+  }
+  return queries;
+}
+
+// The second argument selects HloDfsReachability over HloReachabilityMap.
+void BM_ReachabilityBuild(::testing::benchmark::State& state) {
+  auto module = MakeBenchmarkModule(state.range(0));
+  const HloComputation* computation = module->entry_computation();
+  for (auto s : state) {
+    if (state.range(1) != 0) {
+      tsl::testing::DoNotOptimize(HloDfsReachability::Build(computation));
+    } else {
+      tsl::testing::DoNotOptimize(HloReachabilityMap::Build(computation));
+    }
+  }
+}
+
+void BM_ReachabilityQuery(::testing::benchmark::State& state) {
+  auto module = MakeBenchmarkModule(state.range(0));
+  const HloComputation* computation = module->entry_computation();
+  auto queries = MakeBenchmarkQueries(computation);
+  auto bitset = HloReachabilityMap::Build(computation);
+  auto dfs = HloDfsReachability::Build(computation);
+  for (auto s : state) {
+    for (const auto& [a, b] : queries) {
+      if (state.range(1) != 0) {
+        tsl::testing::DoNotOptimize(dfs->IsReachable(a, b));
+      } else {
+        tsl::testing::DoNotOptimize(bitset->IsReachable(a, b));
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * queries.size());
+}
+
+// Adds and removes a control dependency between the two chains, which changes
+// what half of the instructions of one chain are reachable from.
+void BM_ReachabilityUpdate(::testing::benchmark::State& state) {
+  auto module = MakeBenchmarkModule(state.range(0));
+  const HloComputation* computation = module->entry_computation();
+  std::vector<HloInstruction*> post_order =
+      computation->MakeInstructionPostOrder();
+  HloInstruction* from = post_order[post_order.size() / 4];
+  HloInstruction* to = post_order[post_order.size() * 3 / 4];
+  auto bitset = HloReachabilityMap::Build(computation);
+  auto dfs = HloDfsReachability::Build(computation);
+  for (auto s : state) {
+    TF_CHECK_OK(from->AddControlDependencyTo(to));
+    if (state.range(1) != 0) {
+      dfs->UpdateReachabilityThroughInstruction(to);
+    } else {
+      bitset->UpdateReachabilityThroughInstruction(to);
+    }
+    TF_CHECK_OK(from->RemoveControlDependencyTo(to));
+    if (state.range(1) != 0) {
+      dfs->UpdateReachabilityThroughInstruction(to);
+    } else {
+      bitset->UpdateReachabilityThroughInstruction(to);
+    }
+  }
+}
+
+BENCHMARK(BM_ReachabilityBuild)
+    ->ArgPair(1 << 10, 0)
+    ->ArgPair(1 << 10, 1)
+    ->ArgPair(1 << 14, 0)
+    ->ArgPair(1 << 14, 1)
+    ->ArgPair(1 << 18, 1);
+BENCHMARK(BM_ReachabilityQuery)
+    ->ArgPair(1 << 10, 0)
+    ->ArgPair(1 << 10, 1)
+    ->ArgPair(1 << 14, 0)
+    ->ArgPair(1 << 14, 1)
+    ->ArgPair(1 << 18, 1);
+BENCHMARK(BM_ReachabilityUpdate)
+    ->ArgPair(1 << 10, 0)
+    ->ArgPair(1 << 10, 1)
+    ->ArgPair(1 << 14, 0)
+    ->ArgPair(1 << 14, 1)
+    ->ArgPair(1 << 18, 1);
+
 }  // namespace
 
 }  // namespace xla
@@ -40,6 +40,7 @@ limitations under the License.
 #include "xla/primitive_util.h"
 #include "xla/service/buffer_value.h"
 #include "xla/service/flatten_call_graph.h"
+#include "xla/service/hlo_cost_analysis.h"
 #include "xla/service/hlo_dataflow_analysis.h"
 #include "xla/service/hlo_dce.h"
 #include "xla/service/hlo_memory_scheduler.h"
@@ -57,6 +58,11 @@ namespace {
 
 using ::tsl::strings::HumanReadableNumBytes;
 
+// Maximum number of instructions a prefetch from host memory is started ahead
+// of the copy-done which waits for it. This bounds how much longer the
+// prefetched buffer is live than strictly needed.
+constexpr int64_t kMaxPrefetchDistance = 8;
+
 // Potential optimizations:
 // . TODO(b/35244891): Avoid N^2 behavior by keeping a priority queue
 //   of candidates.
@@ -126,6 +132,9 @@ struct RematStrategy {
     // Change the layout into a compact form and uncompress it back at a later
     // program point.
     kCompress,
+    // Copy the buffer to host memory and prefetch it back at a later program
+    // point.
+    kHostOffload,
   } kind;
   Shape compact_shape;
 };
@@ -251,6 +260,7 @@ class InstructionList {
   //    for (auto item = q.first(); item != nullptr; item = q.next(item)) {...}
   Item* first() const { return first_; }
   Item* next(Item* item) const { return item->next; }
+  Item* prev(Item* item) const { return item->prev; }
 
   Item* first_skip_node() const { return first_skip_node_; }
   Item* next_skip_node(Item* item) const { return item->next_skip_node; }
@@ -508,7 +518,10 @@ class MemoryUsageTracker {
       const HloRematerialization::CompactShapeFunction& compact_shape_function,
       const HloDataflowAnalysis& dataflow_analysis,
       const InstructionList& instruction_list,
-      HloRematerialization::RematerializationMode mode);
+      HloRematerialization::RematerializationMode mode,
+      HloCostAnalysis* cost_analysis = nullptr,
+      std::optional<HloRematerialization::HostMemoryOffloadConfig>
+          host_memory_offload_config = std::nullopt);
 
   // Starts the placement of the given instruction. This adds the sizes of the
   // HloValues defined by the instruction to the current memory
@@ -518,9 +531,12 @@ class MemoryUsageTracker {
   // EndInstruction memory for dead operand(s) is freed.
   Status BeginInstruction(Item* item);
 
-  int64_t RematerializationCost(const std::vector<Item*>& items,
-                                int64_t memory_reduced,
-                                int64_t memory_limit_bytes) {
+  // Returns the cost of rematerializing 'items' by recomputation. Without a
+  // cost analysis this is the inverse of the benefit; with one, it is the
+  // estimated time of the recomputation per byte of memory saved.
+  double RematerializationCost(const std::vector<Item*>& items,
+                               int64_t memory_reduced,
+                               int64_t memory_limit_bytes) {
     // If none of the users of any 'item' have been placed in the
     // sequence (as tracked by memory_tracker), then rematerialization of
     // 'item' is a zero-cost move of 'item->instruction' in the sequence.
@@ -538,9 +554,60 @@ class MemoryUsageTracker {
       return 0;
     }
 
+    double seconds = 0;
+    if (cost_analysis_ != nullptr) {
+      for (auto* item : items) {
+        seconds += cost_analysis_->optimal_seconds(*item->instruction);
+      }
+    }
+    return StrategyCost(seconds, memory_reduced, memory_limit_bytes);
+  }
+
+  // Returns the cost of a strategy which saves 'memory_reduced' bytes and is
+  // estimated to add 'seconds' to the run time.
+  double StrategyCost(double seconds, int64_t memory_reduced,
+                      int64_t memory_limit_bytes) const {
     CHECK_GT(memory_reduced, 0);
-    // Return the inverse of the benefit of rematerialization.
-    return memory_limit_bytes / memory_reduced;
+    if (cost_analysis_ == nullptr) {
+      // Return the inverse of the benefit of rematerialization.
+      return memory_limit_bytes / memory_reduced;
+    }
+    return seconds / memory_reduced;
+  }
+
+  // Returns the estimated time of copying 'bytes' in device memory.
+  double CopySeconds(int64_t bytes) const {
+    if (cost_analysis_ == nullptr) {
+      return 0;
+    }
+    const float bytes_per_second =
+        cost_analysis_->per_second_rate(HloCostAnalysis::kBytesAccessedKey);
+    return bytes_per_second > 0 ? bytes / bytes_per_second : 0;
+  }
+
+  // Returns the estimated time of offloading 'bytes' to host memory and
+  // prefetching them back.
+  double OffloadSeconds(int64_t bytes) const {
+    CHECK(host_memory_offload_config_.has_value());
+    return bytes /
+               host_memory_offload_config_->bandwidth_to_host_bytes_per_second +
+           PrefetchSeconds(bytes);
+  }
+
+  // Returns the estimated time of prefetching 'bytes' from host memory.
+  double PrefetchSeconds(int64_t bytes) const {
+    CHECK(host_memory_offload_config_.has_value());
+    return bytes /
+           host_memory_offload_config_->bandwidth_from_host_bytes_per_second;
+  }
+
+  // Returns the estimated run time of 'instruction', or zero without a cost
+  // analysis.
+  double InstructionSeconds(const HloInstruction* instruction) const {
+    if (cost_analysis_ == nullptr) {
+      return 0;
+    }
+    return cost_analysis_->optimal_seconds(*instruction);
   }
 
   // Finishes the placement of the current instruction. This frees any dead
@@ -558,9 +625,23 @@ class MemoryUsageTracker {
   int64_t MemoryReducedIfRematerialized(
       absl::Span<const Item* const> items) const;
 
+  // Returns the number of bytes that the current memory usage will be reduced
+  // by if the output of the given instruction is offloaded to host memory.
+  int64_t MemoryReducedIfOffloaded(Item* item) const;
+
   Status AddCompressInstructions(Item* original_item, Item* compressed_item,
                                  Item* uncompressed_item);
 
+  // Adjusts memory usage to account for offloading the output of
+  // original_item to host memory and prefetching it back for all remaining
+  // unplaced uses. The copies to host memory are placed; the copies back are
+  // not.
+  Status AddOffloadInstructions(Item* original_item,
+                                Item* copy_start_to_host_item,
+                                Item* copy_done_to_host_item,
+                                Item* copy_start_to_device_item,
+                                Item* copy_done_to_device_item);
+
   // Adjusts memory usage to account for the rematerialization of
   // original_item for all remaining unplaced uses. The rematerialization
   // is remat_item. This method should be called after the HLO graph has
@@ -613,6 +694,11 @@ class MemoryUsageTracker {
 
   const HloComputation* computation() const { return computation_; }
 
+  const std::optional<HloRematerialization::HostMemoryOffloadConfig>&
+  host_memory_offload_config() const {
+    return host_memory_offload_config_;
+  }
+
   // Check invariants of the data structure. This is expensive to call.
   bool Check() const;
 
@@ -793,6 +879,13 @@ class MemoryUsageTracker {
   Item* in_progress_item_ = nullptr;
 
   HloRematerialization::RematerializationMode mode_;
+
+  // Estimates the run time of candidates, if ranking by a cost model.
+  HloCostAnalysis* cost_analysis_;
+
+  std::optional<HloRematerialization::HostMemoryOffloadConfig>
+      host_memory_offload_config_;
+
   // All buffers in the computation.
   std::vector<Buffer> buffers_;
 };
@@ -803,12 +896,17 @@ MemoryUsageTracker::MemoryUsageTracker(
     const HloRematerialization::CompactShapeFunction& compact_shape_function,
     const HloDataflowAnalysis& dataflow_analysis,
     const InstructionList& instruction_list,
-    HloRematerialization::RematerializationMode mode)
+    HloRematerialization::RematerializationMode mode,
+    HloCostAnalysis* cost_analysis,
+    std::optional<HloRematerialization::HostMemoryOffloadConfig>
+        host_memory_offload_config)
     : computation_(computation),
       instruction_list_(instruction_list),
       size_function_(size_function),
       compact_shape_function_(compact_shape_function),
-      mode_(mode) {
+      mode_(mode),
+      cost_analysis_(cost_analysis),
+      host_memory_offload_config_(std::move(host_memory_offload_config)) {
   tsl::gtl::CompactPointerSet<const HloValue*> live_out_set;
   for (auto& [_, hlo_value_set] : dataflow_analysis.GetInstructionValueSet(
            computation_->root_instruction())) {
@@ -1036,6 +1134,30 @@ int64_t MemoryUsageTracker::MemoryReducedIfRematerialized(
   return memory_reduced;
 }
 
+int64_t MemoryUsageTracker::MemoryReducedIfOffloaded(Item* item) const {
+  CHECK_NE(in_progress_item_, nullptr);
+  if (!item->placed || item == in_progress_item_) {
+    return 0;
+  }
+
+  // Only offload a single buffer defined by the instruction itself, so that
+  // the liveness of the offloaded buffer is known.
+  if (item->buffers_defined.size() != 1 ||
+      item->buffers_output != item->buffers_defined) {
+    return 0;
+  }
+  BufferId buffer_id = item->buffers_defined[0];
+  const Buffer& buffer = buffers_.at(buffer_id);
+  if (buffer.has_indirect_uses || buffer.live_out) {
+    return 0;
+  }
+  if (IsCurrentlyLive(buffer_id) && !IsInUse(buffer_id) &&
+      IsInstructionCurrentlyLive(item)) {
+    return AllocatedSize(buffer_id);
+  }
+  return 0;
+}
+
 Status MemoryUsageTracker::AddCompressInstructions(Item* original_item,
                                                    Item* compressed_item,
                                                    Item* uncompressed_item) {
@@ -1091,6 +1213,60 @@ Status MemoryUsageTracker::AddCompressInstructions(Item* original_item,
   return OkStatus();
 }
 
+Status MemoryUsageTracker::AddOffloadInstructions(
+    Item* original_item, Item* copy_start_to_host_item,
+    Item* copy_done_to_host_item, Item* copy_start_to_device_item,
+    Item* copy_done_to_device_item) {
+  CHECK_EQ(original_item->buffers_defined.size(), 1);
+  BufferId original_buffer_id = original_item->buffers_defined[0];
+  // Original buffer is now dead. The buffers in host memory, which are only
+  // used by the copies, take no device memory and are not tracked.
+  memory_usage_ -= AllocatedSize(original_buffer_id);
+
+  UsesList placed_users;
+  UsesList unplaced_users;
+  Buffer& original_buffer = buffers_.at(original_buffer_id);
+  for (ItemUse& user : original_buffer.users) {
+    if (user.user->placed) {
+      CHECK(IsFinished(user.user)) << user.user->instruction->name();
+      placed_users.push_back(user);
+    } else {
+      unplaced_users.push_back(user);
+    }
+  }
+  original_buffer.users = std::move(placed_users);
+  original_buffer.unfinished_user_count = 0;
+  original_buffer.users.push_back(
+      ItemUse{copy_start_to_host_item, 0, std::nullopt});
+  copy_start_to_host_item->buffers_used = {original_buffer_id};
+  copy_done_to_host_item->buffers_used = {};
+  copy_start_to_device_item->buffers_used = {};
+
+  // The device buffer of the prefetch is allocated by the copy-start and
+  // aliased by the copy-done, so it is live for the whole transfer.
+  unplaced_users.push_back(ItemUse{copy_done_to_device_item, 0, std::nullopt});
+  // NewBuffer may reallocate buffers_, invalidating original_buffer, so copy
+  // the index first.
+  ShapeIndex copied_index = original_buffer.index;
+  Buffer& prefetched_buffer = NewBuffer(
+      copy_start_to_device_item,
+      copy_done_to_device_item->instruction->shape(), copied_index,
+      std::move(unplaced_users), /*live_out=*/false,
+      /*has_indirect_uses=*/false);
+  copy_start_to_device_item->buffers_defined = {prefetched_buffer.id};
+  copy_done_to_device_item->buffers_used = {prefetched_buffer.id};
+  copy_done_to_device_item->buffers_output = {prefetched_buffer.id};
+  copy_done_to_device_item->buffers_defined = {};
+
+  for (ItemUse& user : prefetched_buffer.users) {
+    BufferIdList& buffers_used = user.user->buffers_used;
+    std::replace(buffers_used.begin(), buffers_used.end(), original_buffer_id,
+                 prefetched_buffer.id);
+  }
+
+  return OkStatus();
+}
+
 Status MemoryUsageTracker::AddRematerializedInstruction(
     Item* original_item, Item* remat_item, absl::Span<Item*> indirect_users) {
   VLOG(3) << "AddRematerializedInstruction: original_instruction = "
@@ -1227,6 +1403,12 @@ Status MemoryUsageTracker::AddRematerializedInstruction(
     }
   }
 
+  // The rematerialization may itself become a candidate later on.
+  if (cost_analysis_ != nullptr) {
+    TF_RETURN_IF_ERROR(
+        cost_analysis_->RevisitInstruction(remat_item->instruction));
+  }
+
   VLOG(3) << "  memory usage = " << memory_usage_;
   XLA_VLOG_LINES(10, ToString());
 
@@ -1405,7 +1587,7 @@ MemoryUsageTracker::PickRematerializationCandidates(
     absl::flat_hash_map<const HloInstruction*, bool>* rematerializable_map,
     int min_block_size, int max_block_size, int64_t peak_memory_bytes) {
   std::vector<Item*> best_items;
-  int64_t best_cost = 0;
+  double best_cost = 0;
   RematStrategy best_strategy;
 
   int effort = 0;
@@ -1423,9 +1605,15 @@ MemoryUsageTracker::PickRematerializationCandidates(
       break;
     }
     // If any item in the starting block are denylisted or non-rematable, then
-    // break and move on to next start_item (we can actually move to the last
-    // invalid item in this block, but let's ignore that optimization for now).
-    if (AnyDenylistedOrNonRematerializable(block, rematerializable_map)) {
+    // it can be neither recomputed nor compressed (we can actually move to the
+    // last invalid item in this block, but let's ignore that optimization for
+    // now). Offloading leaves the instruction itself alone, so a single item
+    // which is not denylisted may still be offloaded.
+    const bool can_recompute_or_compress =
+        !AnyDenylistedOrNonRematerializable(block, rematerializable_map);
+    if (!can_recompute_or_compress &&
+        (!host_memory_offload_config_.has_value() || block.size() != 1 ||
+         block[0]->denylisted)) {
       continue;
     }
     while (block.size() <= max_block_size) {
@@ -1434,7 +1622,7 @@ MemoryUsageTracker::PickRematerializationCandidates(
       if (block.size() == 1) {
         auto* item = block[0];
         auto* candidate = item->instruction;
-        if (item->buffers_output.size() == 1 &&
+        if (can_recompute_or_compress && item->buffers_output.size() == 1 &&
             (mode_ ==
                  HloRematerialization::RematerializationMode::kCompressOnly ||
              mode_ == HloRematerialization::RematerializationMode::
@@ -1458,7 +1646,11 @@ MemoryUsageTracker::PickRematerializationCandidates(
               effort++;
               if (memory_reduced > 0 &&
                   size + reduced_size < peak_memory_bytes) {
-                const int64_t cost = memory_limit_bytes / memory_reduced;
+                // The compression and the uncompression each read one of the
+                // two buffers and write the other.
+                const double cost =
+                    StrategyCost(CopySeconds(2 * (size + reduced_size)),
+                                 memory_reduced, memory_limit_bytes);
                 if (best_items.empty() || cost < best_cost) {
                   VLOG(3) << "candidate " << candidate->name() << "("
                           << candidate->ToShortString() << ")"
@@ -1475,9 +1667,30 @@ MemoryUsageTracker::PickRematerializationCandidates(
             }
           }
         }
+        if (host_memory_offload_config_.has_value() &&
+            item->instruction->shape().IsArray() &&
+            LayoutUtil::HasLayout(item->instruction->shape())) {
+          const int64_t memory_reduced = MemoryReducedIfOffloaded(item);
+          effort++;
+          if (memory_reduced > 0) {
+            const double cost =
+                StrategyCost(OffloadSeconds(memory_reduced), memory_reduced,
+                             memory_limit_bytes);
+            if (best_items.empty() || cost < best_cost) {
+              VLOG(3) << "candidate " << candidate->name() << "("
+                      << candidate->ToShortString() << ")"
+                      << " now best when offloaded to host memory";
+              best_strategy.kind = RematStrategy::kHostOffload;
+              best_items = block;
+              best_cost = cost;
+            }
+          }
+        }
       }
-      // Do not consider recomputation in compress-only mode.
-      if (mode_ == HloRematerialization::RematerializationMode::kCompressOnly) {
+      // Do not consider recomputation in compress-only mode, or of a block
+      // which cannot be rematerialized.
+      if (!can_recompute_or_compress ||
+          mode_ == HloRematerialization::RematerializationMode::kCompressOnly) {
         // break out of this loop. Move on to the next start_item.
         break;
       }
@@ -1506,7 +1719,7 @@ MemoryUsageTracker::PickRematerializationCandidates(
       const int64_t memory_reduced = MemoryReducedIfRematerialized(block);
       effort++;
       if (memory_reduced > 0) {
-        const int cost =
+        const double cost =
             RematerializationCost(block, memory_reduced, memory_limit_bytes);
 
         VLOG(5) << "Candidate block of size " << block.size()
@@ -1792,6 +2005,112 @@ StatusOr<int64_t> CompressInstruction(MemoryUsageTracker* memory_tracker,
   return 2;
 }
 
+StatusOr<int64_t> OffloadInstruction(MemoryUsageTracker* memory_tracker,
+                                     Item* best_item,
+                                     InstructionList* instruction_list) {
+  HloInstruction* best = best_item->instruction;
+  VLOG(5) << "Offloading instruction " << best->name() << " (saving "
+          << HumanReadableNumBytes(
+                 memory_tracker->MemoryReducedIfOffloaded(best_item))
+          << ") to host memory";
+
+  HloComputation* computation = best->parent();
+  const Shape& device_shape = best->shape();
+  Shape host_shape = device_shape;
+  host_shape.mutable_layout()->set_memory_space(
+      memory_tracker->host_memory_offload_config()->host_memory_space);
+  const Shape context_shape = ShapeUtil::MakeShape(U32, {});
+
+  HloInstruction* copy_start_to_host = computation->AddInstruction(
+      HloInstruction::CreateCopyStart(
+          ShapeUtil::MakeTupleShape({host_shape, device_shape, context_shape}),
+          best),
+      /*new_name=*/best->name() + ".remat_copy_start_to_host");
+  HloInstruction* copy_done_to_host = computation->AddInstruction(
+      HloInstruction::CreateUnary(host_shape, HloOpcode::kCopyDone,
+                                  copy_start_to_host),
+      /*new_name=*/best->name() + ".remat_copy_done_to_host");
+  HloInstruction* copy_start_to_device = computation->AddInstruction(
+      HloInstruction::CreateCopyStart(
+          ShapeUtil::MakeTupleShape({device_shape, host_shape, context_shape}),
+          copy_done_to_host),
+      /*new_name=*/best->name() + ".remat_copy_start_to_device");
+  HloInstruction* copy_done_to_device = computation->AddInstruction(
+      HloInstruction::CreateUnary(device_shape, HloOpcode::kCopyDone,
+                                  copy_start_to_device),
+      /*new_name=*/best->name() + ".remat_copy_done_to_device");
+
+  Item* copy_start_to_host_item =
+      instruction_list->CreateItem(copy_start_to_host);
+  copy_start_to_host_item->placed = true;
+  Item* copy_done_to_host_item =
+      instruction_list->CreateItem(copy_done_to_host);
+  copy_done_to_host_item->placed = true;
+  Item* copy_start_to_device_item =
+      instruction_list->CreateItem(copy_start_to_device);
+  Item* copy_done_to_device_item =
+      instruction_list->CreateItem(copy_done_to_device);
+
+  // Replace each remaining use of 'best' with the prefetched buffer.
+  std::vector<HloInstruction*> best_users_copy = best->users();
+  for (HloInstruction* user : best_users_copy) {
+    if (!memory_tracker->IsPlaced(user)) {
+      VLOG(5) << "  Replacing use of " << best->name() << " in " << user->name()
+              << " with " << copy_done_to_device->name();
+      TF_RETURN_IF_ERROR(best->ReplaceUseWith(user, copy_done_to_device));
+    }
+  }
+
+  // Account for the offload in the memory tracker.
+  TF_RETURN_IF_ERROR(memory_tracker->AddOffloadInstructions(
+      best_item, copy_start_to_host_item, copy_done_to_host_item,
+      copy_start_to_device_item, copy_done_to_device_item));
+
+  // Finish the prefetch right before the earliest unplaced use of the
+  // instruction.
+  ItemList place_before;
+  for (auto user : copy_done_to_device->users()) {
+    place_before.push_back(instruction_list->GetItem(user));
+  }
+
+  instruction_list->Denylist(copy_start_to_host);
+  instruction_list->Denylist(copy_done_to_host);
+  instruction_list->Denylist(copy_start_to_device);
+  instruction_list->Denylist(copy_done_to_device);
+
+  instruction_list->InsertBeforeInstructions(copy_done_to_device_item,
+                                             place_before);
+
+  // Start the prefetch early enough for the instructions in between to hide
+  // the estimated transfer time, but no earlier than the current program point
+  // and at most kMaxPrefetchDistance instructions before the copy-done. Without
+  // a cost analysis nothing is known to hide the transfer, so the prefetch is
+  // started as early as this bound allows.
+  const double prefetch_seconds = memory_tracker->PrefetchSeconds(
+      memory_tracker->AllocatedSize(copy_start_to_device_item));
+  double hidden_seconds = 0;
+  Item* prefetch_before = copy_done_to_device_item;
+  for (int64_t distance = 0; distance < kMaxPrefetchDistance &&
+                             hidden_seconds < prefetch_seconds;
+       ++distance) {
+    Item* prev = instruction_list->prev(prefetch_before);
+    if (prev == nullptr || prev->placed) {
+      break;
+    }
+    hidden_seconds += memory_tracker->InstructionSeconds(prev->instruction);
+    prefetch_before = prev;
+  }
+  instruction_list->InsertBeforeInstructions(copy_start_to_device_item,
+                                             {prefetch_before});
+
+  instruction_list->InsertAfterInstructions(copy_done_to_host_item,
+                                            {best_item});
+  instruction_list->InsertAfterInstructions(copy_start_to_host_item,
+                                            {best_item});
+
+  return 4;
+}
+
 // A simple struct to encapsulate the number of instructions added during
 // rematerialization.
 struct InstructionsAdded {
@@ -1845,6 +2164,18 @@ StatusOr<InstructionsAdded> RematerializeBestBlock(
         num_instructions_added.net_instructions_added,
         CompressInstruction(memory_tracker, best_items[0],
                             best_strategy.compact_shape, instruction_list));
+  } else if (best_strategy.kind == RematStrategy::kHostOffload) {
+    CHECK(best_items.size() == 1)
+        << "More than one instruction offloaded simultaneously.";
+    VLOG(1) << "Offloading instruction " << best_items[0]->instruction->name()
+            << " (saving "
+            << HumanReadableNumBytes(
+                   memory_tracker->MemoryReducedIfOffloaded(best_items[0]))
+            << ") to host memory";
+
+    TF_ASSIGN_OR_RETURN(
+        num_instructions_added.net_instructions_added,
+        OffloadInstruction(memory_tracker, best_items[0], instruction_list));
   } else {
     TF_ASSIGN_OR_RETURN(
         num_instructions_added.net_instructions_added,
@@ -1917,9 +2248,15 @@ StatusOr<bool> HloRematerialization::RematerializeComputation(
   CHECK(!ContainsKey(rematerialized_computations_, computation));
 
   InstructionList instruction_list(schedule->sequence(computation));
+  std::unique_ptr<HloCostAnalysis> cost_analysis;
+  if (cost_analysis_options_.has_value()) {
+    cost_analysis = std::make_unique<HloCostAnalysis>(*cost_analysis_options_);
+    TF_RETURN_IF_ERROR(computation->Accept(cost_analysis.get()));
+  }
   MemoryUsageTracker memory_tracker(
       computation, size_function_, compact_shape_function_, *dataflow_analysis_,
-      instruction_list, mode_);
+      instruction_list, mode_, cost_analysis.get(),
+      host_memory_offload_config_);
 
   instruction_list.PromoteNodesToSkip([&](Item* item) {
     return memory_tracker.AllocatedSize(item) >= min_remat_size;
@@ -15,6 +15,8 @@
 #ifndef TENSORFLOW_COMPILER_XLA_SERVICE_HLO_REMATERIALIZATION_H_
 #define TENSORFLOW_COMPILER_XLA_SERVICE_HLO_REMATERIALIZATION_H_
 
+#include <optional>
+
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/string_view.h"
@@ -23,6 +25,7 @@
 #include "xla/hlo/ir/hlo_module.h"
 #include "xla/hlo/ir/hlo_schedule.h"
 #include "xla/service/call_graph.h"
+#include "xla/service/hlo_cost_analysis.h"
 #include "xla/service/hlo_memory_scheduler.h"
 #include "xla/shape.h"
 #include "xla/statusor.h"
@@ -63,6 +66,17 @@ class HloRematerialization : public HloModulePass {
     kPostFusion  // Rematerialization pass after multi-output fusion.
   };
 
+  // Configuration for offloading live buffers to host memory and prefetching
+  // them back before their next use, which is considered alongside the other
+  // strategies when provided.
+  struct HostMemoryOffloadConfig {
+    // The memory space of host memory in the layouts of offloaded buffers.
+    int64_t host_memory_space;
+    // Bandwidth of the copies to and from host memory.
+    float bandwidth_to_host_bytes_per_second;
+    float bandwidth_from_host_bytes_per_second;
+  };
+
   static Shape DefaultCompactShapeFunction(const Shape& shape) { return shape; }
 
   // Constructor parameters:
@@ -80,13 +94,30 @@ class HloRematerialization : public HloModulePass {
   //
   //   compact_shape_function: Function which returns the compact form of a
   //   shape. If nullptr is provided, an default identity function is used.
+  //
+  //   cost_analysis_options: If provided, candidates are ranked by the time an
+  //     HloCostAnalysis with these options estimates they add per byte of
+  //     memory saved, rather than by the memory saved alone. The options
+  //     should set the FLOP and memory bandwidth rates.
+  //
+  //   host_memory_offload_config: If provided, a live buffer may also be
+  //     offloaded to host memory with copy-start/copy-done pairs and
+  //     prefetched back before its next use.
+  //
+  // No compiler in this tree runs HloRematerialization, so the cost-based
+  // ranking and host offloading are only available to callers which pass
+  // cost_analysis_options or host_memory_offload_config themselves.
   explicit HloRematerialization(
       const ShapeSizeFunction& size_function, int64_t memory_limit_bytes,
       RematerializationSizes* sizes, RematerializationPass pass_location,
       int block_size_limit, int block_rematerialization_factor,
       CompactShapeFunction compact_shape_function = nullptr,
       RematerializationMode mode = RematerializationMode::kRecomputeAndCompress,
-      int64_t min_remat_size = 0)
+      int64_t min_remat_size = 0,
+      std::optional<HloCostAnalysis::Options> cost_analysis_options =
+          std::nullopt,
+      std::optional<HostMemoryOffloadConfig> host_memory_offload_config =
+          std::nullopt)
       : size_function_(size_function),
         memory_limit_bytes_(memory_limit_bytes),
         sizes_(sizes),
@@ -97,7 +128,9 @@ class HloRematerialization : public HloModulePass {
                                     ? DefaultCompactShapeFunction
                                     : std::move(compact_shape_function)),
         mode_(mode),
-        min_remat_size_(min_remat_size) {}
+        min_remat_size_(min_remat_size),
+        cost_analysis_options_(std::move(cost_analysis_options)),
+        host_memory_offload_config_(std::move(host_memory_offload_config)) {}
   ~HloRematerialization() override = default;
 
   absl::string_view name() const override { return "rematerialization"; }
@@ -224,6 +257,11 @@ class HloRematerialization : public HloModulePass {
 
   int64_t min_remat_size_;
 
+  // Options of the HloCostAnalysis used to rank candidates, if any.
+  std::optional<HloCostAnalysis::Options> cost_analysis_options_;
+
+  std::optional<HostMemoryOffloadConfig> host_memory_offload_config_;
+
   // Tracking available channel id numbers to use to apply to rematerialized
   // channel instructions
   int64_t next_channel_id_;
@@ -15,12 +15,15 @@ limitations under the License.
 
 #include "xla/service/hlo_rematerialization.h"
 
+#include <algorithm>
 #include <memory>
+#include <optional>
 #include <string>
 
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/service/hlo_cost_analysis.h"
 #include "xla/service/hlo_matchers.h"
 #include "xla/service/hlo_ordering.h"
 #include "xla/service/hlo_rematerialization_test_utils.h"
@@ -700,6 +703,257 @@ ENTRY %entry {
               op::Reduce(op::Copy(op::Copy(broadcast)), op::Constant()));
 }
 
+class HostOffloadRematerializationTest : public RematerializationTestBase {
+ protected:
+  static constexpr int64_t kHostMemorySpace = 5;
+
+  StatusOr<bool> RunHloRematerialization(int64_t memory_limit_bytes,
+                                         HloModule* module) {
+    TF_EXPECT_OK(verifier().Run(module).status());
+    HloRematerialization::HostMemoryOffloadConfig config;
+    config.host_memory_space = kHostMemorySpace;
+    config.bandwidth_to_host_bytes_per_second = 1e9;
+    config.bandwidth_from_host_bytes_per_second = 1e9;
+    HloRematerialization remat(
+        ByteSizeOf, memory_limit_bytes,
+        /*sizes=*/nullptr,
+        HloRematerialization::RematerializationPass::kPreFusion,
+        /*block_size_limit=*/1, /*block_rematerialization_factor=*/1,
+        /*compact_shape_function=*/nullptr,
+        HloRematerialization::RematerializationMode::kCompressOnly,
+        /*min_remat_size=*/0, /*cost_analysis_options=*/std::nullopt,
+        config);
+    return remat.Run(module);
+  }
+};
+
+// Test that a buffer which is live across other large buffers is offloaded to
+// host memory and prefetched back before its last use.
+TEST_F(HostOffloadRematerializationTest, SingleOffload) {
+  const std::string& hlo_string = R"(
+HloModule fusion, is_scheduled=true
+
+%add_float {
+  %x = f32[] parameter(0)
+  %y = f32[] parameter(1)
+  ROOT %add = f32[] add(f32[] %x, f32[] %y)
+}
+
+ENTRY %entry {
+  %param.0 = f32[] parameter(0)
+  %constant = f32[] constant(0)
+  %broadcast.0 = f32[64,64]{1,0} broadcast(f32[] %param.0), dimensions={}
+  %negate = f32[64,64]{1,0} negate(f32[64,64]{1,0} broadcast.0)
+  %exp = f32[64,64]{1,0} exponential(f32[64,64]{1,0} negate)
+  %reduce.0 = f32[] reduce(f32[64,64]{1,0} %exp, f32[] %constant), dimensions={1, 0}, to_apply=%add_float
+  %reduce.1 = f32[] reduce(f32[64,64]{1,0} %broadcast.0, f32[] %constant), dimensions={1, 0}, to_apply=%add_float
+  ROOT %add = f32[] add(f32[] %reduce.0, f32[] %reduce.1)
+}
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+
+  // Without offloading, broadcast.0, negate and exp are all live at once
+  // (48KiB); offloading broadcast.0 brings the peak down to 32KiB.
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          RunHloRematerialization(
+                              /*memory_limit_bytes=*/40 * 1024, module.get()));
+  EXPECT_TRUE(changed);
+  HloInstruction* broadcast =
+      module->entry_computation()->GetInstructionWithName("broadcast.0");
+  HloInstruction* reduce =
+      module->entry_computation()->GetInstructionWithName("reduce.1");
+  EXPECT_THAT(reduce, op::Reduce(op::CopyDone(op::CopyStart(op::CopyDone(
+                                     op::CopyStart(broadcast)))),
+                                 op::Constant()));
+  const HloInstruction* to_host = reduce->operand(0)->operand(0)->operand(0);
+  EXPECT_EQ(to_host->shape().layout().memory_space(), kHostMemorySpace);
+  EXPECT_EQ(reduce->operand(0)->shape().layout().memory_space(), 0);
+
+  // The copy to host memory directly follows the offloaded instruction. The
+  // prefetch back to device memory starts right after the program point where
+  // memory was exceeded, so that reduce.0 overlaps the transfer, and finishes
+  // right before the use.
+  const HloComputation* computation = module->entry_computation();
+  const auto& sequence =
+      module->schedule().sequence(computation).instructions();
+  auto position = [&](const HloInstruction* instruction) {
+    return std::find(sequence.begin(), sequence.end(), instruction) -
+           sequence.begin();
+  };
+  const HloInstruction* prefetch_start = reduce->operand(0)->operand(0);
+  EXPECT_EQ(position(reduce->operand(0)) + 1, position(reduce));
+  EXPECT_EQ(position(computation->GetInstructionWithName("exp")) + 1,
+            position(prefetch_start));
+  EXPECT_LT(position(prefetch_start),
+            position(computation->GetInstructionWithName("reduce.0")));
+  EXPECT_LT(position(to_host),
+            position(computation->GetInstructionWithName("exp")));
+}
+
+// Test that an instruction which cannot be rematerialized, such as a custom
+// call, can still be offloaded to host memory.
+TEST_F(HostOffloadRematerializationTest, OffloadsNonRematerializable) {
+  const std::string& hlo_string = R"(
+HloModule fusion, is_scheduled=true
+
+%add_float {
+  %x = f32[] parameter(0)
+  %y = f32[] parameter(1)
+  ROOT %add = f32[] add(f32[] %x, f32[] %y)
+}
+
+ENTRY %entry {
+  %param.0 = f32[] parameter(0)
+  %constant = f32[] constant(0)
+  %custom-call = f32[64,64]{1,0} custom-call(f32[] %param.0), custom_call_target="foo"
+  %negate = f32[64,64]{1,0} negate(f32[64,64]{1,0} custom-call)
+  %exp = f32[64,64]{1,0} exponential(f32[64,64]{1,0} negate)
+  %reduce.0 = f32[] reduce(f32[64,64]{1,0} %exp, f32[] %constant), dimensions={1, 0}, to_apply=%add_float
+  %reduce.1 = f32[] reduce(f32[64,64]{1,0} %custom-call, f32[] %constant), dimensions={1, 0}, to_apply=%add_float
+  ROOT %add = f32[] add(f32[] %reduce.0, f32[] %reduce.1)
+}
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+
+  TF_ASSERT_OK_AND_ASSIGN(bool changed,
+                          RunHloRematerialization(
+                              /*memory_limit_bytes=*/40 * 1024, module.get()));
+  EXPECT_TRUE(changed);
+  HloInstruction* custom_call =
+      module->entry_computation()->GetInstructionWithName("custom-call");
+  HloInstruction* reduce =
+      module->entry_computation()->GetInstructionWithName("reduce.1");
+  EXPECT_THAT(reduce, op::Reduce(op::CopyDone(op::CopyStart(op::CopyDone(
+                                     op::CopyStart(custom_call)))),
+                                 op::Constant()));
+}
+
+class CostAnalysisRematerializationTest : public RematerializationTestBase {
+ protected:
+  StatusOr<bool> RunHloRematerialization(
+      int64_t memory_limit_bytes, HloModule* module, bool use_cost_analysis,
+      std::optional<HloRematerialization::HostMemoryOffloadConfig>
+          host_memory_offload_config = std::nullopt) {
+    TF_EXPECT_OK(verifier().Run(module).status());
+    std::optional<HloCostAnalysis::Options> cost_analysis_options;
+    if (use_cost_analysis) {
+      cost_analysis_options.emplace();
+      cost_analysis_options->shape_size = ByteSizeOf;
+      cost_analysis_options->set_flops_per_second(1e9);
+      cost_analysis_options->set_transcendentals_per_second(1e9);
+      cost_analysis_options->set_bytes_per_second(1e9);
+    }
+    HloRematerialization remat(
+        ByteSizeOf, memory_limit_bytes,
+        /*sizes=*/nullptr,
+        HloRematerialization::RematerializationPass::kPreFusion,
+        /*block_size_limit=*/1, /*block_rematerialization_factor=*/1,
+        /*compact_shape_function=*/nullptr,
+        HloRematerialization::RematerializationMode::kRecomputeAndCompress,
+        /*min_remat_size=*/1024, cost_analysis_options,
+        host_memory_offload_config);
+    return remat.Run(module);
+  }
+
+  // At the program point of 'negate', the dot (16KiB, expensive) and the
+  // broadcast (8KiB, cheap) are both live and used again later. Rematerializing
+  // either of them brings the peak (40KiB) below 36KiB.
+  static constexpr char kHloString[] = R"(
+HloModule fusion, is_scheduled=true
+
+%add_float {
+  %x = f32[] parameter(0)
+  %y = f32[] parameter(1)
+  ROOT %add = f32[] add(f32[] %x, f32[] %y)
+}
+
+ENTRY %entry {
+  %param.0 = f32[64,64]{1,0} parameter(0)
+  %param.1 = f32[] parameter(1)
+  %dot = f32[64,64]{1,0} dot(f32[64,64]{1,0} %param.0, f32[64,64]{1,0} %param.0), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  %reduce.dot.0 = f32[] reduce(f32[64,64]{1,0} %dot, f32[] %param.1), dimensions={1, 0}, to_apply=%add_float
+  %broadcast = f32[64,32]{1,0} broadcast(f32[] %param.1), dimensions={}
+  %reduce.broadcast.0 = f32[] reduce(f32[64,32]{1,0} %broadcast, f32[] %param.1), dimensions={1, 0}, to_apply=%add_float
+  %negate = f32[64,64]{1,0} negate(f32[64,64]{1,0} %param.0)
+  %reduce.negate = f32[] reduce(f32[64,64]{1,0} %negate, f32[] %param.1), dimensions={1, 0}, to_apply=%add_float
+  %reduce.dot.1 = f32[] reduce(f32[64,64]{1,0} %dot, f32[] %param.1), dimensions={1, 0}, to_apply=%add_float
+  %reduce.broadcast.1 = f32[] reduce(f32[64,32]{1,0} %broadcast, f32[] %param.1), dimensions={1, 0}, to_apply=%add_float
+  %add.0 = f32[] add(f32[] %reduce.dot.0, f32[] %reduce.broadcast.0)
+  %add.1 = f32[] add(f32[] %add.0, f32[] %reduce.negate)
+  %add.2 = f32[] add(f32[] %add.1, f32[] %reduce.dot.1)
+  ROOT %add.3 = f32[] add(f32[] %add.2, f32[] %reduce.broadcast.1)
+}
+)";
+};
+
+// Without a cost analysis the candidate which saves the most memory (the dot)
+// is rematerialized; with one, the candidate which is cheapest per byte saved
+// (the broadcast) is.
+TEST_F(CostAnalysisRematerializationTest, CostAnalysisChangesCandidate) {
+  for (bool use_cost_analysis : {false, true}) {
+    SCOPED_TRACE(use_cost_analysis);
+    TF_ASSERT_OK_AND_ASSIGN(auto module,
+                            ParseAndReturnVerifiedModule(kHloString));
+    TF_ASSERT_OK_AND_ASSIGN(
+        bool changed,
+        RunHloRematerialization(/*memory_limit_bytes=*/36 * 1024, module.get(),
+                                use_cost_analysis));
+    EXPECT_TRUE(changed);
+
+    HloComputation* computation = module->entry_computation();
+    HloInstruction* dot = computation->GetInstructionWithName("dot");
+    HloInstruction* broadcast =
+        computation->GetInstructionWithName("broadcast");
+    HloInstruction* reduce_dot =
+        computation->GetInstructionWithName("reduce.dot.1");
+    HloInstruction* reduce_broadcast =
+        computation->GetInstructionWithName("reduce.broadcast.1");
+    if (use_cost_analysis) {
+      EXPECT_EQ(reduce_dot->operand(0), dot);
+      EXPECT_THAT(reduce_broadcast->operand(0),
+                  op::Broadcast(op::Parameter(1)));
+      EXPECT_NE(reduce_broadcast->operand(0), broadcast);
+    } else {
+      EXPECT_THAT(reduce_dot->operand(0),
+                  op::Dot(op::Parameter(0), op::Parameter(0)));
+      EXPECT_NE(reduce_dot->operand(0), dot);
+      EXPECT_EQ(reduce_broadcast->operand(0), broadcast);
+    }
+  }
+}
+
+// With slow transfers to and from host memory, recomputing the broadcast is
+// cheaper than offloading any of the live buffers.
+TEST_F(CostAnalysisRematerializationTest, RecomputeCheaperThanOffload) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kHloString));
+  HloRematerialization::HostMemoryOffloadConfig config;
+  config.host_memory_space = 5;
+  config.bandwidth_to_host_bytes_per_second = 1e8;
+  config.bandwidth_from_host_bytes_per_second = 1e8;
+  TF_ASSERT_OK_AND_ASSIGN(
+      bool changed,
+      RunHloRematerialization(/*memory_limit_bytes=*/36 * 1024, module.get(),
+                              /*use_cost_analysis=*/true, config));
+  EXPECT_TRUE(changed);
+
+  HloComputation* computation = module->entry_computation();
+  for (const HloInstruction* instruction : computation->instructions()) {
+    EXPECT_NE(instruction->opcode(), HloOpcode::kCopyStart);
+  }
+  HloInstruction* reduce_broadcast =
+      computation->GetInstructionWithName("reduce.broadcast.1");
+  EXPECT_THAT(reduce_broadcast->operand(0), op::Broadcast(op::Parameter(1)));
+  EXPECT_NE(reduce_broadcast->operand(0),
+            computation->GetInstructionWithName("broadcast"));
+  EXPECT_EQ(computation->GetInstructionWithName("reduce.dot.1")->operand(0),
+            computation->GetInstructionWithName("dot"));
+}
+
 // Test a pathological case where the peak memory is largely due to a single
 // tensor (broadcast.0) and compressing it would actually increase the peak
 // memory.
@@ -0,0 +1,125 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/hlo_structural_hasher.h"
+
+#include <cstdint>
+#include <utility>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/inlined_vector.h"
+#include "absl/hash/hash.h"
+#include "absl/types/span.h"
+#include "xla/hlo/ir/hlo_opcode.h"
+#include "xla/literal.h"
+#include "xla/shape.h"
+
+namespace xla {
+
+namespace {
+
+// Only attributes which HloInstruction::Identical compares may be hashed.
+struct InstructionKey {
+  template <typename H>
+  friend H AbslHashValue(H h, const InstructionKey& key) {
+    const HloInstruction* instruction = key.hlo;
+    h = H::combine(std::move(h), instruction->opcode(), key.operand_hashes,
+                   key.called_computations_hash);
+    h = Shape::Hash<H, /*kIsLayoutSensitive=*/false>(std::move(h),
+                                                      instruction->shape());
+    switch (instruction->opcode()) {
+      case HloOpcode::kParameter:
+        return H::combine(std::move(h), instruction->parameter_number());
+      case HloOpcode::kConstant:
+        return Literal::Hash<H, /*kIsLayoutSensitive=*/false,
+                             /*kByteLimit=*/64>(std::move(h),
+                                                instruction->literal());
+      case HloOpcode::kGetTupleElement:
+        return H::combine(std::move(h), instruction->tuple_index());
+      case HloOpcode::kSlice:
+        return H::combine(std::move(h), instruction->slice_starts(),
+                          instruction->slice_limits(),
+                          instruction->slice_strides());
+      case HloOpcode::kConcatenate:
+      case HloOpcode::kBroadcast:
+      case HloOpcode::kTranspose:
+      case HloOpcode::kReduce:
+        return H::combine(std::move(h), instruction->dimensions());
+      default:
+        return std::move(h);
+    }
+  }
+
+  const HloInstruction* hlo;
+  absl::Span<const uint64_t> operand_hashes;
+  uint64_t called_computations_hash;
+};
+
+}  // namespace
+
+uint64_t HloStructuralHasher::ComputationHash(
+    const HloComputation* computation) {
+  {
+    absl::MutexLock lock(&mu_);
+    auto it = computation_hashes_.find(computation);
+    if (it != computation_hashes_.end()) {
+      return it->second;
+    }
+  }
+
+  absl::flat_hash_map<const HloInstruction*, uint64_t> instruction_hashes;
+  instruction_hashes.reserve(computation->instruction_count());
+  for (const HloInstruction* instruction :
+       computation->MakeInstructionPostOrder()) {
+    absl::InlinedVector<uint64_t, 2> operand_hashes;
+    operand_hashes.reserve(instruction->operand_count());
+    for (const HloInstruction* operand : instruction->operands()) {
+      operand_hashes.push_back(instruction_hashes.at(operand));
+    }
+    // Keep the hash independent of the order of commutative operands, which
+    // some comparisons ignore.
+    if (HloOpcodeIsBinaryCommutative(instruction->opcode())) {
+      absl::c_sort(operand_hashes);
+    }
+    instruction_hashes[instruction] = absl::HashOf(InstructionKey{
+        instruction, operand_hashes, CalledComputationsHash(instruction)});
+  }
+  const uint64_t hash =
+      absl::HashOf(instruction_hashes.at(computation->root_instruction()),
+                   computation->num_parameters());
+
+  absl::MutexLock lock(&mu_);
+  computation_hashes_.emplace(computation, hash);
+  return hash;
+}
+
+uint64_t HloStructuralHasher::CalledComputationsHash(
+    const HloInstruction* instruction) {
+  if (instruction->called_computations().empty()) {
+    return 0;
+  }
+  absl::InlinedVector<uint64_t, 2> hashes;
+  for (const HloComputation* callee : instruction->called_computations()) {
+    hashes.push_back(ComputationHash(callee));
+  }
+  return absl::HashOf(absl::MakeConstSpan(hashes));
+}
+
+void HloStructuralHasher::Clear() {
+  absl::MutexLock lock(&mu_);
+  computation_hashes_.clear();
+}
+
+}  // namespace xla
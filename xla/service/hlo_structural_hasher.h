@@ -0,0 +1,63 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_HLO_STRUCTURAL_HASHER_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_HLO_STRUCTURAL_HASHER_H_
+
+#include <cstdint>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_instruction.h"
+
+namespace xla {
+
+// Computes structural hashes of computations bottom-up: an instruction's hash
+// combines its opcode, its shape without layout, a few opcode-specific
+// attributes, the hashes of its operands and those of the computations it
+// calls. Names and unique ids do not contribute.
+//
+// Computations which are equal according to HloComputation::Equal, with or
+// without layouts, have equal hashes, so the hash can be used to bucket
+// candidates before comparing them. Different computations may have equal
+// hashes.
+//
+// The hash of every computation is computed once and cached; callers must
+// Clear() the cache once computations which have been hashed are modified.
+// ComputationHash may be called concurrently.
+class HloStructuralHasher {
+ public:
+  HloStructuralHasher() = default;
+
+  // Returns the structural hash of `computation`, hashing the computations it
+  // calls first if needed.
+  uint64_t ComputationHash(const HloComputation* computation);
+
+  // Returns a hash of the computations called by `instruction`, or zero if it
+  // does not call any.
+  uint64_t CalledComputationsHash(const HloInstruction* instruction);
+
+  void Clear();
+
+ private:
+  absl::Mutex mu_;
+  absl::flat_hash_map<const HloComputation*, uint64_t> computation_hashes_
+      ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_HLO_STRUCTURAL_HASHER_H_
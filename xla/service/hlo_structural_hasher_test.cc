@@ -0,0 +1,129 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "xla/service/hlo_structural_hasher.h"
+
+#include <cstdint>
+
+#include "xla/hlo/ir/hlo_computation.h"
+#include "xla/hlo/ir/hlo_module.h"
+#include "xla/tests/hlo_test_base.h"
+#include "tsl/platform/statusor.h"
+#include "tsl/platform/test.h"
+
+namespace xla {
+namespace {
+
+using HloStructuralHasherTest = HloTestBase;
+
+constexpr char kModuleStr[] = R"(
+HloModule m
+
+add_a {
+  x = f32[] parameter(0)
+  y = f32[] parameter(1)
+  ROOT add = f32[] add(x, y)
+}
+
+add_b {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT sum = f32[] add(rhs, lhs)
+}
+
+mul {
+  x = f32[] parameter(0)
+  y = f32[] parameter(1)
+  ROOT mul = f32[] multiply(x, y)
+}
+
+reduce_a {
+  p = f32[8] parameter(0)
+  zero = f32[] constant(0)
+  ROOT r = f32[] reduce(p, zero), dimensions={0}, to_apply=add_a
+}
+
+reduce_b {
+  param = f32[8]{0} parameter(0)
+  c = f32[] constant(0)
+  ROOT reduce = f32[] reduce(param, c), dimensions={0}, to_apply=add_b
+}
+
+reduce_mul {
+  p = f32[8] parameter(0)
+  zero = f32[] constant(0)
+  ROOT r = f32[] reduce(p, zero), dimensions={0}, to_apply=mul
+}
+
+reduce_one {
+  p = f32[8] parameter(0)
+  one = f32[] constant(1)
+  ROOT r = f32[] reduce(p, one), dimensions={0}, to_apply=add_a
+}
+
+ENTRY e {
+  p = f32[8] parameter(0)
+  a = f32[] call(p), to_apply=reduce_a
+  b = f32[] call(p), to_apply=reduce_b
+  c = f32[] call(p), to_apply=reduce_mul
+  d = f32[] call(p), to_apply=reduce_one
+  ROOT t = (f32[], f32[], f32[], f32[]) tuple(a, b, c, d)
+}
+)";
+
+TEST_F(HloStructuralHasherTest, IdenticalComputationsHashEqual) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnUnverifiedModule(kModuleStr));
+  HloStructuralHasher hasher;
+  // Names and the order of commutative operands do not matter.
+  EXPECT_EQ(hasher.ComputationHash(module->GetComputationWithName("add_a")),
+            hasher.ComputationHash(module->GetComputationWithName("add_b")));
+  EXPECT_EQ(
+      hasher.ComputationHash(module->GetComputationWithName("reduce_a")),
+      hasher.ComputationHash(module->GetComputationWithName("reduce_b")));
+}
+
+TEST_F(HloStructuralHasherTest, DifferentComputationsHashDifferently) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnUnverifiedModule(kModuleStr));
+  HloStructuralHasher hasher;
+  const uint64_t reduce_hash =
+      hasher.ComputationHash(module->GetComputationWithName("reduce_a"));
+  // A different reducer.
+  EXPECT_NE(reduce_hash, hasher.ComputationHash(
+                             module->GetComputationWithName("reduce_mul")));
+  // A different init value.
+  EXPECT_NE(reduce_hash, hasher.ComputationHash(
+                             module->GetComputationWithName("reduce_one")));
+}
+
+TEST_F(HloStructuralHasherTest, CalledComputationsHash) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnUnverifiedModule(kModuleStr));
+  HloStructuralHasher hasher;
+  const HloComputation* entry = module->entry_computation();
+  EXPECT_EQ(hasher.CalledComputationsHash(entry->parameter_instruction(0)), 0);
+  EXPECT_EQ(hasher.CalledComputationsHash(
+                entry->root_instruction()->operand(0)),
+            hasher.CalledComputationsHash(
+                entry->root_instruction()->operand(1)));
+  EXPECT_NE(hasher.CalledComputationsHash(
+                entry->root_instruction()->operand(0)),
+            hasher.CalledComputationsHash(
+                entry->root_instruction()->operand(2)));
+}
+
+}  // namespace
+}  // namespace xla
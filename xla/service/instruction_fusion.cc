@@ -236,7 +236,7 @@ bool InstructionFusion::EffectivelyAtMostUnary(HloInstruction* hlo) {
 bool InstructionFusion::CanFuseOnAllPaths(
     HloInstruction* producer, HloInstruction* consumer,
     const HloInstructionSet& do_not_fuse,
-    const HloReachabilityMap& reachability,
+    const HloDfsReachability& reachability,
     absl::flat_hash_map<std::pair<HloInstruction*, HloInstruction*>, bool>*
         result_cache) {
   if (consumer == producer) {
@@ -279,7 +279,7 @@ bool InstructionFusion::CanFuseOnAllPaths(
 InstructionFusion::HloInstructionSet
 InstructionFusion::ComputeGloballyUnfusible(
     absl::Span<HloInstruction* const> post_order,
-    const HloReachabilityMap& reachability) {
+    const HloDfsReachability& reachability) {
   // Forbid fusion of producers that:
   // a) Need to be duplicated, unless they can be fused into all consumers
   //    via all paths.
@@ -513,8 +513,10 @@ StatusOr<bool> InstructionFusion::Run(
 
   for (auto* computation : GetFusionComputations(module, execution_threads)) {
     CHECK(!computation->IsFusionComputation());
-    std::unique_ptr<HloReachabilityMap> reachability =
-        HloReachabilityMap::Build(computation);
+    // Kept up to date as instructions are fused, so that cycle checks for
+    // multi-output fusion see the current graph.
+    std::unique_ptr<HloDfsReachability> reachability =
+        HloDfsReachability::Build(computation);
 
     HloInstructionSet do_not_duplicate;
     // If we allow duplications, we need to compute which instructions we do not
@@ -648,11 +650,18 @@ StatusOr<bool> InstructionFusion::Run(
         std::string producer_name = operand->name();
         fusion_queue->OnFusingInstruction(fusion_instruction, operand,
                                           instruction);
+        if (fusion_instruction != instruction) {
+          reachability->Replace(instruction, fusion_instruction);
+        } else {
+          reachability->UpdateReachabilityThroughInstruction(
+              fusion_instruction);
+        }
         changed = true;
         ++fuse_count;
 
         if (operand->user_count() == 0) {
           do_not_duplicate.erase(operand);
+          reachability->Remove(operand);
           // Operand is now dead. Remove from queue.
           fusion_queue->RemoveInstruction(operand);
           // Remove from computation.
@@ -781,7 +790,7 @@ HloInstruction* InstructionFusion::FuseIntoMultiOutput(
 
 bool InstructionFusion::MultiOutputFusionCreatesCycle(
     HloInstruction* producer, HloInstruction* consumer,
-    const HloReachabilityMap& reachability) {
+    const HloDfsReachability& reachability) {
   absl::flat_hash_set<int> operands;
   for (const HloInstruction* operand : consumer->operands()) {
     if (operand == producer) {
@@ -266,7 +266,7 @@ class InstructionFusion : public HloModulePass {
   // Whether multi-output fusion would introduce a cycle into the HLO graph.
   bool MultiOutputFusionCreatesCycle(HloInstruction* producer,
                                      HloInstruction* consumer,
-                                     const HloReachabilityMap& reachability);
+                                     const HloDfsReachability& reachability);
 
   FusionConfigCollection config_collection_mode() {
     return config_collection_mode_;
@@ -284,7 +284,7 @@ class InstructionFusion : public HloModulePass {
   // consumers based on a global analysis of the HLO graph.
   virtual HloInstructionSet ComputeGloballyUnfusible(
       absl::Span<HloInstruction* const> post_order,
-      const HloReachabilityMap& reachability);
+      const HloDfsReachability& reachability);
 
  private:
   // Returns the reused operands of `instruction` from reused_fusion_operands_,
@@ -313,7 +313,7 @@ class InstructionFusion : public HloModulePass {
   bool CanFuseOnAllPaths(
       HloInstruction* producer, HloInstruction* consumer,
       const HloInstructionSet& do_not_fuse,
-      const HloReachabilityMap& reachability,
+      const HloDfsReachability& reachability,
       absl::flat_hash_map<std::pair<HloInstruction*, HloInstruction*>, bool>*
           result_cache);
 
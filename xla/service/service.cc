@@ -25,6 +25,7 @@ limitations under the License.
 
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "absl/time/time.h"
 #include "xla/debug_options_flags.h"
 #include "xla/execution_options_util.h"
 #include "xla/hlo/evaluator/hlo_evaluator.h"
@@ -131,6 +132,26 @@ const std::optional<std::set<int>>& ServiceOptions::allowed_devices() const {
   return allowed_devices_;
 }
 
+ServiceOptions& ServiceOptions::set_compilation_cache_max_size_bytes(
+    int64_t max_size_bytes) {
+  compilation_cache_max_size_bytes_ = max_size_bytes;
+  return *this;
+}
+
+int64_t ServiceOptions::compilation_cache_max_size_bytes() const {
+  return compilation_cache_max_size_bytes_;
+}
+
+ServiceOptions& ServiceOptions::set_compilation_cache_max_entries(
+    int64_t max_entries) {
+  compilation_cache_max_entries_ = max_entries;
+  return *this;
+}
+
+int64_t ServiceOptions::compilation_cache_max_entries() const {
+  return compilation_cache_max_entries_;
+}
+
 /* static */ StatusOr<std::unique_ptr<Service>> Service::NewService(
     se::Platform* platform) {
   ServiceOptions default_options;
@@ -158,6 +179,8 @@ const std::optional<std::set<int>>& ServiceOptions::allowed_devices() const {
 Service::Service(const ServiceOptions& options,
                  std::unique_ptr<Backend> execute_backend)
     : options_(options),
+      compilation_cache_(options.compilation_cache_max_size_bytes(),
+                         options.compilation_cache_max_entries()),
       allocation_tracker_(execute_backend.get()),
       execute_backend_(std::move(execute_backend)) {
   CHECK_GT(options_.number_of_replicas(), 0);
@@ -883,6 +906,7 @@ Status Service::Compile(const CompileRequest* arg, CompileResponse* result) {
   VLOG(3) << "Compile created HloModuleConfig computation layout: "
           << module_config->entry_computation_layout().ToString();
 
+  const absl::Time compile_start = absl::Now();
   TF_ASSIGN_OR_RETURN(
       std::unique_ptr<Executable> executable,
       BuildExecutable(arg->computation(), std::move(module_config),
@@ -890,7 +914,8 @@ Status Service::Compile(const CompileRequest* arg, CompileResponse* result) {
                       execute_backend_->default_stream_executor(),
                       {/*device_allocator=*/nullptr}));
 
-  *result->mutable_handle() = compilation_cache_.Insert(std::move(executable));
+  *result->mutable_handle() = compilation_cache_.Insert(
+      std::move(executable), /*compile_time=*/absl::Now() - compile_start);
 
   VLOG(1) << "successfully completed 'compile' request";
   return OkStatus();
@@ -67,11 +67,20 @@ class ServiceOptions {
       const std::optional<std::set<int>>& allowed_devices);
   const std::optional<std::set<int>>& allowed_devices() const;
 
+  // Bounds the compilation cache by the total size of the generated code and
+  // by the number of executables. Zero or less means unbounded.
+  ServiceOptions& set_compilation_cache_max_size_bytes(int64_t max_size_bytes);
+  int64_t compilation_cache_max_size_bytes() const;
+  ServiceOptions& set_compilation_cache_max_entries(int64_t max_entries);
+  int64_t compilation_cache_max_entries() const;
+
  private:
   se::Platform* platform_ = nullptr;
   int number_of_replicas_ = 1;
   int intra_op_parallelism_threads_ = -1;
   std::optional<std::set<int>> allowed_devices_;
+  int64_t compilation_cache_max_size_bytes_ = 0;
+  int64_t compilation_cache_max_entries_ = 0;
 };
 
 // The XLA service object, which is the same across all platforms. It maintains
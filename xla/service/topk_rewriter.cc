@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "xla/service/topk_rewriter.h"
 
+#include <limits>
 #include <optional>
 
 #include "absl/algorithm/container.h"
@@ -93,6 +94,38 @@ static bool IsNanSafeGt(HloComputation* comp) {
                      param_s32);
   };
 
+  auto match_bitcast_f16 = [](int64_t parameter_number) {
+    auto param = m::Parameter(parameter_number)
+                     .WithShape(m::Shape().WithElementType(F16));
+    auto param_s16 =
+        m::BitcastConvert(param).WithShape(m::Shape().WithElementType(S16));
+    auto param_u16 =
+        m::BitcastConvert(param).WithShape(m::Shape().WithElementType(U16));
+    return m::Select(
+        m::Lt(param_s16, m::ConstantScalar(0)),
+        m::BitcastConvert(
+            m::Subtract(m::ConstantScalar(std::numeric_limits<int16_t>::max()),
+                        param_u16))
+            .WithShape(m::Shape().WithElementType(S16)),
+        param_s16);
+  };
+
+  auto match_bitcast_f16_with_convert = [](int64_t parameter_number) {
+    auto param = m::Parameter(parameter_number)
+                     .WithShape(m::Shape().WithElementType(F16));
+    auto param_s16 =
+        m::BitcastConvert(param).WithShape(m::Shape().WithElementType(S16));
+    auto param_u16 =
+        m::BitcastConvert(param).WithShape(m::Shape().WithElementType(U16));
+    auto max_u16 =
+        m::Convert(m::ConstantScalar(std::numeric_limits<int16_t>::max()))
+            .WithShape(m::Shape().WithElementType(U16));
+    return m::Select(m::Lt(param_s16, m::ConstantScalar(0)),
+                     m::BitcastConvert(m::Subtract(max_u16, param_u16))
+                         .WithShape(m::Shape().WithElementType(S16)),
+                     param_s16);
+  };
+
   auto match_s32 = [](int64_t parameter_number) {
     auto param = m::Parameter(parameter_number)
                      .WithShape(m::Shape().WithElementType(S32));
@@ -109,6 +142,11 @@ static bool IsNanSafeGt(HloComputation* comp) {
          Match(comp->root_instruction(),
                m::Gt(match_bitcast_bf16_with_convert(0),
                      match_bitcast_bf16_with_convert(1))) ||
+         Match(comp->root_instruction(),
+               m::Gt(match_bitcast_f16(0), match_bitcast_f16(1))) ||
+         Match(comp->root_instruction(),
+               m::Gt(match_bitcast_f16_with_convert(0),
+                     match_bitcast_f16_with_convert(1))) ||
          Match(comp->root_instruction(), m::Gt(match_s32(0), match_s32(1)));
 }
 
@@ -199,7 +237,8 @@ StatusOr<bool> TopkRewriter::TransformToCustomCall(
       const PrimitiveType element_type = data->shape().element_type();
 
       if ((data->shape().rank() != 1 && data->shape().rank() != 2) ||
-          (element_type != F32 && element_type != BF16)) {
+          (element_type != F32 && element_type != BF16 &&
+           element_type != F16 && element_type != S32)) {
         continue;
       }
 
@@ -266,5 +266,77 @@ ENTRY cluster {
   EXPECT_THAT(cc->custom_call_target(), "TopK");
 }
 
+TEST_F(TopkRewriterTest, RewriteF16) {
+  const std::string hlo_string = R"(
+HloModule module
+
+%compare {
+  %p.0.lhs = f16[] parameter(0)
+  %bitcast-convert = s16[] bitcast-convert(%p.0.lhs)
+  %constant = s16[] constant(0)
+  %compare = pred[] compare(%bitcast-convert, %constant), direction=LT
+  %constant.1 = u16[] constant(32767)
+  %bitcast-convert.1 = u16[] bitcast-convert(%p.0.lhs)
+  %subtract = u16[] subtract(%constant.1, %bitcast-convert.1)
+  %bitcast-convert.2 = s16[] bitcast-convert(%subtract)
+  %select = s16[] select(%compare, %bitcast-convert.2, %bitcast-convert)
+  %p.0.rhs = f16[] parameter(1)
+  %bitcast-convert.3 = s16[] bitcast-convert(%p.0.rhs)
+  %compare.1 = pred[] compare(%bitcast-convert.3, %constant), direction=LT
+  %bitcast-convert.4 = u16[] bitcast-convert(%p.0.rhs)
+  %subtract.1 = u16[] subtract(%constant.1, %bitcast-convert.4)
+  %bitcast-convert.5 = s16[] bitcast-convert(%subtract.1)
+  %select.1 = s16[] select(%compare.1, %bitcast-convert.5, %bitcast-convert.3)
+  ROOT %compare.2 = pred[] compare(%select, %select.1), direction=GT
+}
+
+ENTRY cluster {
+  %arg_tuple.1 = f16[8,1234567] parameter(0)
+  %sort.27 = f16[8,1234567] sort(%arg_tuple.1), dimensions={1}, is_stable=true, to_apply=%compare
+  ROOT %slice.29 = f16[8,5] slice(%sort.27), slice={[0:8], [0:5]}
+})";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TopkRewriter rewriter(
+      [](const HloSortInstruction*, int64_t) { return true; });
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, rewriter.Run(module.get()));
+  TF_ASSERT_OK(HloDCE().Run(module.get()).status());
+  EXPECT_TRUE(changed);
+  EXPECT_THAT(module->entry_computation()->root_instruction(),
+              op::GetTupleElement(op::CustomCall(op::Parameter(0)), 0));
+  const HloInstruction* cc =
+      module->entry_computation()->root_instruction()->operand(0);
+  EXPECT_THAT(cc->custom_call_target(), "TopK");
+}
+
+TEST_F(TopkRewriterTest, RewriteS32) {
+  const std::string hlo_string = R"(
+HloModule module
+
+%compare {
+  %p.0.lhs = s32[] parameter(0)
+  %p.0.rhs = s32[] parameter(1)
+  ROOT %compare = pred[] compare(%p.0.lhs, %p.0.rhs), direction=GT
+}
+
+ENTRY cluster {
+  %arg_tuple.1 = s32[8,1234567] parameter(0)
+  %sort.27 = s32[8,1234567] sort(%arg_tuple.1), dimensions={1}, is_stable=true, to_apply=%compare
+  ROOT %slice.29 = s32[8,5] slice(%sort.27), slice={[0:8], [0:5]}
+})";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TopkRewriter rewriter(
+      [](const HloSortInstruction*, int64_t) { return true; });
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, rewriter.Run(module.get()));
+  TF_ASSERT_OK(HloDCE().Run(module.get()).status());
+  EXPECT_TRUE(changed);
+  EXPECT_THAT(module->entry_computation()->root_instruction(),
+              op::GetTupleElement(op::CustomCall(op::Parameter(0)), 0));
+  const HloInstruction* cc =
+      module->entry_computation()->root_instruction()->operand(0);
+  EXPECT_THAT(cc->custom_call_target(), "TopK");
+}
+
 }  // namespace
 }  // namespace xla
@@ -20,28 +20,24 @@ limitations under the License.
 
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/hlo/ir/hlo_module.h"
-#include "xla/service/hlo_pass_interface.h"
+#include "xla/service/hlo_computation_pass.h"
 
 namespace xla {
 
 // A pass which simplifies patterns of Tuple and GetTupleElement instructions in
 // the module.
-class TupleSimplifier : public HloModulePass {
+class TupleSimplifier : public HloComputationPass {
  public:
   TupleSimplifier() : TupleSimplifier(/*exclude_entry_computation=*/false) {}
   explicit TupleSimplifier(bool exclude_entry_computation);
   ~TupleSimplifier() override {}
   absl::string_view name() const override { return "tuple-simplifier"; }
 
+ private:
   // Run tuple simplification on the given computation. Returns whether the
   // computation was changed.
-  using HloPassInterface::Run;
-  using HloPassInterface::RunOnModuleGroup;
-  StatusOr<bool> Run(
-      HloModule* module,
-      const absl::flat_hash_set<absl::string_view>& execution_threads) override;
+  StatusOr<bool> RunOnComputation(HloComputation* computation) override;
 
- private:
   // When set, this pipeline stage will perform optimization of all computations
   // apart from the module's entry computation. This is used by Graphcore's
   // backend.
@@ -29,6 +29,7 @@ limitations under the License.
 #include "xla/hlo/ir/hlo_computation.h"
 #include "xla/hlo/ir/hlo_instruction.h"
 #include "xla/service/hlo_parser.h"
+#include "tsl/platform/cpu_info.h"
 #include "tsl/platform/env.h"
 #include "tsl/platform/logging.h"
 #include "tsl/platform/path.h"
@@ -45,6 +46,25 @@ Status OverrideConfig(const hlo_module_loader_details::Config& ovr_config,
   return OkStatus();
 }
 
+// Builds the module of `proto`, consuming it so that its computations and large
+// constants aren't held in memory twice.
+StatusOr<std::unique_ptr<HloModule>> LoadModuleFromSnapshot(
+    HloSnapshot proto, const DebugOptions& debug_options,
+    const hlo_module_loader_details::Config& ovr_config,
+    const std::function<void(HloModuleConfig*)>& config_modifier_hook) {
+  TF_ASSIGN_OR_RETURN(HloModuleConfig config,
+                      HloModule::CreateModuleConfigFromProto(
+                          proto.hlo().hlo_module(), debug_options));
+  TF_RETURN_IF_ERROR(OverrideConfig(ovr_config, &config));
+  if (config_modifier_hook) {
+    config_modifier_hook(&config);
+  }
+  HloModule::IncrementalLoadingOptions options;
+  options.lazy_constant_dir = ovr_config.lazy_constant_dir;
+  return HloModule::CreateFromProtoIncrementally(
+      std::move(*proto.mutable_hlo()->mutable_hlo_module()), config, options);
+}
+
 }  // namespace
 
 std::string StripLogHeaders(const std::string& hlo_string) {
@@ -79,8 +99,9 @@ StatusOr<std::unique_ptr<HloModule>> LoadModuleFromData(
     if (config_modifier_hook) {
       config_modifier_hook(&config);
     }
-    TF_ASSIGN_OR_RETURN(module,
-                        ParseAndReturnUnverifiedModule(hlo_string, config));
+    TF_ASSIGN_OR_RETURN(module, ParseAndReturnUnverifiedModuleInParallel(
+                                    hlo_string, config,
+                                    tsl::port::MaxParallelism()));
   } else {
     HloSnapshot proto;
     if (format == "pb") {
@@ -103,15 +124,9 @@ StatusOr<std::unique_ptr<HloModule>> LoadModuleFromData(
           "or pbtxt",
           format);
     }
-    TF_ASSIGN_OR_RETURN(HloModuleConfig config,
-                        HloModule::CreateModuleConfigFromProto(
-                            proto.hlo().hlo_module(), debug_options));
-    TF_RETURN_IF_ERROR(OverrideConfig(ovr_config, &config));
-    if (config_modifier_hook) {
-      config_modifier_hook(&config);
-    }
     TF_ASSIGN_OR_RETURN(
-        module, HloModule::CreateFromProto(proto.hlo().hlo_module(), config));
+        module, LoadModuleFromSnapshot(std::move(proto), debug_options,
+                                       ovr_config, config_modifier_hook));
   }
   return std::move(module);
 }
@@ -124,6 +139,21 @@ StatusOr<std::unique_ptr<HloModule>> LoadModuleFromFile(
   if (format.empty()) {
     format = std::string(tsl::io::Extension(path));
   }
+  if (format == "pb") {
+    // Parses the proto straight from the file, without holding its contents
+    // in memory as well.
+    tsl::Env* env = tsl::Env::Default();
+    HloSnapshot proto;
+    if (!tsl::ReadBinaryProto(env, path, &proto).ok() &&
+        !tsl::ReadBinaryProto(env, path, proto.mutable_hlo()).ok() &&
+        !tsl::ReadBinaryProto(env, path,
+                              proto.mutable_hlo()->mutable_hlo_module())
+             .ok()) {
+      return InvalidArgument("Failed to parse input as HLO protobuf binary");
+    }
+    return LoadModuleFromSnapshot(std::move(proto), GetDebugOptionsFromFlags(),
+                                  ovr_config, config_modifier_hook);
+  }
   TF_RETURN_IF_ERROR(tsl::ReadFileToString(tsl::Env::Default(), path, &data));
   return LoadModuleFromData(data, format, ovr_config, config_modifier_hook);
 }
@@ -30,6 +30,9 @@ struct Config {
   Config() {}
   int64_t num_replicas = 1;
   int64_t num_partitions = 1;
+  // If not empty, large constants of modules loaded from protos are kept in
+  // files in this directory until they are used.
+  std::string lazy_constant_dir;
 };
 
 }  // namespace hlo_module_loader_details
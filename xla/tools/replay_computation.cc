@@ -29,7 +29,9 @@ limitations under the License.
 //
 // Computations that require arguments can be replayed using fake data by
 // passing --use_fake_data on the command line.  If the real data is available
-// in the proto and --use_fake_data is false, the real data is used.
+// in the proto and --use_fake_data is false, the real data is used.  Real data
+// can also be passed with --arguments_file as a flat literal file (see
+// xla/flat_literal_file.h), which is memory-mapped instead of parsed.
 //
 // Input can be a binary HloSnapshot proto, a binary HloProto proto, or a
 // textual HLO string.
@@ -51,6 +53,7 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "absl/types/span.h"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "xla/client/client.h"
@@ -61,6 +64,7 @@ limitations under the License.
 #include "xla/client/xla_computation.h"
 #include "xla/debug_options_flags.h"
 #include "xla/execution_options_util.h"
+#include "xla/flat_literal_file.h"
 #include "xla/literal.h"
 #include "xla/service/hlo.pb.h"
 #include "xla/service/hlo_parser.h"
@@ -88,7 +92,9 @@ namespace {
 struct Options {
   Options() {}
 
-  bool NeedsRealData() const { return !use_fake_data && !compile_only; }
+  bool NeedsRealData() const {
+    return !use_fake_data && !compile_only && arguments_file.empty();
+  }
 
   std::string fake_infeed_shape;
   std::string fake_outfeed_shape;
@@ -109,10 +115,18 @@ struct Options {
   int intra_op_thread_pool_size = -1;
 
   bool compile_only = false;
+
+  // Flat literal files holding a tuple of the arguments, and to write the
+  // result to.
+  std::string arguments_file;
+  std::string result_file;
 };
 
+// `arguments`, if not null, holds the arguments to use instead of the ones
+// recorded in `module`.
 StatusOr<std::unique_ptr<LocalExecutable>> CompileExecutable(
-    const HloSnapshot& module, LocalClient* client, const Options& opts) {
+    const HloSnapshot& module, const FlatLiteralFile* arguments,
+    LocalClient* client, const Options& opts) {
   XlaComputation computation(module.hlo().hlo_module());
   std::vector<Shape> argument_layouts;
   argument_layouts.reserve(
@@ -124,6 +138,11 @@ StatusOr<std::unique_ptr<LocalExecutable>> CompileExecutable(
       argument_layouts.push_back(Shape(param));
       argument_layout_ptrs.push_back(&argument_layouts.back());
     }
+  } else if (arguments != nullptr) {
+    for (const Shape& shape : arguments->literal().shape().tuple_shapes()) {
+      argument_layouts.push_back(shape);
+      argument_layout_ptrs.push_back(&argument_layouts.back());
+    }
   } else {
     for (const auto& proto : module.arguments()) {
       if (!proto.has_shape()) {
@@ -220,7 +239,8 @@ std::optional<Shape> GetXfeedShape(bool is_infeed, const HloModuleProto& module,
 }
 
 // Invokes the given computation passing arbitrary data for every (unbound)
-// parameter if use_fake_data, Otherwise use recorded data if available.
+// parameter if use_fake_data, Otherwise use `arguments` if not null, or
+// recorded data if available.
 //
 // Similarly, infeeds fake data of shape fake_infeed_shape if it is provided.
 // If generate_fake_infeed is true, the required infeed shape is derived from
@@ -229,6 +249,7 @@ std::optional<Shape> GetXfeedShape(bool is_infeed, const HloModuleProto& module,
 // If neither generate_fake_infeed is true nor a fake_infeed_shape is provided,
 // no infeed is performed.
 StatusOr<Literal> ReplayComputation(const HloSnapshot& module,
+                                    const FlatLiteralFile* arguments,
                                     LocalExecutable* executable,
                                     LocalClient* client, const Options& opts) {
   XlaComputation computation(module.hlo().hlo_module());
@@ -259,6 +280,20 @@ StatusOr<Literal> ReplayComputation(const HloSnapshot& module,
           client->GlobalDataToShapedBuffer(data->handle(), /*replica_number=*/0)
               .value());
     }
+  } else if (arguments != nullptr) {
+    // The elements of the mapped literal are transferred without copying them
+    // into an owned Literal first.
+    for (int64_t i = 0;
+         i < ShapeUtil::TupleElementCount(arguments->literal().shape()); ++i) {
+      TF_ASSIGN_OR_RETURN(
+          ScopedShapedBuffer data,
+          client->LiteralToShapedBuffer(LiteralSlice(arguments->literal(), {i}),
+                                        /*device_ordinal=*/0));
+      scoped_shaped_buffer_arguments.push_back(std::move(data));
+    }
+    for (const auto& argument : scoped_shaped_buffer_arguments) {
+      argument_ptrs.push_back(&argument);
+    }
   } else {  // use recorded data if available
     for (const auto& proto : module.arguments()) {
       TF_ASSIGN_OR_RETURN(Literal literal, Literal::CreateFromProto(proto));
@@ -454,6 +489,17 @@ int RealMain(absl::Span<char* const> args, const Options& opts) {
   LocalClient* client = ClientLibrary::LocalClientOrDie();
   int exit_status = EXIT_SUCCESS;
 
+  std::unique_ptr<FlatLiteralFile> arguments;
+  if (!opts.arguments_file.empty() && !opts.use_fake_data) {
+    StatusOr<std::unique_ptr<FlatLiteralFile>> maybe_arguments =
+        FlatLiteralFile::Open(opts.arguments_file);
+    QCHECK(maybe_arguments.ok()) << maybe_arguments.status();
+    arguments = std::move(maybe_arguments).value();
+    QCHECK(arguments->literal().shape().IsTuple())
+        << opts.arguments_file << " must hold a tuple of arguments, not "
+        << ShapeUtil::HumanString(arguments->literal().shape());
+  }
+
   std::vector<HloSnapshot> snapshots;
   for (char* arg : args) {
     StatusOr<std::vector<HloSnapshot>> maybe_snapshot =
@@ -480,9 +526,11 @@ int RealMain(absl::Span<char* const> args, const Options& opts) {
         /*low_latency_hint=*/false);
     executables.resize(snapshots.size());
     for (int64_t i = 0; i < snapshots.size(); ++i) {
-      thread_pool.Schedule([&snapshots, &executables, client, i, &opts] {
-        executables[i] = CompileExecutable(snapshots[i], client, opts);
-      });
+      thread_pool.Schedule(
+          [&snapshots, &executables, &arguments, client, i, &opts] {
+            executables[i] = CompileExecutable(snapshots[i], arguments.get(),
+                                               client, opts);
+          });
     }
   }
   LOG(INFO) << "Done compiling; now running the modules.";
@@ -501,8 +549,8 @@ int RealMain(absl::Span<char* const> args, const Options& opts) {
 
     LocalExecutable* executable = executables[i].value().get();
     LOG(ERROR) << "Running iteration " << i;
-    StatusOr<Literal> result_status =
-        ReplayComputation(snapshots[i], executable, client, opts);
+    StatusOr<Literal> result_status = ReplayComputation(
+        snapshots[i], arguments.get(), executable, client, opts);
     LOG(ERROR) << "iteration complete.";
     if (!result_status.ok()) {
       fprintf(stderr, "%s: error: %s\n", args[i],
@@ -511,8 +559,21 @@ int RealMain(absl::Span<char* const> args, const Options& opts) {
       continue;
     }
 
+    Literal result = std::move(result_status).value();
+    if (!opts.result_file.empty()) {
+      // With several modules, each result gets its own file.
+      std::string result_file =
+          executables.size() == 1 ? opts.result_file
+                                  : absl::StrCat(opts.result_file, ".", i);
+      Status status = FlatLiteralFile::Write(result, result_file);
+      if (!status.ok()) {
+        fprintf(stderr, "%s: error writing %s: %s\n", args[i],
+                result_file.c_str(), status.ToString().c_str());
+        exit_status = EXIT_FAILURE;
+      }
+    }
+
     if (opts.print_result) {
-      Literal result = std::move(result_status).value();
       fprintf(stdout, "%s: %s :: %s:%s\n", args[i],
               executable->executable()->module().name().c_str(),
               ShapeUtil::HumanString(result.shape()).c_str(),
@@ -561,6 +622,13 @@ int main(int argc, char** argv) {
       tsl::Flag("compile_only", &opts.compile_only,
                 "Whether the input should only be compiled, as opposed "
                 "to compiled and executed."),
+      tsl::Flag("arguments_file", &opts.arguments_file,
+                "A flat literal file holding a tuple with the arguments of "
+                "the computations. It is memory-mapped and used instead of "
+                "the arguments recorded in the HloSnapshot."),
+      tsl::Flag("result_file", &opts.result_file,
+                "If set, the result of each computation is written to this "
+                "path as a flat literal file."),
   };
   xla::AppendDebugOptionsFlags(&flag_list);
   std::string usage = tsl::Flags::Usage(argv[0], flag_list);
@@ -27,11 +27,13 @@ limitations under the License.
 #include "xla/client/lib/testing.h"
 #include "xla/debug_options_flags.h"
 #include "xla/error_spec.h"
+#include "xla/flat_literal_file.h"
 #include "xla/hlo/ir/hlo_module.h"
 #include "xla/literal.h"
 #include "xla/literal_comparison.h"
 #include "xla/service/hlo_runner.h"
 #include "xla/service/hlo_verifier.h"
+#include "xla/shape_util.h"
 #include "xla/tests/test_utils.h"
 #include "xla/tools/hlo_control_flow_flattening.h"
 #include "xla/tools/hlo_module_loader.h"
@@ -163,6 +165,29 @@ Status RunAndCompare(
       }
     }
   }
+  // Arguments from a flat literal file take precedence over the ones above.
+  if (!options.flat_arguments_file.empty()) {
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<FlatLiteralFile> file,
+                        FlatLiteralFile::Open(options.flat_arguments_file));
+    const Shape& shape = file->literal().shape();
+    if (!shape.IsTuple() ||
+        ShapeUtil::TupleElementCount(shape) != args.size()) {
+      return InvalidArgument(
+          "Expected %s to hold a tuple of %d arguments, but its shape is %s",
+          options.flat_arguments_file, args.size(),
+          ShapeUtil::HumanString(shape));
+    }
+    for (int i = 0; i < args.size(); ++i) {
+      LiteralSlice arg(file->literal(), {i});
+      if (!literal_comparison::EqualShapes(args[i].shape(), arg.shape())
+               .ok()) {
+        return InvalidArgument(
+            "Failed to use %s for argument %d because of a shape mismatch.",
+            options.flat_arguments_file, i);
+      }
+      args[i] = arg.Clone();
+    }
+  }
   if (options.print_literals) {
     for (int i = 0; i < args.size(); ++i) {
       std::cout << "\n** Argument " << i << " **\n"
@@ -195,6 +220,10 @@ Status RunAndCompare(
               << " **\n"
               << test_result.ToString() << "\n";
   }
+  if (!options.flat_result_file.empty()) {
+    TF_RETURN_IF_ERROR(
+        FlatLiteralFile::Write(test_result, options.flat_result_file));
+  }
   if (iteration_literals_proto != nullptr) {
     LiteralProto test_result_proto = test_result.ToProto();
     iteration_literals_proto->mutable_result()->Swap(&test_result_proto);
@@ -236,10 +265,12 @@ Status RunAndCompare(
     std::function<Status(const HloModule&, HloRunnerInterface*, HloModule*)>
         reference_module_modifier_hook,
     std::function<void(HloModuleConfig*)> config_modifier_hook) {
+  hlo_module_loader_details::Config loader_config;
+  loader_config.lazy_constant_dir = options.lazy_constant_dir;
   TF_ASSIGN_OR_RETURN(
       auto test_module,
-      LoadModuleFromFile(hlo_filename, hlo_module_loader_details::Config(),
-                         options.input_format, config_modifier_hook));
+      LoadModuleFromFile(hlo_filename, loader_config, options.input_format,
+                         config_modifier_hook));
   return RunAndCompare(std::move(test_module), test_runner, reference_runner,
                        engine, options, iteration_literals_proto,
                        reference_module_modifier_hook, config_modifier_hook);
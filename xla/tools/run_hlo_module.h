@@ -47,7 +47,10 @@ struct RunHloModuleOptions {
         input_module(""),
         iterations(1),
         output_literals_file(""),
-        input_literals_file("") {}
+        input_literals_file(""),
+        flat_arguments_file(""),
+        flat_result_file(""),
+        lazy_constant_dir("") {}
   std::string platform;
   std::string reference_platform;
   bool print_literals;
@@ -63,6 +66,9 @@ struct RunHloModuleOptions {
   int iterations;
   std::string output_literals_file;
   std::string input_literals_file;
+  std::string flat_arguments_file;
+  std::string flat_result_file;
+  std::string lazy_constant_dir;
 };
 
 // Runs test_module on the platform with the name
@@ -122,7 +122,19 @@ int main(int argc, char** argv) {
       tsl::Flag(
           "iterations", &opts.iterations,
           "The number of times to run the module. Each iteration will be run "
-          "with different input data.")};
+          "with different input data."),
+      tsl::Flag("flat_arguments_file", &opts.flat_arguments_file,
+                "A path to a flat literal file (see xla/flat_literal_file.h) "
+                "holding a tuple with one element per module parameter. The "
+                "file is memory-mapped and used instead of generated "
+                "arguments."),
+      tsl::Flag("flat_result_file", &opts.flat_result_file,
+                "If set, the result of running the module on the test "
+                "platform is written to this path as a flat literal file."),
+      tsl::Flag("lazy_constant_dir", &opts.lazy_constant_dir,
+                "If set, the large constants of a module read from a binary "
+                "or text proto are kept in files in this directory until "
+                "they are used, instead of in memory.")};
   xla::AppendDebugOptionsFlags(&flag_list);
   // The usage string includes the message at the top of the file, the
   // DebugOptions flags and the flags defined above.
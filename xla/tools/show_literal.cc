@@ -13,15 +13,17 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
-// Usage: show_literal <path-to-serialized-literal-proto>
+// Usage: show_literal <path-to-serialized-literal>
 //
 // Dumps out the Literal::ToString of a tsl::WriteBinaryProto format
-// Literal serialized on disk.
+// Literal serialized on disk, or of a literal in a FlatLiteralFile.
 
 #include <stdio.h>
 
+#include <memory>
 #include <string>
 
+#include "xla/flat_literal_file.h"
 #include "xla/literal.h"
 #include "xla/types.h"
 #include "xla/xla_data.pb.h"
@@ -35,7 +37,14 @@ int main(int argc, char **argv) {
 
   if (argc < 2) {
     LOG(QFATAL) << "Usage: " << argv[0]
-                << " <path-to-serialized-literal-proto>";
+                << " <path-to-serialized-literal>";
+  }
+
+  if (xla::FlatLiteralFile::IsFlatLiteralFile(argv[1]).value()) {
+    std::unique_ptr<xla::FlatLiteralFile> file =
+        xla::FlatLiteralFile::Open(argv[1]).value();
+    fprintf(stderr, "%s\n", file->literal().ToString().c_str());
+    return 0;
   }
 
   xla::LiteralProto literal_proto;